@@ -3,12 +3,17 @@
 #include <ert/job_queue/job_node.hpp>
 #include <ert/job_queue/queue_driver.hpp>
 
+/**
+   An append-only list of the nodes in a job queue. The index of a node in the
+   list is its queue_index, which stays valid for the lifetime of the list.
+   Nodes can be added from any thread; reading the size and the nodes never
+   blocks.
+*/
 typedef struct job_list_struct job_list_type;
 
 job_list_type *job_list_alloc();
 void job_list_free(job_list_type *job_list);
 void job_list_add_job(job_list_type *job_list, job_queue_node_type *job_node);
 size_t job_list_get_size(const job_list_type *job_list);
-void job_list_get_wrlock(job_list_type *list);
-void job_list_get_rdlock(job_list_type *list);
-void job_list_unlock(job_list_type *list);
+job_queue_node_type *job_list_iget_job(const job_list_type *job_list,
+                                       int queue_index);
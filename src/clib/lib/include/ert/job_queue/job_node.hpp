@@ -1,11 +1,23 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <memory>
 #include <optional>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <ert/job_queue/queue_driver.hpp>
+#include <ert/job_queue/status_notifier.hpp>
 #include <filesystem>
 namespace fs = std::filesystem;
 
+/** The number of nodes in each status, indexed by the bit number of the
+ * status, i.e. JOB_QUEUE_RUNNING = 1 << 4 is counted at index 4. */
+typedef std::array<std::atomic<int>, JOB_QUEUE_MAX_STATE>
+    job_status_counts_type;
+
 /**
    This struct holds the job_queue information about one job. Observe
    the following:
@@ -42,8 +54,18 @@ struct job_queue_node_struct {
     pthread_mutex_t data_mutex;
     /** Driver specific data about this job - fully handled by the driver. */
     void *job_data = nullptr;
+    /** The number of status queries which use the job_data without holding
+     * the data_mutex, see job_queue_node_refresh_status_many(). */
+    int job_data_users = 0;
+    /** The job_data of jobs which were killed during such a query; they are
+     * freed when the last query is done with them. */
+    std::vector<void *> orphaned_job_data{};
     /** When did the job change status -> RUNNING - the LAST TIME. */
     time_t sim_start = 0;
+    /** Where status changes are reported, set when added to a queue. */
+    std::shared_ptr<ert::StatusNotifier> status_notifier{};
+    /** The status counts of the queue, set when added to a queue. */
+    std::shared_ptr<job_status_counts_type> status_counts{};
 };
 
 typedef struct job_queue_node_struct job_queue_node_type;
@@ -60,5 +82,26 @@ job_queue_node_get_status(const job_queue_node_type *node);
 int job_queue_node_get_queue_index(const job_queue_node_type *node);
 void job_queue_node_set_queue_index(job_queue_node_type *node, int queue_index);
 
+/** Sets the status of the node; the caller must hold its data_mutex. */
 extern "C" void job_queue_node_set_status(job_queue_node_type *node,
                                           job_status_type new_status);
+/** Same as job_queue_node_set_status(), for callers which do not hold the
+ * data_mutex of the node, e.g. Python. */
+extern "C" void job_queue_node_lock_and_set_status(job_queue_node_type *node,
+                                                   job_status_type new_status);
+/** The index of status in job_status_counts_type. */
+int job_status_index(job_status_type status);
+
+submit_status_type job_queue_node_submit(job_queue_node_type *node,
+                                         queue_driver_type *driver);
+std::vector<submit_status_type>
+job_queue_node_submit_many(const std::vector<job_queue_node_type *> &nodes,
+                           queue_driver_type *driver);
+bool job_queue_node_kill(job_queue_node_type *node, queue_driver_type *driver);
+std::optional<queue_driver_job_accounting>
+job_queue_node_get_accounting(job_queue_node_type *node,
+                              queue_driver_type *driver);
+std::vector<std::pair<int, std::optional<std::string>>>
+job_queue_node_refresh_status_many(
+    const std::vector<job_queue_node_type *> &nodes,
+    queue_driver_type *driver);
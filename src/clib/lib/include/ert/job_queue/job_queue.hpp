@@ -1,12 +1,48 @@
 #pragma once
+#include <array>
 #include <ctime>
+#include <optional>
+#include <string>
+#include <vector>
 #include <pthread.h>
 
 #include <ert/job_queue/job_node.hpp>
 #include <ert/job_queue/queue_driver.hpp>
+#include <ert/job_queue/status_notifier.hpp>
 
 typedef struct job_queue_struct job_queue_type;
 extern "C" job_queue_type *job_queue_alloc(queue_driver_type *driver);
 extern "C" void job_queue_free(job_queue_type *);
 extern "C" int job_queue_add_job_node(job_queue_type *queue,
                                       job_queue_node_type *node);
+
+typedef struct job_queue_engine_struct job_queue_engine_type;
+
+/** A change of status of one node, as observed by the polling engine. */
+struct job_queue_transition {
+    int queue_index;
+    job_status_type status;
+    std::optional<std::string> message;
+};
+
+void job_queue_engine_start(job_queue_type *queue, int num_workers);
+void job_queue_engine_stop(job_queue_type *queue);
+void job_queue_engine_submit(job_queue_type *queue, job_queue_node_type *node);
+void job_queue_engine_submit_many(
+    job_queue_type *queue, const std::vector<job_queue_node_type *> &nodes);
+void job_queue_engine_kill(job_queue_type *queue, job_queue_node_type *node);
+std::vector<job_queue_transition>
+job_queue_engine_get_transitions(job_queue_type *queue);
+
+/** The file descriptor which becomes readable when nodes change status. */
+int job_queue_get_status_notifier_fd(const job_queue_type *queue);
+/** Appends the status changes of the nodes since the previous call to changes,
+ * see ert::StatusNotifier::drain(). */
+bool job_queue_drain_status_changes(
+    job_queue_type *queue,
+    std::vector<ert::StatusNotifier::status_change> &changes);
+
+/** The number of nodes in the queue in each status, indexed like
+ * job_status_counts_type. */
+std::array<int, JOB_QUEUE_MAX_STATE>
+job_queue_get_status_counts(const job_queue_type *queue);
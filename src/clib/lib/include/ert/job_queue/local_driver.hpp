@@ -11,6 +11,9 @@ void *local_driver_submit_job(void *_driver, std::string submit_cmd,
 void local_driver_kill_job(void *_driver, void *_job);
 void local_driver_free_(void *_driver);
 job_status_type local_driver_get_job_status(void *_driver, void *_job);
+void local_driver_get_job_status_batch(void *_driver, void *const *jobs,
+                                       size_t num_jobs,
+                                       job_status_type *status);
 void local_driver_free_job(void *_job);
 bool local_driver_set_option(void *_driver, const char *option_key,
                              const void *value_);
@@ -1,6 +1,9 @@
 #pragma once
 #include <ert/job_queue/queue_driver.hpp>
+#include <map>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 /*
   The options supported by the LSF driver.
@@ -20,10 +23,27 @@
 #define LSF_SUBMIT_SLEEP "SUBMIT_SLEEP"
 #define LSF_EXCLUDE_HOST "EXCLUDE_HOST"
 #define LSF_PROJECT_CODE "PROJECT_CODE"
+#define LSF_COMMAND_TIMEOUT "COMMAND_TIMEOUT"
+/** Ask 'bjobs -json' for the status of the jobs of the driver only. */
+#define LSF_BJOBS_JSON "BJOBS_JSON"
+/** Submit the jobs which are submitted together as LSF job arrays. */
+#define LSF_ARRAY_SUBMIT "ARRAY_SUBMIT"
+/** Keep one shell running on a remote LSF_SERVER for all the commands. */
+#define LSF_PERSISTENT_SHELL "PERSISTENT_SHELL"
+/** The most bsub commands which run at the same time. */
+#define LSF_SUBMIT_WORKERS "SUBMIT_WORKERS"
+/** The most bsub commands per second, after a burst of SUBMIT_BURST; 0 is no
+ * limit. */
+#define LSF_SUBMIT_RATE "SUBMIT_RATE"
+#define LSF_SUBMIT_BURST "SUBMIT_BURST"
 
 #define LOCAL_LSF_SERVER "LOCAL"
 #define NULL_LSF_SERVER "NULL"
 #define DEFAULT_SUBMIT_SLEEP "0"
+#define LSF_DEFAULT_COMMAND_TIMEOUT "60"
+#define DEFAULT_SUBMIT_WORKERS "1"
+#define DEFAULT_SUBMIT_RATE "0"
+#define DEFAULT_SUBMIT_BURST "1"
 
 #define JOB_STAT_NULL 0
 #define JOB_STAT_PEND 1
@@ -45,23 +65,43 @@ typedef enum {
 typedef struct lsf_driver_struct lsf_driver_type;
 typedef struct lsf_job_struct lsf_job_type;
 
+/** What 'bhist -l' shows about a job, see lsf_driver_parse_bhist(). */
+struct lsf_job_history {
+    int status = JOB_STAT_NULL;
+    queue_driver_job_accounting accounting;
+};
+
 const std::vector<std::string> LSF_DRIVER_OPTIONS = {
-    LSF_QUEUE,        LSF_RESOURCE,      LSF_SERVER,       LSF_RSH_CMD,
-    LSF_LOGIN_SHELL,  LSF_BSUB_CMD,      LSF_BJOBS_CMD,    LSF_BKILL_CMD,
-    LSF_BHIST_CMD,    LSF_BJOBS_TIMEOUT, LSF_DEBUG_OUTPUT, LSF_SUBMIT_SLEEP,
-    LSF_EXCLUDE_HOST, LSF_PROJECT_CODE};
+    LSF_QUEUE,        LSF_RESOURCE,      LSF_SERVER,          LSF_RSH_CMD,
+    LSF_LOGIN_SHELL,  LSF_BSUB_CMD,      LSF_BJOBS_CMD,       LSF_BKILL_CMD,
+    LSF_BHIST_CMD,    LSF_BJOBS_TIMEOUT, LSF_DEBUG_OUTPUT,    LSF_SUBMIT_SLEEP,
+    LSF_EXCLUDE_HOST, LSF_PROJECT_CODE,  LSF_COMMAND_TIMEOUT, LSF_BJOBS_JSON,
+    LSF_ARRAY_SUBMIT, LSF_PERSISTENT_SHELL, LSF_SUBMIT_WORKERS,
+    LSF_SUBMIT_RATE,  LSF_SUBMIT_BURST};
 
 void lsf_job_free(lsf_job_type *job);
 
 void *lsf_driver_alloc();
 void *lsf_driver_submit_job(void *_driver, std::string submit_cmd, int num_cpu,
                             fs::path run_path, std::string job_name);
+void lsf_driver_submit_job_batch(void *_driver,
+                                 const queue_driver_submit_args *jobs,
+                                 size_t num_jobs, void **job_data);
 job_status_type lsf_driver_convert_status(int lsf_status);
 void lsf_driver_kill_job(void *_driver, void *_job);
 void lsf_driver_free_(void *_driver);
 void lsf_driver_free(lsf_driver_type *driver);
 job_status_type lsf_driver_get_job_status(void *_driver, void *_job);
+void lsf_driver_get_job_status_batch(void *_driver, void *const *jobs,
+                                     size_t num_jobs,
+                                     job_status_type *status);
 int lsf_driver_get_job_status_lsf(void *_driver, void *_job);
+bool lsf_driver_get_job_accounting(void *_driver, void *_job,
+                                   queue_driver_job_accounting *accounting);
+std::vector<std::unordered_map<std::string, std::string>>
+lsf_driver_parse_bjobs_json(std::string_view output);
+std::map<std::string, lsf_job_history>
+lsf_driver_parse_bhist(const std::string &output);
 void lsf_driver_free_job(void *_job);
 void lsf_driver_set_bjobs_refresh_interval(lsf_driver_type *driver,
                                            int refresh_interval);
@@ -75,4 +115,5 @@ const void *lsf_driver_get_option(const void *_driver, const char *option_key);
 bool lsf_driver_set_option(void *_driver, const char *option_key,
                            const void *value);
 bool lsf_driver_has_project_code(const lsf_driver_type *driver);
+int lsf_job_parse_bsub_output(const char *bsub_cmd, const std::string &output);
 int lsf_job_parse_bsub_stdout(const char *bsub_cmd, const char *stdout_file);
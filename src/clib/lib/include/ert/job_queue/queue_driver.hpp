@@ -1,6 +1,9 @@
 #pragma once
+#include <cstdint>
 #include <ert/job_queue/job_status.hpp>
 #include <filesystem>
+#include <optional>
+#include <string>
 
 namespace fs = std::filesystem;
 
@@ -16,8 +19,40 @@ using queue_driver_type = struct queue_driver_struct;
 
 using submit_job_ftype = void *(void *, std::string, int, fs::path,
                                 std::string);
+
+/** The arguments of one job for queue_driver_submit_job_batch(). */
+struct queue_driver_submit_args {
+    std::string run_cmd;
+    int num_cpu;
+    fs::path run_path;
+    std::string job_name;
+};
+using submit_job_batch_ftype = void(void *, const queue_driver_submit_args *,
+                                    size_t, void **);
+/**
+   What the queue system has recorded about the resources used by a job, for
+   queue_driver_get_accounting(); a field is left out when the queue system
+   has not reported it.
+*/
+struct queue_driver_job_accounting {
+    std::optional<int> exit_code;
+    /** The signal which killed the job, 0 if none. */
+    std::optional<int> exit_signal;
+    /** The time the job has been running, in seconds. */
+    std::optional<double> elapsed;
+    /** The largest resident set size of the job, in bytes. */
+    std::optional<int64_t> max_rss;
+    /** The nodes the job ran on, in the notation of the queue system. */
+    std::string node_list;
+    /** The time from the submission until the job started, in seconds. */
+    std::optional<double> pending_time;
+};
+using get_accounting_ftype = bool(void *, void *,
+                                  queue_driver_job_accounting *);
 using kill_job_ftype = void(void *, void *);
 using get_status_ftype = job_status_type(void *, void *);
+using get_status_batch_ftype = void(void *, void *const *, size_t,
+                                    job_status_type *);
 using free_job_ftype = void(void *);
 using free_queue_driver_ftype = void(void *);
 using set_option_ftype = bool(void *, const char *, const void *);
@@ -28,10 +63,18 @@ extern "C" queue_driver_type *queue_driver_alloc(job_driver_type type);
 void *queue_driver_submit_job(queue_driver_type *driver, std::string run_cmd,
                               int num_cpu, const fs::path run_path,
                               std::string job_name);
+void queue_driver_submit_job_batch(queue_driver_type *driver,
+                                   const queue_driver_submit_args *jobs,
+                                   size_t num_jobs, void **job_data);
 void queue_driver_free_job(queue_driver_type *driver, void *job_data);
 void queue_driver_kill_job(queue_driver_type *driver, void *job_data);
 job_status_type queue_driver_get_status(queue_driver_type *driver,
                                         void *job_data);
+void queue_driver_get_status_batch(queue_driver_type *driver,
+                                   void *const *job_data, size_t num_jobs,
+                                   job_status_type *status);
+bool queue_driver_get_accounting(queue_driver_type *driver, void *job_data,
+                                 queue_driver_job_accounting *accounting);
 extern "C" bool queue_driver_set_option(queue_driver_type *driver,
                                         const char *option_key,
                                         const void *value);
@@ -39,7 +82,7 @@ extern "C" const void *queue_driver_get_option(queue_driver_type *driver,
                                                const char *option_key);
 extern "C" void queue_driver_free(queue_driver_type *driver);
 
-using submit_status_type = enum {
+typedef enum {
     SUBMIT_OK = 0,
     /** Typically no more attempts. */
     SUBMIT_JOB_FAIL = 1,
@@ -48,4 +91,4 @@ using submit_status_type = enum {
     /** The queue is currently not accepting more jobs
      * - either (temporarilty) because of pause or it is going down. */
     SUBMIT_QUEUE_CLOSED = 3
-};
+} submit_status_type;
@@ -0,0 +1,67 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <ert/job_queue/spawn.hpp>
+
+namespace ert {
+/**
+   A shell which is kept running on a remote host, e.g. started with
+   "ssh <host> sh", and runs the commands given to run() one at a time, so
+   that each command does not pay for a connection of its own.
+
+   The commands are written to the stdin of the shell. After each command the
+   shell prints a line with a sentinel, which is unique to the command, and
+   the exit status to stdout, and the sentinel to stderr; the output of the
+   command is what comes before the sentinels. The shell is started at the
+   first command, and again after it has exited or a command has not
+   completed in time.
+*/
+class RemoteShell {
+public:
+    /** The command which starts the shell, the shell reads commands from its
+     * stdin. */
+    explicit RemoteShell(std::vector<std::string> argv);
+    ~RemoteShell();
+    RemoteShell(const RemoteShell &) = delete;
+    RemoteShell &operator=(const RemoteShell &) = delete;
+
+    /**
+       Runs the command in the shell, with the input on its stdin, and returns
+       its stdout, stderr and wait status as spawn_capture() does. The stdin of
+       the command is /dev/null when there is no input. If the command has not
+       completed within the timeout, the shell is stopped.
+
+       A command is tried once more in a new shell if the shell had exited
+       before the command could be given to it. Safe to call from several
+       threads; the commands are run one at a time.
+    */
+    spawn_output
+    run(const std::string &command,
+        std::optional<std::string_view> input = std::nullopt,
+        std::optional<std::chrono::milliseconds> timeout = std::nullopt);
+
+private:
+    using deadline_type =
+        std::optional<std::chrono::steady_clock::time_point>;
+
+    bool start(deadline_type deadline);
+    void stop();
+    bool running();
+    bool exchange(std::string_view script, const std::string &sentinel,
+                  spawn_output &output, deadline_type deadline,
+                  bool &written);
+
+    std::vector<std::string> argv;
+    std::mutex mutex;
+    spawn_session_process process;
+    /** Makes the sentinels of this shell unique. */
+    std::string session_id;
+    uint64_t num_commands = 0;
+};
+} // namespace ert
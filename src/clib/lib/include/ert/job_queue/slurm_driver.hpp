@@ -2,9 +2,11 @@
 
 #include <filesystem>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <ert/job_queue/job_status.hpp>
+#include <ert/job_queue/queue_driver.hpp>
 
 namespace fs = std::filesystem;
 
@@ -20,8 +22,15 @@ typedef struct slurm_driver_struct slurm_driver_type;
 #define SLURM_SCANCEL_OPTION "SCANCEL"
 #define SLURM_SCONTROL_OPTION "SCONTROL"
 #define SLURM_SQUEUE_OPTION "SQUEUE"
+#define SLURM_SACCT_OPTION "SACCT"
 #define SLURM_PARTITION_OPTION "PARTITION"
 #define SLURM_SQUEUE_TIMEOUT_OPTION "SQUEUE_TIMEOUT"
+// With SQUEUE_ITERATE set to True the status is read from one long running
+// 'squeue --iterate' command instead of one squeue call per SQUEUE_TIMEOUT.
+#define SLURM_SQUEUE_ITERATE_OPTION "SQUEUE_ITERATE"
+// The deadline in seconds for each call of sbatch, squeue, scontrol and
+// scancel; a command which does not complete in time is killed.
+#define SLURM_COMMAND_TIMEOUT_OPTION "COMMAND_TIMEOUT"
 
 // Observe that the SLURM_MAX_RUNTIME_OPTION expects a time limit in seconds,
 // whereas slurm uses a time limit in minutes
@@ -39,13 +48,24 @@ typedef struct slurm_driver_struct slurm_driver_type;
 #define SLURM_EXCLUDE_HOST_OPTION "EXCLUDE_HOST"
 #define SLURM_INCLUDE_HOST_OPTION "INCLUDE_HOST"
 
+// With ARRAY_SUBMIT set to True the jobs which are submitted together are
+// submitted as one job array, with one array task per realization.
+#define SLURM_ARRAY_SUBMIT_OPTION "ARRAY_SUBMIT"
+
+// With PACK_SIZE set to K > 1 up to K realizations which are submitted
+// together are packed into one allocation, where each of them runs as a step
+// of its own. The status of the steps is read with sacct.
+#define SLURM_PACK_SIZE_OPTION "PACK_SIZE"
+
 const std::vector<std::string> SLURM_DRIVER_OPTIONS = {
     SLURM_SBATCH_OPTION,         SLURM_SCONTROL_OPTION,
     SLURM_SQUEUE_OPTION,         SLURM_SCANCEL_OPTION,
     SLURM_PARTITION_OPTION,      SLURM_SQUEUE_TIMEOUT_OPTION,
     SLURM_MAX_RUNTIME_OPTION,    SLURM_MEMORY_OPTION,
     SLURM_MEMORY_PER_CPU_OPTION, SLURM_INCLUDE_HOST_OPTION,
-    SLURM_EXCLUDE_HOST_OPTION};
+    SLURM_EXCLUDE_HOST_OPTION,   SLURM_COMMAND_TIMEOUT_OPTION,
+    SLURM_SACCT_OPTION,          SLURM_ARRAY_SUBMIT_OPTION,
+    SLURM_SQUEUE_ITERATE_OPTION, SLURM_PACK_SIZE_OPTION};
 
 void *slurm_driver_alloc();
 void slurm_driver_free(slurm_driver_type *driver);
@@ -56,6 +76,19 @@ bool slurm_driver_set_option(void *_driver, const char *option_key,
                              const void *value);
 void *slurm_driver_submit_job(void *_driver, std::string cmd, int num_cpu,
                               fs::path run_path, std::string job_name);
+void slurm_driver_submit_job_batch(void *_driver,
+                                   const queue_driver_submit_args *jobs,
+                                   size_t num_jobs, void **job_data);
 job_status_type slurm_driver_get_job_status(void *_driver, void *_job);
+void slurm_driver_get_job_status_batch(void *_driver, void *const *jobs,
+                                       size_t num_jobs,
+                                       job_status_type *status);
+bool slurm_driver_get_job_accounting(void *_driver, void *_job,
+                                     queue_driver_job_accounting *accounting);
 void slurm_driver_kill_job(void *_driver, void *_job);
 void slurm_driver_free_job(void *_job);
+std::unordered_map<std::string, job_status_type> slurm_driver_parse_sacct(
+    const std::string &sacct_output,
+    std::unordered_map<std::string, std::string> *step_ids = nullptr,
+    std::unordered_map<std::string, queue_driver_job_accounting> *accounting =
+        nullptr);
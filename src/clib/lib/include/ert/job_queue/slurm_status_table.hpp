@@ -0,0 +1,76 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include <ert/job_queue/job_status.hpp>
+
+namespace ert {
+/**
+  The key of a job in the status table: the job id in the upper 32 bits, and
+  in the lower the kind of id in two bits followed by the task id or the pack
+  index, i.e. 1 << 30 | 5 for "1234_5" and 2 << 30 | 5 for "1234.pack5". The
+  key of an id which is none of these is 0.
+*/
+uint64_t slurm_job_key(std::string_view string_id);
+
+/**
+  An immutable open addressing hash table from the keys of the jobs to their
+  status. The slots are kept in one array of a power of two size which is at
+  most half full, and a key is found by linear probing from its hash; a
+  lookup usually reads one or two cache lines, and does not allocate.
+*/
+class SlurmStatusTable {
+public:
+    explicit SlurmStatusTable(size_t num_jobs) {
+        size_t capacity = 16;
+        while (capacity < 2 * num_jobs)
+            capacity *= 2;
+        this->slots.resize(capacity);
+        this->mask = capacity - 1;
+    }
+
+    /** Adds the job, which must not be in the table already. */
+    void insert(uint64_t key, job_status_type status) {
+        size_t index = hash(key) & this->mask;
+        while (this->slots[index].key != 0)
+            index = (index + 1) & this->mask;
+        this->slots[index] = {key, status};
+    }
+
+    std::optional<job_status_type> find(uint64_t key) const {
+        if (key == 0)
+            return std::nullopt;
+        for (size_t index = hash(key) & this->mask;;
+             index = (index + 1) & this->mask) {
+            const auto &slot = this->slots[index];
+            if (slot.key == key)
+                return slot.status;
+            if (slot.key == 0)
+                return std::nullopt;
+        }
+    }
+
+private:
+    struct slot_type {
+        /** 0 for an empty slot. */
+        uint64_t key = 0;
+        job_status_type status = JOB_QUEUE_NOT_ACTIVE;
+    };
+
+    /** The finalizer of MurmurHash3, which mixes the job id and the task. */
+    static size_t hash(uint64_t key) {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return static_cast<size_t>(key);
+    }
+
+    std::vector<slot_type> slots;
+    size_t mask;
+};
+} // namespace ert
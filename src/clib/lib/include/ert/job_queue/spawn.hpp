@@ -1,10 +1,133 @@
 #pragma once
+#include <chrono>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <sys/wait.h>
 pid_t spawn(const char *executable, int argc, const char **argv,
             const char *stdout_file, const char *stderr_file);
 pid_t spawn(char *const argv[], const char *stdout_file,
             const char *stderr_file);
-int spawn_blocking(const char *executable, int argc, const char **argv,
-                   const char *stdout_file, const char *stderr_file);
-int spawn_blocking(char *const argv[], const char *stdout_file,
-                   const char *stderr_file);
+
+/**
+   Runs the command and returns its wait status. If the command has not
+   completed within the timeout its process group is killed, and the wait
+   status of the killed command is returned.
+*/
+int spawn_blocking(
+    const char *executable, int argc, const char **argv,
+    const char *stdout_file, const char *stderr_file,
+    std::optional<std::chrono::milliseconds> timeout = std::nullopt);
+int spawn_blocking(
+    char *const argv[], const char *stdout_file, const char *stderr_file,
+    std::optional<std::chrono::milliseconds> timeout = std::nullopt);
+
+/** The result of running a command with spawn_capture(). */
+struct spawn_output {
+    /** The wait status of the command, as for spawn_blocking(). */
+    int status = -1;
+    std::string out;
+    std::string err;
+    /** The command did not complete within the timeout, and was killed. */
+    bool timed_out = false;
+    /** The output could not be read to the end, e.g. because poll() failed;
+     * the command was waited for as usual. */
+    bool read_failed = false;
+};
+
+/**
+   Runs the command and returns its stdout and stderr, which are read through
+   pipes instead of temporary files. If the command has not completed within
+   the timeout its process group is killed, and the output so far is returned.
+   Without a timeout the command is never killed; give none for a command
+   which must not be stopped halfway, e.g. a submit command, which might
+   already have submitted the job when it is killed, so that submitting it
+   again would run the job twice. The input, when given, is written to the
+   stdin of the command, which otherwise has its stdin closed.
+*/
+spawn_output
+spawn_capture(char *const argv[],
+              std::optional<std::chrono::milliseconds> timeout = std::nullopt,
+              std::optional<std::string_view> input = std::nullopt);
+spawn_output
+spawn_capture(const char *executable, int argc, const char **argv,
+              std::optional<std::chrono::milliseconds> timeout = std::nullopt,
+              std::optional<std::string_view> input = std::nullopt);
+
+/** A long running command started with spawn_stream(). */
+struct spawn_stream_process {
+    pid_t pid = -1;
+    /** The read end of a pipe from the stdout of the command. */
+    int out_fd = -1;
+};
+
+/**
+   Starts the command with its stdout connected to a pipe, which the caller
+   reads while the command runs; stderr is discarded. The command runs until
+   it exits or is stopped with spawn_stream_stop().
+*/
+spawn_stream_process spawn_stream(char *const argv[]);
+/** Kills the command if it is still running, closes the pipe and returns the
+ * wait status of the command. */
+int spawn_stream_stop(spawn_stream_process &process);
+
+/** A long running command started with spawn_session(). */
+struct spawn_session_process {
+    pid_t pid = -1;
+    /** The write end of a socket to the stdin of the command, which does not
+     * block; write to it with send(..., MSG_NOSIGNAL). */
+    int in_fd = -1;
+    /** The read ends of pipes from the stdout and stderr of the command. */
+    int out_fd = -1;
+    int err_fd = -1;
+};
+
+/**
+   Starts the command with its stdin, stdout and stderr connected to the
+   caller, which writes input to it and reads its output while it runs. The
+   command runs until it exits or is stopped with spawn_session_stop().
+*/
+spawn_session_process spawn_session(char *const argv[]);
+/** Closes the stdin of the command, kills it if it is still running, closes
+ * the pipes and returns the wait status of the command. */
+int spawn_session_stop(spawn_session_process &process);
+
+/**
+   The spawn server is a small helper process, forked from this process while
+   it is still small, which runs the commands of spawn_blocking() on its
+   behalf. This keeps the cost of starting a command independent of the size
+   of this process, and commands can be started concurrently.
+
+   When the server is not running, or cannot take a request, spawn_blocking()
+   starts the command itself. The server should be started before any threads
+   are created, and stops when this process exits or spawn_server_stop() is
+   called.
+*/
+bool spawn_server_start();
+void spawn_server_stop();
+bool spawn_server_is_running();
+/** Runs the command through the spawn server and returns its wait status, or
+ * nothing if the server could not take the request. */
+std::optional<int> spawn_server_run(char *const argv[], const char *stdout_file,
+                                    const char *stderr_file);
+
+/** A command started by the spawn server, which is not a child of this
+ * process; wait for it with spawn_server_wait(). */
+struct spawn_server_process {
+    pid_t pid;
+    int channel;
+};
+/** Starts the command through the spawn server, with stdout and stderr
+ * redirected to the given files or file descriptors, and stdin read from
+ * stdin_fd when it is given. Returns nothing if the server could not take the
+ * request. */
+std::optional<spawn_server_process>
+spawn_server_start_process(char *const argv[], const char *stdout_file,
+                           const char *stderr_file, int stdout_fd = -1,
+                           int stderr_fd = -1, int stdin_fd = -1);
+/** Waits for the command to complete, and returns its wait status. */
+int spawn_server_wait(const spawn_server_process &process);
+/** Waits at most timeout for the command to complete, without taking its
+ * wait status; returns false if it is still running. */
+bool spawn_server_wait_for(const spawn_server_process &process,
+                           std::chrono::milliseconds timeout);
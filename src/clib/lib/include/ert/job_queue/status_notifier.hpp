@@ -0,0 +1,65 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <ert/job_queue/job_status.hpp>
+
+namespace ert {
+/**
+   Passes status changes from the threads which update the job queue nodes to
+   one consumer, typically the asyncio event loop of JobQueue.execute().
+
+   The changes are pushed into a bounded lock-free ring, and the consumer is
+   woken up through a file descriptor (an eventfd on Linux, a pipe elsewhere)
+   which becomes readable when there are changes to drain. The descriptor is
+   only written to when the consumer has drained all earlier changes, so a
+   burst of changes costs one wakeup.
+
+   If the ring is full the change is dropped and the next drain() reports that
+   changes have been lost; the consumer must then fall back to reading the
+   status of every node.
+*/
+class StatusNotifier {
+public:
+    static constexpr size_t CAPACITY = 4096;
+
+    struct status_change {
+        int queue_index;
+        job_status_type status;
+    };
+
+    StatusNotifier();
+    ~StatusNotifier();
+    StatusNotifier(const StatusNotifier &) = delete;
+    StatusNotifier &operator=(const StatusNotifier &) = delete;
+
+    /** The file descriptor which becomes readable when there are changes. */
+    int fd() const { return read_fd; }
+
+    /** Records a status change; safe to call from any number of threads. */
+    void push(int queue_index, job_status_type status);
+
+    /** Appends all pending changes, in the order they were pushed, to changes
+     * and clears the file descriptor. Must only be called from one thread at a
+     * time. Returns false if changes have been lost since the previous call. */
+    bool drain(std::vector<status_change> &changes);
+
+private:
+    struct cell {
+        std::atomic<size_t> sequence;
+        status_change change;
+    };
+
+    void signal();
+
+    std::unique_ptr<cell[]> cells;
+    alignas(64) std::atomic<size_t> tail{0};
+    alignas(64) size_t head = 0;
+    std::atomic<bool> signalled{false};
+    std::atomic<bool> overflowed{false};
+    int read_fd = -1;
+    int write_fd = -1;
+};
+} // namespace ert
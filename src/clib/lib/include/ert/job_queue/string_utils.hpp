@@ -7,6 +7,7 @@
 #include <fmt/format.h>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 
 /// strdup with realloc
 static char *restrdup(char *old_string, const char *src) {
@@ -96,6 +97,57 @@ static inline bool sscanf_int(const char *buffer, int *value) {
     return value_OK;
 }
 
+/**
+    Parses:
+
+      1 , T (not 't') , True (with any case) => true
+      0 , F (not 'f') , False(with any case) => false
+
+    Otherwise, set _value to false and return false.
+*/
+static inline bool sscanf_bool(const char *buffer, bool *_value) {
+    if (!buffer) {
+        if (_value)
+            *_value = false;
+        return false;
+    }
+
+    bool parse_OK = false;
+    bool value = false; /* Compiler shut up */
+
+    if (strcmp(buffer, "1") == 0) {
+        parse_OK = true;
+        value = true;
+    } else if (strcmp(buffer, "0") == 0) {
+        parse_OK = true;
+        value = false;
+    } else if (strcmp(buffer, "T") == 0) {
+        parse_OK = true;
+        value = true;
+    } else if (strcmp(buffer, "F") == 0) {
+        parse_OK = true;
+        value = false;
+    } else {
+        size_t size = strlen(buffer);
+        char *local_buffer = strndup(buffer, size);
+        for (size_t i = 0; i < size; i++)
+            local_buffer[i] = toupper(local_buffer[i]);
+
+        if (strcmp(local_buffer, "TRUE") == 0) {
+            parse_OK = true;
+            value = true;
+        } else if (strcmp(local_buffer, "FALSE") == 0) {
+            parse_OK = true;
+            value = false;
+        }
+
+        free(local_buffer);
+    }
+    if (_value != NULL)
+        *_value = value;
+    return parse_OK;
+}
+
 /** Repositions the stream pointer at the the first
    occurence of 'string'. If 'string' is found the function will
    return true, otherwise the function will return false, and stream
@@ -215,3 +267,17 @@ static inline char *saprintf(const char *fmt, ...) {
     }
     return s;
 }
+
+/** Quotes the value as one word for a POSIX shell. Within single quotes only
+ * a single quote is special, and it is written as '\''. */
+static inline std::string shell_quote(std::string_view value) {
+    std::string quoted = "'";
+    for (char c : value) {
+        if (c == '\'')
+            quoted += "'\\''";
+        else
+            quoted += c;
+    }
+    quoted += "'";
+    return quoted;
+}
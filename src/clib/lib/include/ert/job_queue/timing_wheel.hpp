@@ -0,0 +1,66 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace ert {
+/**
+   A hierarchical timing wheel which keeps track of deadlines for a large
+   number of timers, e.g. the next time each node of the job queue should be
+   polled.
+
+   Time is measured in integer ticks; it is up to the user what a tick is.
+   Level 0 has one slot per tick, level 1 has one slot per SLOTS ticks and so
+   on, so scheduling and cancelling a timer is O(1), and advancing the wheel is
+   O(1) per tick plus the number of expired timers. A timer is identified by a
+   non-negative integer id, and scheduling an id which is already scheduled
+   moves the deadline of that timer.
+*/
+class TimingWheel {
+public:
+    static constexpr int SLOT_BITS = 6;
+    static constexpr int SLOTS = 1 << SLOT_BITS;
+    static constexpr int LEVELS = 4;
+
+    explicit TimingWheel(uint64_t now = 0) : current(now) {}
+
+    /** Schedules the timer id to expire at tick deadline. Deadlines which are
+     * not in the future expire at the next tick. */
+    void schedule(int id, uint64_t deadline);
+    void cancel(int id);
+    bool is_scheduled(int id) const { return timers.count(id) > 0; }
+    size_t size() const { return timers.size(); }
+    uint64_t now() const { return current; }
+
+    /** Advances the wheel to tick now, and appends the ids of all the timers
+     * which have expired, in deadline order, to expired. */
+    void advance(uint64_t now, std::vector<int> &expired);
+
+private:
+    struct entry {
+        int id;
+        uint64_t deadline;
+        uint64_t generation;
+    };
+
+    struct timer {
+        uint64_t deadline;
+        uint64_t generation;
+    };
+
+    bool is_current(const entry &e) const;
+    void insert(const entry &e);
+    void cascade(int level);
+
+    uint64_t current;
+    uint64_t next_generation = 0;
+    /** Entries which are cancelled or rescheduled are left in the slots, and
+     * are dropped when they are found to not match the timer anymore. */
+    std::unordered_map<int, timer> timers;
+    std::array<std::array<std::vector<entry>, SLOTS>, LEVELS> slots;
+    /** Entries too far into the future to fit in the top level. */
+    std::vector<entry> overflow;
+};
+} // namespace ert
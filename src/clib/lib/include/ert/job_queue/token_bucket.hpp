@@ -0,0 +1,40 @@
+#pragma once
+#include <chrono>
+#include <mutex>
+
+namespace ert {
+/**
+   A token bucket which limits the rate of an operation, e.g. of submitting
+   jobs: tokens are added at a steady rate, and up to burst tokens are saved
+   up while the operation is idle, so that a burst of operations can start at
+   once before the rate applies.
+
+   A caller which finds the bucket empty reserves the next token which will
+   be added, so the callers are served in order, and only the time until
+   that token waits.
+*/
+class TokenBucket {
+public:
+    using clock = std::chrono::steady_clock;
+
+    /** A rate of 0 tokens per second is no limit. */
+    explicit TokenBucket(double rate = 0.0, double burst = 1.0);
+
+    /** Changes the rate and the burst; the bucket is filled. */
+    void configure(double rate, double burst);
+
+    /** Takes a token, and returns the time at which it may be used, which is
+     * now unless the bucket is empty. Safe to call from several threads. */
+    clock::time_point reserve(clock::time_point now);
+
+    /** Takes a token, and waits until it may be used. */
+    void acquire();
+
+private:
+    std::mutex mutex;
+    double rate;
+    double burst;
+    double tokens;
+    clock::time_point last_update;
+};
+} // namespace ert
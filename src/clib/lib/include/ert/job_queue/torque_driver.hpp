@@ -8,6 +8,7 @@
 /* The options supported by the Torque driver. */
 
 #define TORQUE_CLUSTER_LABEL "CLUSTER_LABEL"
+#define TORQUE_COMMAND_TIMEOUT "COMMAND_TIMEOUT"
 #define TORQUE_DEBUG_OUTPUT "DEBUG_OUTPUT"
 #define TORQUE_JOB_PREFIX_KEY "JOB_PREFIX"
 #define TORQUE_KEEP_QSUB_OUTPUT "KEEP_QSUB_OUTPUT"
@@ -28,6 +29,7 @@
 #define TORQUE_DEFAULT_QDEL_CMD "qdel"
 #define TORQUE_DEFAULT_SUBMIT_SLEEP "0"
 #define TORQUE_DEFAULT_QUEUE_QUERY_TIMEOUT "126"
+#define TORQUE_DEFAULT_COMMAND_TIMEOUT "60"
 
 typedef struct torque_driver_struct torque_driver_type;
 typedef struct torque_job_struct torque_job_type;
@@ -37,7 +39,7 @@ const std::vector<std::string> TORQUE_DRIVER_OPTIONS = {
     TORQUE_KEEP_QSUB_OUTPUT,    TORQUE_MEMORY_PER_JOB, TORQUE_NUM_CPUS_PER_NODE,
     TORQUE_NUM_NODES,           TORQUE_QDEL_CMD,       TORQUE_QSTAT_CMD,
     TORQUE_QSTAT_OPTIONS,       TORQUE_QSUB_CMD,       TORQUE_QUEUE,
-    TORQUE_QUEUE_QUERY_TIMEOUT, TORQUE_SUBMIT_SLEEP};
+    TORQUE_QUEUE_QUERY_TIMEOUT, TORQUE_SUBMIT_SLEEP,   TORQUE_COMMAND_TIMEOUT};
 
 void *torque_driver_alloc();
 
@@ -49,6 +51,9 @@ void torque_driver_kill_job(void *_driver, void *_job);
 void torque_driver_free_(void *_driver);
 void torque_driver_free(torque_driver_type *driver);
 job_status_type torque_driver_get_job_status(void *_driver, void *_job);
+void torque_driver_get_job_status_batch(void *_driver, void *const *jobs,
+                                        size_t num_jobs,
+                                        job_status_type *status);
 void torque_driver_free_job(void *_job);
 
 const void *torque_driver_get_option(const void *_driver,
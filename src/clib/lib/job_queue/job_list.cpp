@@ -1,45 +1,75 @@
-#include <pthread.h>
-#include <vector>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <string>
 
 #include <ert/job_queue/job_list.hpp>
 #include <ert/job_queue/job_node.hpp>
 
+namespace {
+constexpr size_t JOB_LIST_CHUNK_BITS = 10;
+constexpr size_t JOB_LIST_CHUNK_SIZE = size_t(1) << JOB_LIST_CHUNK_BITS;
+/** With 1024 nodes per chunk this allows for four million nodes. */
+constexpr size_t JOB_LIST_MAX_CHUNKS = 4096;
+
+using job_list_chunk = std::array<job_queue_node_type *, JOB_LIST_CHUNK_SIZE>;
+} // namespace
+
+/**
+   The nodes are stored in fixed size chunks which are never moved or freed
+   before the list itself, so a node pointer can be read without locking once
+   its index is below the published size. Appending is serialized by the
+   add_mutex, and only allocates when a chunk is full.
+*/
 struct job_list_struct {
-    std::vector<job_queue_node_type *> vec_jobs{};
-    pthread_rwlock_t lock;
+    std::array<std::atomic<job_list_chunk *>, JOB_LIST_MAX_CHUNKS> chunks{};
+    std::atomic<size_t> size{0};
+    std::mutex add_mutex;
 };
 
-job_list_type *job_list_alloc() {
-    auto job_list = new job_list_type;
-    pthread_rwlock_init(&job_list->lock, nullptr);
-    return job_list;
-}
+job_list_type *job_list_alloc() { return new job_list_type; }
 
 void job_list_add_job(job_list_type *job_list, job_queue_node_type *job_node) {
-    unsigned long queue_index = job_list->vec_jobs.size();
+    std::lock_guard guard{job_list->add_mutex};
+    size_t queue_index = job_list->size.load(std::memory_order_relaxed);
+    size_t chunk_index = queue_index >> JOB_LIST_CHUNK_BITS;
+    if (chunk_index >= JOB_LIST_MAX_CHUNKS)
+        throw std::length_error("Too many jobs in the job list");
+
+    auto chunk = job_list->chunks[chunk_index].load(std::memory_order_relaxed);
+    if (chunk == nullptr) {
+        chunk = new job_list_chunk{};
+        job_list->chunks[chunk_index].store(chunk, std::memory_order_release);
+    }
+
     job_queue_node_set_queue_index(job_node, static_cast<int>(queue_index));
-    job_list->vec_jobs.push_back(job_node);
+    (*chunk)[queue_index & (JOB_LIST_CHUNK_SIZE - 1)] = job_node;
+    job_list->size.store(queue_index + 1, std::memory_order_release);
 }
 
 size_t job_list_get_size(const job_list_type *job_list) {
-    return job_list->vec_jobs.size();
+    return job_list->size.load(std::memory_order_acquire);
 }
 
-void job_list_free(job_list_type *job_list) {
-    for (auto &vec_job : job_list->vec_jobs)
-        job_queue_node_free(vec_job);
-    job_list->vec_jobs.clear();
-    delete job_list;
-}
+job_queue_node_type *job_list_iget_job(const job_list_type *job_list,
+                                       int queue_index) {
+    if (queue_index < 0 ||
+        static_cast<size_t>(queue_index) >= job_list_get_size(job_list))
+        throw std::out_of_range("No job with queue index " +
+                                std::to_string(queue_index));
 
-void job_list_get_wrlock(job_list_type *list) {
-    pthread_rwlock_wrlock(&list->lock);
+    auto chunk = job_list->chunks[queue_index >> JOB_LIST_CHUNK_BITS].load(
+        std::memory_order_acquire);
+    return (*chunk)[queue_index & (JOB_LIST_CHUNK_SIZE - 1)];
 }
 
-void job_list_get_rdlock(job_list_type *list) {
-    pthread_rwlock_rdlock(&list->lock);
-}
+void job_list_free(job_list_type *job_list) {
+    size_t size = job_list_get_size(job_list);
+    for (size_t i = 0; i < size; i++)
+        job_queue_node_free(job_list_iget_job(job_list, static_cast<int>(i)));
 
-void job_list_unlock(job_list_type *list) {
-    pthread_rwlock_unlock(&list->lock);
+    for (auto &chunk : job_list->chunks)
+        delete chunk.load();
+    delete job_list;
 }
@@ -2,9 +2,12 @@
 #include <fstream>
 #include <string>
 
+#include <algorithm>
 #include <cstdlib>
 #include <pthread.h>
+#include <stdexcept>
 #include <tuple>
+#include <vector>
 
 #include <ert/logging.hpp>
 
@@ -128,6 +131,14 @@ job_queue_node_type *job_queue_node_alloc(const char *job_name,
     return node;
 }
 
+int job_status_index(job_status_type status) {
+    for (int index = 0; index < JOB_QUEUE_MAX_STATE; index++)
+        if (status == (1 << index))
+            return index;
+    throw std::invalid_argument(
+        fmt::format("Invalid job status: {}", static_cast<int>(status)));
+}
+
 void job_queue_node_set_status(job_queue_node_type *node,
                                job_status_type new_status) {
     if (new_status == node->job_status)
@@ -135,7 +146,13 @@ void job_queue_node_set_status(job_queue_node_type *node,
 
     logger->debug("Set {}({}) to {}", node->job_name, node->queue_index,
                   job_status_names.at(new_status));
+    if (node->status_counts) {
+        (*node->status_counts)[job_status_index(node->job_status)]--;
+        (*node->status_counts)[job_status_index(new_status)]++;
+    }
     node->job_status = new_status;
+    if (node->status_notifier)
+        node->status_notifier->push(node->queue_index, new_status);
 
     // We record sim start when the node is in state JOB_QUEUE_WAITING to be
     // sure that we do not miss the start time completely for very fast jobs
@@ -147,137 +164,407 @@ void job_queue_node_set_status(job_queue_node_type *node,
         return;
 }
 
-ERT_CLIB_SUBMODULE("queue", m) {
-    using namespace py::literals;
-    m.def("_refresh_status", [](Cwrap<job_queue_node_type> node,
-                                Cwrap<queue_driver_type> driver) {
-        // release the GIL
-        py::gil_scoped_release release;
+void job_queue_node_lock_and_set_status(job_queue_node_type *node,
+                                        job_status_type new_status) {
+    pthread_mutex_lock(&node->data_mutex);
+    job_queue_node_set_status(node, new_status);
+    pthread_mutex_unlock(&node->data_mutex);
+}
 
-        pthread_mutex_lock(&node->data_mutex);
-        job_status_type current_status = job_queue_node_get_status(node);
+/**
+   Checks that a node registered as running has actually started, i.e. that
+   the STATUS file is present. If it has not started within
+   MAX_CONFIRMED_WAIT the node is set to JOB_QUEUE_DO_KILL_NODE_FAILURE. The
+   caller must hold the data_mutex of the node.
+*/
+static void
+job_queue_node_confirm_running(job_queue_node_type *node,
+                               job_status_type &current_status,
+                               std::optional<std::string> &error_msg) {
+    if (current_status & JOB_QUEUE_RUNNING && !node->confirmed_running) {
+        node->confirmed_running =
+            fs::exists(node->run_path / fs::path(status_file));
+
+        if (!node->confirmed_running) {
+            if ((time(nullptr) - node->sim_start) >= MAX_CONFIRMED_WAIT) {
+                error_msg = fmt::format(
+                    "max_confirm_wait ({}) has passed since sim_start"
+                    "without success; {} is assumed dead (attempt {})",
+                    MAX_CONFIRMED_WAIT, node->job_name, node->submit_attempt);
+                logger->info(error_msg.value());
+                job_queue_node_set_status(node, JOB_QUEUE_DO_KILL_NODE_FAILURE);
+                current_status = JOB_QUEUE_DO_KILL_NODE_FAILURE;
+            }
+        }
+    }
+}
+
+/**
+   Records a status obtained from the driver on the node. The caller must
+   hold the data_mutex of the node.
+*/
+static void job_queue_node_update_status(job_queue_node_type *node,
+                                         job_status_type new_status) {
+    if (new_status == JOB_QUEUE_EXIT)
+        job_queue_node_fscanf_EXIT(node);
+
+    job_queue_node_set_status(node, new_status);
+}
+
+/**
+   Refreshes the status of one node: checks that a node registered as running
+   has actually started (the STATUS file is present), asks the driver for an
+   updated status and returns the resulting status along with an optional error
+   message. The caller must NOT hold the GIL.
+*/
+static std::pair<int, std::optional<std::string>>
+job_queue_node_refresh_status(job_queue_node_type *node,
+                              queue_driver_type *driver) {
+    pthread_mutex_lock(&node->data_mutex);
+    job_status_type current_status = job_queue_node_get_status(node);
+
+    if (!node->job_data) {
+        pthread_mutex_unlock(&node->data_mutex);
+        return std::make_pair<int, std::optional<std::string>>(
+            int(current_status), std::nullopt);
+    }
+
+    std::optional<std::string> error_msg = std::nullopt;
+    job_queue_node_confirm_running(node, current_status, error_msg);
 
-        if (!node->job_data) {
-            pthread_mutex_unlock(&node->data_mutex);
-            return std::make_pair<int, std::optional<std::string>>(
-                int(current_status), std::nullopt);
+    if (current_status & JOB_QUEUE_CAN_UPDATE_STATUS) {
+        job_status_type new_status;
+        try {
+            new_status = queue_driver_get_status(driver, node->job_data);
+        } catch (std::exception &err) {
+            new_status = JOB_QUEUE_STATUS_FAILURE;
+            error_msg = err.what();
         }
 
-        std::optional<std::string> error_msg = std::nullopt;
+        job_queue_node_update_status(node, new_status);
+        current_status = new_status;
+    }
 
-        if (current_status & JOB_QUEUE_RUNNING && !node->confirmed_running) {
-            node->confirmed_running =
-                fs::exists(node->run_path / fs::path(status_file));
+    if (node->fail_message.has_value() and !error_msg.has_value())
+        error_msg = node->fail_message;
 
-            if (!node->confirmed_running) {
-                if ((time(nullptr) - node->sim_start) >= MAX_CONFIRMED_WAIT) {
-                    error_msg = fmt::format(
-                        "max_confirm_wait ({}) has passed since sim_start"
-                        "without success; {} is assumed dead (attempt {})",
-                        MAX_CONFIRMED_WAIT, node->job_name,
-                        node->submit_attempt);
-                    logger->info(error_msg.value());
-                    job_queue_node_set_status(node,
-                                              JOB_QUEUE_DO_KILL_NODE_FAILURE);
-                    current_status = JOB_QUEUE_DO_KILL_NODE_FAILURE;
-                }
+    pthread_mutex_unlock(&node->data_mutex);
+    return std::make_pair(static_cast<int>(current_status), error_msg);
+}
+
+/**
+   Same as job_queue_node_refresh_status() for several nodes, but the driver
+   is asked for the status of all the nodes in one
+   queue_driver_get_status_batch() call. The nodes are not locked during the
+   driver call, which may take long, so that they can be killed or read in
+   the meantime: the job_data is marked as in use, and a job_data which is
+   killed meanwhile is left to this function to free, and its status is not
+   recorded. When the batch call fails the nodes are asked for one by one, so
+   that only the jobs whose status can not be read get
+   JOB_QUEUE_STATUS_FAILURE. A node which is given more than once is only
+   refreshed once. The caller must NOT hold the GIL.
+*/
+std::vector<std::pair<int, std::optional<std::string>>>
+job_queue_node_refresh_status_many(
+    const std::vector<job_queue_node_type *> &nodes,
+    queue_driver_type *driver) {
+    std::vector<job_queue_node_type *> unique_nodes(nodes);
+    std::sort(unique_nodes.begin(), unique_nodes.end());
+    unique_nodes.erase(std::unique(unique_nodes.begin(), unique_nodes.end()),
+                       unique_nodes.end());
+
+    std::vector<job_status_type> current_status(unique_nodes.size());
+    std::vector<std::optional<std::string>> error_msg(unique_nodes.size());
+    std::vector<size_t> queried;
+    std::vector<void *> job_data;
+    for (size_t i = 0; i < unique_nodes.size(); i++) {
+        auto node = unique_nodes[i];
+        pthread_mutex_lock(&node->data_mutex);
+        current_status[i] = job_queue_node_get_status(node);
+        if (node->job_data) {
+            job_queue_node_confirm_running(node, current_status[i],
+                                           error_msg[i]);
+            if (current_status[i] & JOB_QUEUE_CAN_UPDATE_STATUS) {
+                queried.push_back(i);
+                job_data.push_back(node->job_data);
+                node->job_data_users++;
             }
         }
+        pthread_mutex_unlock(&node->data_mutex);
+    }
 
-        if (current_status & JOB_QUEUE_CAN_UPDATE_STATUS) {
-            job_status_type new_status;
+    std::vector<job_status_type> new_status(queried.size());
+    std::vector<std::optional<std::string>> driver_error(queried.size());
+    try {
+        queue_driver_get_status_batch(driver, job_data.data(), job_data.size(),
+                                      new_status.data());
+    } catch (std::exception &batch_err) {
+        logger->warning("Failed to get the status of {} jobs due to {}",
+                        job_data.size(), batch_err.what());
+        for (size_t j = 0; j < queried.size(); j++) {
             try {
-                new_status = queue_driver_get_status(driver, node->job_data);
+                new_status[j] = queue_driver_get_status(driver, job_data[j]);
             } catch (std::exception &err) {
-                new_status = JOB_QUEUE_STATUS_FAILURE;
-                error_msg = err.what();
+                new_status[j] = JOB_QUEUE_STATUS_FAILURE;
+                driver_error[j] = err.what();
             }
+        }
+    }
 
-            if (new_status == JOB_QUEUE_EXIT)
-                job_queue_node_fscanf_EXIT(node);
-
-            job_queue_node_set_status(node, new_status);
-            current_status = new_status;
+    for (size_t j = 0; j < queried.size(); j++) {
+        auto i = queried[j];
+        auto node = unique_nodes[i];
+        pthread_mutex_lock(&node->data_mutex);
+        if (--node->job_data_users == 0) {
+            for (auto orphan : node->orphaned_job_data)
+                queue_driver_free_job(driver, orphan);
+            node->orphaned_job_data.clear();
         }
+        // The job may have been killed, and maybe submitted again, while the
+        // driver was asked
+        if (node->job_data == job_data[j] &&
+            job_queue_node_get_status(node) == current_status[i]) {
+            job_queue_node_update_status(node, new_status[j]);
+            current_status[i] = new_status[j];
+            if (driver_error[j].has_value())
+                error_msg[i] = driver_error[j];
+        } else
+            current_status[i] = job_queue_node_get_status(node);
+        pthread_mutex_unlock(&node->data_mutex);
+    }
 
-        if (node->fail_message.has_value() and !error_msg.has_value())
-            error_msg = node->fail_message;
+    for (size_t i = 0; i < unique_nodes.size(); i++) {
+        auto node = unique_nodes[i];
+        pthread_mutex_lock(&node->data_mutex);
+        if (node->job_data && node->fail_message.has_value() &&
+            !error_msg[i].has_value())
+            error_msg[i] = node->fail_message;
+        pthread_mutex_unlock(&node->data_mutex);
+    }
+
+    std::vector<std::pair<int, std::optional<std::string>>> results;
+    results.reserve(nodes.size());
+    for (auto node : nodes) {
+        auto i = std::lower_bound(unique_nodes.begin(), unique_nodes.end(),
+                                  node) -
+                 unique_nodes.begin();
+        results.emplace_back(static_cast<int>(current_status[i]),
+                             error_msg[i]);
+    }
+    return results;
+}
 
+/**
+   Submits the job of the node to the driver. The caller must NOT hold the
+   GIL.
+*/
+submit_status_type job_queue_node_submit(job_queue_node_type *node,
+                                         queue_driver_type *driver) {
+    pthread_mutex_lock(&node->data_mutex);
+    job_queue_node_set_status(node, JOB_QUEUE_SUBMITTED);
+    void *job_data = nullptr;
+    try {
+        job_data = queue_driver_submit_job(driver, node->run_cmd, node->num_cpu,
+                                           node->run_path, node->job_name);
+    } catch (std::exception &err) {
+        logger->warning("Failed to submit job {} (attempt {}) due to {}",
+                        node->job_name, node->submit_attempt, err.what());
         pthread_mutex_unlock(&node->data_mutex);
-        return std::make_pair(static_cast<int>(current_status), error_msg);
-    });
+        return SUBMIT_DRIVER_FAIL;
+    }
 
-    m.def("_submit", [](Cwrap<job_queue_node_type> node,
-                        Cwrap<queue_driver_type> driver) {
-        // release the GIL
-        py::gil_scoped_release release;
+    if (job_data == nullptr) {
+        // In this case the status of the job itself will be
+        // unmodified; i.e. it will still be WAITING, and a new attempt
+        // to submit it will be performed in the next round.
+        logger->warning("Failed to submit job {} (attempt {})", node->job_name,
+                        node->submit_attempt);
+        pthread_mutex_unlock(&node->data_mutex);
+        return SUBMIT_DRIVER_FAIL;
+    }
+
+    logger->info("Submitted job {} (attempt {})", node->job_name,
+                 node->submit_attempt);
+
+    node->job_data = job_data;
+    node->submit_attempt++;
+    // The status JOB_QUEUE_SUBMITTED is internal, and not exported anywhere.
+    // The job_queue_update_status() will update this to PENDING or RUNNING at
+    // the next call. The important difference between SUBMITTED and WAITING is
+    // that SUBMITTED have job_data != NULL and the job_queue_node free
+    // function must be called on it.
+    job_queue_node_set_status(node, JOB_QUEUE_SUBMITTED);
+    pthread_mutex_unlock(&node->data_mutex);
+    return SUBMIT_OK;
+}
 
+/**
+   Same as job_queue_node_submit() for several nodes, but the jobs are handed
+   to the driver in one queue_driver_submit_job_batch() call. The nodes are
+   locked in address order, so that concurrent calls can not deadlock, and
+   must all be different. The caller must NOT hold the GIL.
+*/
+std::vector<submit_status_type>
+job_queue_node_submit_many(const std::vector<job_queue_node_type *> &nodes,
+                           queue_driver_type *driver) {
+    std::vector<job_queue_node_type *> locked(nodes);
+    std::sort(locked.begin(), locked.end());
+    for (auto node : locked)
         pthread_mutex_lock(&node->data_mutex);
+
+    std::vector<queue_driver_submit_args> jobs;
+    jobs.reserve(nodes.size());
+    for (auto node : nodes) {
         job_queue_node_set_status(node, JOB_QUEUE_SUBMITTED);
-        void *job_data = nullptr;
-        try {
-            job_data =
-                queue_driver_submit_job(driver, node->run_cmd, node->num_cpu,
-                                        node->run_path, node->job_name);
-        } catch (std::exception &err) {
-            logger->warning("Failed to submit job {} (attempt {}) due to {}",
-                            node->job_name, node->submit_attempt, err.what());
-            pthread_mutex_unlock(&node->data_mutex);
-            return static_cast<int>(SUBMIT_DRIVER_FAIL);
-        }
+        jobs.push_back(
+            {node->run_cmd, node->num_cpu, node->run_path, node->job_name});
+    }
 
-        if (job_data == nullptr) {
-            // In this case the status of the job itself will be
-            // unmodified; i.e. it will still be WAITING, and a new attempt
-            // to submit it will be performed in the next round.
+    std::vector<void *> job_data(nodes.size(), nullptr);
+    try {
+        queue_driver_submit_job_batch(driver, jobs.data(), jobs.size(),
+                                      job_data.data());
+    } catch (std::exception &err) {
+        logger->warning("Failed to submit {} jobs due to {}", nodes.size(),
+                        err.what());
+    }
+
+    std::vector<submit_status_type> results;
+    results.reserve(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        auto node = nodes[i];
+        if (job_data[i] == nullptr) {
             logger->warning("Failed to submit job {} (attempt {})",
                             node->job_name, node->submit_attempt);
-            pthread_mutex_unlock(&node->data_mutex);
-            return static_cast<int>(SUBMIT_DRIVER_FAIL);
+            results.push_back(SUBMIT_DRIVER_FAIL);
+            continue;
         }
 
         logger->info("Submitted job {} (attempt {})", node->job_name,
                      node->submit_attempt);
-
-        node->job_data = job_data;
+        node->job_data = job_data[i];
         node->submit_attempt++;
-        // The status JOB_QUEUE_SUBMITTED is internal, and not exported anywhere.
-        // The job_queue_update_status() will update this to PENDING or RUNNING at
-        // the next call. The important difference between SUBMITTED and WAITING is
-        // that SUBMITTED have job_data != NULL and the job_queue_node free
-        // function must be called on it.
-        job_queue_node_set_status(node, JOB_QUEUE_SUBMITTED);
+        results.push_back(SUBMIT_OK);
+    }
+
+    for (auto node : locked)
         pthread_mutex_unlock(&node->data_mutex);
-        return static_cast<int>(SUBMIT_OK);
+    return results;
+}
+
+/**
+   Kills the job of the node if it is in a state where that is possible, and
+   returns whether it was killed. The caller must NOT hold the GIL.
+*/
+bool job_queue_node_kill(job_queue_node_type *node,
+                         queue_driver_type *driver) {
+    bool result = false;
+    pthread_mutex_lock(&node->data_mutex);
+    job_status_type current_status = job_queue_node_get_status(node);
+    if (current_status & JOB_QUEUE_CAN_KILL) {
+        // If the job is killed before it is even started no driver specific
+        // job data has been assigned; we therefore must check the
+        // node->job_data pointer before entering.
+        if (node->job_data) {
+            queue_driver_kill_job(driver, node->job_data);
+            // A status query which is using the job_data frees it when done
+            if (node->job_data_users > 0)
+                node->orphaned_job_data.push_back(node->job_data);
+            else
+                queue_driver_free_job(driver, node->job_data);
+            node->job_data = NULL;
+        }
+        job_queue_node_set_status(node, JOB_QUEUE_IS_KILLED);
+        logger->info("job {} set to killed", node->job_name);
+        result = true;
+    } else {
+        logger->warning("node_kill called but cannot kill {}", node->job_name);
+    }
+    pthread_mutex_unlock(&node->data_mutex);
+    return result;
+}
+
+/**
+   The accounting the driver has recorded for the job of the node, if any. The
+   caller must NOT hold the GIL.
+*/
+std::optional<queue_driver_job_accounting>
+job_queue_node_get_accounting(job_queue_node_type *node,
+                              queue_driver_type *driver) {
+    std::optional<queue_driver_job_accounting> result;
+    pthread_mutex_lock(&node->data_mutex);
+    queue_driver_job_accounting accounting;
+    if (node->job_data &&
+        queue_driver_get_accounting(driver, node->job_data, &accounting))
+        result = accounting;
+    pthread_mutex_unlock(&node->data_mutex);
+    return result;
+}
+
+ERT_CLIB_SUBMODULE("queue", m) {
+    using namespace py::literals;
+    m.def("_refresh_status", [](Cwrap<job_queue_node_type> node,
+                                Cwrap<queue_driver_type> driver) {
+        // release the GIL
+        py::gil_scoped_release release;
+
+        return job_queue_node_refresh_status(node, driver);
+    });
+
+    /*
+      Refreshes the status of all the given nodes in one call, i.e. the GIL is
+      released once for the whole ensemble instead of once per realization,
+      and the driver is asked for the status of all the jobs at once. The
+      result is a list of (status, message) pairs in the same order as the
+      nodes.
+    */
+    m.def("_refresh_status_many",
+          [](std::vector<Cwrap<job_queue_node_type>> nodes,
+             Cwrap<queue_driver_type> driver) {
+              // release the GIL
+              py::gil_scoped_release release;
+
+              std::vector<job_queue_node_type *> node_ptrs(nodes.begin(),
+                                                           nodes.end());
+              return job_queue_node_refresh_status_many(node_ptrs, driver);
+          });
+
+    m.def("_submit", [](Cwrap<job_queue_node_type> node,
+                        Cwrap<queue_driver_type> driver) {
+        // release the GIL
+        py::gil_scoped_release release;
+
+        return static_cast<int>(job_queue_node_submit(node, driver));
     });
+
     m.def("_kill",
           [](Cwrap<job_queue_node_type> node, Cwrap<queue_driver_type> driver) {
               // release the GIL
               py::gil_scoped_release release;
 
-              bool result = false;
-              pthread_mutex_lock(&node->data_mutex);
-              job_status_type current_status = job_queue_node_get_status(node);
-              if (current_status & JOB_QUEUE_CAN_KILL) {
-                  // If the job is killed before it is even started no driver specific
-                  // job data has been assigned; we therefore must check the
-                  // node->job_data pointer before entering.
-                  if (node->job_data) {
-                      queue_driver_kill_job(driver, node->job_data);
-                      queue_driver_free_job(driver, node->job_data);
-                      node->job_data = NULL;
-                  }
-                  job_queue_node_set_status(node, JOB_QUEUE_IS_KILLED);
-                  logger->info("job {} set to killed", node->job_name);
-                  result = true;
-              } else {
-                  logger->warning("node_kill called but cannot kill {}",
-                                  node->job_name);
-              }
-              pthread_mutex_unlock(&node->data_mutex);
-              return result;
+              return job_queue_node_kill(node, driver);
           });
 
     m.def("_get_submit_attempt",
           [](Cwrap<job_queue_node_type> node) { return node->submit_attempt; });
+
+    m.def("_get_accounting",
+          [](Cwrap<job_queue_node_type> node,
+             Cwrap<queue_driver_type> driver) -> py::object {
+              std::optional<queue_driver_job_accounting> accounting;
+              {
+                  // release the GIL
+                  py::gil_scoped_release release;
+
+                  accounting = job_queue_node_get_accounting(node, driver);
+              }
+              if (!accounting)
+                  return py::none();
+              return py::dict("exit_code"_a = accounting->exit_code,
+                              "exit_signal"_a = accounting->exit_signal,
+                              "elapsed"_a = accounting->elapsed,
+                              "max_rss"_a = accounting->max_rss,
+                              "node_list"_a = accounting->node_list,
+                              "pending_time"_a = accounting->pending_time);
+          });
 }
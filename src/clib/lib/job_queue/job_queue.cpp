@@ -1,12 +1,299 @@
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
 
 #include <ert/job_queue/job_list.hpp>
 #include <ert/job_queue/job_queue.hpp>
+#include <ert/job_queue/status_notifier.hpp>
+#include <ert/job_queue/timing_wheel.hpp>
+#include <ert/python.hpp>
+
+namespace {
+using engine_clock = std::chrono::steady_clock;
+
+/** The resolution of the deadlines in the polling engine. */
+constexpr auto ENGINE_TICK = std::chrono::milliseconds(100);
+
+/* The polling cadence follows _BackoffFunction in job_queue_node.py: a node is
+ * polled every second for the first 30 seconds it is running, and then every
+ * 30 +/- 5 seconds. */
+constexpr auto ENGINE_MIN_POLL_INTERVAL = std::chrono::seconds(1);
+constexpr auto ENGINE_MAX_POLL_INTERVAL = std::chrono::seconds(30);
+constexpr auto ENGINE_BACKOFF_AFTER = std::chrono::seconds(30);
+constexpr int ENGINE_POLL_JITTER = 5;
+
+/** The maximum number of nodes refreshed with one driver call. */
+constexpr size_t ENGINE_POLL_BATCH_SIZE = 256;
+/** The maximum number of nodes submitted with one driver call. */
+constexpr size_t ENGINE_SUBMIT_BATCH_SIZE = 1000;
+
+/** The engine keeps polling a node as long as it is in one of these states. */
+constexpr int ENGINE_POLL_STATUS = JOB_QUEUE_SUBMITTED + JOB_QUEUE_PENDING +
+                                   JOB_QUEUE_RUNNING + JOB_QUEUE_UNKNOWN +
+                                   JOB_QUEUE_STATUS_FAILURE;
+
+enum class engine_action { SUBMIT, POLL, KILL };
+
+struct engine_work {
+    engine_action action;
+    int queue_index;
+};
+
+struct engine_node {
+    job_queue_node_type *node = nullptr;
+    /** The last status which has been passed on as a transition. */
+    job_status_type reported_status = JOB_QUEUE_NOT_ACTIVE;
+    /** When the node was first seen RUNNING, used for the poll backoff. */
+    std::optional<engine_clock::time_point> running_since{};
+};
+} // namespace
+
+/**
+   The polling engine drives the nodes of a queue through the driver: it
+   submits and kills nodes on request, and polls the status of the submitted
+   nodes on a schedule kept in a timing wheel. The driver calls are made by a
+   small pool of worker threads, where due polls are grouped so that the status
+   of up to ENGINE_POLL_BATCH_SIZE nodes is fetched with one
+   job_queue_node_refresh_status_many() call, and queued submissions are
+   grouped likewise into job_queue_node_submit_many() calls. Only the changes
+   of status are collected for the caller, see
+   job_queue_engine_get_transitions().
+*/
+struct job_queue_engine_struct {
+    queue_driver_type *driver;
+    engine_clock::time_point epoch = engine_clock::now();
+
+    std::mutex mutex;
+    std::condition_variable timer_cv;
+    std::condition_variable work_cv;
+    bool stop = false;
+
+    ert::TimingWheel wheel{};
+    std::deque<engine_work> work{};
+    std::vector<engine_node> nodes{};
+    std::vector<job_queue_transition> transitions{};
+    std::mt19937 random{std::random_device{}()};
+
+    std::thread timer_thread{};
+    std::vector<std::thread> workers{};
+
+    explicit job_queue_engine_struct(queue_driver_type *driver)
+        : driver(driver) {}
+
+    uint64_t tick(engine_clock::time_point time) const {
+        return (time - epoch) / ENGINE_TICK;
+    }
+
+    /** Must be called with the mutex held. */
+    engine_node &get_node(job_queue_node_type *node) {
+        auto queue_index = job_queue_node_get_queue_index(node);
+        if (static_cast<size_t>(queue_index) >= nodes.size())
+            nodes.resize(queue_index + 1);
+
+        auto &engine_node = nodes[queue_index];
+        if (engine_node.node != node) {
+            engine_node = {};
+            engine_node.node = node;
+            engine_node.reported_status = job_queue_node_get_status(node);
+        }
+        return engine_node;
+    }
+
+    /** Must be called with the mutex held. */
+    void schedule_poll(int queue_index, engine_clock::duration delay) {
+        wheel.schedule(queue_index, tick(engine_clock::now() + delay));
+    }
+
+    /** Must be called with the mutex held. */
+    void record(int queue_index, job_status_type status,
+                std::optional<std::string> message) {
+        auto &engine_node = nodes[queue_index];
+        if (status == JOB_QUEUE_RUNNING && !engine_node.running_since)
+            engine_node.running_since = engine_clock::now();
+
+        if (status != engine_node.reported_status) {
+            engine_node.reported_status = status;
+            transitions.push_back({queue_index, status, std::move(message)});
+        }
+
+        if (!(status & ENGINE_POLL_STATUS)) {
+            wheel.cancel(queue_index);
+            return;
+        }
+
+        engine_clock::duration interval = ENGINE_MIN_POLL_INTERVAL;
+        if (engine_node.running_since &&
+            engine_clock::now() - *engine_node.running_since >
+                ENGINE_BACKOFF_AFTER) {
+            std::uniform_int_distribution<int> jitter(-ENGINE_POLL_JITTER,
+                                                      ENGINE_POLL_JITTER);
+            interval = ENGINE_MAX_POLL_INTERVAL +
+                       std::chrono::seconds(jitter(random));
+        }
+        schedule_poll(queue_index, interval);
+    }
+
+    void run_timer() {
+        auto next_tick = engine_clock::now();
+        std::vector<int> expired;
+        std::unique_lock lock{mutex};
+        while (true) {
+            next_tick += ENGINE_TICK;
+            if (timer_cv.wait_until(lock, next_tick, [&] { return stop; }))
+                break;
+
+            expired.clear();
+            wheel.advance(tick(engine_clock::now()), expired);
+            for (auto queue_index : expired)
+                work.push_back({engine_action::POLL, queue_index});
+            if (!expired.empty())
+                work_cv.notify_all();
+        }
+    }
+
+    void poll(const std::vector<int> &queue_indices) {
+        std::vector<job_queue_node_type *> poll_nodes;
+        {
+            std::lock_guard guard{mutex};
+            for (auto queue_index : queue_indices)
+                poll_nodes.push_back(nodes[queue_index].node);
+        }
+
+        auto results = job_queue_node_refresh_status_many(poll_nodes, driver);
+
+        std::lock_guard guard{mutex};
+        for (size_t i = 0; i < queue_indices.size(); i++) {
+            auto &[status, message] = results[i];
+            record(queue_indices[i], static_cast<job_status_type>(status),
+                   std::move(message));
+        }
+    }
+
+    void submit(const std::vector<int> &queue_indices) {
+        std::vector<job_queue_node_type *> submit_nodes;
+        {
+            std::lock_guard guard{mutex};
+            for (auto queue_index : queue_indices)
+                submit_nodes.push_back(nodes[queue_index].node);
+        }
+
+        auto results = job_queue_node_submit_many(submit_nodes, driver);
+
+        std::lock_guard guard{mutex};
+        for (size_t i = 0; i < queue_indices.size(); i++) {
+            auto queue_index = queue_indices[i];
+            auto node = submit_nodes[i];
+            if (results[i] != SUBMIT_OK) {
+                // A node which could not be submitted is WAITING again, and
+                // the failure is passed on even if the status is unchanged
+                pthread_mutex_lock(&node->data_mutex);
+                job_queue_node_set_status(node, JOB_QUEUE_WAITING);
+                pthread_mutex_unlock(&node->data_mutex);
+                auto status = job_queue_node_get_status(node);
+                nodes[queue_index].reported_status = status;
+                transitions.push_back(
+                    {queue_index, status,
+                     fmt::format("Failed to submit job {}", node->job_name)});
+                wheel.cancel(queue_index);
+                continue;
+            }
+            nodes[queue_index].running_since.reset();
+            record(queue_index, job_queue_node_get_status(node), std::nullopt);
+        }
+    }
+
+    void kill(int queue_index) {
+        job_queue_node_type *node;
+        {
+            std::lock_guard guard{mutex};
+            node = nodes[queue_index].node;
+            // A node which is killed before it has been submitted is not
+            // submitted afterwards
+            auto queued_submit = [queue_index](const engine_work &item) {
+                return item.action == engine_action::SUBMIT &&
+                       item.queue_index == queue_index;
+            };
+            work.erase(std::remove_if(work.begin(), work.end(), queued_submit),
+                       work.end());
+        }
+
+        job_queue_node_kill(node, driver);
+
+        std::lock_guard guard{mutex};
+        record(queue_index, job_queue_node_get_status(node), std::nullopt);
+    }
+
+    void run_worker() {
+        std::vector<int> batch;
+        while (true) {
+            engine_work item;
+            batch.clear();
+            {
+                std::unique_lock lock{mutex};
+                work_cv.wait(lock, [&] { return stop || !work.empty(); });
+                if (stop)
+                    break;
+
+                item = work.front();
+                work.pop_front();
+                batch.push_back(item.queue_index);
+                if (item.action != engine_action::KILL) {
+                    auto batch_size = item.action == engine_action::POLL
+                                          ? ENGINE_POLL_BATCH_SIZE
+                                          : ENGINE_SUBMIT_BATCH_SIZE;
+                    // A node is submitted at most once per batch
+                    while (!work.empty() && batch.size() < batch_size &&
+                           work.front().action == item.action &&
+                           (item.action == engine_action::POLL ||
+                            std::find(batch.begin(), batch.end(),
+                                      work.front().queue_index) ==
+                                batch.end())) {
+                        batch.push_back(work.front().queue_index);
+                        work.pop_front();
+                    }
+                }
+            }
+
+            switch (item.action) {
+            case engine_action::SUBMIT:
+                submit(batch);
+                break;
+            case engine_action::KILL:
+                kill(item.queue_index);
+                break;
+            case engine_action::POLL:
+                poll(batch);
+                break;
+            }
+        }
+    }
+};
 
 struct job_queue_struct {
     job_list_type *job_list = nullptr;
     /** A pointer to a driver instance (LSF|LOCAL) which actually 'does it'. */
     queue_driver_type *driver = nullptr;
+    /** The native polling engine, only present when it has been started. */
+    job_queue_engine_type *engine = nullptr;
+    /** Receives the status changes of all the nodes in the queue. */
+    std::shared_ptr<ert::StatusNotifier> status_notifier =
+        std::make_shared<ert::StatusNotifier>();
+    /** The number of nodes in the queue in each status. */
+    std::shared_ptr<job_status_counts_type> status_counts =
+        std::make_shared<job_status_counts_type>();
 };
 
 job_queue_type *job_queue_alloc(queue_driver_type *driver) {
@@ -17,22 +304,206 @@ job_queue_type *job_queue_alloc(queue_driver_type *driver) {
 }
 
 void job_queue_free(job_queue_type *queue) {
+    job_queue_engine_stop(queue);
     job_list_free(queue->job_list);
     delete queue;
 }
 
 int job_queue_add_job_node(job_queue_type *queue, job_queue_node_type *node) {
-    job_list_get_wrlock(queue->job_list);
     job_list_add_job(queue->job_list, node);
 
     pthread_mutex_lock(&node->data_mutex);
+    node->status_notifier = queue->status_notifier;
+    node->status_counts = queue->status_counts;
+    (*node->status_counts)[job_status_index(node->job_status)]++;
 
     if (job_queue_node_get_status(node) != JOB_QUEUE_WAITING)
         job_queue_node_set_status(node, JOB_QUEUE_WAITING);
 
     pthread_mutex_unlock(&node->data_mutex);
 
-    int queue_index = job_queue_node_get_queue_index(node);
-    job_list_unlock(queue->job_list);
-    return queue_index;
+    return job_queue_node_get_queue_index(node);
+}
+
+void job_queue_engine_start(job_queue_type *queue, int num_workers) {
+    if (queue->engine != nullptr)
+        return;
+
+    auto engine = new job_queue_engine_type(queue->driver);
+    engine->timer_thread = std::thread{[engine] { engine->run_timer(); }};
+    for (int i = 0; i < std::max(num_workers, 1); i++)
+        engine->workers.emplace_back([engine] { engine->run_worker(); });
+    queue->engine = engine;
+}
+
+/**
+   Stops the engine threads; driver calls which are in progress are completed,
+   while submissions, kills and polls which have not been started yet are
+   dropped.
+*/
+void job_queue_engine_stop(job_queue_type *queue) {
+    auto engine = queue->engine;
+    if (engine == nullptr)
+        return;
+
+    {
+        std::lock_guard guard{engine->mutex};
+        engine->stop = true;
+    }
+    engine->timer_cv.notify_all();
+    engine->work_cv.notify_all();
+    engine->timer_thread.join();
+    for (auto &worker : engine->workers)
+        worker.join();
+
+    delete engine;
+    queue->engine = nullptr;
+}
+
+static void job_queue_engine_add_work(job_queue_type *queue,
+                                      job_queue_node_type *node,
+                                      engine_action action) {
+    auto engine = queue->engine;
+    if (engine == nullptr)
+        throw std::runtime_error("The job queue engine has not been started");
+
+    std::lock_guard guard{engine->mutex};
+    engine->get_node(node);
+    engine->work.push_back({action, job_queue_node_get_queue_index(node)});
+    engine->work_cv.notify_one();
+}
+
+void job_queue_engine_submit(job_queue_type *queue, job_queue_node_type *node) {
+    job_queue_engine_add_work(queue, node, engine_action::SUBMIT);
+}
+
+/**
+   Queues the submission of all the nodes at once, so that they are handed to
+   the driver together, in as few job_queue_node_submit_many() calls as the
+   batch size allows.
+*/
+void job_queue_engine_submit_many(
+    job_queue_type *queue, const std::vector<job_queue_node_type *> &nodes) {
+    auto engine = queue->engine;
+    if (engine == nullptr)
+        throw std::runtime_error("The job queue engine has not been started");
+
+    std::lock_guard guard{engine->mutex};
+    for (auto node : nodes) {
+        engine->get_node(node);
+        engine->work.push_back(
+            {engine_action::SUBMIT, job_queue_node_get_queue_index(node)});
+    }
+    engine->work_cv.notify_all();
+}
+
+void job_queue_engine_kill(job_queue_type *queue, job_queue_node_type *node) {
+    job_queue_engine_add_work(queue, node, engine_action::KILL);
+}
+
+std::vector<job_queue_transition>
+job_queue_engine_get_transitions(job_queue_type *queue) {
+    std::vector<job_queue_transition> transitions;
+    auto engine = queue->engine;
+    if (engine == nullptr)
+        return transitions;
+
+    std::lock_guard guard{engine->mutex};
+    transitions.swap(engine->transitions);
+    return transitions;
+}
+
+int job_queue_get_status_notifier_fd(const job_queue_type *queue) {
+    return queue->status_notifier->fd();
+}
+
+bool job_queue_drain_status_changes(
+    job_queue_type *queue,
+    std::vector<ert::StatusNotifier::status_change> &changes) {
+    return queue->status_notifier->drain(changes);
+}
+
+std::array<int, JOB_QUEUE_MAX_STATE>
+job_queue_get_status_counts(const job_queue_type *queue) {
+    std::array<int, JOB_QUEUE_MAX_STATE> counts;
+    for (int index = 0; index < JOB_QUEUE_MAX_STATE; index++)
+        counts[index] = (*queue->status_counts)[index];
+    return counts;
+}
+
+ERT_CLIB_SUBMODULE("queue", m) {
+    using namespace py::literals;
+    m.def(
+        "_engine_start",
+        [](Cwrap<job_queue_type> queue, int num_workers) {
+            job_queue_engine_start(queue, num_workers);
+        },
+        "queue"_a, "num_workers"_a);
+    m.def("_engine_stop", [](Cwrap<job_queue_type> queue) {
+        // release the GIL
+        py::gil_scoped_release release;
+
+        job_queue_engine_stop(queue);
+    });
+    m.def("_engine_submit", [](Cwrap<job_queue_type> queue,
+                               Cwrap<job_queue_node_type> node) {
+        job_queue_engine_submit(queue, node);
+    });
+    m.def("_engine_submit_many",
+          [](Cwrap<job_queue_type> queue,
+             std::vector<Cwrap<job_queue_node_type>> nodes) {
+              std::vector<job_queue_node_type *> node_ptrs(nodes.begin(),
+                                                           nodes.end());
+              job_queue_engine_submit_many(queue, node_ptrs);
+          });
+    m.def("_engine_kill", [](Cwrap<job_queue_type> queue,
+                             Cwrap<job_queue_node_type> node) {
+        job_queue_engine_kill(queue, node);
+    });
+
+    /*
+      Returns the status changes since the previous call as a list of
+      (queue_index, status, message) tuples, in the order they happened.
+    */
+    m.def("_engine_transitions", [](Cwrap<job_queue_type> queue) {
+        std::vector<std::tuple<int, int, std::optional<std::string>>> result;
+        for (auto &transition : job_queue_engine_get_transitions(queue))
+            result.emplace_back(transition.queue_index,
+                                static_cast<int>(transition.status),
+                                std::move(transition.message));
+        return result;
+    });
+
+    /*
+      Returns the number of nodes in the queue in each status, as a dict from
+      the status value to the count.
+    */
+    m.def("_status_counts", [](Cwrap<job_queue_type> queue) {
+        auto counts = job_queue_get_status_counts(queue);
+        std::map<int, int> result;
+        for (int index = 0; index < JOB_QUEUE_MAX_STATE; index++)
+            result[1 << index] = counts[index];
+        return result;
+    });
+
+    m.def("_status_notifier_fd", [](Cwrap<job_queue_type> queue) {
+        return job_queue_get_status_notifier_fd(queue);
+    });
+
+    /*
+      Returns the status changes since the previous call as a list of
+      (queue_index, status) tuples, and whether the list is complete. When it is
+      not, changes have been dropped and the status of every node must be read.
+    */
+    m.def("_drain_status_changes", [](Cwrap<job_queue_type> queue) {
+        std::vector<ert::StatusNotifier::status_change> changes;
+        bool complete = job_queue_drain_status_changes(queue, changes);
+
+        std::vector<std::pair<int, int>> result;
+        result.reserve(changes.size());
+        for (const auto &change : changes)
+            result.emplace_back(change.queue_index,
+                                static_cast<int>(change.status));
+        return std::make_pair(std::move(result), complete);
+    });
 }
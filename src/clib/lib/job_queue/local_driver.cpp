@@ -1,25 +1,304 @@
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
 #include <csignal>
 #include <cstdlib>
+#include <memory>
 #include <mutex>
-#include <optional>
 #include <sys/wait.h>
 #include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#endif
 
 #include <ert/job_queue/local_driver.hpp>
 #include <ert/job_queue/queue_driver.hpp>
 #include <ert/job_queue/spawn.hpp>
+#include <ert/logging.hpp>
+
+static auto logger = ert::get_logger("ert.job_queue.local_driver");
 
 typedef struct local_job_struct local_job_type;
 
+namespace {
+class ChildReaper;
+}
+
 struct local_job_struct {
-    bool active = false;
-    job_status_type status = JOB_QUEUE_WAITING;
-    std::optional<std::thread> run_thread = std::nullopt;
+    std::atomic<job_status_type> status{JOB_QUEUE_WAITING};
     pid_t child_process = 0;
+    /** The reaper which is waiting for the child_process to complete. */
+    std::weak_ptr<ChildReaper> reaper;
 };
 
+namespace {
+/**
+  One thread per driver which waits for all the child processes started by the
+  driver, and sets the status of the corresponding jobs when they complete.
+
+  On Linux every child is watched with a pidfd in an epoll set, so the thread
+  only wakes up when a child has actually exited. When pidfds are not
+  available (non-Linux, or kernels older than 5.3) the children are instead
+  polled with waitpid(WNOHANG) every SWEEP_INTERVAL.
+
+  A job which is freed while its child process is still running is owned by the
+  reaper, and deleted when the child completes. The children which are still
+  running when the driver is freed are left running, and the reaper keeps
+  itself alive until it has reaped them, see keep_until_reaped().
+*/
+class ChildReaper {
+    static constexpr auto SWEEP_INTERVAL = std::chrono::milliseconds(100);
+    static constexpr int MAX_EVENTS = 64;
+
+    struct watched_child {
+        local_job_type *job;
+        int pidfd;
+        /** The job has been freed, and must be deleted by the reaper. */
+        bool orphaned;
+    };
+
+    std::mutex mutex;
+    std::condition_variable wakeup_cv;
+    std::unordered_map<pid_t, watched_child> children;
+    /** Number of children without a pidfd, which must be polled. */
+    size_t num_polled = 0;
+    bool stop = false;
+    /** Set by keep_until_reaped() while children are still running after the
+     * driver has been freed; dropped by the thread when they have all been
+     * reaped. */
+    std::shared_ptr<ChildReaper> self;
+    int epoll_fd = -1;
+    int wakeup_fd = -1;
+    std::thread thread;
+
+    void wakeup() {
+#ifdef __linux__
+        if (wakeup_fd >= 0) {
+            uint64_t one = 1;
+            if (write(wakeup_fd, &one, sizeof one) < 0)
+                logger->warning("Failed to wake up the local driver reaper");
+            return;
+        }
+#endif
+        wakeup_cv.notify_one();
+    }
+
+    static int open_pidfd(pid_t pid) {
+#if defined(__linux__) && defined(SYS_pidfd_open)
+        return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+        (void)pid;
+        return -1;
+#endif
+    }
+
+    /** Must be called with the mutex held. */
+    void reap(pid_t pid) {
+        auto child = children.find(pid);
+        if (child == children.end())
+            return;
+
+        int wait_status = 0;
+        pid_t result = waitpid(pid, &wait_status, WNOHANG);
+        if (result == 0 || (result < 0 && errno == EINTR))
+            return; // Still running
+
+        job_status_type status = JOB_QUEUE_EXIT;
+        if (result == pid && WIFEXITED(wait_status) != 0 &&
+            WEXITSTATUS(wait_status) == 0)
+            status = JOB_QUEUE_DONE;
+
+        auto [job, pidfd, orphaned] = child->second;
+        if (pidfd >= 0) {
+#ifdef __linux__
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, pidfd, nullptr);
+#endif
+            close(pidfd);
+        } else
+            num_polled--;
+        children.erase(child);
+
+        if (orphaned)
+            delete job;
+        else
+            job->status = status;
+    }
+
+    /**
+      Reaps the children until the reaper is stopped, or until the last child
+      has been reaped after keep_until_reaped(). In the latter case the thread
+      is detached, and the reference to the reaper is returned, so that the
+      reaper is deleted when the thread lets go of it.
+    */
+    std::shared_ptr<ChildReaper> run() {
+        std::vector<pid_t> exited;
+        while (true) {
+            exited.clear();
+#ifdef __linux__
+            if (epoll_fd >= 0) {
+                int timeout = -1;
+                {
+                    std::lock_guard guard{mutex};
+                    if (num_polled > 0)
+                        timeout = SWEEP_INTERVAL.count();
+                }
+
+                epoll_event events[MAX_EVENTS];
+                int num_events =
+                    epoll_wait(epoll_fd, events, MAX_EVENTS, timeout);
+                for (int i = 0; i < num_events; i++) {
+                    if (events[i].data.u64 == 0) {
+                        uint64_t count;
+                        if (read(wakeup_fd, &count, sizeof count) < 0)
+                            logger->warning("Failed to read the local "
+                                            "driver reaper wakeup");
+                    } else
+                        exited.push_back(
+                            static_cast<pid_t>(events[i].data.u64));
+                }
+            }
+#endif
+            std::unique_lock lock{mutex};
+            if (epoll_fd < 0)
+                wakeup_cv.wait_for(lock, SWEEP_INTERVAL, [&] { return stop; });
+            if (stop)
+                return nullptr;
+
+            for (auto pid : exited)
+                reap(pid);
+
+            if (num_polled > 0) {
+                std::vector<pid_t> polled;
+                for (const auto &[pid, child] : children)
+                    if (child.pidfd < 0)
+                        polled.push_back(pid);
+                for (auto pid : polled)
+                    reap(pid);
+            }
+
+            if (self && children.empty()) {
+                thread.detach();
+                return std::move(self);
+            }
+        }
+    }
+
+public:
+    ChildReaper() {
+#ifdef __linux__
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd >= 0) {
+            wakeup_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.u64 = 0;
+            if (wakeup_fd < 0 ||
+                epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wakeup_fd, &event) != 0) {
+                if (wakeup_fd >= 0)
+                    close(wakeup_fd);
+                close(epoll_fd);
+                wakeup_fd = -1;
+                epoll_fd = -1;
+            }
+        }
+#endif
+    }
+
+    ~ChildReaper() {
+        {
+            std::lock_guard guard{mutex};
+            stop = true;
+        }
+        wakeup();
+        // Not joinable when the thread itself deletes the reaper, see run()
+        if (thread.joinable())
+            thread.join();
+
+        if (wakeup_fd >= 0)
+            close(wakeup_fd);
+        if (epoll_fd >= 0)
+            close(epoll_fd);
+    }
+
+    /**
+      Called when the driver is freed. The children which are still running
+      are left running, and the reaper is kept alive until it has reaped them
+      all, so that they are not left as zombies and the jobs which have not
+      been freed yet still get their status.
+    */
+    static void keep_until_reaped(const std::shared_ptr<ChildReaper> &reaper) {
+        {
+            std::lock_guard guard{reaper->mutex};
+            if (reaper->children.empty())
+                return;
+            reaper->self = reaper;
+        }
+        reaper->wakeup();
+    }
+
+    void watch(local_job_type *job) {
+        std::lock_guard guard{mutex};
+        if (!thread.joinable())
+            thread = std::thread{[this] { auto last_reference = run(); }};
+
+        pid_t pid = job->child_process;
+        int pidfd = epoll_fd >= 0 ? open_pidfd(pid) : -1;
+#ifdef __linux__
+        if (pidfd >= 0) {
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.u64 = static_cast<uint64_t>(pid);
+            if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, pidfd, &event) != 0) {
+                close(pidfd);
+                pidfd = -1;
+            }
+        }
+#endif
+        children[pid] = {job, pidfd, false};
+        if (pidfd < 0) {
+            num_polled++;
+            wakeup();
+        }
+    }
+
+    /**
+      Hands the ownership of a job over to the reaper if the child process is
+      still running. Returns false if the job is not watched by the reaper, in
+      which case the caller must delete it.
+    */
+    bool release(local_job_type *job) {
+        std::lock_guard guard{mutex};
+        auto child = children.find(job->child_process);
+        if (child == children.end() || child->second.job != job)
+            return false;
+
+        child->second.orphaned = true;
+        return true;
+    }
+
+    /**
+      Sends SIGTERM to the child process of the job, unless it has already
+      been reaped; the pid might then have been reused by another process.
+    */
+    void kill(local_job_type *job) {
+        std::lock_guard guard{mutex};
+        auto child = children.find(job->child_process);
+        if (child != children.end() && child->second.job == job)
+            ::kill(job->child_process, SIGTERM);
+    }
+};
+} // namespace
+
 struct local_driver_struct {
     std::mutex submit_lock;
+    std::shared_ptr<ChildReaper> reaper = std::make_shared<ChildReaper>();
 };
 
 static local_job_type *local_job_alloc() { return new local_job_type; }
@@ -33,34 +312,29 @@ job_status_type local_driver_get_job_status(void * /**_driver*/, void *_job) {
     return JOB_QUEUE_NOT_ACTIVE; // The job has not been registered at all
 }
 
-void local_driver_free_job(void *_job) {
-    local_job_type *job = reinterpret_cast<local_job_type *>(_job);
-    if (!job->active)
-        free(job);
+void local_driver_get_job_status_batch(void *_driver, void *const *jobs,
+                                       size_t num_jobs,
+                                       job_status_type *status) {
+    for (size_t i = 0; i < num_jobs; i++)
+        status[i] = local_driver_get_job_status(_driver, jobs[i]);
 }
 
-void local_driver_kill_job(void * /**_driver*/, void *_job) {
+void local_driver_free_job(void *_job) {
     local_job_type *job = reinterpret_cast<local_job_type *>(_job);
-    if (job->child_process > 0)
-        kill(job->child_process, SIGTERM);
+    if (auto reaper = job->reaper.lock(); reaper && reaper->release(job))
+        return;
+
+    delete job;
 }
 
 /**
-  This function needs to dereference the job pointer after the waitpid() call is
-  complete, it is therefore essential that no other threads have called free(job)
-  while the external process is running.
+  Kills the child process of the job, also after the driver has been freed,
+  as long as the child has not been reaped.
 */
-void submit_job_thread(const char *executable, const char *run_path,
-                       local_job_type *job) {
-    int wait_status;
-    char *const argv[3] = {(char *)executable, (char *)run_path, nullptr};
-    job->child_process = spawn(argv, nullptr, nullptr);
-    waitpid(job->child_process, &wait_status, 0);
-
-    job->active = false;
-    job->status = JOB_QUEUE_EXIT;
-    if (WIFEXITED(wait_status) != 0 && (WEXITSTATUS(wait_status) == 0))
-        job->status = JOB_QUEUE_DONE;
+void local_driver_kill_job(void * /**_driver*/, void *_job) {
+    local_job_type *job = reinterpret_cast<local_job_type *>(_job);
+    if (auto reaper = job->reaper.lock())
+        reaper->kill(job);
 }
 
 void *local_driver_submit_job(void *_driver, std::string submit_cmd,
@@ -70,17 +344,25 @@ void *local_driver_submit_job(void *_driver, std::string submit_cmd,
     local_job_type *job = local_job_alloc();
 
     std::lock_guard guard{driver->submit_lock};
-    job->active = true;
-    job->status = JOB_QUEUE_RUNNING;
-
-    job->run_thread = std::thread{
-        [=] { submit_job_thread(submit_cmd.c_str(), run_path.c_str(), job); }};
-    job->run_thread->detach();
+    char *const argv[3] = {submit_cmd.data(), (char *)run_path.c_str(),
+                           nullptr};
+    try {
+        job->child_process = spawn(argv, nullptr, nullptr);
+    } catch (...) {
+        delete job;
+        throw;
+    }
 
+    job->status = JOB_QUEUE_RUNNING;
+    job->reaper = driver->reaper;
+    driver->reaper->watch(job);
     return job;
 }
 
-void local_driver_free(local_driver_type *driver) { delete driver; }
+void local_driver_free(local_driver_type *driver) {
+    ChildReaper::keep_until_reaped(driver->reaper);
+    delete driver;
+}
 
 void local_driver_free_(void *_driver) {
     local_driver_type *driver = reinterpret_cast<local_driver_type *>(_driver);
@@ -1,25 +1,39 @@
 #include <algorithm>
 #include <cassert>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <exception>
 #include <fcntl.h>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <iterator>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <pthread.h>
 #include <set>
+#include <sstream>
 #include <string>
+#include <string_view>
 #include <sys/stat.h>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include <ert/abort.hpp>
 #include <ert/except.hpp>
 #include <ert/job_queue/lsf_driver.hpp>
 #include <ert/job_queue/queue_driver.hpp>
+#include <ert/job_queue/remote_shell.hpp>
 #include <ert/job_queue/spawn.hpp>
 #include <ert/job_queue/string_utils.hpp>
+#include <ert/job_queue/token_bucket.hpp>
 #include <ert/logging.hpp>
 #include <ert/python.hpp>
 #include <ert/res_util/string.hpp>
@@ -37,10 +51,22 @@ static auto logger = ert::get_logger("ert.job_queue.lsf_driver");
 #define DEFAULT_BJOBS_CMD "bjobs"
 #define DEFAULT_BKILL_CMD "bkill"
 #define DEFAULT_BHIST_CMD "bhist"
+/** The fields asked from 'bjobs -json', see lsf_driver_parse_bjobs_json(). */
+#define LSF_BJOBS_JSON_FIELDS                                                  \
+    "jobid jobindex stat exit_code exec_host pend_time run_time"
+/** The most job ids given to one bjobs or bhist call. */
+#define LSF_MAX_JOB_IDS 1000
+/** The number of bhist calls in a row which have no record of a job before it
+ * is assumed to be DONE. */
+#define LSF_BHIST_MISSING_LIMIT 2
+/** The most elements of one job array, the default MAX_JOB_ARRAY_SIZE of
+ * LSF. */
+#define LSF_MAX_ARRAY_SIZE 1000
 
 struct lsf_job_struct {
     long int lsf_jobnr = 0;
-    /** Used to look up the job status in the bjobs_cache map */
+    /** Used to look up the job status in the bjobs_cache map; "1234[5]" for
+     * element 5 of job array 1234. */
     char *lsf_jobnr_char = nullptr;
     char *job_name = nullptr;
 };
@@ -52,6 +78,20 @@ struct lsf_driver_struct {
     char *login_shell = nullptr;
     char *project_code = nullptr;
     pthread_mutex_t submit_lock;
+    /** The most bsub commands which run at the same time, and the number
+     * which are running; see lsf_driver_begin_submit(). */
+    int submit_workers = 1;
+    int running_submits = 0;
+    std::mutex submit_slots_mutex;
+    std::condition_variable submit_slot_free;
+    /** Limits the rate of the bsub commands to SUBMIT_RATE per second, after
+     * a burst of SUBMIT_BURST. */
+    ert::TokenBucket submit_rate_limit;
+    double submit_rate = 0.0;
+    int submit_burst = 1;
+    std::string submit_workers_string;
+    std::string submit_rate_string;
+    std::string submit_burst_string;
 
     lsf_submit_method_enum submit_method = LSF_SUBMIT_LOCAL_SHELL;
     int submit_sleep = 0;
@@ -64,7 +104,8 @@ struct lsf_driver_struct {
     int bjobs_refresh_interval = 0;
     time_t last_bjobs_update = time(nullptr);
     /** A set of all jobs submitted by this ERT instance - to ensure
-     * that we do not check status of old jobs in e.g. ZOMBIE status. */
+     * that we do not check status of old jobs in e.g. ZOMBIE status. Guarded
+     * by the submit_lock; the status updates use a copy of it. */
     std::set<std::string> my_jobs;
     /** The output of calling bjobs is cached in this table. */
     std::map<std::string, int> bjobs_cache;
@@ -76,6 +117,32 @@ struct lsf_driver_struct {
     char *bjobs_cmd = nullptr;
     char *bkill_cmd = nullptr;
     char *bhist_cmd = nullptr;
+    /** The deadline for each bsub/bjobs/bkill/bhist command. */
+    std::chrono::milliseconds command_timeout{};
+    std::string command_timeout_string;
+    /** bjobs did not complete in time at the last update, so the
+     * bjobs_cache holds the status from before that. */
+    bool bjobs_stale = false;
+    /** Ask 'bjobs -json' for the jobs of this driver only, instead of
+     * listing all the jobs of the user with 'bjobs -a'. */
+    bool bjobs_json = false;
+    /** The exit code, hosts and times of the jobs from 'bjobs -json' and
+     * 'bhist -l'. */
+    std::map<std::string, queue_driver_job_accounting> bjobs_accounting;
+    /** The DONE or EXIT status of the jobs which have ended, from bjobs or
+     * bhist; these jobs are not looked up again. */
+    std::map<std::string, int> ended_jobs;
+    /** The number of bhist calls in a row which have had no record of the
+     * job, see lsf_driver_update_from_bhist(). */
+    std::map<std::string, int> bhist_missing;
+    /** Submit the jobs of a batch as job arrays. */
+    bool array_submit = false;
+    /** Run the commands on the remote LSF server in one shell which is kept
+     * running, instead of with a connection for each command. */
+    bool persistent_shell = false;
+    /** Created at the first remote command, see lsf_driver_run_remote(). */
+    std::unique_ptr<ert::RemoteShell> remote_shell;
+    std::mutex remote_shell_mutex;
 };
 
 const std::map<const std::string, int> status_map = {
@@ -127,33 +194,42 @@ static size_t file_size(const char *file) {
     return buffer.st_size;
 }
 
-int lsf_job_parse_bsub_stdout(const char *bsub_cmd, const char *stdout_file) {
+/**
+  Parses the job id from the output of bsub, which is on the form
+  "Job <12345> is submitted to default queue <normal>."; returns -1 if no job
+  id was found.
+*/
+int lsf_job_parse_bsub_output(const char *bsub_cmd, const std::string &output) {
     int jobid = -1;
-    if ((fs::exists(stdout_file)) && (file_size(stdout_file) > 0)) {
-        FILE *stream = fopen(stdout_file, "r");
-        if (!stream)
-            throw std::runtime_error("Unable to open bsub output: " +
-                                     std::string(strerror(errno)));
-        if (fseek_string(stream, "<", true)) {
-            char *jobid_string = fscanf_upto(stream, ">");
-            if (jobid_string != NULL) {
-                sscanf_int(jobid_string, &jobid);
-                free(jobid_string);
-            }
+    auto start = output.find('<');
+    if (start != std::string::npos) {
+        auto end = output.find('>', start + 1);
+        if (end != std::string::npos) {
+            auto jobid_string = output.substr(start + 1, end - start - 1);
+            sscanf_int(jobid_string.c_str(), &jobid);
         }
-        fclose(stream);
     }
     if (jobid == -1) {
-        std::ifstream ifs(stdout_file);
-        std::cerr << "Failed to get lsf job id from file: " << stdout_file;
-        std::cerr << "\n";
+        std::cerr << "Failed to get lsf job id from bsub output\n";
         std::cerr << "bsub command                      : " << bsub_cmd;
         std::cerr << "\n";
-        std::cerr << ifs.rdbuf() << std::endl;
+        std::cerr << output << std::endl;
     }
     return jobid;
 }
 
+int lsf_job_parse_bsub_stdout(const char *bsub_cmd, const char *stdout_file) {
+    std::string output;
+    if (fs::exists(stdout_file) && file_size(stdout_file) > 0) {
+        std::ifstream stream(stdout_file);
+        if (!stream)
+            throw std::runtime_error("Unable to open bsub output: " +
+                                     std::string(strerror(errno)));
+        std::getline(stream, output, '\0');
+    }
+    return lsf_job_parse_bsub_output(bsub_cmd, output);
+}
+
 static void lsf_driver_internal_error() {
     std::cerr << "\n\n";
     std::cerr << "******************************************************\n";
@@ -198,22 +274,21 @@ alloc_composed_resource_request(const lsf_driver_type *driver,
     } else {
         // add select string to existing select[...]
         char *endpos = strstr(pos, "]");
-        if (endpos != nullptr)
-            *endpos = ' ';
-        else
+        if (endpos == nullptr)
             throw std::runtime_error(fmt::format(
                 "could not find termination of select statement: {}",
                 std::string(resreq)));
 
         // We split string into (before) "bla[..] bla[..] select[xxx_"
-        // and (after) "... bla[..] bla[..]". (we replaced one ']' with ' ')
+        // and (after) "... bla[..] bla[..]". (the ']' is replaced with ' ',
+        // in the copy, as the request is shared by the submitting threads)
         // Then we make final string:  before + &&excludes] + after
         size_t before_size = endpos - resreq;
         char *before = strdup(resreq);
         before[before_size] = '\0';
-        char *after = &resreq[before_size];
+        const char *after = endpos + 1;
 
-        req = saprintf("%s && %s]%s", before, excludes_string.c_str(), after);
+        req = saprintf("%s && %s] %s", before, excludes_string.c_str(), after);
         free(before);
     }
     return req;
@@ -302,40 +377,62 @@ static char **lsf_driver_alloc_cmd(lsf_driver_type *driver,
         argv[i++] = strdup(driver->project_code);
     }
 
-    argv[i++] = strdup(submit_cmd);
-    argv[i++] = strdup(run_path);
+    // Without a command bsub reads the job script from its stdin
+    if (submit_cmd != NULL) {
+        argv[i++] = strdup(submit_cmd);
+        argv[i++] = strdup(run_path);
+    }
 
     assert(i <= LSF_ARGV_SIZE);
 
     return argv;
 }
 
-static int lsf_driver_submit_shell_job(lsf_driver_type *driver,
-                                       const char *lsf_stdout,
-                                       const char *job_name,
-                                       const char *submit_cmd, int num_cpu,
-                                       const char *run_path) {
-    int job_id;
-    constexpr int OUTPUT_FILE_SIZE = 32;
-    char tmp_file[OUTPUT_FILE_SIZE];
-    strncpy(tmp_file, "/tmp/enkf-submit-XXXXXX", OUTPUT_FILE_SIZE);
-    int fd = mkstemp(tmp_file);
-    close(fd);
+/**
+  Runs the command on the remote LSF server in the persistent remote shell,
+  or, without the PERSISTENT_SHELL option, with a connection of its own:
+  'ssh <server> <command>'. The command is killed after the timeout, if any.
+*/
+static spawn_output
+lsf_driver_run_remote(lsf_driver_type *driver, std::string command,
+                      std::optional<std::chrono::milliseconds> timeout,
+                      std::optional<std::string_view> input = std::nullopt) {
+    if (!driver->persistent_shell) {
+        char *const argv[4] = {driver->rsh_cmd, driver->remote_lsf_server,
+                               command.data(), nullptr};
+        return spawn_capture(argv, timeout, input);
+    }
+
+    ert::RemoteShell *shell;
+    {
+        std::lock_guard<std::mutex> lock(driver->remote_shell_mutex);
+        if (!driver->remote_shell)
+            driver->remote_shell =
+                std::make_unique<ert::RemoteShell>(std::vector<std::string>{
+                    driver->rsh_cmd, driver->remote_lsf_server, "sh"});
+        shell = driver->remote_shell.get();
+    }
+    return shell->run(command, input, timeout);
+}
 
+static int lsf_driver_submit_shell_job(
+    lsf_driver_type *driver, const char *lsf_stdout, const char *job_name,
+    const char *submit_cmd, int num_cpu, const char *run_path,
+    std::optional<std::string_view> job_script = std::nullopt) {
     char **remote_argv = lsf_driver_alloc_cmd(driver, lsf_stdout, job_name,
                                               submit_cmd, num_cpu, run_path);
 
     std::string joined_argv = join_with_space(remote_argv);
+    spawn_output output;
     if (driver->submit_method == LSF_SUBMIT_REMOTE_SHELL) {
-        char *const argv[2] = {driver->remote_lsf_server, joined_argv.data()};
-
-        logger->debug("Submitting: {} {} {} \n", driver->rsh_cmd, argv[0],
-                      argv[1]);
+        logger->debug("Submitting: {} {} {} \n", driver->rsh_cmd,
+                      driver->remote_lsf_server, joined_argv);
 
-        spawn_blocking(driver->rsh_cmd, 2, (const char **)argv, tmp_file, NULL);
+        output = lsf_driver_run_remote(driver, joined_argv, std::nullopt,
+                                       job_script);
     } else if (driver->submit_method == LSF_SUBMIT_LOCAL_SHELL) {
         logger->debug("Submitting: {}\n", joined_argv);
-        spawn_blocking(remote_argv, tmp_file, nullptr);
+        output = spawn_capture(remote_argv, std::nullopt, job_script);
     }
 
     for (int i = 0; i < LSF_ARGV_SIZE; i++) {
@@ -343,22 +440,28 @@ static int lsf_driver_submit_shell_job(lsf_driver_type *driver,
     }
     free(remote_argv);
 
-    job_id = lsf_job_parse_bsub_stdout(driver->bsub_cmd, tmp_file);
-    remove(tmp_file);
-    return job_id;
+    return lsf_job_parse_bsub_output(driver->bsub_cmd, output.out);
 }
 
-static void run_bjobs(lsf_driver_type *driver, char *output_file) {
+/** Runs the bjobs or bhist command with the arguments, on the LSF server. */
+static spawn_output run_lsf_query(lsf_driver_type *driver, char *cmd,
+                                  const std::vector<std::string> &args) {
     if (driver->submit_method == LSF_SUBMIT_REMOTE_SHELL) {
-        std::string remote_argv = fmt::format("{} -a", driver->bjobs_cmd);
-        char *const argv[4] = {driver->rsh_cmd, driver->remote_lsf_server,
-                               remote_argv.data(), nullptr};
-        spawn_blocking(argv, output_file, nullptr);
+        std::string remote_argv = cmd;
+        for (const auto &arg : args)
+            remote_argv += arg.find_first_of(" []") == std::string::npos
+                               ? " " + arg
+                               : " '" + arg + "'";
+        return lsf_driver_run_remote(driver, remote_argv,
+                                     driver->command_timeout);
     } else if (driver->submit_method == LSF_SUBMIT_LOCAL_SHELL) {
-        char arg[] = "-a";
-        char *const argv[3] = {driver->bjobs_cmd, arg, nullptr};
-        spawn_blocking(argv, output_file, nullptr);
+        std::vector<char *> argv{cmd};
+        for (const auto &arg : args)
+            argv.push_back(const_cast<char *>(arg.c_str()));
+        argv.push_back(nullptr);
+        return spawn_capture(argv.data(), driver->command_timeout);
     }
+    return {};
 }
 
 static char *strip(const char *src) {
@@ -465,23 +568,318 @@ static void skip_line(FILE *stream) {
     }
 }
 
-static void lsf_driver_update_bjobs_table(lsf_driver_type *driver) {
-    constexpr int OUTPUT_FILE_SIZE = 32;
-    char tmp_file[OUTPUT_FILE_SIZE];
-    strncpy(tmp_file, "/tmp/enkf-submit-XXXXXX", OUTPUT_FILE_SIZE);
-    int fd = mkstemp(tmp_file);
-    close(fd);
+namespace {
+/** Reads one JSON string starting at the opening quote, and decodes its
+ * escapes; pos is left after the closing quote. */
+std::string scan_json_string(std::string_view text, size_t &pos) {
+    std::string value;
+    for (pos++; pos < text.size() && text[pos] != '"'; pos++) {
+        if (text[pos] != '\\' || pos + 1 == text.size()) {
+            value += text[pos];
+            continue;
+        }
+        switch (char escaped = text[++pos]) {
+        case 'b':
+            value += '\b';
+            break;
+        case 'f':
+            value += '\f';
+            break;
+        case 'n':
+            value += '\n';
+            break;
+        case 'r':
+            value += '\r';
+            break;
+        case 't':
+            value += '\t';
+            break;
+        case 'u': {
+            unsigned code = 0;
+            if (pos + 4 >= text.size() ||
+                sscanf(std::string(text.substr(pos + 1, 4)).c_str(), "%4x",
+                       &code) != 1)
+                break;
+            pos += 4;
+            // UTF-8, surrogate pairs are not combined
+            if (code < 0x80) {
+                value += static_cast<char>(code);
+            } else if (code < 0x800) {
+                value += static_cast<char>(0xc0 | code >> 6);
+                value += static_cast<char>(0x80 | (code & 0x3f));
+            } else {
+                value += static_cast<char>(0xe0 | code >> 12);
+                value += static_cast<char>(0x80 | (code >> 6 & 0x3f));
+                value += static_cast<char>(0x80 | (code & 0x3f));
+            }
+            break;
+        }
+        default:
+            value += escaped;
+        }
+    }
+    pos++;
+    return value;
+}
+} // namespace
+
+/**
+  Scans the output of 'bjobs -json' in one pass, and returns the fields of
+  each object in its RECORDS list. bjobs gives all the fields as strings;
+  other values are returned as they are written. A job which bjobs does not
+  know has an ERROR field instead of its status.
+*/
+std::vector<std::unordered_map<std::string, std::string>>
+lsf_driver_parse_bjobs_json(std::string_view output) {
+    std::vector<std::unordered_map<std::string, std::string>> records;
+    // The open objects and arrays, and the key of the value being read
+    std::string nesting;
+    std::string key;
+    bool in_records = false;
+    size_t pos = 0;
+    while (pos < output.size()) {
+        char c = output[pos];
+        switch (c) {
+        case '{':
+            nesting += c;
+            // The records are the objects in the RECORDS list of the
+            // outermost object
+            if (in_records && nesting == "{[{")
+                records.emplace_back();
+            pos++;
+            break;
+        case '[':
+            if (nesting == "{")
+                in_records = key == "RECORDS";
+            nesting += c;
+            pos++;
+            break;
+        case '}':
+        case ']':
+            if (!nesting.empty())
+                nesting.pop_back();
+            key.clear();
+            pos++;
+            break;
+        case ':':
+        case ',':
+        case ' ':
+        case '\t':
+        case '\r':
+        case '\n':
+            pos++;
+            break;
+        default: {
+            // A string, or a number or literal up to the next delimiter
+            bool is_key = false;
+            std::string value;
+            if (c == '"') {
+                value = scan_json_string(output, pos);
+                auto next = output.find_first_not_of(" \t\r\n", pos);
+                is_key = next != std::string_view::npos && output[next] == ':';
+            } else {
+                auto end = output.find_first_of(",:{}[] \t\r\n", pos);
+                if (end == std::string_view::npos)
+                    end = output.size();
+                value = output.substr(pos, end - pos);
+                pos = end;
+            }
+            if (is_key) {
+                key = value;
+            } else {
+                if (in_records && nesting == "{[{")
+                    records.back()[key] = value;
+                key.clear();
+            }
+        }
+        }
+    }
+    return records;
+}
+
+/** The number at the start of a bjobs field, e.g. "25 second(s)". */
+static std::optional<double> lsf_parse_number(const std::string &field) {
+    char *end = nullptr;
+    double value = std::strtod(field.c_str(), &end);
+    if (end == field.c_str())
+        return std::nullopt;
+    return value;
+}
+
+/** Whether the job id is that of a submitted job, "1234", or of an element
+ * of a job array, "1234[5]"; failed submissions have no job id. */
+static bool lsf_driver_is_job_id(const std::string &job_id) {
+    auto id_end = job_id.find_first_not_of("0123456789");
+    if (id_end == 0 || job_id == "0")
+        return false;
+    if (id_end == std::string::npos)
+        return true;
+    return job_id[id_end] == '[' && job_id.back() == ']' &&
+           job_id.size() > id_end + 2 &&
+           job_id.find_first_not_of("0123456789", id_end + 1) ==
+               job_id.size() - 1;
+}
+
+/** The id of the job array of an element, "1234" for "1234[5]". */
+static std::string lsf_array_job_id(const std::string &job_id) {
+    return job_id.substr(0, job_id.find('['));
+}
+
+/** The jobs of this driver which are not known to have ended. */
+static std::vector<std::string>
+lsf_driver_active_ids(const lsf_driver_type *driver,
+                      const std::set<std::string> &my_jobs) {
+    std::vector<std::string> active_ids;
+    for (const auto &job_id : my_jobs)
+        if (lsf_driver_is_job_id(job_id) &&
+            driver->ended_jobs.count(job_id) == 0)
+            active_ids.push_back(job_id);
+    return active_ids;
+}
+
+/**
+  Replaces the bjobs_cache with the status from bjobs, to which the jobs
+  which have ended are added; those which bjobs shows as ended are recorded.
+*/
+static void lsf_driver_replace_bjobs_cache(lsf_driver_type *driver,
+                                           std::map<std::string, int> cache) {
+    for (const auto &[job_id, status] : cache)
+        if (status == JOB_STAT_DONE || status == JOB_STAT_EXIT)
+            driver->ended_jobs[job_id] = status;
+    cache.insert(driver->ended_jobs.begin(), driver->ended_jobs.end());
+    driver->bjobs_cache = std::move(cache);
+}
+
+/**
+  Updates the bjobs_cache with 'bjobs -json' for the jobs of this driver
+  which have not ended, at most LSF_MAX_JOB_IDS in each call, and records
+  their exit code, hosts and times. A job array is asked for once for all its
+  elements. If a bjobs call does not complete in time the previous cache is
+  kept.
+*/
+static void
+lsf_driver_update_bjobs_table_json(lsf_driver_type *driver,
+                                   const std::set<std::string> &my_jobs) {
+    std::map<std::string, int> bjobs_cache;
+    std::vector<std::string> active_ids;
+    std::set<std::string> array_ids;
+    for (const auto &job_id : lsf_driver_active_ids(driver, my_jobs))
+        if (auto array_id = lsf_array_job_id(job_id);
+            array_ids.insert(array_id).second)
+            active_ids.push_back(array_id);
+
+    std::string output;
+    for (size_t first = 0; first < active_ids.size();
+         first += LSF_MAX_JOB_IDS) {
+        std::vector<std::string> args{"-o", LSF_BJOBS_JSON_FIELDS, "-json"};
+        auto last = std::min(active_ids.size(), first + LSF_MAX_JOB_IDS);
+        args.insert(args.end(), active_ids.begin() + first,
+                    active_ids.begin() + last);
+        auto bjobs = run_lsf_query(driver, driver->bjobs_cmd, args);
+        driver->bjobs_stale = bjobs.timed_out;
+        if (bjobs.timed_out) {
+            logger->warning("bjobs did not complete within {} ms, keeping the "
+                            "status of {} jobs from the previous bjobs call",
+                            driver->command_timeout.count(),
+                            driver->bjobs_cache.size());
+            return;
+        }
+        if (bjobs.status != 0)
+            logger->warning("bjobs returned non zero exitcode: {} {}",
+                            bjobs.status, bjobs.err);
+        output += bjobs.out;
+    }
 
-    run_bjobs(driver, tmp_file);
+    for (auto &record : lsf_driver_parse_bjobs_json(output)) {
+        auto job_id = record["JOBID"];
+        if (const auto &index = record["JOBINDEX"]; !index.empty() &&
+                                                    index != "0" &&
+                                                    index != "-")
+            job_id += "[" + index + "]";
+        const auto &status = record["STAT"];
+        // A job which bjobs does not know has no STAT
+        if (status.empty() || my_jobs.count(job_id) == 0)
+            continue;
+        auto found_status = status_map.find(status);
+        if (found_status == status_map.end())
+            throw std::runtime_error(
+                fmt::format("The lsf_status:{} for job:{} was "
+                            "not recognized\n",
+                            status, job_id));
+        bjobs_cache[job_id] = found_status->second;
+
+        // A field without a value is empty, or "-"
+        auto &accounting = driver->bjobs_accounting[job_id];
+        auto exit_code = lsf_parse_number(record["EXIT_CODE"]);
+        if (exit_code)
+            accounting.exit_code = static_cast<int>(*exit_code);
+        else if (found_status->second == JOB_STAT_DONE)
+            accounting.exit_code = 0;
+        if (const auto &hosts = record["EXEC_HOST"]; hosts != "-")
+            accounting.node_list = hosts;
+        accounting.pending_time = lsf_parse_number(record["PEND_TIME"]);
+        accounting.elapsed = lsf_parse_number(record["RUN_TIME"]);
+    }
+    lsf_driver_replace_bjobs_cache(driver, std::move(bjobs_cache));
+}
+
+/**
+  The id of the job on a line of the 'bjobs -a' output. An element of a job
+  array is listed with the id of the array, and a job name which ends with
+  the index of the element, e.g. "realization-0[5]"; bjobs keeps the end of
+  a job name which is too long for its column.
+*/
+static std::string
+lsf_bjobs_line_job_id(const std::set<std::string> &my_jobs, int job_id_int,
+                      const char *line) {
+    std::string job_id = std::to_string(job_id_int);
+    if (my_jobs.count(job_id) > 0)
+        return job_id;
+
+    std::istringstream words{line};
+    for (std::string word; words >> word;) {
+        auto index_start = word.rfind('[');
+        if (index_start == std::string::npos || word.back() != ']')
+            continue;
+        auto element_id = job_id + word.substr(index_start);
+        if (my_jobs.count(element_id) > 0)
+            return element_id;
+    }
+    return job_id;
+}
+
+/**
+  Replaces the bjobs_cache with the output of 'bjobs -a'. If bjobs does not
+  complete in time the previous cache is kept, so that a slow LSF server
+  gives an old status instead of stalling the queue.
+*/
+static void
+lsf_driver_update_bjobs_table_all(lsf_driver_type *driver,
+                                  const std::set<std::string> &my_jobs) {
+    auto bjobs = run_lsf_query(driver, driver->bjobs_cmd, {"-a"});
+    driver->bjobs_stale = bjobs.timed_out;
+    if (bjobs.timed_out) {
+        logger->warning("bjobs did not complete within {} ms, keeping the "
+                        "status of {} jobs from the previous bjobs call",
+                        driver->command_timeout.count(),
+                        driver->bjobs_cache.size());
+        return;
+    }
+
+    std::string &output = bjobs.out;
+    std::map<std::string, int> bjobs_cache;
+    if (output.empty()) {
+        lsf_driver_replace_bjobs_cache(driver, std::move(bjobs_cache));
+        return;
+    }
 
     char status[16];
-    FILE *stream = fopen(tmp_file, "r");
+    FILE *stream = fmemopen(output.data(), output.size(), "r");
     if (!stream) {
         throw std::runtime_error("Unable to open bjobs output: " +
                                  std::string(strerror(errno)));
     }
     bool at_eof = false;
-    driver->bjobs_cache.clear();
     skip_line(stream);
     while (!at_eof) {
         char *line = next_line(stream, &at_eof);
@@ -489,14 +887,13 @@ static void lsf_driver_update_bjobs_table(lsf_driver_type *driver) {
             int job_id_int;
 
             if (sscanf(line, "%d %*s %s", &job_id_int, status) == 2) {
-                std::string job_id = std::to_string(job_id_int);
+                auto job_id = lsf_bjobs_line_job_id(my_jobs, job_id_int, line);
                 // Consider only jobs submitted by this ERT instance - not
                 // old jobs lying around from the same user.
-                if (driver->my_jobs.count(job_id) > 0) {
+                if (my_jobs.count(job_id) > 0) {
                     if (auto found_status = status_map.find(status);
                         found_status != status_map.end())
-                        driver->bjobs_cache.insert(
-                            {job_id, found_status->second});
+                        bjobs_cache.insert({job_id, found_status->second});
                     else {
                         free(line);
                         fclose(stream);
@@ -511,60 +908,108 @@ static void lsf_driver_update_bjobs_table(lsf_driver_type *driver) {
         }
     }
     fclose(stream);
-    unlink(tmp_file);
+    lsf_driver_replace_bjobs_cache(driver, std::move(bjobs_cache));
 }
 
-/// Run bhist and store its output in output_file
-static void run_bhist(lsf_driver_type *driver, lsf_job_type *job,
-                      char *output_file) {
-    if (driver->submit_method == LSF_SUBMIT_REMOTE_SHELL) {
-        std::string remote_argv =
-            fmt::format("{} {}", driver->bhist_cmd, job->lsf_jobnr_char);
-        char *const argv[4] = {driver->rsh_cmd, driver->remote_lsf_server,
-                               remote_argv.data(), nullptr};
-        spawn_blocking(argv, output_file, nullptr);
-    } else if (driver->submit_method == LSF_SUBMIT_LOCAL_SHELL) {
-        char *const argv[3] = {driver->bhist_cmd, job->lsf_jobnr_char, nullptr};
-        spawn_blocking(argv, output_file, nullptr);
+/**
+  Joins the lines which 'bhist -l' has wrapped at 80 columns; the rest of a
+  wrapped line is indented by 21 spaces, and may start within a word.
+*/
+static std::vector<std::string>
+lsf_unwrap_bhist_lines(std::string_view output) {
+    constexpr std::string_view indent = "                     ";
+    std::vector<std::string> lines;
+    while (!output.empty()) {
+        auto line_end = std::min(output.find('\n'), output.size());
+        auto line = output.substr(0, line_end);
+        output.remove_prefix(std::min(line_end + 1, output.size()));
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+
+        if (!lines.empty() && line.substr(0, indent.size()) == indent)
+            lines.back() += line.substr(line.find_first_not_of(' '));
+        else
+            lines.emplace_back(line);
     }
+    return lines;
 }
 
-/// Get the bhist output from output_file and return
-/// tuple of pend_time and run_time
-static std::pair<int, int> parse_bhist_output(char *output_file, char *job_id) {
-    std::ifstream stream(output_file);
-    std::string line;
-    std::getline(stream, line); // skip header lines
-    std::getline(stream, line);
-    stream >> std::skipws;
-    int pend_time = 0, run_time = 0;
-    std::string tmp_str;
-    stream >> tmp_str; // skip job id
-    if (tmp_str != job_id) {
-        logger->warning("bhist showed job id {} while looking for {}", tmp_str,
-                        job_id);
-    }
-    stream >> tmp_str; // skip user
-    stream >> tmp_str; // skip job name
-    stream >> pend_time;
-    stream >> tmp_str; // skip psusp
-    stream >> run_time;
-    return std::make_pair(pend_time, run_time);
+/** The text between the first '<' after the prefix and the next '>'. */
+static std::string lsf_bracketed(const std::string &line,
+                                 std::string_view prefix) {
+    auto start = line.find(prefix);
+    if (start == std::string::npos)
+        return {};
+    start = line.find('<', start + prefix.size());
+    auto end = line.find('>', start);
+    if (start == std::string::npos || end == std::string::npos)
+        return {};
+    return line.substr(start + 1, end - start - 1);
 }
 
-static std::pair<int, int> get_bhist_stats(lsf_driver_type *driver,
-                                           lsf_job_type *job) {
-    constexpr int OUTPUT_FILE_SIZE = 32;
-    char output_file[OUTPUT_FILE_SIZE];
-    strncpy(output_file, "/tmp/bhist-XXXXXXXXXX", OUTPUT_FILE_SIZE);
-    int fd = mkstemp(output_file);
-    close(fd);
-
-    run_bhist(driver, job, output_file);
-    auto result = parse_bhist_output(output_file, job->lsf_jobnr_char);
-
-    remove(output_file);
-    return result;
+/**
+  Parses the output of 'bhist -l' for one or more jobs. The status of each
+  job is that of its last event: submitted, dispatched or started, done, or
+  exited, with the exit code or signal. The pending and running times are
+  read from the summary of the job.
+*/
+std::map<std::string, lsf_job_history>
+lsf_driver_parse_bhist(const std::string &output) {
+    std::map<std::string, lsf_job_history> jobs;
+    lsf_job_history *job = nullptr;
+    std::vector<std::string> summary_header;
+    for (const auto &line : lsf_unwrap_bhist_lines(output)) {
+        if (line.rfind("Job <", 0) == 0) {
+            job = &jobs[lsf_bracketed(line, "Job")];
+            summary_header.clear();
+            continue;
+        }
+        if (job == nullptr)
+            continue;
+
+        auto &accounting = job->accounting;
+        int exit_value;
+        if (line.find(": Submitted from") != std::string::npos) {
+            job->status = JOB_STAT_PEND;
+        } else if (line.find(": Dispatched") != std::string::npos) {
+            job->status = JOB_STAT_RUN;
+            accounting.node_list = lsf_bracketed(line, "Host(s)");
+        } else if (line.find(": Starting") != std::string::npos ||
+                   line.find(": Running") != std::string::npos) {
+            job->status = JOB_STAT_RUN;
+        } else if (line.find(": Done successfully") != std::string::npos) {
+            job->status = JOB_STAT_DONE;
+            accounting.exit_code = 0;
+            accounting.exit_signal = 0;
+        } else if (auto exited = line.find(": Exited");
+                   exited != std::string::npos) {
+            job->status = JOB_STAT_EXIT;
+            auto detail = line.c_str() + exited;
+            if (sscanf(detail, ": Exited with exit code %d", &exit_value) == 1)
+                accounting.exit_code = exit_value;
+            else if (sscanf(detail, ": Exited by signal %d", &exit_value) == 1)
+                accounting.exit_signal = exit_value;
+        } else if (auto first = line.find_first_not_of(' ');
+                   first != std::string::npos &&
+                   line.compare(first, 5, "PEND ") == 0) {
+            std::istringstream words{line};
+            summary_header.assign(std::istream_iterator<std::string>(words),
+                                  std::istream_iterator<std::string>());
+        } else if (!summary_header.empty()) {
+            std::istringstream words{line};
+            for (const auto &column : summary_header) {
+                double seconds;
+                if (!(words >> seconds))
+                    break;
+                if (column == "PEND")
+                    accounting.pending_time = seconds;
+                else if (column == "RUN")
+                    accounting.elapsed = seconds;
+            }
+            summary_header.clear();
+        }
+    }
+    return jobs;
 }
 
 /**
@@ -575,55 +1020,104 @@ static std::pair<int, int> get_bhist_stats(lsf_driver_type *driver,
   subsequently evicted from the LSF status table, before we are able
   to record the DONE/EXIT status.
 
-  When a job is missing from the bjobs_cache table we as a last resort
-  invoke the bhist command (which is based on internal LSF data with
-  much longer lifetime) and measure the change in run_time and
-  pend_time between two subsequent calls:
-
-
-    1. ((pend_time1 == pend_time2) && (run_time1 == run_time2)) :
-       Nothing is happening, and we assume that the job is DONE (this
-       method can not distinguish between DONE and EXIT).
-
-    2. (run_time2 > run_time1) : The job is running.
-
-    3. (pend_tim2 > pend_time1) : The job is pending.
-
-    4. Status unknown - have not got a clue?!
+  The jobs of this driver which are missing from the bjobs_cache are
+  therefore looked up with one 'bhist -l' call, which is based on internal
+  LSF data with a much longer lifetime, for at most LSF_MAX_JOB_IDS jobs.
+  A job which bhist has no record of in LSF_BHIST_MISSING_LIMIT calls in a
+  row is assumed to be DONE; if it has actually failed this should be picked
+  up by the post run checking. Only the jobs which bhist shows as ended are
+  recorded, so that each is looked up once; an assumed DONE job is looked up
+  again at the next update, in case bhist did not know of it yet.
 */
-static int lsf_driver_get_bhist_status_shell(lsf_driver_type *driver,
-                                             lsf_job_type *job) {
-    constexpr int SLEEP_TIME = 4;
-
-    std::pair<int, int> stats1{}, stats2{};
-    try {
-        stats1 = get_bhist_stats(driver, job);
-    } catch (std::exception &err) {
-        logger->warning("bhist failed: {}", err.what());
-        return JOB_STAT_UNKWN;
+static void
+lsf_driver_update_from_bhist(lsf_driver_type *driver,
+                             const std::set<std::string> &my_jobs) {
+    std::vector<std::string> missing_ids;
+    for (const auto &job_id : lsf_driver_active_ids(driver, my_jobs))
+        if (driver->bjobs_cache.count(job_id) == 0)
+            missing_ids.push_back(job_id);
+        else
+            driver->bhist_missing.erase(job_id);
+    if (missing_ids.empty())
+        return;
+
+    logger->info("{} jobs are not listed by bjobs, this *might* mean that "
+                 "they have completed/exited and fallen out of the bjobs "
+                 "status table maintained by LSF - trying with 'bhist'",
+                 missing_ids.size());
+    std::string output;
+    for (size_t first = 0; first < missing_ids.size();
+         first += LSF_MAX_JOB_IDS) {
+        std::vector<std::string> args{"-l"};
+        auto last = std::min(missing_ids.size(), first + LSF_MAX_JOB_IDS);
+        args.insert(args.end(), missing_ids.begin() + first,
+                    missing_ids.begin() + last);
+        auto bhist = run_lsf_query(driver, driver->bhist_cmd, args);
+        if (bhist.timed_out) {
+            logger->warning("bhist did not complete within {} ms",
+                            driver->command_timeout.count());
+            return;
+        }
+        if (bhist.status != 0 && bhist.out.empty()) {
+            logger->warning("bhist failed with exitcode: {} {}", bhist.status,
+                            bhist.err);
+            return;
+        }
+        output += bhist.out;
     }
 
-    sleep(SLEEP_TIME);
+    auto history = lsf_driver_parse_bhist(output);
+    for (const auto &job_id : missing_ids) {
+        auto job = history.find(job_id);
+        if (job == history.end()) {
+            if (++driver->bhist_missing[job_id] < LSF_BHIST_MISSING_LIMIT)
+                continue;
+            logger->warning("bhist has no record of job {} - assuming it is "
+                            "DONE",
+                            job_id);
+            driver->bjobs_cache[job_id] = JOB_STAT_DONE;
+            continue;
+        }
 
-    try {
-        stats2 = get_bhist_stats(driver, job);
-    } catch (std::exception &err) {
-        logger->warning("bhist failed: {}", err.what());
-        return JOB_STAT_UNKWN;
+        int status = job->second.status;
+        driver->bhist_missing.erase(job_id);
+        driver->bjobs_accounting[job_id] = job->second.accounting;
+        driver->bjobs_cache[job_id] = status;
+        if (status == JOB_STAT_DONE || status == JOB_STAT_EXIT)
+            driver->ended_jobs[job_id] = status;
     }
+}
 
-    if (stats1 == stats2)
-        return JOB_STAT_DONE;
-
-    auto [pend_time1, run_time1] = stats1;
-    auto [pend_time2, run_time2] = stats2;
+/**
+  Updates the bjobs_cache with bjobs, and the jobs which bjobs does not list
+  with bhist. The jobs of the driver are copied under the submit_lock, as
+  they may be submitted while bjobs runs.
+*/
+static void lsf_driver_update_bjobs_table(lsf_driver_type *driver) {
+    pthread_mutex_lock(&driver->submit_lock);
+    auto my_jobs = driver->my_jobs;
+    pthread_mutex_unlock(&driver->submit_lock);
 
-    if (pend_time2 > pend_time1)
-        return JOB_STAT_PEND;
+    if (driver->bjobs_json)
+        lsf_driver_update_bjobs_table_json(driver, my_jobs);
+    else
+        lsf_driver_update_bjobs_table_all(driver, my_jobs);
 
-    if (run_time2 > run_time1)
-        return JOB_STAT_RUN;
+    // bhist goes to the same LSF server which did not answer bjobs in time
+    if (!driver->bjobs_stale)
+        lsf_driver_update_from_bhist(driver, my_jobs);
+}
 
+/**
+  Looks up the status of the job in the bjobs_cache table; the table must
+  already have been updated by the caller, who holds the bjobs_mutex. A job
+  which neither bjobs nor bhist has given the status of is UNKWN.
+*/
+static int lsf_driver_get_cached_status(lsf_driver_type *driver,
+                                        lsf_job_type *job) {
+    if (auto cached = driver->bjobs_cache.find(job->lsf_jobnr_char);
+        cached != driver->bjobs_cache.end())
+        return cached->second;
     return JOB_STAT_UNKWN;
 }
 
@@ -644,32 +1138,17 @@ static int lsf_driver_get_job_status_shell(void *_driver, void *_job) {
                 bool update_cache =
                     ((difftime(time(NULL), driver->last_bjobs_update) >
                       driver->bjobs_refresh_interval) ||
-                     driver->bjobs_cache.count(job->lsf_jobnr_char) < 1);
+                     (!driver->bjobs_stale &&
+                      driver->bjobs_cache.count(job->lsf_jobnr_char) < 1));
                 if (update_cache) {
                     lsf_driver_update_bjobs_table(driver);
                     driver->last_bjobs_update = time(NULL);
                 }
             }
+            // Another thread may replace the bjobs_cache as soon as the mutex
+            // is released
+            status = lsf_driver_get_cached_status(driver, job);
             pthread_mutex_unlock(&driver->bjobs_mutex);
-
-            if (driver->bjobs_cache.count(job->lsf_jobnr_char) > 0)
-                status = driver->bjobs_cache.at(job->lsf_jobnr_char);
-            else {
-                // The job was not in the status cache, this *might* mean that
-                // it has completed/exited and fallen out of the bjobs status
-                // table maintained by LSF. We try calling bhist to get the
-                // status.
-                logger->error(
-                    "In lsf_driver we found that job {}/{} was not in the "
-                    "status cache, this *might* mean that it has "
-                    "completed/exited and fallen out of the bjobs "
-                    "status table maintained by LSF. "
-                    " - trying with \'bhist\'.\n",
-                    job->lsf_jobnr_char, job->job_name);
-
-                status = lsf_driver_get_bhist_status_shell(driver, job);
-                driver->bjobs_cache.insert({job->lsf_jobnr_char, status});
-            }
         }
     }
 
@@ -698,6 +1177,62 @@ job_status_type lsf_driver_get_job_status(void *_driver, void *_job) {
     return lsf_driver_convert_status(lsf_status);
 }
 
+/**
+  Same as lsf_driver_get_job_status(), but the bjobs_cache table is updated
+  with at most one bjobs call for all the jobs.
+*/
+void lsf_driver_get_job_status_batch(void *_driver, void *const *jobs,
+                                     size_t num_jobs,
+                                     job_status_type *status) {
+    auto driver = static_cast<lsf_driver_type *>(_driver);
+
+    pthread_mutex_lock(&driver->bjobs_mutex);
+    {
+        bool update_cache = difftime(time(NULL), driver->last_bjobs_update) >
+                            driver->bjobs_refresh_interval;
+        // New jobs are not looked up while the cache is stale, see
+        // lsf_driver_update_bjobs_table()
+        for (size_t i = 0; i < num_jobs && !update_cache; i++) {
+            auto job = static_cast<const lsf_job_type *>(jobs[i]);
+            if (job != NULL && !driver->bjobs_stale &&
+                driver->bjobs_cache.count(job->lsf_jobnr_char) < 1)
+                update_cache = true;
+        }
+        if (update_cache) {
+            lsf_driver_update_bjobs_table(driver);
+            driver->last_bjobs_update = time(NULL);
+        }
+    }
+    // Read under the mutex, see lsf_driver_get_job_status_shell()
+    std::vector<int> lsf_status(num_jobs, JOB_STAT_NULL);
+    for (size_t i = 0; i < num_jobs; i++)
+        if (jobs[i] != NULL)
+            lsf_status[i] = lsf_driver_get_cached_status(
+                driver, static_cast<lsf_job_type *>(jobs[i]));
+    pthread_mutex_unlock(&driver->bjobs_mutex);
+
+    for (size_t i = 0; i < num_jobs; i++)
+        status[i] = lsf_driver_convert_status(lsf_status[i]);
+}
+
+/**
+  The exit code, hosts and times of the job from the latest 'bjobs -json'
+  call which listed it, or from 'bhist -l' for a job which bjobs no longer
+  lists. Without the BJOBS_JSON option only the latter is recorded.
+*/
+bool lsf_driver_get_job_accounting(void *_driver, void *_job,
+                                   queue_driver_job_accounting *accounting) {
+    auto driver = static_cast<lsf_driver_type *>(_driver);
+    auto job = static_cast<const lsf_job_type *>(_job);
+    pthread_mutex_lock(&driver->bjobs_mutex);
+    auto recorded = driver->bjobs_accounting.find(job->lsf_jobnr_char);
+    bool found = recorded != driver->bjobs_accounting.end();
+    if (found)
+        *accounting = recorded->second;
+    pthread_mutex_unlock(&driver->bjobs_mutex);
+    return found;
+}
+
 void lsf_driver_free_job(void *_job) {
     auto job = static_cast<lsf_job_type *>(_job);
     lsf_job_free(job);
@@ -732,30 +1267,33 @@ void lsf_driver_kill_job(void *_driver, void *_job) {
     auto driver = static_cast<lsf_driver_type *>(_driver);
     auto job = static_cast<lsf_job_type *>(_job);
     if (driver->submit_method == LSF_SUBMIT_REMOTE_SHELL) {
-        char **argv = (char **)calloc(2, sizeof *argv);
-        CHECK_ALLOC(argv);
-        argv[0] = driver->remote_lsf_server;
-        argv[1] = saprintf("%s %s %s", driver->bkill_cmd, "-s SIGTERM",
-                           job->lsf_jobnr_char);
-        spawn_blocking(driver->rsh_cmd, 2, (const char **)argv, NULL, NULL);
-        free(argv[1]);
-        free(argv);
-
-        char **argv2 = (char **)calloc(2, sizeof *argv2);
-        argv2[0] = driver->remote_lsf_server;
-        argv2[1] = saprintf("%s %s %s %s %s", "sleep 30;", driver->bkill_cmd,
-                            "-s", "SIGKILL", job->lsf_jobnr_char);
-        spawn(driver->rsh_cmd, 2, (const char **)argv2, NULL, NULL);
-        free(argv2[0]);
-        free(argv2);
-
+        lsf_driver_run_remote(driver,
+                              fmt::format("{} -s SIGTERM '{}'",
+                                          driver->bkill_cmd,
+                                          job->lsf_jobnr_char),
+                              driver->command_timeout);
+
+        auto delayed_kill = fmt::format("sleep 30; {} -s SIGKILL '{}'",
+                                        driver->bkill_cmd, job->lsf_jobnr_char);
+        if (driver->persistent_shell) {
+            // In the background, where it outlives a restart of the shell
+            lsf_driver_run_remote(driver,
+                                  "(trap '' HUP; " + delayed_kill +
+                                      ") >/dev/null 2>&1 &",
+                                  driver->command_timeout);
+        } else {
+            char *const argv[2] = {driver->remote_lsf_server,
+                                   delayed_kill.data()};
+            spawn(driver->rsh_cmd, 2, (const char **)argv, NULL, NULL);
+        }
     } else if (driver->submit_method == LSF_SUBMIT_LOCAL_SHELL) {
         char **argv = (char **)calloc(3, sizeof *argv);
         CHECK_ALLOC(argv);
         argv[0] = saprintf("%s", "-s");
         argv[1] = saprintf("%s", "SIGTERM");
         argv[2] = saprintf("%s", job->lsf_jobnr_char);
-        spawn_blocking(driver->bkill_cmd, 3, (const char **)argv, NULL, NULL);
+        spawn_blocking(driver->bkill_cmd, 3, (const char **)argv, NULL, NULL,
+                       driver->command_timeout);
         free(argv[0]);
         free(argv[1]);
         free(argv[2]);
@@ -764,7 +1302,7 @@ void lsf_driver_kill_job(void *_driver, void *_job) {
         char **argv2 = (char **)calloc(2, sizeof *argv2);
         CHECK_ALLOC(argv2);
         argv2[0] = saprintf("%s", "-c");
-        argv2[1] = saprintf("%s %s %s %s %s", "sleep 30;", driver->bkill_cmd,
+        argv2[1] = saprintf("%s %s %s %s '%s'", "sleep 30;", driver->bkill_cmd,
                             "-s", "SIGKILL", job->lsf_jobnr_char);
         spawn((const char *)saprintf("%s", "/bin/sh"), 2, (const char **)argv2,
               "/dev/null", "/dev/null");
@@ -774,6 +1312,79 @@ void lsf_driver_kill_job(void *_driver, void *_job) {
     }
 }
 
+/** Writes the id of the job to the lsf_info.json file in the run_path. */
+static void lsf_job_write_info(const lsf_job_type *job,
+                               const fs::path &run_path,
+                               size_t array_index = 0) {
+    fs::path json_file = run_path / LSF_JSON;
+    std::ofstream stream(json_file);
+    if (stream.fail()) {
+        throw std::runtime_error("Unable to open bjobs output");
+    }
+    if (array_index > 0)
+        stream << fmt::format("{{\"job_id\" : {}, \"array_index\" : {} }}\n",
+                              job->lsf_jobnr, array_index);
+    else
+        stream << fmt::format("{{\"job_id\" : {} }}\n", job->lsf_jobnr);
+    stream.close();
+}
+
+/**
+  Counts a failed submission, and waits before the next one; throws when too
+  many submissions have failed.
+*/
+static void lsf_driver_submit_failed(lsf_driver_type *driver) {
+    pthread_mutex_lock(&driver->submit_lock);
+    int error_count = ++driver->error_count;
+    pthread_mutex_unlock(&driver->submit_lock);
+
+    if (error_count >= MAX_ERROR_COUNT) {
+        throw std::runtime_error("Maximum number of submit errors exceeded\n");
+    } else {
+        logger->error("** ERROR ** Failed when submitting to LSF - "
+                      "will try again.");
+        usleep(driver->submit_error_sleep);
+    }
+}
+
+/**
+  Waits until fewer than SUBMIT_WORKERS bsub commands are running, and for
+  the SUBMIT_RATE limit, before a bsub command; lsf_driver_end_submit() must
+  be called when the command has completed, see lsf_submit_slot.
+*/
+static void lsf_driver_begin_submit(lsf_driver_type *driver) {
+    usleep(driver->submit_sleep);
+    {
+        std::unique_lock<std::mutex> lock(driver->submit_slots_mutex);
+        driver->submit_slot_free.wait(lock, [driver] {
+            return driver->running_submits < driver->submit_workers;
+        });
+        driver->running_submits++;
+    }
+    driver->submit_rate_limit.acquire();
+}
+
+static void lsf_driver_end_submit(lsf_driver_type *driver) {
+    {
+        std::lock_guard<std::mutex> lock(driver->submit_slots_mutex);
+        driver->running_submits--;
+    }
+    driver->submit_slot_free.notify_one();
+}
+
+/** Holds a submit slot from lsf_driver_begin_submit() while it is in scope,
+ * so that the slot is also given back when the bsub command throws. */
+struct lsf_submit_slot {
+    explicit lsf_submit_slot(lsf_driver_type *driver) : driver(driver) {
+        lsf_driver_begin_submit(driver);
+    }
+    ~lsf_submit_slot() { lsf_driver_end_submit(driver); }
+    lsf_submit_slot(const lsf_submit_slot &) = delete;
+    lsf_submit_slot &operator=(const lsf_submit_slot &) = delete;
+
+    lsf_driver_type *driver;
+};
+
 void *lsf_driver_submit_job(void *_driver, std::string submit_cmd, int num_cpu,
                             fs::path run_path, std::string job_name) {
     auto driver = static_cast<lsf_driver_type *>(_driver);
@@ -781,49 +1392,179 @@ void *lsf_driver_submit_job(void *_driver, std::string submit_cmd, int num_cpu,
         lsf_driver_internal_error();
 
     lsf_job_type *job = lsf_job_alloc(job_name.c_str());
-    usleep(driver->submit_sleep);
-
     auto lsf_stdout = run_path / (job_name + ".LSF-stdout");
     lsf_submit_method_enum submit_method = driver->submit_method;
-    pthread_mutex_lock(&driver->submit_lock);
 
-    logger->debug("LSF DRIVER submitting using method:{} \n", submit_method);
+    {
+        lsf_submit_slot slot{driver};
+        logger->debug("LSF DRIVER submitting using method:{} \n",
+                      submit_method);
+        job->lsf_jobnr = lsf_driver_submit_shell_job(
+            driver, lsf_stdout.c_str(), job_name.c_str(), submit_cmd.c_str(),
+            num_cpu, run_path.c_str());
+    }
 
-    job->lsf_jobnr = lsf_driver_submit_shell_job(
-        driver, lsf_stdout.c_str(), job_name.c_str(), submit_cmd.c_str(),
-        num_cpu, run_path.c_str());
     job->lsf_jobnr_char = saprintf("%ld", job->lsf_jobnr);
+    pthread_mutex_lock(&driver->submit_lock);
     driver->my_jobs.insert(job->lsf_jobnr_char);
-
     pthread_mutex_unlock(&driver->submit_lock);
 
     if (job->lsf_jobnr > 0) {
-        fs::path json_file = run_path / LSF_JSON;
-        std::ofstream stream(json_file);
-        if (stream.fail()) {
-            throw std::runtime_error("Unable to open bjobs output");
-        }
-        stream << fmt::format("{{\"job_id\" : {} }}\n", job->lsf_jobnr);
-        stream.close();
+        lsf_job_write_info(job, run_path);
         return job;
     } else {
         // The submit failed - the queue system shall handle
         // NULL return values.
-        driver->error_count++;
+        lsf_job_free(job);
+        lsf_driver_submit_failed(driver);
+        return NULL;
+    }
+}
 
-        if (driver->error_count >= MAX_ERROR_COUNT) {
-            lsf_job_free(job);
-            throw std::runtime_error(
-                "Maximum number of submit errors exceeded\n");
-        } else {
-            logger->error("** ERROR ** Failed when submitting to LSF - "
-                          "will try again.");
-            usleep(driver->submit_error_sleep);
+/**
+  The job script of a job array runs the job of one realization in each
+  element: the LSB_JOBINDEX, from 1, selects the run_path, and the output of
+  the element goes to the same <job_name>.LSF-stdout file in the run_path as
+  for a job submitted on its own, without the LSF job report. The run_path,
+  command and output file are single-quoted, as they may contain spaces or
+  other characters which are special to the shell.
+*/
+static std::string make_array_job_script(const queue_driver_submit_args *jobs,
+                                         const std::vector<size_t> &elements) {
+    std::string script = "#!/bin/sh\n"
+                         "case \"$LSB_JOBINDEX\" in\n";
+    for (size_t index = 1; index <= elements.size(); index++) {
+        const auto &job = jobs[elements[index - 1]];
+        auto run_path = shell_quote(job.run_path.string());
+        fmt::format_to(std::back_inserter(script),
+                       "{0}) cd {1} && exec {2} {1} >{3} 2>&1 ;;\n", index,
+                       run_path, shell_quote(job.run_cmd),
+                       shell_quote(job.job_name + ".LSF-stdout"));
+    }
+    script += "esac\n";
+    return script;
+}
+
+/**
+  Submits the jobs as one job array with 'bsub -J "<job_name>[1-<n>]"', so
+  that a whole ensemble costs one bsub call instead of one per realization.
+  The job script is given on the stdin of bsub. The jobs must share the
+  command and the number of cpus.
+*/
+static void lsf_driver_submit_job_array(lsf_driver_type *driver,
+                                        const queue_driver_submit_args *jobs,
+                                        const std::vector<size_t> &elements,
+                                        void **job_data) {
+    const auto &first = jobs[elements.front()];
+    auto job_script = make_array_job_script(jobs, elements);
+    auto array_name = fmt::format("{}[1-{}]", first.job_name, elements.size());
+    if (driver->submit_method == LSF_SUBMIT_REMOTE_SHELL)
+        array_name = "'" + array_name + "'";
+
+    long int array_id;
+    {
+        lsf_submit_slot slot{driver};
+        logger->debug("LSF DRIVER submitting a job array of {} jobs\n",
+                      elements.size());
+        array_id = lsf_driver_submit_shell_job(
+            driver, "/dev/null", array_name.c_str(), nullptr, first.num_cpu,
+            nullptr, job_script);
+    }
+
+    pthread_mutex_lock(&driver->submit_lock);
+    if (array_id > 0) {
+        for (size_t index = 1; index <= elements.size(); index++) {
+            const auto &args = jobs[elements[index - 1]];
+            auto job = lsf_job_alloc(args.job_name.c_str());
+            job->lsf_jobnr = array_id;
+            job->lsf_jobnr_char = saprintf("%ld[%zu]", array_id, index);
+            driver->my_jobs.insert(job->lsf_jobnr_char);
+            job_data[elements[index - 1]] = job;
         }
+    }
+    pthread_mutex_unlock(&driver->submit_lock);
 
-        lsf_job_free(job);
-        return NULL;
+    if (array_id <= 0) {
+        lsf_driver_submit_failed(driver);
+        return;
     }
+    for (size_t index = 1; index <= elements.size(); index++)
+        lsf_job_write_info(
+            static_cast<lsf_job_type *>(job_data[elements[index - 1]]),
+            jobs[elements[index - 1]].run_path, index);
+}
+
+/**
+  With the ARRAY_SUBMIT option the jobs are submitted as job arrays, one for
+  each group of jobs with the same command and number of cpus, of at most
+  LSF_MAX_ARRAY_SIZE jobs. Otherwise, and for a group of only one job, the
+  jobs are submitted one by one as with lsf_driver_submit_job().
+
+  With SUBMIT_WORKERS above one, that many threads run the bsub commands
+  concurrently, within the SUBMIT_RATE limit. When a submission throws, e.g.
+  because the maximum number of submit errors has been exceeded, no more
+  groups are submitted and the first exception is rethrown; the job_data of
+  the jobs which were submitted before that is filled in.
+*/
+void lsf_driver_submit_job_batch(void *_driver,
+                                 const queue_driver_submit_args *jobs,
+                                 size_t num_jobs, void **job_data) {
+    auto driver = static_cast<lsf_driver_type *>(_driver);
+    if (driver->submit_method == LSF_SUBMIT_INVALID)
+        lsf_driver_internal_error();
+    std::fill(job_data, job_data + num_jobs, nullptr);
+
+    std::vector<std::vector<size_t>> groups;
+    std::map<std::pair<std::string, int>, size_t> open_groups;
+    for (size_t i = 0; i < num_jobs; i++) {
+        auto key = std::make_pair(jobs[i].run_cmd, jobs[i].num_cpu);
+        auto group = open_groups.find(key);
+        if (!driver->array_submit || group == open_groups.end() ||
+            groups[group->second].size() == LSF_MAX_ARRAY_SIZE) {
+            open_groups[key] = groups.size();
+            groups.push_back({i});
+        } else
+            groups[group->second].push_back(i);
+    }
+
+    std::atomic<size_t> next_group{0};
+    std::atomic<bool> failed{false};
+    std::exception_ptr first_error;
+    std::mutex error_mutex;
+    auto submit_groups = [&] {
+        for (size_t group;
+             !failed && (group = next_group++) < groups.size();) {
+            const auto &elements = groups[group];
+            const auto &job = jobs[elements.front()];
+            try {
+                if (elements.size() > 1)
+                    lsf_driver_submit_job_array(driver, jobs, elements,
+                                                job_data);
+                else
+                    job_data[elements.front()] =
+                        lsf_driver_submit_job(driver, job.run_cmd, job.num_cpu,
+                                              job.run_path, job.job_name);
+            } catch (std::exception &exc) {
+                logger->warning("Submitting {} failed: {}", job.job_name,
+                                exc.what());
+                std::lock_guard guard{error_mutex};
+                if (!first_error)
+                    first_error = std::current_exception();
+                failed = true;
+            }
+        }
+    };
+
+    size_t num_workers =
+        std::min(static_cast<size_t>(driver->submit_workers), groups.size());
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < num_workers; i++)
+        workers.emplace_back(submit_groups);
+    submit_groups();
+    for (auto &worker : workers)
+        worker.join();
+    if (first_error)
+        std::rethrow_exception(first_error);
 }
 
 void lsf_driver_free(lsf_driver_type *driver) {
@@ -904,6 +1645,84 @@ static bool lsf_driver_set_submit_sleep(lsf_driver_type *driver,
     return OK;
 }
 
+static bool lsf_driver_set_bjobs_json(lsf_driver_type *driver,
+                                      const char *arg) {
+    bool bjobs_json;
+    bool OK = sscanf_bool(arg, &bjobs_json);
+    if (OK)
+        driver->bjobs_json = bjobs_json;
+    return OK;
+}
+
+static bool lsf_driver_set_array_submit(lsf_driver_type *driver,
+                                        const char *arg) {
+    bool array_submit;
+    bool OK = sscanf_bool(arg, &array_submit);
+    if (OK)
+        driver->array_submit = array_submit;
+    return OK;
+}
+
+static bool lsf_driver_set_persistent_shell(lsf_driver_type *driver,
+                                            const char *arg) {
+    bool persistent_shell;
+    bool OK = sscanf_bool(arg, &persistent_shell);
+    if (OK) {
+        driver->persistent_shell = persistent_shell;
+        driver->remote_shell.reset();
+    }
+    return OK;
+}
+
+static bool lsf_driver_set_submit_workers(lsf_driver_type *driver,
+                                          const char *arg) {
+    int submit_workers;
+    bool OK = sscanf_int(arg, &submit_workers) && submit_workers > 0;
+    if (OK) {
+        driver->submit_workers = submit_workers;
+        driver->submit_workers_string = arg;
+    }
+    return OK;
+}
+
+static bool lsf_driver_set_submit_rate(lsf_driver_type *driver,
+                                       const char *arg) {
+    double submit_rate;
+    bool OK = sscanf_double(arg, &submit_rate) && submit_rate >= 0;
+    if (OK) {
+        driver->submit_rate = submit_rate;
+        driver->submit_rate_string = arg;
+        driver->submit_rate_limit.configure(driver->submit_rate,
+                                            driver->submit_burst);
+    }
+    return OK;
+}
+
+static bool lsf_driver_set_submit_burst(lsf_driver_type *driver,
+                                        const char *arg) {
+    int submit_burst;
+    bool OK = sscanf_int(arg, &submit_burst) && submit_burst > 0;
+    if (OK) {
+        driver->submit_burst = submit_burst;
+        driver->submit_burst_string = arg;
+        driver->submit_rate_limit.configure(driver->submit_rate,
+                                            driver->submit_burst);
+    }
+    return OK;
+}
+
+static bool lsf_driver_set_command_timeout(lsf_driver_type *driver,
+                                           const char *arg) {
+    double timeout;
+    bool OK = sscanf_double(arg, &timeout) && timeout > 0;
+    if (OK) {
+        driver->command_timeout =
+            std::chrono::milliseconds(std::llround(1000 * timeout));
+        driver->command_timeout_string = arg;
+    }
+    return OK;
+}
+
 void lsf_driver_set_bjobs_refresh_interval_option(lsf_driver_type *driver,
                                                   const char *option_value) {
     int refresh_interval;
@@ -920,15 +1739,17 @@ bool lsf_driver_set_option(void *_driver, const char *option_key,
         if (strcmp(LSF_RESOURCE, option_key) == 0)
             driver->resource_request =
                 restrdup(driver->resource_request, value);
-        else if (strcmp(LSF_SERVER, option_key) == 0)
+        else if (strcmp(LSF_SERVER, option_key) == 0) {
             lsf_driver_set_remote_server(driver, value);
-        else if (strcmp(LSF_QUEUE, option_key) == 0)
+            driver->remote_shell.reset();
+        } else if (strcmp(LSF_QUEUE, option_key) == 0)
             driver->queue_name = restrdup(driver->queue_name, value);
         else if (strcmp(LSF_LOGIN_SHELL, option_key) == 0)
             driver->login_shell = restrdup(driver->login_shell, value);
-        else if (strcmp(LSF_RSH_CMD, option_key) == 0)
+        else if (strcmp(LSF_RSH_CMD, option_key) == 0) {
             driver->rsh_cmd = restrdup(driver->rsh_cmd, value);
-        else if (strcmp(LSF_BSUB_CMD, option_key) == 0)
+            driver->remote_shell.reset();
+        } else if (strcmp(LSF_BSUB_CMD, option_key) == 0)
             driver->bsub_cmd = restrdup(driver->bsub_cmd, value);
         else if (strcmp(LSF_BJOBS_CMD, option_key) == 0)
             driver->bjobs_cmd = restrdup(driver->bjobs_cmd, value);
@@ -947,6 +1768,20 @@ bool lsf_driver_set_option(void *_driver, const char *option_key,
             lsf_driver_set_bjobs_refresh_interval_option(driver, value);
         else if (strcmp(LSF_PROJECT_CODE, option_key) == 0)
             driver->project_code = restrdup(driver->project_code, value);
+        else if (strcmp(LSF_COMMAND_TIMEOUT, option_key) == 0)
+            has_option = lsf_driver_set_command_timeout(driver, value);
+        else if (strcmp(LSF_BJOBS_JSON, option_key) == 0)
+            has_option = lsf_driver_set_bjobs_json(driver, value);
+        else if (strcmp(LSF_ARRAY_SUBMIT, option_key) == 0)
+            has_option = lsf_driver_set_array_submit(driver, value);
+        else if (strcmp(LSF_PERSISTENT_SHELL, option_key) == 0)
+            has_option = lsf_driver_set_persistent_shell(driver, value);
+        else if (strcmp(LSF_SUBMIT_WORKERS, option_key) == 0)
+            has_option = lsf_driver_set_submit_workers(driver, value);
+        else if (strcmp(LSF_SUBMIT_RATE, option_key) == 0)
+            has_option = lsf_driver_set_submit_rate(driver, value);
+        else if (strcmp(LSF_SUBMIT_BURST, option_key) == 0)
+            has_option = lsf_driver_set_submit_burst(driver, value);
         else
             has_option = false;
     }
@@ -976,6 +1811,20 @@ const void *lsf_driver_get_option(const void *_driver, const char *option_key) {
             return driver->bhist_cmd;
         else if (strcmp(LSF_PROJECT_CODE, option_key) == 0)
             return driver->project_code;
+        else if (strcmp(LSF_COMMAND_TIMEOUT, option_key) == 0)
+            return driver->command_timeout_string.c_str();
+        else if (strcmp(LSF_BJOBS_JSON, option_key) == 0)
+            return driver->bjobs_json ? "True" : "False";
+        else if (strcmp(LSF_ARRAY_SUBMIT, option_key) == 0)
+            return driver->array_submit ? "True" : "False";
+        else if (strcmp(LSF_PERSISTENT_SHELL, option_key) == 0)
+            return driver->persistent_shell ? "True" : "False";
+        else if (strcmp(LSF_SUBMIT_WORKERS, option_key) == 0)
+            return driver->submit_workers_string.c_str();
+        else if (strcmp(LSF_SUBMIT_RATE, option_key) == 0)
+            return driver->submit_rate_string.c_str();
+        else if (strcmp(LSF_SUBMIT_BURST, option_key) == 0)
+            return driver->submit_burst_string.c_str();
         else if (strcmp(LSF_BJOBS_TIMEOUT, option_key) == 0) {
             /* This will leak. */
             char *timeout_string =
@@ -1016,7 +1865,13 @@ void *lsf_driver_alloc() {
     lsf_driver_set_option(lsf_driver, LSF_BKILL_CMD, DEFAULT_BKILL_CMD);
     lsf_driver_set_option(lsf_driver, LSF_BHIST_CMD, DEFAULT_BHIST_CMD);
     lsf_driver_set_option(lsf_driver, LSF_SUBMIT_SLEEP, DEFAULT_SUBMIT_SLEEP);
+    lsf_driver_set_option(lsf_driver, LSF_SUBMIT_WORKERS,
+                          DEFAULT_SUBMIT_WORKERS);
+    lsf_driver_set_option(lsf_driver, LSF_SUBMIT_BURST, DEFAULT_SUBMIT_BURST);
+    lsf_driver_set_option(lsf_driver, LSF_SUBMIT_RATE, DEFAULT_SUBMIT_RATE);
     lsf_driver_set_option(lsf_driver, LSF_BJOBS_TIMEOUT, BJOBS_REFRESH_TIME);
+    lsf_driver_set_option(lsf_driver, LSF_COMMAND_TIMEOUT,
+                          LSF_DEFAULT_COMMAND_TIMEOUT);
     return lsf_driver;
 }
 
@@ -3,9 +3,12 @@
 #include <ert/job_queue/queue_driver.hpp>
 #include <ert/job_queue/slurm_driver.hpp>
 #include <ert/job_queue/torque_driver.hpp>
+#include <ert/logging.hpp>
 #include <fmt/format.h>
 #include <stdexcept>
 
+static auto logger = ert::get_logger("ert.job_queue.queue_driver");
+
 /*
    This file implements the datatype queue_driver_type which is an
    abstract datatype for communicating with a subsystem for
@@ -35,9 +38,18 @@ struct queue_driver_struct {
     /** Function pointers - pointing to low level functions in the
      * implementations of e.g. lsf_driver. */
     submit_job_ftype *submit = nullptr;
+    /** Optional; when not set queue_driver_submit_job_batch() will fall back
+     * to calling submit once per job. */
+    submit_job_batch_ftype *submit_batch = nullptr;
     free_job_ftype *free_job = nullptr;
     kill_job_ftype *kill_job = nullptr;
     get_status_ftype *get_status = nullptr;
+    /** Optional; when not set queue_driver_get_status_batch() will fall back
+     * to calling get_status once per job. */
+    get_status_batch_ftype *get_status_batch = nullptr;
+    /** Optional; the Slurm and LSF drivers record the accounting of the
+     * jobs. */
+    get_accounting_ftype *get_accounting = nullptr;
     free_queue_driver_ftype *free_driver = nullptr;
     set_option_ftype *set_option = nullptr;
     get_option_ftype *get_option = nullptr;
@@ -74,17 +86,21 @@ queue_driver_type *queue_driver_alloc(job_driver_type type) {
     switch (type) {
     case LSF_DRIVER:
         driver->submit = lsf_driver_submit_job;
+        driver->submit_batch = lsf_driver_submit_job_batch;
         driver->get_status = lsf_driver_get_job_status;
+        driver->get_status_batch = lsf_driver_get_job_status_batch;
         driver->kill_job = lsf_driver_kill_job;
         driver->free_job = lsf_driver_free_job;
         driver->free_driver = lsf_driver_free_;
         driver->set_option = lsf_driver_set_option;
         driver->get_option = lsf_driver_get_option;
+        driver->get_accounting = lsf_driver_get_job_accounting;
         driver->data = lsf_driver_alloc();
         break;
     case LOCAL_DRIVER:
         driver->submit = local_driver_submit_job;
         driver->get_status = local_driver_get_job_status;
+        driver->get_status_batch = local_driver_get_job_status_batch;
         driver->kill_job = local_driver_kill_job;
         driver->free_job = local_driver_free_job;
         driver->free_driver = local_driver_free_;
@@ -95,6 +111,7 @@ queue_driver_type *queue_driver_alloc(job_driver_type type) {
     case TORQUE_DRIVER:
         driver->submit = torque_driver_submit_job;
         driver->get_status = torque_driver_get_job_status;
+        driver->get_status_batch = torque_driver_get_job_status_batch;
         driver->kill_job = torque_driver_kill_job;
         driver->free_job = torque_driver_free_job;
         driver->free_driver = torque_driver_free_;
@@ -109,7 +126,10 @@ queue_driver_type *queue_driver_alloc(job_driver_type type) {
         driver->kill_job = slurm_driver_kill_job;
         driver->free_job = slurm_driver_free_job;
         driver->submit = slurm_driver_submit_job;
+        driver->submit_batch = slurm_driver_submit_job_batch;
         driver->get_status = slurm_driver_get_job_status;
+        driver->get_status_batch = slurm_driver_get_job_status_batch;
+        driver->get_accounting = slurm_driver_get_job_accounting;
         driver->data = slurm_driver_alloc();
         break;
     default:
@@ -133,6 +153,35 @@ void *queue_driver_submit_job(queue_driver_type *driver, std::string run_cmd,
     return driver->submit(driver->data, run_cmd, num_cpu, run_path, job_name);
 }
 
+/**
+   Submits num_jobs jobs and fills job_data[i] with the driver data of jobs[i],
+   or nullptr if that job could not be submitted. The Slurm and LSF drivers can
+   submit the jobs as job arrays, the other drivers submit them one by one.
+*/
+void queue_driver_submit_job_batch(queue_driver_type *driver,
+                                   const queue_driver_submit_args *jobs,
+                                   size_t num_jobs, void **job_data) {
+    if (num_jobs == 0)
+        return;
+
+    if (driver->submit_batch) {
+        driver->submit_batch(driver->data, jobs, num_jobs, job_data);
+        return;
+    }
+
+    for (size_t i = 0; i < num_jobs; i++) {
+        try {
+            job_data[i] = queue_driver_submit_job(
+                driver, jobs[i].run_cmd, jobs[i].num_cpu, jobs[i].run_path,
+                jobs[i].job_name);
+        } catch (std::exception &err) {
+            logger->warning("Failed to submit job {} due to {}",
+                            jobs[i].job_name, err.what());
+            job_data[i] = nullptr;
+        }
+    }
+}
+
 void queue_driver_free_job(queue_driver_type *driver, void *job_data) {
     driver->free_job(job_data);
 }
@@ -147,6 +196,38 @@ job_status_type queue_driver_get_status(queue_driver_type *driver,
     return status;
 }
 
+/**
+   Fills status[i] with the status of job_data[i] for all num_jobs jobs. The
+   drivers which query an external system (bjobs, squeue, qstat) implement
+   this with one query for all the jobs, instead of one query per job.
+*/
+void queue_driver_get_status_batch(queue_driver_type *driver,
+                                   void *const *job_data, size_t num_jobs,
+                                   job_status_type *status) {
+    if (num_jobs == 0)
+        return;
+
+    if (driver->get_status_batch) {
+        driver->get_status_batch(driver->data, job_data, num_jobs, status);
+        return;
+    }
+
+    for (size_t i = 0; i < num_jobs; i++)
+        status[i] = driver->get_status(driver->data, job_data[i]);
+}
+
+/**
+   Fills accounting with what the queue system has recorded about the job, and
+   returns false if the driver does not record accounting or has nothing for
+   the job yet.
+*/
+bool queue_driver_get_accounting(queue_driver_type *driver, void *job_data,
+                                 queue_driver_job_accounting *accounting) {
+    if (!driver->get_accounting)
+        return false;
+    return driver->get_accounting(driver->data, job_data, accounting);
+}
+
 void queue_driver_free_driver(queue_driver_type *driver) {
     driver->free_driver(driver->data);
 }
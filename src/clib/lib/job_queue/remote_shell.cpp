@@ -0,0 +1,219 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+
+#include <ert/job_queue/remote_shell.hpp>
+#include <ert/logging.hpp>
+
+static auto logger = ert::get_logger("ert.job_queue.remote_shell");
+
+namespace {
+int remaining_ms(std::chrono::steady_clock::time_point deadline) {
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now());
+    return std::max<int>(0, remaining.count());
+}
+
+/** Prints the sentinel after a command: with the exit status of the command
+ * to stdout, and on its own to stderr. */
+std::string end_of_command(const std::string &sentinel) {
+    return fmt::format("printf '\\n%s %d\\n' {0} \"$?\"; "
+                       "printf '\\n%s\\n' {0} >&2\n",
+                       sentinel);
+}
+
+/** Looks for the marker in the part of the output which has not been
+ * searched before; from is updated to where the next search starts. */
+std::optional<size_t> find_marker(const std::string &output,
+                                  const std::string &marker, size_t &from) {
+    auto pos = output.find(marker, from);
+    if (pos != std::string::npos &&
+        output.find('\n', pos + marker.size() - 1) != std::string::npos)
+        return pos;
+    from = output.size() > marker.size() ? output.size() - marker.size() : 0;
+    return std::nullopt;
+}
+} // namespace
+
+namespace ert {
+RemoteShell::RemoteShell(std::vector<std::string> argv)
+    : argv(std::move(argv)),
+      session_id(fmt::format(
+          "{:x}{:x}", getpid(),
+          std::chrono::steady_clock::now().time_since_epoch().count())) {}
+
+RemoteShell::~RemoteShell() { stop(); }
+
+void RemoteShell::stop() { spawn_session_stop(process); }
+
+/** Whether the shell is running; a shell which has exited is cleaned up. */
+bool RemoteShell::running() {
+    if (process.pid <= 0)
+        return false;
+    int status;
+    if (waitpid(process.pid, &status, WNOHANG) == 0)
+        return true;
+
+    logger->info("The remote shell {} has exited with status {}", argv[0],
+                 status);
+    // The process has been waited for, so it must not be killed
+    process.pid = -1;
+    stop();
+    return false;
+}
+
+/**
+  Writes the script to the shell, and reads its stdout and stderr until both
+  have the sentinel at the end of the script. Returns false if the shell has
+  exited or the deadline has passed before that; written tells whether any of
+  the script was given to the shell.
+*/
+bool RemoteShell::exchange(std::string_view script,
+                           const std::string &sentinel, spawn_output &output,
+                           deadline_type deadline, bool &written) {
+    const std::string markers[2] = {"\n" + sentinel + " ",
+                                    "\n" + sentinel + "\n"};
+    std::string *buffers[2] = {&output.out, &output.err};
+    std::optional<size_t> ends[2];
+    size_t search_from[2] = {0, 0};
+    char chunk[4096];
+
+    while (!ends[0] || !ends[1]) {
+        int timeout = -1;
+        if (deadline) {
+            timeout = remaining_ms(*deadline);
+            if (timeout == 0)
+                return false;
+        }
+
+        pollfd fds[3] = {{process.out_fd, POLLIN, 0},
+                         {process.err_fd, POLLIN, 0},
+                         {script.empty() ? -1 : process.in_fd, POLLOUT, 0}};
+        if (poll(fds, 3, timeout) < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+
+        if (fds[2].fd >= 0 && fds[2].revents != 0) {
+#ifdef MSG_NOSIGNAL
+            ssize_t count = send(process.in_fd, script.data(), script.size(),
+                                 MSG_NOSIGNAL);
+#else
+            ssize_t count = write(process.in_fd, script.data(), script.size());
+#endif
+            if (count > 0) {
+                written = true;
+                script.remove_prefix(count);
+            } else if (count < 0 && errno != EINTR && errno != EAGAIN)
+                return false;
+        }
+
+        for (int i = 0; i < 2; i++) {
+            if (fds[i].revents == 0)
+                continue;
+            ssize_t count = read(fds[i].fd, chunk, sizeof chunk);
+            if (count > 0)
+                buffers[i]->append(chunk, count);
+            else if (count == 0 || errno != EINTR)
+                return false; // The shell has exited
+            if (!ends[i])
+                ends[i] = find_marker(*buffers[i], markers[i], search_from[i]);
+        }
+    }
+
+    int exit_code =
+        std::atoi(output.out.c_str() + *ends[0] + markers[0].size());
+    output.out.resize(*ends[0]);
+    output.err.resize(*ends[1]);
+    output.status = W_EXITCODE(exit_code, 0);
+    return true;
+}
+
+/**
+  Starts the shell, and waits until it runs commands; anything the shell
+  prints before that, e.g. from the login scripts on the remote host, is
+  discarded.
+*/
+bool RemoteShell::start(deadline_type deadline) {
+    std::vector<char *> args;
+    for (auto &arg : argv)
+        args.push_back(arg.data());
+    args.push_back(nullptr);
+    try {
+        process = spawn_session(args.data());
+    } catch (std::runtime_error &err) {
+        logger->warning("Unable to start the remote shell: {}", err.what());
+        return false;
+    }
+
+    auto sentinel = fmt::format("ert-remote-shell-{}-ready", session_id);
+    spawn_output output;
+    bool written = false;
+    if (!exchange(end_of_command(sentinel), sentinel, output, deadline,
+                  written)) {
+        logger->warning("The remote shell {} did not start: {}", argv[0],
+                        output.err);
+        stop();
+        return false;
+    }
+    return true;
+}
+
+spawn_output
+RemoteShell::run(const std::string &command,
+                 std::optional<std::string_view> input,
+                 std::optional<std::chrono::milliseconds> timeout) {
+    std::lock_guard<std::mutex> lock(mutex);
+    deadline_type deadline;
+    if (timeout)
+        deadline = std::chrono::steady_clock::now() + *timeout;
+
+    auto sentinel =
+        fmt::format("ert-remote-shell-{}-{}", session_id, ++num_commands);
+    // The command is grouped so that the redirection of its stdin applies to
+    // all of it; the input is given as a here-document ended by the sentinel
+    std::string script = "{ " + command + "\n}";
+    if (input) {
+        script += " <<'" + sentinel + "'\n";
+        script += *input;
+        if (!input->empty() && input->back() != '\n')
+            script += '\n';
+        script += sentinel + "\n";
+    } else
+        script += " </dev/null\n";
+    script += end_of_command(sentinel);
+
+    spawn_output output;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        output = {};
+        if (!running() && !start(deadline))
+            break;
+
+        bool written = false;
+        if (exchange(script, sentinel, output, deadline, written))
+            return output;
+
+        stop();
+        if (deadline && remaining_ms(*deadline) == 0) {
+            output.timed_out = true;
+            break;
+        }
+        // The command may have been run before the shell exited
+        if (written)
+            break;
+    }
+    output.status = -1;
+    return output;
+}
+} // namespace ert
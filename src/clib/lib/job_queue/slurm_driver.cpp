@@ -1,14 +1,28 @@
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <condition_variable>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
 #include <fcntl.h>
-#include <pthread.h>
+#include <iomanip>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <poll.h>
 #include <pwd.h>
 #include <set>
+#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <unistd.h>
 #include <unordered_map>
@@ -16,6 +30,7 @@
 
 #include <ert/abort.hpp>
 #include <ert/job_queue/slurm_driver.hpp>
+#include <ert/job_queue/slurm_status_table.hpp>
 #include <ert/job_queue/spawn.hpp>
 #include <ert/job_queue/string_utils.hpp>
 #include <ert/logging.hpp>
@@ -27,22 +42,134 @@ namespace fs = std::filesystem;
 
 static auto logger = ert::get_logger("ert.job_queue.slurm_driver");
 
+/** The step names of the realizations packed into one allocation are
+ * "pack0", "pack1", ..., see make_pack_submit_script(). */
+#define SLURM_PACK_STEP_PREFIX "pack"
+
+/**
+  The realizations which are packed into one allocation; see
+  slurm_driver_submit_job_pack().
+*/
+struct SlurmPack {
+    SlurmPack(int job_id, size_t size) : job_id(job_id), size(size) {}
+
+    int job_id;
+    size_t size;
+    /** The realizations which have been killed before their step started. */
+    std::atomic<size_t> num_killed{0};
+};
+
+namespace ert {
+uint64_t slurm_job_key(std::string_view string_id) {
+    auto parse = [](std::string_view digits, uint64_t &value) {
+        const char *end = digits.data() + digits.size();
+        auto [ptr, error] = std::from_chars(digits.data(), end, value);
+        return error == std::errc() && ptr == end && !digits.empty();
+    };
+    constexpr std::string_view pack_sep = "." SLURM_PACK_STEP_PREFIX;
+
+    auto sep = string_id.find_first_of("_.");
+    uint64_t job_id;
+    if (!parse(string_id.substr(0, sep), job_id) || job_id > UINT32_MAX)
+        return 0;
+    if (sep == std::string_view::npos)
+        return job_id << 32;
+
+    uint64_t kind = 1;
+    auto index = string_id.substr(sep + 1);
+    if (string_id[sep] == '.') {
+        if (string_id.substr(sep, pack_sep.size()) != pack_sep)
+            return 0;
+        kind = 2;
+        index = string_id.substr(sep + pack_sep.size());
+    }
+    uint64_t index_value;
+    if (!parse(index, index_value) || index_value >= (1 << 30))
+        return 0;
+    return job_id << 32 | kind << 30 | index_value;
+}
+} // namespace ert
+
+/**
+  A job, one task of a job array, or one realization packed into an
+  allocation. The string_id is the id used by the Slurm commands, i.e. "1234"
+  for a job and "1234_5" for task 5 of array job 1234. For a packed
+  realization it is "1234.pack5", after the name of its step in allocation
+  1234, as the id Slurm gives the step is not known until it has started.
+*/
 struct SlurmJob {
-    SlurmJob(int job_id) : job_id(job_id), string_id(std::to_string(job_id)) {}
+    SlurmJob(int job_id)
+        : job_id(job_id), string_id(std::to_string(job_id)),
+          key(ert::slurm_job_key(string_id)) {}
+    SlurmJob(int job_id, int task_id)
+        : job_id(job_id), string_id(fmt::format("{}_{}", job_id, task_id)),
+          key(ert::slurm_job_key(string_id)) {}
+    SlurmJob(std::shared_ptr<SlurmPack> pack, int index)
+        : job_id(pack->job_id),
+          string_id(fmt::format("{}." SLURM_PACK_STEP_PREFIX "{}",
+                                pack->job_id, index)),
+          key(ert::slurm_job_key(string_id)), pack(std::move(pack)) {}
 
     int job_id;
     std::string string_id;
+    /** The key of the job in the status table, see slurm_job_key(). */
+    uint64_t key;
+    std::shared_ptr<SlurmPack> pack;
 };
 
+/** The allocation of a packed realization, "1234" for "1234.pack5". */
+static std::string_view slurm_pack_parent(std::string_view job_id) {
+    return job_id.substr(0, job_id.find('.'));
+}
+
+/**
+  The status of the jobs is kept in a map which is only used by the writers,
+  i.e. the submitting threads and the status poller, under the mutex. After
+  each refresh the poller publishes an immutable copy of it as the snapshot,
+  a SlurmStatusTable, which the readers look up without taking the mutex; a
+  reader is never held up by a refresh, and keeps the snapshot it has loaded
+  alive until it is done with it.
+*/
 class SlurmStatus {
 public:
-    void update(int job_id, job_status_type status) {
-        pthread_rwlock_wrlock(&this->lock);
+    using snapshot_type = ert::SlurmStatusTable;
+
+    void update(const std::string &job_id, job_status_type status) {
+        std::lock_guard guard{this->mutex};
         this->jobs[job_id] = status;
-        pthread_rwlock_unlock(&this->lock);
     }
 
-    void new_job(int job_id) { this->update(job_id, JOB_QUEUE_PENDING); }
+    void new_job(const std::string &job_id) {
+        this->update(job_id, JOB_QUEUE_PENDING);
+    }
+
+    /**
+      The ids to give squeue for the jobs which are PENDING or RUNNING, in
+      order; an array job is given once for all its tasks, and an allocation
+      once for all the realizations packed into it.
+    */
+    std::vector<std::string> active_squeue_ids() const {
+        std::set<std::string> job_ids;
+        {
+            std::lock_guard guard{this->mutex};
+            for (const auto &[job_id, job_status] : this->jobs)
+                if (job_status == JOB_QUEUE_PENDING ||
+                    job_status == JOB_QUEUE_RUNNING)
+                    job_ids.insert(
+                        job_id.substr(0, job_id.find_first_of("_.")));
+        }
+        return {job_ids.begin(), job_ids.end()};
+    }
+
+    /** Whether there are jobs which are PENDING or RUNNING. */
+    bool has_active_jobs() const {
+        std::lock_guard guard{this->mutex};
+        return std::any_of(this->jobs.begin(), this->jobs.end(),
+                           [](const auto &job_pair) {
+                               return job_pair.second == JOB_QUEUE_PENDING ||
+                                      job_pair.second == JOB_QUEUE_RUNNING;
+                           });
+    }
 
     /**
     This function is used when the status of the jobs is updated with squeue. The
@@ -60,48 +187,173 @@ class SlurmStatus {
      3. The return value is a list of jobs which were previously registered as
         active, but are not fallen out. Calling scope must update their status
         with calls to scontrol.
+
+    squeue only lists the allocation of packed realizations. They are PENDING
+    while it is, and otherwise returned with the active jobs, as the status of
+    their steps is only known to sacct.
     */
-    std::vector<int>
-    squeue_update(const std::unordered_map<int, job_status_type> &squeue_jobs) {
-        std::vector<int> active_jobs;
+    std::vector<std::string> squeue_update(
+        const std::unordered_map<std::string_view, job_status_type>
+            &squeue_jobs) {
+        std::vector<std::string> active_jobs;
 
-        pthread_rwlock_wrlock(&this->lock);
+        std::lock_guard guard{this->mutex};
         for (auto &job_pair : this->jobs) {
-            auto job_id = job_pair.first;
+            const auto &job_id = job_pair.first;
             auto job_status = job_pair.second;
 
+            if (job_id.find('.') != std::string::npos) {
+                auto parent = squeue_jobs.find(slurm_pack_parent(job_id));
+                if (parent != squeue_jobs.end() &&
+                    parent->second == JOB_QUEUE_PENDING)
+                    job_pair.second = JOB_QUEUE_PENDING;
+                else if (job_status == JOB_QUEUE_PENDING ||
+                         job_status == JOB_QUEUE_RUNNING)
+                    active_jobs.push_back(job_id);
+                continue;
+            }
+
             auto squeue_pair = squeue_jobs.find(job_id);
             if (squeue_pair == squeue_jobs.end()) {
                 if ((job_status == JOB_QUEUE_PENDING ||
                      job_status == JOB_QUEUE_RUNNING))
                     active_jobs.push_back(job_id);
             } else
-                this->jobs[job_id] = squeue_pair->second;
+                job_pair.second = squeue_pair->second;
         }
-        pthread_rwlock_unlock(&this->lock);
 
         return active_jobs;
     }
 
-    job_status_type get(int job_id) const {
+    /** Makes the current status of all the jobs visible to get(). */
+    void publish() {
+        std::shared_ptr<snapshot_type> next;
+        {
+            std::lock_guard guard{this->mutex};
+            next = std::make_shared<snapshot_type>(this->jobs.size());
+            for (const auto &[job_id, job_status] : this->jobs)
+                if (auto key = ert::slurm_job_key(job_id); key != 0)
+                    next->insert(key, job_status);
+        }
+        std::shared_ptr<const snapshot_type> published = std::move(next);
+        std::atomic_store(&this->snapshot, std::move(published));
+    }
 
-        pthread_rwlock_rdlock(&this->lock);
-        auto status = this->jobs.at(job_id);
-        pthread_rwlock_unlock(&this->lock);
+    /** The latest snapshot, for looking up several jobs at once. */
+    std::shared_ptr<const snapshot_type> get_snapshot() const {
+        return std::atomic_load(&this->snapshot);
+    }
 
-        return status;
+    /**
+      The status of the job in the snapshot; a job which has been submitted
+      after the snapshot was published is PENDING.
+    */
+    static job_status_type get(const snapshot_type &snapshot, uint64_t key) {
+        return snapshot.find(key).value_or(JOB_QUEUE_PENDING);
+    }
+
+    /** The status of the job in the latest snapshot. */
+    job_status_type get(uint64_t key) const {
+        return get(*this->get_snapshot(), key);
+    }
+
+    /** Records the ids Slurm has given the steps of packed realizations. */
+    void update_step_ids(
+        const std::unordered_map<std::string, std::string> &step_ids) {
+        std::lock_guard guard{this->mutex};
+        for (const auto &[job_id, step_id] : step_ids)
+            this->step_ids[job_id] = step_id;
+    }
+
+    /** The Slurm id of the step of a packed realization, once it is known. */
+    std::optional<std::string> step_id(const std::string &job_id) const {
+        std::lock_guard guard{this->mutex};
+        if (auto found = this->step_ids.find(job_id);
+            found != this->step_ids.end())
+            return found->second;
+        return std::nullopt;
+    }
+
+    /** Records the accounting of the jobs, in addition to what is there. */
+    void update_accounting(
+        const std::unordered_map<std::string, queue_driver_job_accounting>
+            &accounting) {
+        std::lock_guard guard{this->mutex};
+        for (const auto &[job_id, job_accounting] : accounting) {
+            auto &recorded = this->accounting[job_id];
+            auto max_rss = recorded.max_rss;
+            recorded = job_accounting;
+            // The MaxRSS of a job is not known to scontrol, and sacct only
+            // lists it for the steps which have completed
+            if (max_rss && (!recorded.max_rss || *recorded.max_rss < *max_rss))
+                recorded.max_rss = max_rss;
+        }
+    }
+
+    std::optional<queue_driver_job_accounting>
+    get_accounting(const std::string &job_id) const {
+        std::lock_guard guard{this->mutex};
+        if (auto found = this->accounting.find(job_id);
+            found != this->accounting.end())
+            return found->second;
+        return std::nullopt;
+    }
+
+    /** The packed realization is to be cancelled once its step has started. */
+    void request_kill(const std::string &job_id) {
+        std::lock_guard guard{this->mutex};
+        this->pending_kills.insert(job_id);
+    }
+
+    /** The steps of the pending kills which have started by now. */
+    std::vector<std::string> take_started_kills() {
+        std::vector<std::string> started;
+        std::lock_guard guard{this->mutex};
+        for (auto job_id = this->pending_kills.begin();
+             job_id != this->pending_kills.end();) {
+            auto found = this->step_ids.find(*job_id);
+            if (found == this->step_ids.end()) {
+                ++job_id;
+                continue;
+            }
+            started.push_back(found->second);
+            job_id = this->pending_kills.erase(job_id);
+        }
+        return started;
     }
 
 private:
-    std::unordered_map<int, job_status_type> jobs;
-    mutable pthread_rwlock_t lock = PTHREAD_RWLOCK_INITIALIZER;
+    std::unordered_map<std::string, job_status_type> jobs;
+    /** Packed realization -> the id of its step, e.g. "1234.7". */
+    std::unordered_map<std::string, std::string> step_ids;
+    std::set<std::string> pending_kills;
+    std::unordered_map<std::string, queue_driver_job_accounting> accounting;
+    mutable std::mutex mutex;
+    std::shared_ptr<const snapshot_type> snapshot =
+        std::make_shared<const snapshot_type>(0);
 };
 
 #define DEFAULT_SBATCH_CMD "sbatch"
 #define DEFAULT_SCANCEL_CMD "scancel"
 #define DEFAULT_SQUEUE_CMD "squeue"
 #define DEFAULT_SCONTROL_CMD "scontrol"
+#define DEFAULT_SACCT_CMD "sacct"
 #define DEFAULT_SQUEUE_TIMEOUT 10
+/** The longest --jobs argument given to squeue, well within the limits for
+ * the length of one command line argument. */
+#define SLURM_MAX_JOBS_ARG 32768
+/** The status is not refreshed more often than this, in seconds. */
+#define SLURM_MIN_POLL_INTERVAL 1.0
+/** A listing from 'squeue --iterate' is complete when no more output has
+ * arrived for this long, in milliseconds. */
+#define SLURM_STREAM_QUIET_MS 200
+#define DEFAULT_COMMAND_TIMEOUT "60"
+/** The default MaxArraySize of Slurm is 1001, i.e. task ids up to 1000. */
+#define SLURM_MAX_ARRAY_SIZE 1000
+#define DEFAULT_PACK_SIZE 1
+/** The columns asked from sacct, see slurm_driver_parse_sacct(). */
+#define SLURM_SACCT_FORMAT                                                     \
+    "JobID,State,ExitCode,JobName,Elapsed,MaxRSS,NodeList,Submit,Start"
 
 #define SLURM_PENDING_STATUS "PENDING"
 #define SLURM_COMPLETED_STATUS "COMPLETED"
@@ -110,12 +362,18 @@ class SlurmStatus {
 #define SLURM_CANCELED_STATUS "CANCELLED"
 #define SLURM_COMPLETING_STATUS "COMPLETING"
 #define SLURM_CONFIGURING_STATUS "CONFIGURING"
+#define SLURM_TIMEOUT_STATUS "TIMEOUT"
+#define SLURM_NODE_FAIL_STATUS "NODE_FAIL"
+#define SLURM_OUT_OF_MEMORY_STATUS "OUT_OF_MEMORY"
+#define SLURM_BOOT_FAIL_STATUS "BOOT_FAIL"
+#define SLURM_DEADLINE_STATUS "DEADLINE"
 
 struct slurm_driver_struct {
     std::string sbatch_cmd;
     std::string scancel_cmd;
     std::string squeue_cmd;
     std::string scontrol_cmd;
+    std::string sacct_cmd;
     std::string partition;
     std::string memory;
     std::string memory_per_cpu;
@@ -123,44 +381,80 @@ struct slurm_driver_struct {
     std::pair<std::string, int> max_runtime;
     std::pair<std::set<std::string>, std::string> exclude;
     std::pair<std::set<std::string>, std::string> include;
+    /** The #SBATCH lines of the options above, which are the same for every
+     * job; see slurm_driver_render_sbatch_header(). */
+    std::string sbatch_header;
     mutable SlurmStatus status;
-    mutable std::time_t status_timestamp;
+    /** The interval in seconds between the refreshes of the status. */
     double status_timeout = DEFAULT_SQUEUE_TIMEOUT;
     std::string status_timeout_string;
+    /** The deadline for each sbatch/squeue/scontrol/scancel command. */
+    std::chrono::milliseconds command_timeout{};
+    std::string command_timeout_string;
+    /** Submit the jobs of a batch as job arrays. */
+    bool array_submit = false;
+    /** The number of realizations packed into one allocation. */
+    int pack_size = DEFAULT_PACK_SIZE;
+    std::string pack_size_string = std::to_string(DEFAULT_PACK_SIZE);
+
+    /** Refreshes the status in the background, see slurm_driver_poll(). */
+    std::thread poller;
+    std::mutex poller_mutex;
+    std::condition_variable poller_cv;
+    std::atomic<bool> poller_stop{false};
+    /** Wakes the poller from reading the squeue stream when it should stop. */
+    int poller_wakeup[2] = {-1, -1};
+    /** Read the status from a long running 'squeue --iterate' command. */
+    bool squeue_iterate = false;
+    /** Set once the poller has published its first snapshot. */
+    std::atomic<bool> poller_ready{false};
 };
 
-static std::string load_stdout(const char *cmd, int argc, const char **argv) {
-    std::string fname = std::string(cmd) + "-stdout";
-    constexpr int OUTPUT_FILE_SIZE = 32;
-    char stdout[OUTPUT_FILE_SIZE];
-    strncpy(stdout, "/tmp/slurm-stdout-XXXXXX", OUTPUT_FILE_SIZE);
-    int fd = mkstemp(stdout);
-    close(fd);
-
-    auto exit_status = spawn_blocking(cmd, argc, argv, stdout, nullptr);
-    std::string file_content;
-    std::getline(std::ifstream(stdout), file_content, '\0');
+namespace {
+/** A Slurm command did not complete within the command timeout. */
+struct slurm_timeout_error : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+} // namespace
 
-    if (exit_status != 0)
+/**
+  Runs the command, with the input on its stdin, and returns its stdout;
+  throws slurm_timeout_error if the command does not complete within the
+  timeout, and std::runtime_error if its output could not be read.
+*/
+static std::string
+run_command(const char *cmd, const std::vector<std::string> &args,
+            std::optional<std::chrono::milliseconds> timeout,
+            std::optional<std::string_view> input = std::nullopt) {
+    std::vector<const char *> argv;
+    for (const auto &arg : args)
+        argv.push_back(arg.c_str());
+
+    auto output =
+        spawn_capture(cmd, argv.size(), argv.data(), timeout, input);
+    if (output.timed_out && timeout)
+        throw slurm_timeout_error(fmt::format(
+            "{} did not complete within {} ms", cmd, timeout->count()));
+    if (output.read_failed)
+        throw std::runtime_error(
+            fmt::format("Unable to read the output of {}", cmd));
+    if (output.status != 0)
         logger->warning(
-            "Calling shell command %s ... returned non zero exitcode: %d", cmd,
-            exit_status);
+            "Calling shell command {} ... returned non zero exitcode: {} {}",
+            cmd, output.status, output.err);
 
-    unlink(stdout);
-    return file_content;
+    return output.out;
 }
 
-static std::string load_stdout(const char *cmd,
+/**
+  Runs a query, e.g. squeue, and returns its stdout; throws
+  slurm_timeout_error if the command does not complete within the command
+  timeout of the driver.
+*/
+static std::string load_stdout(const slurm_driver_type *driver,
+                               const char *cmd,
                                const std::vector<std::string> &args) {
-    const char **argv =
-        static_cast<const char **>(calloc(args.size(), sizeof *argv));
-    CHECK_ALLOC(argv);
-    for (std::size_t i = 0; i < args.size(); i++)
-        argv[i] = args[i].c_str();
-
-    auto file_content = load_stdout(cmd, args.size(), argv);
-    free(argv);
-    return file_content;
+    return run_command(cmd, args, driver->command_timeout);
 }
 
 static std::vector<std::string> split_string(const std::string &string_value) {
@@ -193,14 +487,34 @@ void *slurm_driver_alloc() {
     driver->scancel_cmd = DEFAULT_SCANCEL_CMD;
     driver->squeue_cmd = DEFAULT_SQUEUE_CMD;
     driver->scontrol_cmd = DEFAULT_SCONTROL_CMD;
+    driver->sacct_cmd = DEFAULT_SACCT_CMD;
     driver->status_timeout_string = std::to_string(driver->status_timeout);
+    slurm_driver_set_option(driver, SLURM_COMMAND_TIMEOUT_OPTION,
+                            DEFAULT_COMMAND_TIMEOUT);
 
     auto pwname = getpwuid(geteuid());
     driver->username = pwname->pw_name;
     return driver;
 }
 
-void slurm_driver_free(slurm_driver_type *driver) { delete driver; }
+void slurm_driver_free(slurm_driver_type *driver) {
+    {
+        std::lock_guard guard{driver->poller_mutex};
+        driver->poller_stop = true;
+    }
+    driver->poller_cv.notify_all();
+    if (driver->poller_wakeup[1] >= 0) {
+        char stop = 1;
+        if (write(driver->poller_wakeup[1], &stop, 1) < 0)
+            logger->warning("Unable to wake the poller: {}", strerror(errno));
+    }
+    if (driver->poller.joinable())
+        driver->poller.join();
+    for (int fd : driver->poller_wakeup)
+        if (fd >= 0)
+            close(fd);
+    delete driver;
+}
 
 void slurm_driver_free_(void *_driver) {
     auto driver = static_cast<slurm_driver_type *>(_driver);
@@ -222,15 +536,30 @@ const void *slurm_driver_get_option(const void *_driver,
     if (strcmp(option_key, SLURM_SQUEUE_OPTION) == 0)
         return driver->squeue_cmd.c_str();
 
+    if (strcmp(option_key, SLURM_SACCT_OPTION) == 0)
+        return driver->sacct_cmd.c_str();
+
     if (strcmp(option_key, SLURM_PARTITION_OPTION) == 0)
         return driver->partition.c_str();
 
     if (strcmp(option_key, SLURM_SQUEUE_TIMEOUT_OPTION) == 0)
         return driver->status_timeout_string.c_str();
 
+    if (strcmp(option_key, SLURM_COMMAND_TIMEOUT_OPTION) == 0)
+        return driver->command_timeout_string.c_str();
+
     if (strcmp(option_key, SLURM_MEMORY_OPTION) == 0)
         return driver->memory.c_str();
 
+    if (strcmp(option_key, SLURM_ARRAY_SUBMIT_OPTION) == 0)
+        return driver->array_submit ? "True" : "False";
+
+    if (strcmp(option_key, SLURM_SQUEUE_ITERATE_OPTION) == 0)
+        return driver->squeue_iterate ? "True" : "False";
+
+    if (strcmp(option_key, SLURM_PACK_SIZE_OPTION) == 0)
+        return driver->pack_size_string.c_str();
+
     if (strcmp(option_key, SLURM_MEMORY_PER_CPU_OPTION) == 0)
         return driver->memory_per_cpu.c_str();
 
@@ -246,6 +575,34 @@ const void *slurm_driver_get_option(const void *_driver,
     return nullptr;
 }
 
+/*
+  Slurm allows very fine control over how a parallel job should be distributed
+  over available nodes and CPUs, the current approach is an absolutely simplest
+  way - where we just say how many processors we will need in total with the
+  --ntasks=$num_cpu setting.
+
+  The other #SBATCH options only change with the options of the driver, so
+  they are rendered once in slurm_driver_set_option() and copied into every
+  submit script.
+*/
+static void slurm_driver_render_sbatch_header(slurm_driver_type *driver) {
+    std::string header;
+    if (driver->memory.size() > 0)
+        header += fmt::format("#SBATCH --mem={}\n", driver->memory);
+    if (driver->memory_per_cpu.size() > 0)
+        header +=
+            fmt::format("#SBATCH --mem-per-cpu={}\n", driver->memory_per_cpu);
+    if (driver->max_runtime.second != 0)
+        header +=
+            fmt::format("#SBATCH --time={}\n", driver->max_runtime.second);
+    if (!driver->exclude.first.empty())
+        header += fmt::format("#SBATCH --exclude={}\n", driver->exclude.second);
+    if (!driver->include.first.empty())
+        header +=
+            fmt::format("#SBATCH --nodelist={}\n", driver->include.second);
+    driver->sbatch_header = std::move(header);
+}
+
 bool slurm_driver_set_option(void *_driver, const char *option_key,
                              const void *value) {
     auto driver = static_cast<slurm_driver_type *>(_driver);
@@ -260,13 +617,34 @@ bool slurm_driver_set_option(void *_driver, const char *option_key,
         driver->squeue_cmd = string_value;
     else if (strcmp(option_key, SLURM_SCONTROL_OPTION) == 0)
         driver->scontrol_cmd = string_value;
+    else if (strcmp(option_key, SLURM_SACCT_OPTION) == 0)
+        driver->sacct_cmd = string_value;
     else if (strcmp(option_key, SLURM_PARTITION_OPTION) == 0)
         driver->partition = string_value;
     else if (strcmp(option_key, SLURM_MEMORY_OPTION) == 0)
         driver->memory = string_value;
     else if (strcmp(option_key, SLURM_MEMORY_PER_CPU_OPTION) == 0)
         driver->memory_per_cpu = string_value;
-    else if (strcmp(option_key, SLURM_EXCLUDE_HOST_OPTION) == 0) {
+    else if (strcmp(option_key, SLURM_ARRAY_SUBMIT_OPTION) == 0) {
+        bool array_submit;
+        if (sscanf_bool(string_value.c_str(), &array_submit))
+            driver->array_submit = array_submit;
+        else
+            option_set = false;
+    } else if (strcmp(option_key, SLURM_SQUEUE_ITERATE_OPTION) == 0) {
+        bool squeue_iterate;
+        if (sscanf_bool(string_value.c_str(), &squeue_iterate))
+            driver->squeue_iterate = squeue_iterate;
+        else
+            option_set = false;
+    } else if (strcmp(option_key, SLURM_PACK_SIZE_OPTION) == 0) {
+        int pack_size;
+        if (sscanf_int(string_value.c_str(), &pack_size) && pack_size > 0) {
+            driver->pack_size = pack_size;
+            driver->pack_size_string = string_value;
+        } else
+            option_set = false;
+    } else if (strcmp(option_key, SLURM_EXCLUDE_HOST_OPTION) == 0) {
         auto host_list = split_string(string_value);
         driver->exclude.first.insert(host_list.begin(), host_list.end());
         driver->exclude.second = join_string(driver->exclude.first);
@@ -281,6 +659,14 @@ bool slurm_driver_set_option(void *_driver, const char *option_key,
             driver->status_timeout_string = string_value;
         } else
             option_set = false;
+    } else if (strcmp(option_key, SLURM_COMMAND_TIMEOUT_OPTION) == 0) {
+        double timeout;
+        if (sscanf_double(string_value.c_str(), &timeout) && timeout > 0) {
+            driver->command_timeout =
+                std::chrono::milliseconds(std::llround(1000 * timeout));
+            driver->command_timeout_string = string_value;
+        } else
+            option_set = false;
     } else if (strcmp(option_key, SLURM_MAX_RUNTIME_OPTION) == 0) {
         // The --time option in slurm which is used to set the maximum runtime of a
         // job is in minutes, whereas the libres option system uses seconds. This
@@ -294,66 +680,123 @@ bool slurm_driver_set_option(void *_driver, const char *option_key,
     } else
         option_set = false;
 
+    if (option_set)
+        slurm_driver_render_sbatch_header(driver);
     return option_set;
 }
 
-/*
-  Slurm allows very fine control over how a parallel job should be distributed
-  over available nodes and CPUs, the current approach is an absolutely simplest
-  way - where we just say how many processors we will need in total with the
-  --ntasks=$num_cpu setting.
+static std::string make_submit_script(const slurm_driver_type *driver,
+                                      const std::string &cmd,
+                                      const std::string &job_name, int num_cpu,
+                                      const fs::path &run_path) {
+    auto script = fmt::format("#!/bin/sh\n"
+                              "#SBATCH --output={0}.stdout\n"
+                              "#SBATCH --error={0}.stderr\n"
+                              "#SBATCH --ntasks={1}\n",
+                              job_name, num_cpu);
+    script += driver->sbatch_header;
+    script += fmt::format("{} {}\n", cmd, run_path.string()); // Without srun?
+    return script;
+}
+
+/**
+  The submit script of a job array runs the job of one realization in each
+  task: the SLURM_ARRAY_TASK_ID selects the run_path, and the output of the
+  task goes to the same <job_name>.stdout/stderr files in the run_path as for
+  a job submitted on its own. The run_path, command and output files are
+  single-quoted, as they may contain characters which are special to the
+  shell.
 */
-static fs::path make_submit_script(const slurm_driver_type *driver,
-                                   std::string cmd, std::string job_name,
-                                   int num_cpu, fs::path run_path) {
-    constexpr int OUTPUT_FILE_SIZE = 32;
-    char submit[OUTPUT_FILE_SIZE];
-    strncpy(submit, "/tmp/slurm-submit-XXXXXX", OUTPUT_FILE_SIZE);
-    int fd = mkstemp(submit);
-    if (fd == -1) {
-        throw std::runtime_error(
-            "Unable to create tempory file /tmp/slurm-submit");
+static std::string
+make_array_submit_script(const slurm_driver_type *driver,
+                         const queue_driver_submit_args *jobs,
+                         const std::vector<size_t> &tasks) {
+    auto script = fmt::format("#!/bin/sh\n"
+                              "#SBATCH --output=/dev/null\n"
+                              "#SBATCH --error=/dev/null\n"
+                              "#SBATCH --ntasks={}\n",
+                              jobs[tasks.front()].num_cpu);
+    script += driver->sbatch_header;
+
+    script += "case \"$SLURM_ARRAY_TASK_ID\" in\n";
+    for (size_t task_id = 0; task_id < tasks.size(); task_id++) {
+        const auto &job = jobs[tasks[task_id]];
+        fmt::format_to(std::back_inserter(script),
+                       "{0}) cd {1} && exec {2} {1} >{3} 2>{4} ;;\n", task_id,
+                       shell_quote(job.run_path.string()),
+                       shell_quote(job.run_cmd),
+                       shell_quote(job.job_name + ".stdout"),
+                       shell_quote(job.job_name + ".stderr"));
     }
+    script += "esac\n";
+    return script;
+}
 
-    FILE *submit_stream = fdopen(fd, "w");
-    if (!submit_stream) {
-        throw std::runtime_error("Unable to open submit script file: " +
-                                 std::string(strerror(errno)));
+/**
+  The submit script of a pack asks for the cpus of all its realizations, and
+  starts each of them as a step of its own with 'srun --exclusive', so that
+  the steps run side by side on their share of the allocation. The step name
+  identifies the realization in sacct, and the output of the step goes to the
+  <job_name>.stdout/stderr files in its run_path. As in the array submit
+  script, the run_path, command and output files are single-quoted.
+*/
+static std::string
+make_pack_submit_script(const slurm_driver_type *driver,
+                        const queue_driver_submit_args *jobs,
+                        const std::vector<size_t> &tasks) {
+    int num_cpu = jobs[tasks.front()].num_cpu;
+    auto script = fmt::format("#!/bin/sh\n"
+                              "#SBATCH --output=/dev/null\n"
+                              "#SBATCH --error=/dev/null\n"
+                              "#SBATCH --ntasks={}\n",
+                              num_cpu * tasks.size());
+    script += driver->sbatch_header;
+
+    for (size_t index = 0; index < tasks.size(); index++) {
+        const auto &job = jobs[tasks[index]];
+        fmt::format_to(std::back_inserter(script),
+                       "(cd {0} && exec srun --exclusive --ntasks={1} "
+                       "--job-name=" SLURM_PACK_STEP_PREFIX "{2} {3} {0} "
+                       ">{4} 2>{5}) &\n",
+                       shell_quote(job.run_path.string()), num_cpu, index,
+                       shell_quote(job.run_cmd),
+                       shell_quote(job.job_name + ".stdout"),
+                       shell_quote(job.job_name + ".stderr"));
     }
-    fprintf(submit_stream, "#!/bin/sh\n");
-    fprintf(submit_stream, "#SBATCH --ntasks=%d\n", num_cpu);
-    fprintf(submit_stream, "#SBATCH --output=%s.stdout\n", job_name.c_str());
-    fprintf(submit_stream, "#SBATCH --error=%s.stderr\n", job_name.c_str());
-    if (driver->memory.size() > 0)
-        fprintf(submit_stream, "#SBATCH --mem=%s\n", driver->memory.c_str());
-    if (driver->memory_per_cpu.size() > 0)
-        fprintf(submit_stream, "#SBATCH --mem-per-cpu=%s\n",
-                driver->memory_per_cpu.c_str());
-    if (driver->max_runtime.second != 0)
-        fprintf(submit_stream, "#SBATCH --time=%d\n",
-                driver->max_runtime.second);
-    if (!driver->exclude.first.empty())
-        fprintf(submit_stream, "#SBATCH --exclude=%s\n",
-                driver->exclude.second.c_str());
-    if (!driver->include.first.empty())
-        fprintf(submit_stream, "#SBATCH --nodelist=%s\n",
-                driver->include.second.c_str());
+    script += "wait\n";
+    return script;
+}
 
-    fprintf(submit_stream, "%s", cmd.c_str()); // Without srun?
-    fprintf(submit_stream, " %s", run_path.c_str());
-    fprintf(submit_stream, "\n");
+/**
+  Runs sbatch with the submit script on its stdin, so that no temporary file
+  is written and removed for each submission, and returns the job id.
+*/
+static std::optional<int>
+run_sbatch(const slurm_driver_type *driver, const std::string &submit_script,
+           const std::string &job_name, std::vector<std::string> sbatch_argv) {
+    sbatch_argv.push_back("--parsable");
+    if (!driver->partition.empty())
+        sbatch_argv.push_back("--partition=" + driver->partition);
 
-    fclose(submit_stream);
-    chmod(submit, S_IRWXU + S_IRGRP + S_IROTH);
+    std::string file_content;
+    try {
+        file_content = run_command(driver->sbatch_cmd.c_str(), sbatch_argv,
+                                   std::nullopt, submit_script);
+    } catch (std::runtime_error &exc) {
+        logger->warning("Submitting {} failed: {}", job_name, exc.what());
+    }
 
-    fs::path submit_script = submit;
-    return submit_script;
+    try {
+        return std::stoi(file_content);
+    } catch (std::invalid_argument &exc) {
+        return std::nullopt;
+    }
 }
 
 /**
  The slurm jobs are submitted by first creating a submit script, which is a
  small shell which contains the command to run along with possible slurm
- options, and then this script is submitted with the 'sbatch' command.
+ options, and then this script is piped to the 'sbatch' command.
 */
 void *slurm_driver_submit_job(void *_driver, std::string cmd, int num_cpu,
                               fs::path run_path, std::string job_name) {
@@ -361,42 +804,141 @@ void *slurm_driver_submit_job(void *_driver, std::string cmd, int num_cpu,
 
     auto submit_script =
         make_submit_script(driver, cmd, job_name, num_cpu, run_path);
-    std::vector<std::string> sbatch_argv = {
-        "-D" + run_path.string(), "--job-name=" + job_name, "--parsable"};
-    if (!driver->partition.empty())
-        sbatch_argv.push_back("--partition=" + driver->partition);
-    sbatch_argv.push_back(submit_script);
+    auto job_id =
+        run_sbatch(driver, submit_script, job_name,
+                   {"-D" + run_path.string(), "--job-name=" + job_name});
+    if (!job_id)
+        return nullptr;
 
-    auto file_content = load_stdout(driver->sbatch_cmd.c_str(), sbatch_argv);
-    fs::remove(submit_script);
+    auto job = new SlurmJob(*job_id);
+    driver->status.new_job(job->string_id);
+    return job;
+}
 
-    int job_id;
-    try {
-        job_id = std::stoi(file_content);
-    } catch (std::invalid_argument &exc) {
-        return nullptr;
+/**
+  Submits the jobs as one job array with 'sbatch --array=0-<n-1>', so that a
+  whole ensemble costs one sbatch call instead of one per realization. The
+  jobs must share the command and the number of cpus.
+*/
+static void slurm_driver_submit_job_array(slurm_driver_type *driver,
+                                          const queue_driver_submit_args *jobs,
+                                          const std::vector<size_t> &tasks,
+                                          void **job_data) {
+    const auto &first = jobs[tasks.front()];
+    auto submit_script = make_array_submit_script(driver, jobs, tasks);
+    auto job_id = run_sbatch(
+        driver, submit_script, first.job_name,
+        {"-D" + first.run_path.string(), "--job-name=" + first.job_name,
+         fmt::format("--array=0-{}", tasks.size() - 1)});
+    if (!job_id)
+        return;
+
+    for (size_t task_id = 0; task_id < tasks.size(); task_id++) {
+        auto job = new SlurmJob(*job_id, static_cast<int>(task_id));
+        driver->status.new_job(job->string_id);
+        job_data[tasks[task_id]] = job;
     }
+}
 
-    driver->status.new_job(job_id);
-    return new SlurmJob(job_id);
+/**
+  Submits the jobs as one allocation for all of them, in which each job runs
+  as a step; this saves the scheduling of each job on its own when the jobs
+  are short. The jobs must share the number of cpus.
+*/
+static void slurm_driver_submit_job_pack(slurm_driver_type *driver,
+                                         const queue_driver_submit_args *jobs,
+                                         const std::vector<size_t> &tasks,
+                                         void **job_data) {
+    const auto &first = jobs[tasks.front()];
+    auto submit_script = make_pack_submit_script(driver, jobs, tasks);
+    auto job_id =
+        run_sbatch(driver, submit_script, first.job_name,
+                   {"-D" + first.run_path.string(),
+                    "--job-name=" + first.job_name});
+    if (!job_id)
+        return;
+
+    auto pack = std::make_shared<SlurmPack>(*job_id, tasks.size());
+    for (size_t index = 0; index < tasks.size(); index++) {
+        auto job = new SlurmJob(pack, static_cast<int>(index));
+        driver->status.new_job(job->string_id);
+        job_data[tasks[index]] = job;
+    }
 }
 
-const std::map<const std::string, const job_status_type>
+/**
+  With a PACK_SIZE above one the jobs are packed into allocations of at most
+  PACK_SIZE jobs with the same number of cpus. Otherwise, with the
+  ARRAY_SUBMIT option, the jobs are submitted as job arrays, one for each
+  group of jobs with the same command and number of cpus, of at most
+  SLURM_MAX_ARRAY_SIZE jobs. Otherwise, and for a group of only one job, the
+  jobs are submitted one by one as with slurm_driver_submit_job().
+*/
+void slurm_driver_submit_job_batch(void *_driver,
+                                   const queue_driver_submit_args *jobs,
+                                   size_t num_jobs, void **job_data) {
+    auto driver = static_cast<slurm_driver_type *>(_driver);
+    std::fill(job_data, job_data + num_jobs, nullptr);
+
+    bool pack = driver->pack_size > 1;
+    size_t max_group_size =
+        pack ? static_cast<size_t>(driver->pack_size) : SLURM_MAX_ARRAY_SIZE;
+    std::vector<std::vector<size_t>> groups;
+    std::map<std::pair<std::string, int>, size_t> open_groups;
+    for (size_t i = 0; i < num_jobs; i++) {
+        // The steps of a pack can run different commands
+        auto key = std::make_pair(pack ? std::string() : jobs[i].run_cmd,
+                                  jobs[i].num_cpu);
+        auto group = open_groups.find(key);
+        if (!(pack || driver->array_submit) || group == open_groups.end() ||
+            groups[group->second].size() == max_group_size) {
+            open_groups[key] = groups.size();
+            groups.push_back({i});
+        } else
+            groups[group->second].push_back(i);
+    }
+
+    for (const auto &tasks : groups) {
+        if (tasks.size() > 1) {
+            if (pack)
+                slurm_driver_submit_job_pack(driver, jobs, tasks, job_data);
+            else
+                slurm_driver_submit_job_array(driver, jobs, tasks, job_data);
+            continue;
+        }
+
+        const auto &job = jobs[tasks.front()];
+        try {
+            job_data[tasks.front()] = slurm_driver_submit_job(
+                driver, job.run_cmd, job.num_cpu, job.run_path, job.job_name);
+        } catch (std::runtime_error &exc) {
+            logger->warning("Submitting {} failed: {}", job.job_name,
+                            exc.what());
+        }
+    }
+}
+
+const std::map<std::string, job_status_type, std::less<>>
     slurm_translate_status_map = {{SLURM_PENDING_STATUS, JOB_QUEUE_PENDING},
                                   {SLURM_COMPLETED_STATUS, JOB_QUEUE_DONE},
                                   {SLURM_COMPLETING_STATUS, JOB_QUEUE_RUNNING},
                                   {SLURM_RUNNING_STATUS, JOB_QUEUE_RUNNING},
                                   {SLURM_CONFIGURING_STATUS, JOB_QUEUE_RUNNING},
                                   {SLURM_FAILED_STATUS, JOB_QUEUE_EXIT},
+                                  {SLURM_TIMEOUT_STATUS, JOB_QUEUE_EXIT},
+                                  {SLURM_NODE_FAIL_STATUS, JOB_QUEUE_EXIT},
+                                  {SLURM_OUT_OF_MEMORY_STATUS, JOB_QUEUE_EXIT},
+                                  {SLURM_BOOT_FAIL_STATUS, JOB_QUEUE_EXIT},
+                                  {SLURM_DEADLINE_STATUS, JOB_QUEUE_EXIT},
                                   {SLURM_CANCELED_STATUS, JOB_QUEUE_IS_KILLED}};
 
 static job_status_type
-slurm_driver_translate_status(const std::string &status_string,
-                              const std::string &string_id) {
+slurm_driver_translate_status(std::string_view status_string,
+                              std::string_view string_id) {
 
     if (auto search = slurm_translate_status_map.find(status_string);
         search != slurm_translate_status_map.end())
-        return slurm_translate_status_map.at(status_string);
+        return search->second;
 
     logger->warning("The job status: '{}' for job:{} is not recognized",
                     status_string, string_id);
@@ -404,10 +946,109 @@ slurm_driver_translate_status(const std::string &status_string,
     return JOB_QUEUE_UNKNOWN;
 }
 
+/** A number with nothing else in it; sscanf_double() accepts "". */
+static std::optional<double> slurm_parse_number(std::string_view number) {
+    double value;
+    if (number.empty() || !sscanf_double(std::string(number).c_str(), &value))
+        return std::nullopt;
+    return value;
+}
+
+/** A Slurm duration, "[DD-[HH:]]MM:SS", in seconds. */
+static std::optional<double> slurm_parse_duration(std::string_view duration) {
+    double days = 0;
+    if (auto dash = duration.find('-'); dash != std::string_view::npos) {
+        auto value = slurm_parse_number(duration.substr(0, dash));
+        if (!value)
+            return std::nullopt;
+        days = *value;
+        duration.remove_prefix(dash + 1);
+    }
+
+    double seconds = 0;
+    for (int num_fields = 1;; num_fields++) {
+        auto sep = duration.find(':');
+        auto value = slurm_parse_number(duration.substr(0, sep));
+        if (!value || num_fields > 3)
+            return std::nullopt;
+        seconds = 60 * seconds + *value;
+        if (sep == std::string_view::npos)
+            break;
+        duration.remove_prefix(sep + 1);
+    }
+    return 24 * 3600 * days + seconds;
+}
+
+/** A Slurm memory size, e.g. "2048K" or "1.5G", in bytes. A size without a
+ * unit is in kilobytes, as Slurm counts memory. */
+static std::optional<int64_t> slurm_parse_memory(std::string_view memory) {
+    if (memory.empty())
+        return std::nullopt;
+    double scale = 1024;
+    switch (memory.back()) {
+    case 'K':
+        memory.remove_suffix(1);
+        break;
+    case 'M':
+        scale = 1024.0 * 1024;
+        memory.remove_suffix(1);
+        break;
+    case 'G':
+        scale = 1024.0 * 1024 * 1024;
+        memory.remove_suffix(1);
+        break;
+    case 'T':
+        scale = 1024.0 * 1024 * 1024 * 1024;
+        memory.remove_suffix(1);
+        break;
+    }
+    auto value = slurm_parse_number(memory);
+    if (!value)
+        return std::nullopt;
+    return static_cast<int64_t>(std::llround(*value * scale));
+}
+
+/** The seconds from a Slurm timestamp, "2020-06-08T19:43:54", to another;
+ * nothing if either is e.g. "Unknown". */
+static std::optional<double> slurm_time_between(std::string_view from,
+                                                std::string_view to) {
+    auto parse = [](std::string_view timestamp) -> std::optional<time_t> {
+        std::tm time{};
+        std::istringstream stream{std::string(timestamp)};
+        stream >> std::get_time(&time, "%Y-%m-%dT%H:%M:%S");
+        if (stream.fail())
+            return std::nullopt;
+        return timegm(&time);
+    };
+    auto from_time = parse(from);
+    auto to_time = parse(to);
+    if (!from_time || !to_time)
+        return std::nullopt;
+    return std::difftime(*to_time, *from_time);
+}
+
+/** Sets the exit code and signal from a Slurm "<exit code>:<signal>". */
+static void slurm_parse_exit_code(std::string_view exit_code,
+                                  queue_driver_job_accounting &accounting) {
+    int code;
+    int signal;
+    if (sscanf(std::string(exit_code).c_str(), "%d:%d", &code, &signal) == 2) {
+        accounting.exit_code = code;
+        accounting.exit_signal = signal;
+    }
+}
+
+/** The node list of a job, without the "None assigned" of a pending job. */
+static std::string slurm_node_list(std::string_view node_list) {
+    if (node_list.empty() || node_list.rfind("None", 0) == 0)
+        return {};
+    return std::string(node_list);
+}
+
 static std::unordered_map<std::string, std::string>
 load_scontrol(const slurm_driver_type *driver, const std::string &string_id) {
-    auto file_content =
-        load_stdout(driver->scontrol_cmd.c_str(), {"show", "jobid", string_id});
+    auto file_content = load_stdout(driver, driver->scontrol_cmd.c_str(),
+                                    {"show", "jobid", string_id});
 
     std::unordered_map<std::string, std::string> options;
     std::size_t offset = 0;
@@ -430,11 +1071,26 @@ load_scontrol(const slurm_driver_type *driver, const std::string &string_id) {
     return options;
 }
 
+/**
+  The status of the job from scontrol. The accounting which scontrol shows,
+  i.e. all but the MaxRSS, is recorded for the job when record_accounting is
+  set.
+*/
 static job_status_type
 slurm_driver_get_job_status_scontrol(const slurm_driver_type *driver,
-                                     const std::string &string_id) {
+                                     const std::string &string_id,
+                                     bool record_accounting = false) {
     auto values = load_scontrol(driver, string_id);
     const auto status_iter = values.find("JobState");
+    if (record_accounting && status_iter != values.end()) {
+        queue_driver_job_accounting accounting;
+        slurm_parse_exit_code(values["ExitCode"], accounting);
+        accounting.elapsed = slurm_parse_duration(values["RunTime"]);
+        accounting.node_list = slurm_node_list(values["NodeList"]);
+        accounting.pending_time =
+            slurm_time_between(values["SubmitTime"], values["StartTime"]);
+        driver->status.update_accounting({{string_id, accounting}});
+    }
 
     // When a job has finished running it quite quickly - the order of minutes
     // - falls out of the slurm database, and the scontrol command will not
@@ -461,36 +1117,521 @@ slurm_driver_get_job_status_scontrol(const slurm_driver_type *driver,
     return status;
 }
 
-static void slurm_driver_update_status_cache(const slurm_driver_type *driver) {
-    driver->status_timestamp = time(nullptr);
-    const std::string space = " \n";
-    auto squeue_output =
-        load_stdout(driver->squeue_cmd.c_str(),
-                    {"-h", "--user=" + driver->username, "--format=%i %T"});
-    auto offset = squeue_output.find_first_not_of(space);
-
-    std::unordered_map<int, job_status_type> squeue_jobs;
-    while (offset != std::string::npos) {
-        auto id_end = squeue_output.find_first_of(space, offset);
-        auto job_string = squeue_output.substr(offset, id_end - offset);
-        int job_id = std::stoi(squeue_output.substr(offset, id_end - offset));
+/** Whether the id is that of a job, "1234", or of an array task, "1234_5". */
+static bool slurm_driver_is_job_id(const std::string &id) {
+    auto task_sep = id.find('_');
+    auto job_part = id.substr(0, task_sep);
+    if (job_part.empty() ||
+        job_part.find_first_not_of("0123456789") != std::string::npos)
+        return false;
+    if (task_sep == std::string::npos)
+        return true;
+
+    auto task_part = id.substr(task_sep + 1);
+    return !task_part.empty() &&
+           task_part.find_first_not_of("0123456789") == std::string::npos;
+}
+
+/** Whether the id is that of a numbered step of a job, e.g. "1234.7". */
+static bool slurm_driver_is_step_id(const std::string &id) {
+    auto step_sep = id.find('.');
+    if (step_sep == std::string::npos ||
+        !slurm_driver_is_job_id(id.substr(0, step_sep)))
+        return false;
 
-        auto status_start = squeue_output.find_first_not_of(space, id_end + 1);
-        auto status_end = squeue_output.find_first_of(space, status_start);
-        auto status = slurm_driver_translate_status(
-            squeue_output.substr(status_start, status_end - status_start),
-            std::to_string(job_id));
+    auto step_part = id.substr(step_sep + 1);
+    return !step_part.empty() &&
+           step_part.find_first_not_of("0123456789") == std::string::npos;
+}
 
-        squeue_jobs.insert({job_id, status});
-        offset = squeue_output.find_first_not_of(space, status_end);
+namespace {
+/** The columns of SLURM_SACCT_FORMAT. */
+enum slurm_sacct_field {
+    SACCT_JOB_ID,
+    SACCT_STATE,
+    SACCT_EXIT_CODE,
+    SACCT_JOB_NAME,
+    SACCT_ELAPSED,
+    SACCT_MAX_RSS,
+    SACCT_NODE_LIST,
+    SACCT_SUBMIT,
+    SACCT_START,
+    SACCT_NUM_FIELDS
+};
+} // namespace
+
+/**
+  Parses the output of "sacct --format=" SLURM_SACCT_FORMAT " --parsable2",
+  i.e. lines like "1234|CANCELLED by 1000|0:15|name|...", where the columns
+  after the ExitCode can be left out. Only the lines of the jobs and array
+  tasks themselves are used, not those of their steps, e.g. "1234.batch", or
+  of pending array ranges, e.g. "1234_[5-9]".
+
+  The exception are the steps of packed realizations, "1234.7|...|pack5",
+  which are returned as "1234.pack5"; the ids of these steps, "1234.7", are
+  added to step_ids when it is given.
+
+  When accounting is given it is filled with the accounting of the jobs. The
+  MaxRSS of a job is only listed for its steps, so that of the job is the
+  largest of its steps.
+*/
+std::unordered_map<std::string, job_status_type> slurm_driver_parse_sacct(
+    const std::string &sacct_output,
+    std::unordered_map<std::string, std::string> *step_ids,
+    std::unordered_map<std::string, queue_driver_job_accounting> *accounting) {
+    std::unordered_map<std::string, job_status_type> sacct_jobs;
+    std::size_t offset = 0;
+    while (offset < sacct_output.size()) {
+        auto line_end = sacct_output.find('\n', offset);
+        if (line_end == std::string::npos)
+            line_end = sacct_output.size();
+        auto line = sacct_output.substr(offset, line_end - offset);
+        offset = line_end + 1;
+
+        std::vector<std::string> fields;
+        for (std::size_t field_start = 0; field_start <= line.size();) {
+            auto field_end = std::min(line.find('|', field_start), line.size());
+            fields.push_back(
+                line.substr(field_start, field_end - field_start));
+            field_start = field_end + 1;
+        }
+        if (fields.size() <= SACCT_EXIT_CODE)
+            continue;
+        fields.resize(SACCT_NUM_FIELDS);
+
+        auto job_string = fields[SACCT_JOB_ID];
+        const auto &job_name = fields[SACCT_JOB_NAME];
+        auto max_rss = slurm_parse_memory(fields[SACCT_MAX_RSS]);
+        if (slurm_driver_is_step_id(job_string) &&
+            job_name.rfind(SLURM_PACK_STEP_PREFIX, 0) == 0) {
+            auto step_id = job_string;
+            job_string = job_string.substr(0, job_string.find('.') + 1);
+            job_string += job_name;
+            if (step_ids != nullptr)
+                (*step_ids)[job_string] = step_id;
+        } else if (!slurm_driver_is_job_id(job_string)) {
+            // The header, or a job step
+            auto step_sep = job_string.find('.');
+            if (accounting != nullptr && max_rss &&
+                step_sep != std::string::npos) {
+                auto &job_max_rss =
+                    (*accounting)[job_string.substr(0, step_sep)].max_rss;
+                job_max_rss = std::max(job_max_rss.value_or(0), *max_rss);
+            }
+            continue;
+        }
+
+        // The state can be followed by e.g. " by <uid>"
+        auto state = fields[SACCT_STATE];
+        state = state.substr(0, state.find(' '));
+        const auto &exit_code = fields[SACCT_EXIT_CODE];
+
+        auto status = slurm_driver_translate_status(state, job_string);
+        if (status == JOB_QUEUE_UNKNOWN)
+            continue;
+        if (status == JOB_QUEUE_DONE && exit_code != "0:0" &&
+            !exit_code.empty())
+            status = JOB_QUEUE_EXIT;
+        sacct_jobs[job_string] = status;
+
+        if (accounting != nullptr) {
+            auto &job = (*accounting)[job_string];
+            slurm_parse_exit_code(exit_code, job);
+            job.elapsed = slurm_parse_duration(fields[SACCT_ELAPSED]);
+            if (max_rss)
+                job.max_rss = std::max(job.max_rss.value_or(0), *max_rss);
+            job.node_list = slurm_node_list(fields[SACCT_NODE_LIST]);
+            job.pending_time =
+                slurm_time_between(fields[SACCT_SUBMIT], fields[SACCT_START]);
+        }
     }
+    return sacct_jobs;
+}
 
+/**
+  Gets the status of all the jobs from one sacct call, and records their
+  accounting; jobs which sacct does not know, e.g. when accounting is not
+  enabled, are left out.
+*/
+static std::unordered_map<std::string, job_status_type>
+slurm_driver_get_job_status_sacct(const slurm_driver_type *driver,
+                                  const std::vector<std::string> &job_ids) {
+    // The steps of packed realizations are listed with their allocation
+    std::set<std::string_view> sacct_ids;
+    for (const auto &job_id : job_ids)
+        sacct_ids.insert(slurm_pack_parent(job_id));
+    auto id_list = join_string(sacct_ids);
+
+    std::string sacct_output;
+    try {
+        sacct_output =
+            load_stdout(driver, driver->sacct_cmd.c_str(),
+                        {"-j", id_list, "--format=" SLURM_SACCT_FORMAT,
+                         "--parsable2", "--noheader"});
+    } catch (slurm_timeout_error &) {
+        throw;
+    } catch (std::runtime_error &exc) {
+        logger->debug("sacct failed, using scontrol: {}", exc.what());
+        return {};
+    }
+    std::unordered_map<std::string, std::string> step_ids;
+    std::unordered_map<std::string, queue_driver_job_accounting> accounting;
+    auto sacct_jobs =
+        slurm_driver_parse_sacct(sacct_output, &step_ids, &accounting);
+    driver->status.update_step_ids(step_ids);
+    driver->status.update_accounting(accounting);
+    return sacct_jobs;
+}
+
+/**
+  Parses the "%i %T" lines of squeue into a job id -> status mapping. The ids
+  in the mapping refer to the squeue_output, which must outlive it.
+*/
+static std::unordered_map<std::string_view, job_status_type>
+slurm_driver_parse_squeue(std::string_view squeue_output) {
+    constexpr std::string_view space = " \t\r";
+    std::unordered_map<std::string_view, job_status_type> squeue_jobs;
+    while (!squeue_output.empty()) {
+        auto line_end = squeue_output.find('\n');
+        auto line = squeue_output.substr(0, line_end);
+        squeue_output.remove_prefix(line_end == std::string_view::npos
+                                        ? squeue_output.size()
+                                        : line_end + 1);
+
+        auto id_start = line.find_first_not_of(space);
+        if (id_start == std::string_view::npos)
+            continue;
+        line.remove_prefix(id_start);
+        auto id_end = line.find_first_of(space);
+        if (id_end == std::string_view::npos)
+            continue;
+        auto job_id = line.substr(0, id_end);
+
+        auto state = line.substr(id_end);
+        state.remove_prefix(std::min(state.find_first_not_of(space),
+                                     state.size()));
+        state = state.substr(0, state.find_first_of(space));
+
+        squeue_jobs.emplace(job_id,
+                            slurm_driver_translate_status(state, job_id));
+    }
+    return squeue_jobs;
+}
+
+/**
+  The status of a packed realization whose step sacct does not list: the
+  step has not started while its allocation is running, and never will once
+  the allocation has ended. Without accounting the allocation is looked up
+  with scontrol. Returns nothing when the previous status should be kept.
+*/
+static std::optional<job_status_type> slurm_driver_get_unlisted_step_status(
+    const slurm_driver_type *driver,
+    const std::unordered_map<std::string, job_status_type> &sacct_jobs,
+    const std::string &job_id) {
+    auto parent_id = std::string(slurm_pack_parent(job_id));
+    auto parent = sacct_jobs.find(parent_id);
+    auto status = parent != sacct_jobs.end()
+                      ? parent->second
+                      : slurm_driver_get_job_status_scontrol(driver, parent_id);
+    switch (status) {
+    case JOB_QUEUE_PENDING:
+    case JOB_QUEUE_RUNNING:
+        return std::nullopt;
+    case JOB_QUEUE_IS_KILLED:
+        return JOB_QUEUE_IS_KILLED;
+    case JOB_QUEUE_DONE:
+        // Without accounting a step which has completed is not listed either
+        return parent != sacct_jobs.end() ? JOB_QUEUE_EXIT : JOB_QUEUE_DONE;
+    default:
+        return JOB_QUEUE_EXIT;
+    }
+}
+
+static void slurm_driver_scancel(const slurm_driver_type *driver,
+                                 const std::string &job_id) {
+    const char *argv[] = {job_id.c_str()};
+    spawn_blocking(driver->scancel_cmd.c_str(), 1, argv, nullptr, nullptr,
+                   driver->command_timeout);
+}
+
+/**
+  Updates the status cache from the jobs listed by squeue, and the jobs which
+  have fallen out of squeue from one sacct call. Jobs which sacct does not
+  know are looked up with scontrol one by one. If a command does not complete
+  in time, the jobs it should have updated are left with their previous
+  status. Packed realizations which were killed before their step started
+  are cancelled once sacct lists the step.
+*/
+static void slurm_driver_apply_squeue(
+    const slurm_driver_type *driver,
+    const std::unordered_map<std::string_view, job_status_type> &squeue_jobs) {
     const auto &active_jobs = driver->status.squeue_update(squeue_jobs);
+    if (active_jobs.empty())
+        return;
+
+    std::unordered_map<std::string, job_status_type> sacct_jobs;
+    try {
+        sacct_jobs = slurm_driver_get_job_status_sacct(driver, active_jobs);
+    } catch (slurm_timeout_error &exc) {
+        logger->warning("Keeping the previous job status: {}", exc.what());
+        return;
+    }
+
     for (const auto &job_id : active_jobs) {
-        auto status = slurm_driver_get_job_status_scontrol(
-            driver, std::to_string(job_id));
-        driver->status.update(job_id, status);
+        if (auto found = sacct_jobs.find(job_id); found != sacct_jobs.end()) {
+            driver->status.update(job_id, found->second);
+            continue;
+        }
+
+        try {
+            if (job_id.find('.') != std::string::npos) {
+                auto status = slurm_driver_get_unlisted_step_status(
+                    driver, sacct_jobs, job_id);
+                if (status)
+                    driver->status.update(job_id, *status);
+                continue;
+            }
+            auto status =
+                slurm_driver_get_job_status_scontrol(driver, job_id, true);
+            driver->status.update(job_id, status);
+        } catch (slurm_timeout_error &exc) {
+            logger->warning("Keeping the previous status of job {}: {}",
+                            job_id, exc.what());
+        }
+    }
+
+    for (const auto &step_id : driver->status.take_started_kills())
+        slurm_driver_scancel(driver, step_id);
+}
+
+/**
+  The squeue arguments which list the status of the active jobs of the user.
+  Jobs in other states are resolved with sacct when they leave the listing.
+*/
+static std::vector<std::string>
+slurm_driver_squeue_args(const slurm_driver_type *driver) {
+    // With -r the tasks of a job array are listed one by one, also while
+    // they are pending
+    return {"-h",
+            "-r",
+            "--user=" + driver->username,
+            "--states=" SLURM_PENDING_STATUS "," SLURM_RUNNING_STATUS
+            "," SLURM_COMPLETING_STATUS "," SLURM_CONFIGURING_STATUS,
+            "--format=%i %T"};
+}
+
+/**
+  Refreshes the status cache with squeue, which is only asked for the jobs of
+  this driver which are still active. The ids are given in --jobs arguments
+  of at most SLURM_MAX_JOBS_ARG characters, one squeue call for each.
+*/
+static void slurm_driver_update_status_cache(const slurm_driver_type *driver) {
+    std::vector<std::string> id_lists;
+    for (const auto &job_id : driver->status.active_squeue_ids()) {
+        if (id_lists.empty() ||
+            id_lists.back().size() + job_id.size() >= SLURM_MAX_JOBS_ARG)
+            id_lists.emplace_back();
+        else
+            id_lists.back() += ",";
+        id_lists.back() += job_id;
+    }
+
+    std::string squeue_output;
+    try {
+        for (const auto &id_list : id_lists) {
+            auto args = slurm_driver_squeue_args(driver);
+            args.push_back("--jobs=" + id_list);
+            squeue_output +=
+                load_stdout(driver, driver->squeue_cmd.c_str(), args);
+            squeue_output += "\n";
+        }
+    } catch (slurm_timeout_error &exc) {
+        logger->warning("Keeping the previous job status: {}", exc.what());
+        return;
+    }
+    slurm_driver_apply_squeue(driver, slurm_driver_parse_squeue(squeue_output));
+}
+
+/** The interval between the refreshes of the status. */
+static std::chrono::duration<double>
+slurm_driver_poll_interval(const slurm_driver_type *driver) {
+    return std::chrono::duration<double>(
+        std::max(driver->status_timeout, SLURM_MIN_POLL_INTERVAL));
+}
+
+/** Must be called with the poller_mutex held. */
+static void slurm_driver_set_poller_ready(slurm_driver_type *driver) {
+    if (!driver->poller_ready) {
+        driver->poller_ready = true;
+        driver->poller_cv.notify_all();
+    }
+}
+
+/**
+  Waits for the poll interval, or until the driver is freed. Returns false if
+  the poller should stop.
+*/
+static bool slurm_driver_poller_sleep(slurm_driver_type *driver) {
+    std::unique_lock lock{driver->poller_mutex};
+    slurm_driver_set_poller_ready(driver);
+    return !driver->poller_cv.wait_for(
+        lock, slurm_driver_poll_interval(driver),
+        [driver] { return driver->poller_stop.load(); });
+}
+
+/**
+  The poller thread refreshes the status of the jobs every SQUEUE_TIMEOUT
+  seconds, but at most once a second, and publishes it as a new snapshot. The
+  refresh is skipped while there are no PENDING or RUNNING jobs. Exactly one
+  squeue call is made per interval however many threads ask for the status.
+*/
+static void slurm_driver_poll(slurm_driver_type *driver) {
+    do {
+        if (driver->status.has_active_jobs()) {
+            slurm_driver_update_status_cache(driver);
+            driver->status.publish();
+        }
+    } while (slurm_driver_poller_sleep(driver));
+}
+
+/**
+  With SQUEUE_ITERATE the poller keeps one 'squeue --iterate=<interval>'
+  command running, and reads the status of the jobs from its output as it
+  arrives. squeue ends each listing with an empty line; a listing is also
+  taken as complete when no more output has arrived for a short while. When
+  the squeue command exits, it is restarted after one poll interval.
+*/
+static void slurm_driver_poll_stream(slurm_driver_type *driver) {
+    auto args = slurm_driver_squeue_args(driver);
+    args.push_back(fmt::format(
+        "--iterate={}",
+        std::llround(slurm_driver_poll_interval(driver).count())));
+    std::vector<char *> argv{const_cast<char *>(driver->squeue_cmd.c_str())};
+    for (auto &arg : args)
+        argv.push_back(arg.data());
+    argv.push_back(nullptr);
+
+    spawn_stream_process stream;
+    std::string line;
+    std::string listing;
+    auto publish_listing = [driver, &listing] {
+        slurm_driver_apply_squeue(driver, slurm_driver_parse_squeue(listing));
+        driver->status.publish();
+        listing.clear();
+        std::lock_guard guard{driver->poller_mutex};
+        slurm_driver_set_poller_ready(driver);
+    };
+
+    char chunk[4096];
+    while (!driver->poller_stop) {
+        if (stream.pid < 0) {
+            if (!driver->status.has_active_jobs()) {
+                if (!slurm_driver_poller_sleep(driver))
+                    break;
+                continue;
+            }
+            try {
+                stream = spawn_stream(argv.data());
+            } catch (std::runtime_error &exc) {
+                logger->warning("Unable to start {}: {}", driver->squeue_cmd,
+                                exc.what());
+                if (!slurm_driver_poller_sleep(driver))
+                    break;
+                continue;
+            }
+        }
+
+        // Until the first listing has been read, waiting for it is bounded
+        // by the command timeout
+        int timeout = -1;
+        if (!listing.empty() || !line.empty())
+            timeout = SLURM_STREAM_QUIET_MS;
+        else if (!driver->poller_ready)
+            timeout = static_cast<int>(driver->command_timeout.count());
+
+        pollfd fds[2] = {{stream.out_fd, POLLIN, 0},
+                         {driver->poller_wakeup[0], POLLIN, 0}};
+        int num_ready = poll(fds, 2, timeout);
+        if (num_ready < 0) {
+            if (errno == EINTR)
+                continue;
+            logger->warning("Unable to read from {}: {}", driver->squeue_cmd,
+                            strerror(errno));
+            num_ready = 0;
+            fds[0].revents = POLLERR;
+        }
+        if (fds[1].revents != 0)
+            break;
+
+        if (num_ready == 0) {
+            if (listing.empty() && line.empty()) {
+                logger->warning("No output from {} within {} ms",
+                                driver->squeue_cmd,
+                                driver->command_timeout.count());
+                std::lock_guard guard{driver->poller_mutex};
+                slurm_driver_set_poller_ready(driver);
+                continue;
+            }
+            listing += line;
+            line.clear();
+            publish_listing();
+        } else {
+            ssize_t count = read(stream.out_fd, chunk, sizeof chunk);
+            if (count <= 0) {
+                if (count < 0 && errno == EINTR)
+                    continue;
+                int status = spawn_stream_stop(stream);
+                logger->warning("{} exited with status {}, restarting it",
+                                driver->squeue_cmd, status);
+                line.clear();
+                listing.clear();
+                if (!slurm_driver_poller_sleep(driver))
+                    break;
+                continue;
+            }
+
+            for (ssize_t i = 0; i < count; i++) {
+                if (chunk[i] != '\n') {
+                    line += chunk[i];
+                } else if (line.empty()) {
+                    publish_listing();
+                } else {
+                    listing += line + "\n";
+                    line.clear();
+                }
+            }
+        }
+    }
+
+    if (stream.pid > 0)
+        spawn_stream_stop(stream);
+}
+
+/**
+  Starts the poller on the first status request, so that the options of the
+  driver are set before it runs, and waits for its first snapshot.
+*/
+static void slurm_driver_start_poller(slurm_driver_type *driver) {
+    if (driver->poller_ready.load(std::memory_order_acquire))
+        return;
+
+    std::unique_lock lock{driver->poller_mutex};
+    if (!driver->poller.joinable()) {
+        if (driver->squeue_iterate) {
+            if (pipe(driver->poller_wakeup) != 0)
+                throw std::runtime_error("Unable to create pipe: " +
+                                         std::string(strerror(errno)));
+            for (int fd : driver->poller_wakeup)
+                fcntl(fd, F_SETFD, FD_CLOEXEC);
+            driver->poller =
+                std::thread{[driver] { slurm_driver_poll_stream(driver); }};
+        } else
+            driver->poller =
+                std::thread{[driver] { slurm_driver_poll(driver); }};
     }
+    driver->poller_cv.wait(lock, [driver] {
+        return driver->poller_ready.load() || driver->poller_stop;
+    });
 }
 
 /**
@@ -510,23 +1651,64 @@ static void slurm_driver_update_status_cache(const slurm_driver_type *driver) {
 job_status_type slurm_driver_get_job_status(void *_driver, void *_job) {
     auto driver = static_cast<slurm_driver_type *>(_driver);
     const auto *job = static_cast<const SlurmJob *>(_job);
-    auto update_cache = difftime(time(nullptr), driver->status_timestamp) >
-                        driver->status_timeout;
-    if (update_cache)
-        slurm_driver_update_status_cache(driver);
+    slurm_driver_start_poller(driver);
 
-    return driver->status.get(job->job_id);
+    return driver->status.get(job->key);
 }
 
+/**
+  Same as slurm_driver_get_job_status() for several jobs, which are all looked
+  up in the same snapshot.
+*/
+void slurm_driver_get_job_status_batch(void *_driver, void *const *jobs,
+                                       size_t num_jobs,
+                                       job_status_type *status) {
+    auto driver = static_cast<slurm_driver_type *>(_driver);
+    slurm_driver_start_poller(driver);
+
+    auto snapshot = driver->status.get_snapshot();
+    for (size_t i = 0; i < num_jobs; i++) {
+        const auto *job = static_cast<const SlurmJob *>(jobs[i]);
+        status[i] = SlurmStatus::get(*snapshot, job->key);
+    }
+}
+
+/**
+  The accounting of the job from the latest sacct or scontrol call of the
+  poller, which asks for it when the job has left squeue; the steps of packed
+  realizations are also asked for while they run.
+*/
+bool slurm_driver_get_job_accounting(void *_driver, void *_job,
+                                     queue_driver_job_accounting *accounting) {
+    auto driver = static_cast<slurm_driver_type *>(_driver);
+    const auto *job = static_cast<const SlurmJob *>(_job);
+    auto recorded = driver->status.get_accounting(job->string_id);
+    if (!recorded)
+        return false;
+    *accounting = *recorded;
+    return true;
+}
+
+/**
+  A packed realization is killed by cancelling its step. Before the step has
+  started its id is not known: when all the realizations of the pack have
+  been killed the whole allocation is cancelled, otherwise the step is
+  cancelled as soon as the poller finds it.
+*/
 void slurm_driver_kill_job(void *_driver, void *_job) {
     auto driver = static_cast<slurm_driver_type *>(_driver);
     const auto *job = static_cast<const SlurmJob *>(_job);
-    const char **argv = static_cast<const char **>(calloc(1, sizeof *argv));
-    CHECK_ALLOC(argv);
+    if (!job->pack) {
+        slurm_driver_scancel(driver, job->string_id);
+        return;
+    }
 
-    argv[0] = job->string_id.c_str();
-    spawn_blocking(driver->scancel_cmd.c_str(), 1, argv, nullptr, nullptr);
-    free(argv);
+    if (auto step_id = driver->status.step_id(job->string_id))
+        slurm_driver_scancel(driver, *step_id);
+    else if (++job->pack->num_killed == job->pack->size)
+        slurm_driver_scancel(driver, std::to_string(job->pack->job_id));
+    else
+        driver->status.request_kill(job->string_id);
 }
 
 void slurm_driver_free_job(void *_job) {
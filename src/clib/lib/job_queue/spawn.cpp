@@ -1,21 +1,34 @@
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 
 #include <cerrno>
+#include <chrono>
+#include <csignal>
 #include <fcntl.h>
+#include <poll.h>
 #include <pthread.h>
 #include <spawn.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <thread>
 #include <unistd.h>
 #include <vector>
 
+#include <ert/job_queue/spawn.hpp>
+#include <ert/logging.hpp>
+
 extern char **environ;
 
+static auto logger = ert::get_logger("ert.job_queue.spawn");
+
 static bool is_executable(const char *path) {
     if (access(path, F_OK) == 0) {
         struct stat stat_buffer;
@@ -70,11 +83,18 @@ create_fileactions(posix_spawn_file_actions_t *file_actions) {
 
 static void
 spawn_init_redirection(std::shared_ptr<posix_spawn_file_actions_t> file_actions,
-                       const char *stdout_file, const char *stderr_file) {
+                       const char *stdout_file, const char *stderr_file,
+                       int stdout_fd = -1, int stderr_fd = -1,
+                       int stdin_fd = -1) {
 
-    /* STDIN is unconditionally closed in the child process. */
-    if (posix_spawn_file_actions_addclose(file_actions.get(), STDIN_FILENO) !=
-        0) {
+    /* STDIN is closed in the child process, unless a descriptor to read it
+     from is given. */
+    int status = stdin_fd >= 0
+                     ? posix_spawn_file_actions_adddup2(file_actions.get(),
+                                                        stdin_fd, STDIN_FILENO)
+                     : posix_spawn_file_actions_addclose(file_actions.get(),
+                                                         STDIN_FILENO);
+    if (status != 0) {
         throw std::runtime_error("Unable to set up file redirection due to " +
                                  std::string(strerror(errno)));
     }
@@ -84,6 +104,24 @@ spawn_init_redirection(std::shared_ptr<posix_spawn_file_actions_t> file_actions,
      send stdout & stderr to whereever the parent process was already
      sending it.
     */
+    /* Output can also be sent to file descriptors, e.g. pipes, which are
+     duplicated onto stdout & stderr. */
+    if (stdout_fd >= 0)
+        if (posix_spawn_file_actions_adddup2(file_actions.get(), stdout_fd,
+                                             STDOUT_FILENO) != 0) {
+            throw std::runtime_error(
+                "Unable to add posix_spawn stdout file_action " +
+                std::string(strerror(errno)));
+        }
+
+    if (stderr_fd >= 0)
+        if (posix_spawn_file_actions_adddup2(file_actions.get(), stderr_fd,
+                                             STDERR_FILENO) != 0) {
+            throw std::runtime_error(
+                "Unable to add posix_spawn stderr file_action " +
+                std::string(strerror(errno)));
+        }
+
     if (stdout_file)
         if (posix_spawn_file_actions_addopen(
                 file_actions.get(), STDOUT_FILENO, stdout_file,
@@ -109,21 +147,16 @@ spawn_init_redirection(std::shared_ptr<posix_spawn_file_actions_t> file_actions,
 */
 static pthread_mutex_t spawn_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-/**
-  The spawn function will start a new process running
-  @executable. The pid of the new process will be
-  returned. Alternatively the spawn_blocking() function will
-  block until the newlye created process has completed.
-*/
-
-pid_t spawn(char *const argv[], const char *stdout_file,
-            const char *stderr_file) {
+static pid_t spawn_process(char *const argv[], const char *stdout_file,
+                           const char *stderr_file, int stdout_fd,
+                           int stderr_fd, int stdin_fd = -1) {
     pid_t pid;
     posix_spawnattr_t _spawn_attr{};
     posix_spawn_file_actions_t _file_actions{};
     auto spawn_attr = create_spawnattr(&_spawn_attr);
     auto file_actions = create_fileactions(&_file_actions);
-    spawn_init_redirection(file_actions, stdout_file, stderr_file);
+    spawn_init_redirection(file_actions, stdout_file, stderr_file, stdout_fd,
+                           stderr_fd, stdin_fd);
     set_spawn_flags(spawn_attr);
     pthread_mutex_lock(&spawn_mutex);
     {
@@ -137,14 +170,28 @@ pid_t spawn(char *const argv[], const char *stdout_file,
                                   spawn_attr.get(), argv, environ);
         }
 
-        if (status != 0)
+        if (status != 0) {
+            pthread_mutex_unlock(&spawn_mutex);
             throw std::runtime_error("Could not call " + std::string(argv[0]) +
                                      " due to " + std::string(strerror(errno)));
+        }
     }
     pthread_mutex_unlock(&spawn_mutex);
     return pid;
 }
 
+/**
+  The spawn function will start a new process running
+  @executable. The pid of the new process will be
+  returned. Alternatively the spawn_blocking() function will
+  block until the newlye created process has completed.
+*/
+
+pid_t spawn(char *const argv[], const char *stdout_file,
+            const char *stderr_file) {
+    return spawn_process(argv, stdout_file, stderr_file, -1, -1);
+}
+
 pid_t spawn(const char *executable, int argc, const char **argv,
             const char *stdout_file, const char *stderr_file) {
     std::unique_ptr<char *[]> args(new char *[argc + 2]);
@@ -156,6 +203,80 @@ pid_t spawn(const char *executable, int argc, const char **argv,
     return spawn(args.get(), stdout_file, stderr_file);
 }
 
+using deadline_type = std::optional<std::chrono::steady_clock::time_point>;
+
+/** The time left until the deadline in milliseconds, for poll(). */
+static int remaining_ms(std::chrono::steady_clock::time_point deadline) {
+    using namespace std::chrono;
+    auto remaining = ceil<milliseconds>(deadline - steady_clock::now());
+    return static_cast<int>(std::max<milliseconds::rep>(0, remaining.count()));
+}
+
+/**
+  Waits until the child process has exited or the deadline has passed,
+  without reaping it. Returns false if the deadline passed.
+*/
+static bool wait_until(pid_t pid,
+                       std::chrono::steady_clock::time_point deadline) {
+#if defined(__linux__) && defined(SYS_pidfd_open)
+    int pidfd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+    if (pidfd >= 0) {
+        pollfd process{pidfd, POLLIN, 0};
+        int ready;
+        do {
+            ready = poll(&process, 1, remaining_ms(deadline));
+        } while (ready < 0 && errno == EINTR);
+        close(pidfd);
+        return ready != 0;
+    }
+#endif
+    // Without pidfd (older kernels and macOS) the child is polled, backing
+    // off to 100 ms between the checks
+    auto interval = std::chrono::milliseconds(1);
+    while (true) {
+        siginfo_t info{};
+        if (waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) != 0 ||
+            info.si_pid == pid)
+            return true;
+        if (remaining_ms(deadline) == 0)
+            return false;
+        std::this_thread::sleep_for(std::min<std::chrono::milliseconds>(
+            interval, std::chrono::milliseconds(remaining_ms(deadline))));
+        interval = std::min(interval * 2, std::chrono::milliseconds(100));
+    }
+}
+
+/**
+  Waits for a command started locally or by the spawn server, and returns
+  its wait status. If the command is still running at the deadline, or
+  timed_out is already set, its process group is killed first.
+*/
+static int wait_for_command(char *const argv[], pid_t pid,
+                            const std::optional<spawn_server_process> &remote,
+                            deadline_type deadline, bool &timed_out) {
+    if (deadline && !timed_out)
+        timed_out = remote ? !spawn_server_wait_for(
+                                 *remote, std::chrono::milliseconds(
+                                              remaining_ms(*deadline)))
+                           : !wait_until(pid, *deadline);
+
+    // The command is the leader of its own process group, see
+    // set_spawn_flags(), so this also kills whatever it has started
+    if (timed_out) {
+        logger->warning("Killing {} (pid {}), which did not complete in time",
+                        argv[0], pid);
+        kill(-pid, SIGKILL);
+    }
+
+    int status;
+    if (remote)
+        status = spawn_server_wait(*remote);
+    else if (waitpid(pid, &status, 0) < 0)
+        throw std::runtime_error("Unable to wait for " + std::string(argv[0]) +
+                                 ": " + std::string(strerror(errno)));
+    return status;
+}
+
 /**
   Will spawn a new process and wait for its completion. The exit
   status of the new process is returned, observe that exit status 127
@@ -163,11 +284,15 @@ pid_t spawn(const char *executable, int argc, const char **argv,
   found.
 */
 int spawn_blocking(const char *executable, int argc, const char **argv,
-                   const char *stdout_file, const char *stderr_file) {
-    pid_t pid = spawn(executable, argc, argv, stdout_file, stderr_file);
-    int status;
-    waitpid(pid, &status, 0);
-    return status;
+                   const char *stdout_file, const char *stderr_file,
+                   std::optional<std::chrono::milliseconds> timeout) {
+    std::unique_ptr<char *[]> args(new char *[argc + 2]);
+    args[0] = (char *)executable;
+    for (int iarg = 0; iarg < argc; iarg++)
+        args[iarg + 1] = (char *)argv[iarg];
+    args[argc + 1] = nullptr;
+
+    return spawn_blocking(args.get(), stdout_file, stderr_file, timeout);
 }
 
 /**
@@ -177,9 +302,282 @@ int spawn_blocking(const char *executable, int argc, const char **argv,
   found.
 */
 int spawn_blocking(char *const argv[], const char *stdout_file,
-                   const char *stderr_file) {
-    pid_t pid = spawn(argv, stdout_file, stderr_file);
-    int status;
-    waitpid(pid, &status, 0);
+                   const char *stderr_file,
+                   std::optional<std::chrono::milliseconds> timeout) {
+    deadline_type deadline;
+    if (timeout)
+        deadline = std::chrono::steady_clock::now() + *timeout;
+
+    auto remote = spawn_server_start_process(argv, stdout_file, stderr_file);
+    pid_t pid = remote ? remote->pid : spawn(argv, stdout_file, stderr_file);
+    bool timed_out = false;
+    return wait_for_command(argv, pid, remote, deadline, timed_out);
+}
+
+/** Writes to the stdin socket of a command without raising SIGPIPE if the
+ * command has gone away. */
+static ssize_t write_input(int fd, std::string_view input) {
+#ifdef MSG_NOSIGNAL
+    return send(fd, input.data(), input.size(), MSG_NOSIGNAL);
+#else
+    return write(fd, input.data(), input.size());
+#endif
+}
+
+/**
+  Reads the stdout and stderr pipes of a command until both are closed, or
+  the deadline has passed, while writing the input to its stdin. The stdin
+  descriptor is closed when all of the input has been written, so that the
+  command sees the end of it. Sets timed_out if the deadline passed, and
+  read_failed if the pipes could not be polled.
+*/
+static void read_output(int out_fd, int err_fd, int in_fd,
+                        std::string_view input, spawn_output &output,
+                        deadline_type deadline) {
+    pollfd fds[3] = {
+        {out_fd, POLLIN, 0}, {err_fd, POLLIN, 0}, {in_fd, POLLOUT, 0}};
+    std::string *buffers[2] = {&output.out, &output.err};
+    char chunk[4096];
+    auto close_input = [&fds] {
+        if (fds[2].fd >= 0)
+            close(fds[2].fd);
+        fds[2].fd = -1;
+    };
+    if (input.empty())
+        close_input();
+
+    while (fds[0].fd >= 0 || fds[1].fd >= 0) {
+        int timeout = -1;
+        if (deadline) {
+            timeout = remaining_ms(*deadline);
+            if (timeout == 0) {
+                close_input();
+                output.timed_out = true;
+                return;
+            }
+        }
+
+        int num_ready = poll(fds, 3, timeout);
+        if (num_ready < 0) {
+            if (errno == EINTR)
+                continue;
+            logger->warning("Unable to read the output of a command: {}",
+                            strerror(errno));
+            close_input();
+            output.read_failed = true;
+            return;
+        }
+
+        if (fds[2].fd >= 0 && fds[2].revents != 0) {
+            ssize_t count = write_input(fds[2].fd, input);
+            if (count > 0)
+                input.remove_prefix(count);
+            if (input.empty() ||
+                (count < 0 && errno != EINTR && errno != EAGAIN))
+                close_input();
+        }
+
+        for (int i = 0; i < 2 && num_ready > 0; i++) {
+            if (fds[i].fd < 0 || fds[i].revents == 0)
+                continue;
+            ssize_t count = read(fds[i].fd, chunk, sizeof chunk);
+            if (count > 0)
+                buffers[i]->append(chunk, count);
+            else if (count == 0 || errno != EINTR)
+                fds[i].fd = -1;
+        }
+    }
+    // The command has closed its output without reading all of the input
+    close_input();
+}
+
+static void open_pipe(int fds[2]) {
+    if (pipe(fds) != 0)
+        throw std::runtime_error("Unable to create pipe: " +
+                                 std::string(strerror(errno)));
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+}
+
+/** A socket rather than a pipe, so that the input can be written without
+ * SIGPIPE; the write end, fds[1], does not block. */
+static void open_input(int fds[2]) {
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        throw std::runtime_error("Unable to create socket: " +
+                                 std::string(strerror(errno)));
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+    int on = 1;
+    setsockopt(fds[1], SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof on);
+#endif
+}
+
+spawn_output spawn_capture(char *const argv[],
+                           std::optional<std::chrono::milliseconds> timeout,
+                           std::optional<std::string_view> input) {
+    deadline_type deadline;
+    if (timeout)
+        deadline = std::chrono::steady_clock::now() + *timeout;
+
+    int out_pipe[2];
+    int err_pipe[2];
+    int in_pipe[2] = {-1, -1};
+    open_pipe(out_pipe);
+    try {
+        open_pipe(err_pipe);
+        if (input) {
+            try {
+                open_input(in_pipe);
+            } catch (...) {
+                close(err_pipe[0]);
+                close(err_pipe[1]);
+                throw;
+            }
+        }
+    } catch (...) {
+        close(out_pipe[0]);
+        close(out_pipe[1]);
+        throw;
+    }
+
+    std::optional<spawn_server_process> remote;
+    pid_t pid;
+    try {
+        remote = spawn_server_start_process(
+            argv, nullptr, nullptr, out_pipe[1], err_pipe[1], in_pipe[0]);
+        if (remote)
+            pid = remote->pid;
+        else
+            pid = spawn_process(argv, nullptr, nullptr, out_pipe[1],
+                                err_pipe[1], in_pipe[0]);
+    } catch (...) {
+        for (int fd : {out_pipe[0], out_pipe[1], err_pipe[0], err_pipe[1],
+                       in_pipe[0], in_pipe[1]})
+            if (fd >= 0)
+                close(fd);
+        throw;
+    }
+    // The command has the write ends now, so the pipes are closed when it
+    // exits
+    close(out_pipe[1]);
+    close(err_pipe[1]);
+    if (input)
+        close(in_pipe[0]);
+
+    spawn_output output;
+    read_output(out_pipe[0], err_pipe[0], in_pipe[1],
+                input.value_or(std::string_view{}), output, deadline);
+    close(out_pipe[0]);
+    close(err_pipe[0]);
+
+    // The pipes can be closed before the command exits, so the wait is also
+    // bounded by the deadline. A command whose output could not be read is
+    // still waited for, and only killed if it has a deadline which passes.
+    output.status =
+        wait_for_command(argv, pid, remote, deadline, output.timed_out);
+    return output;
+}
+
+spawn_output spawn_capture(const char *executable, int argc, const char **argv,
+                           std::optional<std::chrono::milliseconds> timeout,
+                           std::optional<std::string_view> input) {
+    std::unique_ptr<char *[]> args(new char *[argc + 2]);
+    args[0] = (char *)executable;
+    for (int iarg = 0; iarg < argc; iarg++)
+        args[iarg + 1] = (char *)argv[iarg];
+    args[argc + 1] = nullptr;
+
+    return spawn_capture(args.get(), timeout, input);
+}
+
+spawn_stream_process spawn_stream(char *const argv[]) {
+    int out_pipe[2];
+    open_pipe(out_pipe);
+
+    spawn_stream_process process;
+    try {
+        process.pid =
+            spawn_process(argv, nullptr, "/dev/null", out_pipe[1], -1);
+    } catch (...) {
+        close(out_pipe[0]);
+        close(out_pipe[1]);
+        throw;
+    }
+    close(out_pipe[1]);
+    process.out_fd = out_pipe[0];
+    return process;
+}
+
+int spawn_stream_stop(spawn_stream_process &process) {
+    int status = -1;
+    if (process.pid > 0) {
+        // The command is the leader of its own process group
+        kill(-process.pid, SIGKILL);
+        while (waitpid(process.pid, &status, 0) < 0 && errno == EINTR)
+            ;
+    }
+    if (process.out_fd >= 0)
+        close(process.out_fd);
+
+    process = {};
+    return status;
+}
+
+spawn_session_process spawn_session(char *const argv[]) {
+    int in_pipe[2];
+    int out_pipe[2];
+    int err_pipe[2];
+    open_input(in_pipe);
+    try {
+        open_pipe(out_pipe);
+        try {
+            open_pipe(err_pipe);
+        } catch (...) {
+            close(out_pipe[0]);
+            close(out_pipe[1]);
+            throw;
+        }
+    } catch (...) {
+        close(in_pipe[0]);
+        close(in_pipe[1]);
+        throw;
+    }
+
+    spawn_session_process process;
+    try {
+        process.pid = spawn_process(argv, nullptr, nullptr, out_pipe[1],
+                                    err_pipe[1], in_pipe[0]);
+    } catch (...) {
+        for (int fd : {in_pipe[0], in_pipe[1], out_pipe[0], out_pipe[1],
+                       err_pipe[0], err_pipe[1]})
+            close(fd);
+        throw;
+    }
+    close(in_pipe[0]);
+    close(out_pipe[1]);
+    close(err_pipe[1]);
+    process.in_fd = in_pipe[1];
+    process.out_fd = out_pipe[0];
+    process.err_fd = err_pipe[0];
+    return process;
+}
+
+int spawn_session_stop(spawn_session_process &process) {
+    if (process.in_fd >= 0)
+        close(process.in_fd);
+    int status = -1;
+    if (process.pid > 0) {
+        // The command is the leader of its own process group
+        kill(-process.pid, SIGKILL);
+        while (waitpid(process.pid, &status, 0) < 0 && errno == EINTR)
+            ;
+    }
+    for (int fd : {process.out_fd, process.err_fd})
+        if (fd >= 0)
+            close(fd);
+
+    process = {};
     return status;
 }
@@ -0,0 +1,670 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+
+#include <ert/job_queue/spawn.hpp>
+#include <ert/logging.hpp>
+#include <ert/python.hpp>
+
+extern char **environ;
+
+static auto logger = ert::get_logger("ert.job_queue.spawn_server");
+
+/*
+  A request is sent as a datagram on the control socket which carries one end
+  of a new stream socket, optionally followed by file descriptors for the
+  stdout, stderr and stdin of the command. The request itself is written to that
+  stream: a spawn_request header followed by the NUL terminated strings cwd,
+  stdout file and stderr file (when the flags say so), argv and the
+  environment. The server writes a SPAWN_STARTED reply to the stream when the
+  command has been started, and a SPAWN_EXITED reply when it completes.
+*/
+namespace {
+constexpr size_t SPAWN_REQUEST_MAX_SIZE = 1 << 20;
+constexpr size_t SPAWN_REQUEST_MAX_STRINGS = 1 << 16;
+constexpr int SPAWN_SERVER_MAX_CHILDREN = 1024;
+
+constexpr uint32_t SPAWN_STDOUT = 1;
+constexpr uint32_t SPAWN_STDERR = 2;
+constexpr uint32_t SPAWN_STDOUT_FD = 4;
+constexpr uint32_t SPAWN_STDERR_FD = 8;
+constexpr uint32_t SPAWN_STDIN_FD = 16;
+/** The reply stream, and the stdout, stderr and stdin descriptors. */
+constexpr int SPAWN_REQUEST_MAX_FDS = 4;
+
+struct spawn_request {
+    uint32_t size;
+    uint32_t argc;
+    uint32_t envc;
+    uint32_t flags;
+};
+
+enum spawn_reply_kind : int32_t {
+    /** The command ran, value is the wait status. */
+    SPAWN_EXITED = 0,
+    /** The command could not be started, value is the errno. */
+    SPAWN_EXEC_FAILED = 1,
+    /** The server did not run the command, value is the errno. */
+    SPAWN_REJECTED = 2,
+    /** The command has been started, value is its pid. */
+    SPAWN_STARTED = 3,
+};
+
+struct spawn_reply {
+    int32_t kind;
+    int32_t value;
+};
+
+bool read_full(int fd, void *data, size_t size) {
+    auto bytes = static_cast<char *>(data);
+    while (size > 0) {
+        ssize_t count = read(fd, bytes, size);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        bytes += count;
+        size -= count;
+    }
+    return true;
+}
+
+bool write_full(int fd, const void *data, size_t size) {
+#ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+    auto bytes = static_cast<const char *>(data);
+    while (size > 0) {
+        ssize_t count = send(fd, bytes, size, flags);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        bytes += count;
+        size -= count;
+    }
+    return true;
+}
+
+void set_cloexec(int fd) { fcntl(fd, F_SETFD, FD_CLOEXEC); }
+
+/**
+  Everything below runs in the server process, which is forked from a
+  possibly multithreaded process. It must therefore not allocate memory or
+  take locks, and only uses the buffers which are allocated before the fork.
+*/
+struct spawn_server_state {
+    int control_fd;
+    int lifeline_fd;
+    int sigchld_pipe[2];
+    char *buffer;
+    char **strings;
+    struct {
+        pid_t pid;
+        int reply_fd;
+    } children[SPAWN_SERVER_MAX_CHILDREN];
+    int num_children;
+};
+
+int sigchld_write_fd = -1;
+
+void on_sigchld(int) {
+    int saved_errno = errno;
+    char byte = 0;
+    if (write(sigchld_write_fd, &byte, 1) < 0) {
+        // The pipe is full, so the server will wake up anyway
+    }
+    errno = saved_errno;
+}
+
+void reply(int fd, int32_t kind, int32_t value) {
+    spawn_reply message{kind, value};
+    write_full(fd, &message, sizeof message);
+    close(fd);
+}
+
+/** Receives the file descriptors of one request, returns how many. */
+int receive_fds(int control_fd, int fds[SPAWN_REQUEST_MAX_FDS]) {
+    char byte;
+    iovec iov{&byte, 1};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) *
+                                             SPAWN_REQUEST_MAX_FDS)];
+    msghdr message{};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof control;
+
+    if (recvmsg(control_fd, &message, 0) <= 0)
+        return 0;
+
+    cmsghdr *header = CMSG_FIRSTHDR(&message);
+    if (header == nullptr || header->cmsg_level != SOL_SOCKET ||
+        header->cmsg_type != SCM_RIGHTS)
+        return 0;
+
+    int num_fds = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    memcpy(fds, CMSG_DATA(header), num_fds * sizeof(int));
+    for (int i = 0; i < num_fds; i++)
+        set_cloexec(fds[i]);
+    return num_fds;
+}
+
+const char *find_env(char *const envp[], const char *name) {
+    size_t length = strlen(name);
+    for (int i = 0; envp[i] != nullptr; i++)
+        if (strncmp(envp[i], name, length) == 0 && envp[i][length] == '=')
+            return envp[i] + length + 1;
+    return nullptr;
+}
+
+bool is_executable_file(const char *path) {
+    struct stat stat_buffer;
+    return stat(path, &stat_buffer) == 0 && S_ISREG(stat_buffer.st_mode) &&
+           (stat_buffer.st_mode & S_IXUSR) != 0;
+}
+
+/** Mirrors spawn(): executables are taken as given when they exist, and
+ * otherwise looked up in the PATH of the request. */
+void exec_command(char *const argv[], char *const envp[]) {
+    if (strchr(argv[0], '/') != nullptr || is_executable_file(argv[0])) {
+        execve(argv[0], argv, envp);
+        return;
+    }
+
+    const char *path = find_env(envp, "PATH");
+    if (path == nullptr)
+        path = "/usr/bin:/bin";
+
+    int saved_errno = ENOENT;
+    char candidate[4096];
+    size_t name_length = strlen(argv[0]);
+    while (*path != '\0') {
+        const char *end = strchr(path, ':');
+        size_t dir_length = end ? end - path : strlen(path);
+        if (dir_length + name_length + 2 <= sizeof candidate) {
+            memcpy(candidate, path, dir_length);
+            candidate[dir_length] = '/';
+            memcpy(candidate + dir_length + 1, argv[0], name_length + 1);
+            execve(candidate, argv, envp);
+            if (errno != ENOENT && errno != ENOTDIR)
+                saved_errno = errno;
+        }
+        if (end == nullptr)
+            break;
+        path = end + 1;
+    }
+    errno = saved_errno;
+}
+
+int redirect(int target, int fd) {
+    return fd == target || dup2(fd, target) >= 0 ? 0 : -1;
+}
+
+int open_redirect(int target, const char *file) {
+    int fd = open(file, O_WRONLY | O_TRUNC | O_CREAT, S_IRUSR | S_IWUSR);
+    if (fd < 0)
+        return -1;
+    if (fd != target) {
+        if (dup2(fd, target) < 0)
+            return -1;
+        close(fd);
+    }
+    return 0;
+}
+
+void handle_request(spawn_server_state &state, const int *fds, int num_fds) {
+    int reply_fd = fds[0];
+    spawn_request request;
+    if (!read_full(reply_fd, &request, sizeof request) ||
+        request.size > SPAWN_REQUEST_MAX_SIZE ||
+        size_t(request.argc) + request.envc + 5 > SPAWN_REQUEST_MAX_STRINGS ||
+        !read_full(reply_fd, state.buffer, request.size)) {
+        close(reply_fd);
+        return;
+    }
+
+    int stdout_fd = -1;
+    int stderr_fd = -1;
+    int stdin_fd = -1;
+    int next_fd = 1;
+    if ((request.flags & SPAWN_STDOUT_FD) && next_fd < num_fds)
+        stdout_fd = fds[next_fd++];
+    if ((request.flags & SPAWN_STDERR_FD) && next_fd < num_fds)
+        stderr_fd = fds[next_fd++];
+    if ((request.flags & SPAWN_STDIN_FD) && next_fd < num_fds)
+        stdin_fd = fds[next_fd++];
+    if (request.argc == 0 || next_fd != num_fds) {
+        reply(reply_fd, SPAWN_REJECTED, EINVAL);
+        return;
+    }
+    if (state.num_children == SPAWN_SERVER_MAX_CHILDREN) {
+        reply(reply_fd, SPAWN_REJECTED, EAGAIN);
+        return;
+    }
+
+    // Split the buffer into its strings
+    size_t num_strings = 1 + ((request.flags & SPAWN_STDOUT) ? 1 : 0) +
+                         ((request.flags & SPAWN_STDERR) ? 1 : 0) +
+                         request.argc + request.envc;
+    size_t offset = 0;
+    for (size_t i = 0; i < num_strings; i++) {
+        void *end = memchr(state.buffer + offset, '\0', request.size - offset);
+        if (end == nullptr) {
+            reply(reply_fd, SPAWN_REJECTED, EINVAL);
+            return;
+        }
+        state.strings[i] = state.buffer + offset;
+        offset = static_cast<char *>(end) - state.buffer + 1;
+    }
+
+    char **next = state.strings;
+    const char *cwd = *next++;
+    const char *stdout_file = nullptr;
+    const char *stderr_file = nullptr;
+    if (request.flags & SPAWN_STDOUT)
+        stdout_file = *next++;
+    if (request.flags & SPAWN_STDERR)
+        stderr_file = *next++;
+    // The strings are followed by room for the two terminating nullptrs
+    char **argv = next;
+    memmove(argv + request.argc + 1, argv + request.argc,
+            request.envc * sizeof(char *));
+    argv[request.argc] = nullptr;
+    char **envp = argv + request.argc + 1;
+    envp[request.envc] = nullptr;
+
+    int exec_pipe[2];
+    if (pipe(exec_pipe) != 0) {
+        reply(reply_fd, SPAWN_REJECTED, errno);
+        return;
+    }
+    set_cloexec(exec_pipe[0]);
+    set_cloexec(exec_pipe[1]);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(exec_pipe[0]);
+        close(exec_pipe[1]);
+        reply(reply_fd, SPAWN_REJECTED, errno);
+        return;
+    }
+
+    if (pid == 0) {
+        signal(SIGCHLD, SIG_DFL);
+        signal(SIGINT, SIG_DFL);
+        signal(SIGPIPE, SIG_DFL);
+        setpgid(0, 0);
+
+        // STDIN is closed in the child process, unless it is given
+        if (stdin_fd < 0)
+            close(STDIN_FILENO);
+        if (chdir(cwd) == 0 &&
+            (stdin_fd < 0 || redirect(STDIN_FILENO, stdin_fd) == 0) &&
+            (stdout_fd < 0 || redirect(STDOUT_FILENO, stdout_fd) == 0) &&
+            (stderr_fd < 0 || redirect(STDERR_FILENO, stderr_fd) == 0) &&
+            (stdout_file == nullptr ||
+             open_redirect(STDOUT_FILENO, stdout_file) == 0) &&
+            (stderr_file == nullptr ||
+             open_redirect(STDERR_FILENO, stderr_file) == 0))
+            exec_command(argv, envp);
+
+        int exec_errno = errno;
+        if (write(exec_pipe[1], &exec_errno, sizeof exec_errno) < 0) {
+            // The server will see the command exit with status 127
+        }
+        _exit(127);
+    }
+
+    close(exec_pipe[1]);
+    int exec_errno;
+    bool exec_failed = read_full(exec_pipe[0], &exec_errno, sizeof exec_errno);
+    close(exec_pipe[0]);
+    if (exec_failed) {
+        waitpid(pid, nullptr, 0);
+        reply(reply_fd, SPAWN_EXEC_FAILED, exec_errno);
+        return;
+    }
+
+    state.children[state.num_children++] = {pid, reply_fd};
+    spawn_reply started{SPAWN_STARTED, pid};
+    write_full(reply_fd, &started, sizeof started);
+}
+
+void reap_children(spawn_server_state &state) {
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        for (int i = 0; i < state.num_children; i++) {
+            if (state.children[i].pid != pid)
+                continue;
+            reply(state.children[i].reply_fd, SPAWN_EXITED, status);
+            state.children[i] = state.children[--state.num_children];
+            break;
+        }
+    }
+}
+
+[[noreturn]] void run_server(spawn_server_state &state) {
+    set_cloexec(state.control_fd);
+    set_cloexec(state.lifeline_fd);
+    if (pipe(state.sigchld_pipe) != 0)
+        _exit(1);
+    for (int fd : state.sigchld_pipe) {
+        set_cloexec(fd);
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+    }
+    sigchld_write_fd = state.sigchld_pipe[1];
+
+    struct sigaction action {};
+    action.sa_handler = on_sigchld;
+    action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGCHLD, &action, nullptr);
+    // The server stops when the parent goes away, not on ctrl-c
+    signal(SIGINT, SIG_IGN);
+    signal(SIGPIPE, SIG_IGN);
+    sigset_t all_signals;
+    sigemptyset(&all_signals);
+    sigprocmask(SIG_SETMASK, &all_signals, nullptr);
+
+    bool accepting = true;
+    while (accepting || state.num_children > 0) {
+        pollfd fds[3] = {{state.sigchld_pipe[0], POLLIN, 0},
+                         {accepting ? state.control_fd : -1, POLLIN, 0},
+                         {accepting ? state.lifeline_fd : -1, POLLIN, 0}};
+        if (poll(fds, 3, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            _exit(1);
+        }
+
+        if (fds[0].revents != 0) {
+            char bytes[64];
+            while (read(state.sigchld_pipe[0], bytes, sizeof bytes) > 0)
+                ;
+        }
+        reap_children(state);
+
+        if (fds[1].revents & POLLIN) {
+            int request_fds[SPAWN_REQUEST_MAX_FDS];
+            int num_fds = receive_fds(state.control_fd, request_fds);
+            if (num_fds > 0)
+                handle_request(state, request_fds, num_fds);
+            // The command has its own copies of the descriptors
+            for (int i = 1; i < num_fds; i++)
+                close(request_fds[i]);
+        }
+
+        if (fds[2].revents != 0)
+            accepting = false;
+    }
+    _exit(0);
+}
+
+void close_inherited_fds(int keep_1, int keep_2) {
+    long max_fd = sysconf(_SC_OPEN_MAX);
+    if (max_fd < 0 || max_fd > 65536)
+        max_fd = 65536;
+    for (int fd = STDERR_FILENO + 1; fd < max_fd; fd++)
+        if (fd != keep_1 && fd != keep_2)
+            close(fd);
+}
+
+/** Held shared while sending requests, and exclusively to start and stop. */
+std::shared_mutex server_mutex;
+int server_control_fd = -1;
+int server_lifeline_fd = -1;
+pid_t server_pid = -1;
+} // namespace
+
+bool spawn_server_start() {
+    std::unique_lock lock{server_mutex};
+    if (server_control_fd >= 0)
+        return true;
+
+    int control[2];
+    if (socketpair(AF_UNIX, SOCK_DGRAM, 0, control) != 0) {
+        logger->warning("Unable to create the spawn server socket: {}",
+                        strerror(errno));
+        return false;
+    }
+    int lifeline[2];
+    if (pipe(lifeline) != 0) {
+        logger->warning("Unable to create the spawn server pipe: {}",
+                        strerror(errno));
+        close(control[0]);
+        close(control[1]);
+        return false;
+    }
+
+    auto state = std::make_unique<spawn_server_state>();
+    auto buffer = std::make_unique<char[]>(SPAWN_REQUEST_MAX_SIZE);
+    auto strings = std::make_unique<char *[]>(SPAWN_REQUEST_MAX_STRINGS);
+    state->control_fd = control[1];
+    state->lifeline_fd = lifeline[0];
+    state->buffer = buffer.get();
+    state->strings = strings.get();
+    state->num_children = 0;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close_inherited_fds(control[1], lifeline[0]);
+        run_server(*state);
+    }
+
+    close(control[1]);
+    close(lifeline[0]);
+    if (pid < 0) {
+        logger->warning("Unable to start the spawn server: {}",
+                        strerror(errno));
+        close(control[0]);
+        close(lifeline[1]);
+        return false;
+    }
+
+    set_cloexec(control[0]);
+    set_cloexec(lifeline[1]);
+    server_control_fd = control[0];
+    server_lifeline_fd = lifeline[1];
+    server_pid = pid;
+    logger->info("Started spawn server with pid {}", pid);
+    return true;
+}
+
+void spawn_server_stop() {
+    std::unique_lock lock{server_mutex};
+    if (server_control_fd < 0)
+        return;
+
+    // The server exits when the commands it is running have completed
+    close(server_lifeline_fd);
+    close(server_control_fd);
+    waitpid(server_pid, nullptr, 0);
+    server_control_fd = -1;
+    server_lifeline_fd = -1;
+    server_pid = -1;
+}
+
+bool spawn_server_is_running() {
+    std::shared_lock lock{server_mutex};
+    return server_control_fd >= 0;
+}
+
+static bool send_fds(int control_fd, const int *fds, int num_fds) {
+    char byte = 0;
+    iovec iov{&byte, 1};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) *
+                                             SPAWN_REQUEST_MAX_FDS)]{};
+    msghdr message{};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = CMSG_SPACE(sizeof(int) * num_fds);
+
+    cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int) * num_fds);
+    memcpy(CMSG_DATA(header), fds, sizeof(int) * num_fds);
+
+    while (true) {
+        if (sendmsg(control_fd, &message, 0) == 1)
+            return true;
+        if (errno != EINTR)
+            return false;
+    }
+}
+
+std::optional<spawn_server_process>
+spawn_server_start_process(char *const argv[], const char *stdout_file,
+                           const char *stderr_file, int stdout_fd,
+                           int stderr_fd, int stdin_fd) {
+    spawn_request request{0, 0, 0, 0};
+    std::string payload = std::filesystem::current_path().string();
+    payload.push_back('\0');
+    if (stdout_file != nullptr) {
+        request.flags |= SPAWN_STDOUT;
+        payload.append(stdout_file).push_back('\0');
+    }
+    if (stderr_file != nullptr) {
+        request.flags |= SPAWN_STDERR;
+        payload.append(stderr_file).push_back('\0');
+    }
+    for (; argv[request.argc] != nullptr; request.argc++)
+        payload.append(argv[request.argc]).push_back('\0');
+    for (; environ[request.envc] != nullptr; request.envc++)
+        payload.append(environ[request.envc]).push_back('\0');
+    request.size = static_cast<uint32_t>(payload.size());
+
+    if (request.argc == 0 || payload.size() > SPAWN_REQUEST_MAX_SIZE ||
+        size_t(request.argc) + request.envc + 5 > SPAWN_REQUEST_MAX_STRINGS)
+        return std::nullopt;
+
+    int channel[2];
+    {
+        std::shared_lock lock{server_mutex};
+        if (server_control_fd < 0)
+            return std::nullopt;
+
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, channel) != 0)
+            return std::nullopt;
+        set_cloexec(channel[0]);
+        set_cloexec(channel[1]);
+
+        int fds[SPAWN_REQUEST_MAX_FDS] = {channel[1]};
+        int num_fds = 1;
+        if (stdout_fd >= 0) {
+            request.flags |= SPAWN_STDOUT_FD;
+            fds[num_fds++] = stdout_fd;
+        }
+        if (stderr_fd >= 0) {
+            request.flags |= SPAWN_STDERR_FD;
+            fds[num_fds++] = stderr_fd;
+        }
+        if (stdin_fd >= 0) {
+            request.flags |= SPAWN_STDIN_FD;
+            fds[num_fds++] = stdin_fd;
+        }
+
+        bool sent = send_fds(server_control_fd, fds, num_fds);
+        close(channel[1]);
+        if (!sent) {
+            close(channel[0]);
+            return std::nullopt;
+        }
+    }
+
+    spawn_reply message;
+    bool ok = write_full(channel[0], &request, sizeof request) &&
+              write_full(channel[0], payload.data(), payload.size()) &&
+              read_full(channel[0], &message, sizeof message);
+    if (!ok) {
+        close(channel[0]);
+        throw std::runtime_error(
+            "Lost contact with the spawn server while starting " +
+            std::string(argv[0]));
+    }
+
+    switch (message.kind) {
+    case SPAWN_STARTED:
+        return spawn_server_process{message.value, channel[0]};
+    case SPAWN_EXEC_FAILED:
+        close(channel[0]);
+        throw std::runtime_error("Could not call " + std::string(argv[0]) +
+                                 " due to " +
+                                 std::string(strerror(message.value)));
+    default:
+        close(channel[0]);
+        return std::nullopt;
+    }
+}
+
+int spawn_server_wait(const spawn_server_process &process) {
+    spawn_reply message;
+    bool ok = read_full(process.channel, &message, sizeof message);
+    close(process.channel);
+    if (!ok || message.kind != SPAWN_EXITED)
+        throw std::runtime_error(fmt::format(
+            "Lost contact with the spawn server while waiting for pid {}",
+            process.pid));
+    return message.value;
+}
+
+bool spawn_server_wait_for(const spawn_server_process &process,
+                           std::chrono::milliseconds timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    pollfd channel{process.channel, POLLIN, 0};
+    while (true) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now());
+        int ready = poll(&channel, 1, std::max<int>(0, remaining.count()));
+        if (ready >= 0)
+            // A closed channel counts as completed, so that
+            // spawn_server_wait() reports the lost contact
+            return ready > 0;
+        if (errno != EINTR)
+            return true;
+    }
+}
+
+std::optional<int> spawn_server_run(char *const argv[], const char *stdout_file,
+                                    const char *stderr_file) {
+    auto process = spawn_server_start_process(argv, stdout_file, stderr_file);
+    if (!process)
+        return std::nullopt;
+    return spawn_server_wait(*process);
+}
+
+ERT_CLIB_SUBMODULE("queue", m) {
+    m.def("_start_spawn_server", &spawn_server_start);
+    m.def("_stop_spawn_server", [] {
+        // release the GIL
+        py::gil_scoped_release release;
+
+        spawn_server_stop();
+    });
+}
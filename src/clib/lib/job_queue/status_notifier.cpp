@@ -0,0 +1,124 @@
+#include <cerrno>
+#include <cstdint>
+#include <fcntl.h>
+#include <system_error>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+#include <ert/job_queue/status_notifier.hpp>
+#include <ert/logging.hpp>
+
+static auto logger = ert::get_logger("ert.job_queue.status_notifier");
+
+namespace ert {
+
+static_assert((StatusNotifier::CAPACITY & (StatusNotifier::CAPACITY - 1)) ==
+                  0,
+              "The capacity of the status notifier must be a power of two");
+
+StatusNotifier::StatusNotifier()
+    : cells(std::make_unique<cell[]>(CAPACITY)) {
+    for (size_t i = 0; i < CAPACITY; i++)
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+
+#ifdef __linux__
+    read_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (read_fd < 0)
+        throw std::system_error(errno, std::generic_category(),
+                                "Unable to create the status notifier eventfd");
+    write_fd = read_fd;
+#else
+    int fds[2];
+    if (pipe(fds) != 0)
+        throw std::system_error(errno, std::generic_category(),
+                                "Unable to create the status notifier pipe");
+    for (int fd : fds) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    read_fd = fds[0];
+    write_fd = fds[1];
+#endif
+}
+
+StatusNotifier::~StatusNotifier() {
+    if (write_fd != read_fd)
+        close(write_fd);
+    close(read_fd);
+}
+
+void StatusNotifier::signal() {
+    if (signalled.exchange(true))
+        return; // The consumer has not drained the previous signal yet
+
+#ifdef __linux__
+    uint64_t one = 1;
+    ssize_t written = write(write_fd, &one, sizeof one);
+#else
+    char one = 1;
+    ssize_t written = write(write_fd, &one, sizeof one);
+#endif
+    if (written < 0 && errno != EAGAIN)
+        logger->warning("Failed to signal a status change: {}",
+                        std::generic_category().message(errno));
+}
+
+/**
+  Bounded multi producer queue after Dmitry Vyukov: every cell carries a
+  sequence number which tells the producers when the cell is free, and the
+  consumer when the change in it has been published.
+*/
+void StatusNotifier::push(int queue_index, job_status_type status) {
+    size_t pos = tail.load(std::memory_order_relaxed);
+    cell *target;
+    while (true) {
+        target = &cells[pos & (CAPACITY - 1)];
+        size_t sequence = target->sequence.load(std::memory_order_acquire);
+        auto diff =
+            static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (tail.compare_exchange_weak(pos, pos + 1,
+                                           std::memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            overflowed = true;
+            signal();
+            return;
+        } else
+            pos = tail.load(std::memory_order_relaxed);
+    }
+
+    target->change = {queue_index, status};
+    target->sequence.store(pos + 1, std::memory_order_release);
+    signal();
+}
+
+bool StatusNotifier::drain(std::vector<status_change> &changes) {
+#ifdef __linux__
+    uint64_t count;
+    if (read(read_fd, &count, sizeof count) < 0 && errno != EAGAIN)
+        logger->warning("Failed to clear the status notifier: {}",
+                        std::generic_category().message(errno));
+#else
+    char buffer[64];
+    while (read(read_fd, buffer, sizeof buffer) > 0)
+        ;
+#endif
+    // Changes pushed after this point will signal again, so none of them can
+    // be left in the ring without the file descriptor being readable.
+    signalled.exchange(false);
+
+    while (true) {
+        cell &source = cells[head & (CAPACITY - 1)];
+        if (source.sequence.load(std::memory_order_acquire) != head + 1)
+            break;
+        changes.push_back(source.change);
+        source.sequence.store(head + CAPACITY, std::memory_order_release);
+        head++;
+    }
+    return !overflowed.exchange(false);
+}
+} // namespace ert
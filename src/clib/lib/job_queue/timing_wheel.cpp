@@ -0,0 +1,88 @@
+#include <utility>
+
+#include <ert/job_queue/timing_wheel.hpp>
+
+namespace ert {
+
+static constexpr uint64_t level_span(int level) {
+    return uint64_t(1) << (TimingWheel::SLOT_BITS * level);
+}
+
+bool TimingWheel::is_current(const entry &e) const {
+    auto timer = timers.find(e.id);
+    return timer != timers.end() && timer->second.generation == e.generation;
+}
+
+void TimingWheel::insert(const entry &e) {
+    uint64_t delta = e.deadline - current;
+    for (int level = 0; level < LEVELS; level++) {
+        if (delta < level_span(level + 1)) {
+            auto slot = (e.deadline / level_span(level)) % SLOTS;
+            slots[level][slot].push_back(e);
+            return;
+        }
+    }
+    overflow.push_back(e);
+}
+
+void TimingWheel::schedule(int id, uint64_t deadline) {
+    if (deadline <= current)
+        deadline = current + 1;
+
+    entry e{id, deadline, next_generation++};
+    timers[id] = {e.deadline, e.generation};
+    insert(e);
+}
+
+void TimingWheel::cancel(int id) { timers.erase(id); }
+
+/**
+  Moves the entries of the current slot at the given level down to the lower
+  levels; this happens every time the lower levels have completed a full
+  revolution.
+*/
+void TimingWheel::cascade(int level) {
+    std::vector<entry> entries;
+    if (level == LEVELS)
+        entries.swap(overflow);
+    else
+        entries.swap(slots[level][(current / level_span(level)) % SLOTS]);
+
+    for (const auto &e : entries)
+        if (is_current(e))
+            insert(e);
+}
+
+void TimingWheel::advance(uint64_t now, std::vector<int> &expired) {
+    if (timers.empty()) {
+        if (now > current)
+            current = now;
+        return;
+    }
+
+    while (current < now) {
+        current++;
+
+        int top = 0;
+        while (top < LEVELS && current % level_span(top + 1) == 0)
+            top++;
+        for (int level = top; level > 0; level--)
+            cascade(level);
+
+        auto &slot = slots[0][current % SLOTS];
+        std::vector<entry> entries;
+        entries.swap(slot);
+        for (const auto &e : entries) {
+            if (!is_current(e))
+                continue;
+            expired.push_back(e.id);
+            timers.erase(e.id);
+        }
+
+        if (timers.empty()) {
+            current = now;
+            break;
+        }
+    }
+}
+} // namespace ert
@@ -0,0 +1,39 @@
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include <ert/job_queue/token_bucket.hpp>
+
+namespace ert {
+TokenBucket::TokenBucket(double rate, double burst) { configure(rate, burst); }
+
+void TokenBucket::configure(double rate, double burst) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->rate = rate;
+    this->burst = std::max(1.0, burst);
+    tokens = this->burst;
+    last_update = clock::now();
+}
+
+TokenBucket::clock::time_point TokenBucket::reserve(clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (rate <= 0.0)
+        return now;
+
+    if (now > last_update) {
+        std::chrono::duration<double> elapsed = now - last_update;
+        tokens = std::min(burst, tokens + elapsed.count() * rate);
+        last_update = now;
+    }
+    // Below zero the tokens are owed to the callers which are waiting
+    tokens -= 1.0;
+    if (tokens >= 0.0)
+        return now;
+    return last_update + std::chrono::round<clock::duration>(
+                             std::chrono::duration<double>(-tokens / rate));
+}
+
+void TokenBucket::acquire() {
+    std::this_thread::sleep_until(reserve(clock::now()));
+}
+} // namespace ert
@@ -1,14 +1,18 @@
 #include <array>
 #include <chrono>
+#include <cmath>
 #include <cstdio>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <optional>
 #include <sstream>
 #include <string>
 #include <unistd.h>
+#include <unordered_map>
+#include <vector>
 
 #include <ert/abort.hpp>
 #include <ert/job_queue/spawn.hpp>
@@ -41,6 +45,9 @@ struct torque_driver_struct {
     char *cluster_label = nullptr;
     int submit_sleep = 0;
     int timeout = 0;
+    /** The deadline for each qsub/qstat/qdel command. */
+    std::chrono::milliseconds command_timeout{};
+    char *command_timeout_char = nullptr;
 };
 
 struct torque_job_struct {
@@ -65,6 +72,8 @@ void *torque_driver_alloc() {
                              TORQUE_DEFAULT_SUBMIT_SLEEP);
     torque_driver_set_option(torque_driver, TORQUE_QUEUE_QUERY_TIMEOUT,
                              TORQUE_DEFAULT_QUEUE_QUERY_TIMEOUT);
+    torque_driver_set_option(torque_driver, TORQUE_COMMAND_TIMEOUT,
+                             TORQUE_DEFAULT_COMMAND_TIMEOUT);
 
     return torque_driver;
 }
@@ -116,57 +125,6 @@ static bool torque_driver_set_num_nodes(torque_driver_type *driver,
     return false;
 }
 
-/**
-    Parses:
-
-      1 , T (not 't') , True (with any case) => true
-      0 , F (not 'f') , False(with any case) => false
-
-    Otherwise, set _value to false and return false.
-*/
-static inline bool sscanf_bool(const char *buffer, bool *_value) {
-    if (!buffer) {
-        if (_value)
-            *_value = false;
-        return false;
-    }
-
-    bool parse_OK = false;
-    bool value = false; /* Compiler shut up */
-
-    if (strcmp(buffer, "1") == 0) {
-        parse_OK = true;
-        value = true;
-    } else if (strcmp(buffer, "0") == 0) {
-        parse_OK = true;
-        value = false;
-    } else if (strcmp(buffer, "T") == 0) {
-        parse_OK = true;
-        value = true;
-    } else if (strcmp(buffer, "F") == 0) {
-        parse_OK = true;
-        value = false;
-    } else {
-        size_t size = strlen(buffer);
-        char *local_buffer = strndup(buffer, size);
-        for (size_t i = 0; i < size; i++)
-            local_buffer[i] = toupper(local_buffer[i]);
-
-        if (strcmp(local_buffer, "TRUE") == 0) {
-            parse_OK = true;
-            value = true;
-        } else if (strcmp(local_buffer, "FALSE") == 0) {
-            parse_OK = true;
-            value = false;
-        }
-
-        free(local_buffer);
-    }
-    if (_value != NULL)
-        *_value = value;
-    return parse_OK;
-}
-
 static bool
 torque_driver_set_keep_qsub_output(torque_driver_type *driver,
                                    const char *keep_output_bool_as_char) {
@@ -219,6 +177,19 @@ static bool torque_driver_set_timeout(torque_driver_type *driver,
     return false;
 }
 
+static bool torque_driver_set_command_timeout(torque_driver_type *driver,
+                                              const char *timeout_char) {
+    double timeout;
+    if (sscanf_double(timeout_char, &timeout) && timeout > 0) {
+        driver->command_timeout =
+            std::chrono::milliseconds(std::llround(1000 * timeout));
+        driver->command_timeout_char =
+            restrdup(driver->command_timeout_char, timeout_char);
+        return true;
+    }
+    return false;
+}
+
 bool torque_driver_set_option(void *_driver, const char *option_key,
                               const void *value_) {
     const char *value = (const char *)value_;
@@ -254,6 +225,8 @@ bool torque_driver_set_option(void *_driver, const char *option_key,
         option_set = torque_driver_set_submit_sleep(driver, value);
     else if (strcmp(TORQUE_QUEUE_QUERY_TIMEOUT, option_key) == 0)
         option_set = torque_driver_set_timeout(driver, value);
+    else if (strcmp(TORQUE_COMMAND_TIMEOUT, option_key) == 0)
+        option_set = torque_driver_set_command_timeout(driver, value);
     else
         option_set = false;
     return option_set;
@@ -286,6 +259,8 @@ const void *torque_driver_get_option(const void *_driver,
         return driver->job_prefix;
     else if (strcmp(TORQUE_QUEUE_QUERY_TIMEOUT, option_key) == 0)
         return driver->timeout_char;
+    else if (strcmp(TORQUE_COMMAND_TIMEOUT, option_key) == 0)
+        return driver->command_timeout_char;
     else {
         throw std::runtime_error(
             fmt::format("option_id:{} not recognized for TORQUE driver",
@@ -364,133 +339,28 @@ static char **torque_driver_alloc_cmd(torque_driver_type *driver,
     return argv;
 }
 
-/** Reads a token (characters separated by white-space) from stream.
-
-    It does not read past end of line.
-    If no token is found, then the function will return NULL.
-*/
-static char *next_token(FILE *stream) {
-    bool cont;
-    char *token = NULL;
-    char c;
-
-    cont = true;
-
-    // Skip initial whitespace
-    do {
-        long pos = ftell(stream);
-        if (pos == -1L)
-            throw std::runtime_error(
-                fmt::format("ftell failed: {}/{} \n", errno, strerror(errno)));
-        c = fgetc(stream);
-        if (c == '\r' || c == '\n') {
-            // Going back to position at newline
-            if (fseek(stream, pos, SEEK_SET) != 0)
-                throw std::runtime_error(fmt::format("fseek failed: {}/{} \n",
-                                                     errno, strerror(errno)));
-            cont = false;
-        } else if (c == EOF)
-            cont = false;
-        else if (!isspace(c)) {
-            if (fseek(stream, pos, SEEK_SET) != 0)
-                throw std::runtime_error(fmt::format("fseek failed: {}/{} \n",
-                                                     errno, strerror(errno)));
-            cont = false;
-        }
-    } while (cont);
-    if (c == '\r' || c == '\n' || c == EOF)
-        return NULL;
-
-    // At this point we are guranteed to return something != NULL
-    cont = true;
-    int length = 0;
-    long token_start = ftell(stream);
-    if (token_start == -1L)
-        throw std::runtime_error(
-            fmt::format("ftell failed: {}/{} \n", errno, strerror(errno)));
-
-    do {
-        c = fgetc(stream);
-        if (c == EOF)
-            cont = false;
-        else if ((c == '\r' || c == '\n'))
-            cont = false;
-        else if (isspace(c))
-            cont = false;
-        else
-            length++;
-    } while (cont);
-    if (c == '\r' || c == '\n')
-        if (fseek(stream, -1, SEEK_CUR) != 0)
-            throw std::runtime_error(
-                fmt::format("fseek failed: {}/{} \n", errno, strerror(errno)));
-    token = (char *)calloc(length + 1, sizeof *token);
-    CHECK_ALLOC(token)
-    if (fseek(stream, token_start, SEEK_SET) != 0)
-        throw std::runtime_error(
-            fmt::format("fseek failed: {}/{} \n", errno, strerror(errno)));
-    for (int i = 0; i < length; i++)
-        token[i] = fgetc(stream);
-    token[length] = '\0';
-
-    return token;
-}
-
-static bool fscanf_int(FILE *stream, int *value) {
-    long start_pos = ftell(stream);
-    if (start_pos == -1L)
-        throw std::runtime_error(
-            fmt::format("ftell failed: {}/{} \n", errno, strerror(errno)));
-    char *token = next_token(stream);
-
-    bool value_OK = false;
-    if (token != NULL) {
-        value_OK = sscanf_int(token, value);
-        if (!value_OK)
-            if (fseek(stream, start_pos, SEEK_SET) != 0)
-                throw std::runtime_error(fmt::format("fseek failed: {}/{} \n",
-                                                     errno, strerror(errno)));
-        free(token);
-    }
-    return value_OK;
-}
-
-static int torque_job_parse_qsub_stdout(const torque_driver_type *driver,
-                                        const char *stdout_file,
-                                        const char *stderr_file) {
+static int torque_job_parse_qsub_output(const torque_driver_type *driver,
+                                        const spawn_output &output) {
     int jobid;
-    FILE *stdout_stream = fopen(stdout_file, "r");
-    if (!stdout_stream) {
-        throw std::runtime_error("Unable to open qsub output: " +
-                                 std::string(strerror(errno)));
-    }
-
-    char *jobid_string = fscanf_upto(stdout_stream, ".");
-
     bool possible_jobid;
-    if (jobid_string == nullptr) {
+    auto dot_position = output.out.find('.');
+    if (dot_position == std::string::npos) {
         /* We get here if the '.' separator is not found */
-        possible_jobid = fscanf_int(stdout_stream, &jobid);
+        possible_jobid = sscanf_int(output.out.c_str(), &jobid);
         logger->debug("Torque job ID int: '{}'", jobid);
     } else {
-        possible_jobid = sscanf_int(jobid_string, &jobid);
+        auto jobid_string = output.out.substr(0, dot_position);
+        possible_jobid = sscanf_int(jobid_string.c_str(), &jobid);
         logger->debug("Torque job ID string: '{}'", jobid);
     }
 
     if (!possible_jobid) {
-        std::string stdout_content;
-        std::getline(std::ifstream(stdout_file), stdout_content, '\0');
-        std::string stderr_content;
-        std::getline(std::ifstream(stderr_file), stderr_content, '\0');
-        fprintf(stderr, "Failed to get torque job id from file: %s \n",
-                stdout_file);
+        fprintf(stderr, "Failed to get torque job id from qsub output\n");
         fprintf(stderr, "qsub command: %s \n", driver->qsub_cmd);
-        fprintf(stderr, "qsub output:  %s\n", stdout_content.c_str());
-        fprintf(stderr, "qsub errors:  %s\n", stderr_content.c_str());
+        fprintf(stderr, "qsub output:  %s\n", output.out.c_str());
+        fprintf(stderr, "qsub errors:  %s\n", output.err.c_str());
         jobid = -1;
     }
-    free(jobid_string);
-    fclose(stdout_stream);
     return jobid;
 }
 
@@ -539,21 +409,8 @@ static int torque_driver_submit_shell_job(torque_driver_type *driver,
                                           const char *submit_cmd, int num_cpu) {
 
     usleep(driver->submit_sleep);
-    constexpr int OUTPUT_FILE_SIZE = 32;
-    char tmp_std_file[OUTPUT_FILE_SIZE];
-    strncpy(tmp_std_file, "/tmp/enkf-submit-std-XXXXXX", OUTPUT_FILE_SIZE);
-    int fd = mkstemp(tmp_std_file);
-    close(fd);
-    char tmp_err_file[OUTPUT_FILE_SIZE];
-    strncpy(tmp_err_file, "/tmp/enkf-submit-err-XXXXXX", OUTPUT_FILE_SIZE);
-    fd = mkstemp(tmp_err_file);
-    close(fd);
     fs::path script_filename = fs::path(run_path) / "qsub_script.sh";
 
-    logger->debug("Setting up submit stdout target '{}' for '{}'", tmp_std_file,
-                  script_filename);
-    logger->debug("Setting up submit stderr target '{}' for '{}'", tmp_err_file,
-                  script_filename);
     torque_job_create_submit_script(script_filename.c_str(), submit_cmd,
                                     run_path);
     int p_units_from_driver = driver->num_cpus_per_node * driver->num_nodes;
@@ -574,8 +431,10 @@ static int torque_driver_submit_shell_job(torque_driver_type *driver,
     int return_value = -1;
     int retry_interval = 2; /* seconds */
     int slept_time = 0;
+    spawn_output output;
     while (return_value != 0) {
-        return_value = spawn_blocking(remote_argv, tmp_std_file, tmp_err_file);
+        output = spawn_capture(remote_argv);
+        return_value = output.status;
         if (return_value != 0) {
             if (slept_time + retry_interval <= driver->timeout) {
                 logger->debug("qsub failed for job {}, retrying in "
@@ -608,13 +467,7 @@ static int torque_driver_submit_shell_job(torque_driver_type *driver,
     }
     free(remote_argv);
 
-    int job_id =
-        torque_job_parse_qsub_stdout(driver, tmp_std_file, tmp_err_file);
-
-    unlink(tmp_std_file);
-    unlink(tmp_err_file);
-
-    return job_id;
+    return torque_job_parse_qsub_output(driver, output);
 }
 
 void torque_job_free(torque_job_type *job) {
@@ -660,123 +513,120 @@ void *torque_driver_submit_job(void *_driver, std::string submit_cmd,
 }
 
 /**
-   Will return NULL if "something" fails; that again will be
-   translated to JOB_QUEUE_STATUS_FAILURE - which the queue layer will
-   just interpret as "No change in status". Possible failures are:
-
-    1. The file capturing stdout is not created.
-    2. Can not extract the correct status string from the stdout file.
-
+   Runs the qstat command with the given arguments, and captures its stdout
+   in output. The qstat command might fail
+   intermittently for acceptable reasons, so it is retried a couple of
+   times with exponential sleep. ERT pings qstat every second, thus the
+   initial sleep time is 2 seconds. A qstat which does not complete within
+   the command timeout is not retried, so that a slow Torque server does
+   not stall the status updates.
+
+   The description is only used in log messages, e.g. "job 1234".
 */
-static job_status_type
-torque_driver_get_qstat_status(torque_driver_type *driver,
-                               const char *jobnr_char) {
-    constexpr int OUTPUT_FILE_SIZE = 32;
-    char tmp_std_file[OUTPUT_FILE_SIZE];
-    strncpy(tmp_std_file, "/tmp/ert-qstat-std-XXXXXX", OUTPUT_FILE_SIZE);
-    int fd = mkstemp(tmp_std_file);
-    close(fd);
-    char tmp_err_file[OUTPUT_FILE_SIZE];
-    strncpy(tmp_err_file, "/tmp/ert-qstat-err-XXXXXX", OUTPUT_FILE_SIZE);
-    fd = mkstemp(tmp_err_file);
-    close(fd);
-    job_status_type status = JOB_QUEUE_STATUS_FAILURE;
-
-    /* "qstat -f" means "full"/"long" output
-     * (multiple lines of output pr. job)  */
-    std::array argv{"-f", (const char *)driver->qstat_opts, jobnr_char};
-
-    /* The qstat command might fail intermittently for acceptable reasons,
-       retry a couple of times with exponential sleep. ERT pings qstat
-       every second for every realization, thus the initial sleep time
-       is 2 seconds. */
+static bool torque_driver_run_qstat(torque_driver_type *driver,
+                                    std::vector<const char *> &argv,
+                                    std::string &output,
+                                    const std::string &description) {
     bool qstat_succeeded = false;
     int retry_interval = 2; /* seconds */
     int slept_time = 0;
     while ((!qstat_succeeded) && (slept_time <= driver->timeout)) {
-        int return_value =
-            spawn_blocking(driver->qstat_cmd, argv.size(), argv.data(),
-                           tmp_std_file, tmp_err_file);
+        auto qstat_output = spawn_capture(driver->qstat_cmd, argv.size(),
+                                          argv.data(), driver->command_timeout);
+        int return_value = qstat_output.status;
+        output = std::move(qstat_output.out);
+        if (qstat_output.timed_out) {
+            logger->warning("qstat did not complete within {} ms for {}",
+                            driver->command_timeout.count(), description);
+            break;
+        }
         // A non-zero return value is trusted, but a zero return-value
         // is not trusted unless the output has nonzero length.
         // ERT never calls qstat unless it has already submitted something, and
         // can therefore assume that qstat results about Unknown Job Id are
         // failures (these have nonzero output length, but return value != 0)
         // that should trigger retries.
-        if (std::error_code ec;
-            fs::file_size(tmp_std_file, ec) > 0 && !ec && return_value == 0) {
+        if (!output.empty() && return_value == 0) {
             qstat_succeeded = true;
         }
 
         if (!qstat_succeeded) {
             if (slept_time + retry_interval <= driver->timeout) {
-                logger->debug("qstat failed for job {} with exit code "
+                logger->debug("qstat failed for {} with exit code "
                               "{}, retrying in {} seconds",
-                              jobnr_char, return_value, retry_interval);
+                              description, return_value, retry_interval);
                 sleep(retry_interval);
                 slept_time += retry_interval;
                 retry_interval *= 2;
             } else {
-                logger->debug("qstat failed for job %s, no (more) retries",
-                              jobnr_char);
+                logger->debug("qstat failed for {}, no (more) retries",
+                              description);
                 break;
             }
         } else {
             if (slept_time > 0) {
-                logger->debug("qstat succeeded for job {} after waiting "
+                logger->debug("qstat succeeded for {} after waiting "
                               "{} seconds",
-                              jobnr_char, slept_time);
+                              description, slept_time);
             }
         }
     }
-    if (fs::exists(tmp_std_file)) {
-        status = torque_driver_parse_status(tmp_std_file, jobnr_char);
-        if (status != JOB_QUEUE_STATUS_FAILURE) {
-            unlink(tmp_std_file);
-            unlink(tmp_err_file);
-        }
-    } else
-        fprintf(stderr,
-                "No such file: %s - reading qstat status failed\n"
-                "stderr: %s\n",
-                tmp_std_file, tmp_err_file);
-
-    return status;
+    return qstat_succeeded;
 }
 
-job_status_type torque_driver_parse_status(const char *qstat_file,
-                                           const char *jobnr_char) {
-    job_status_type status = JOB_QUEUE_STATUS_FAILURE;
+static job_status_type torque_driver_parse_status(std::istream &qstatoutput,
+                                                  const char *jobnr_char,
+                                                  const char *source);
 
-    int jobnr_no_namespace = -1;
-    if (jobnr_char != nullptr) {
-        /* Remove namespace from incoming job_id */
-        std::string jobnr_namespaced(jobnr_char);
-        int dot_position = jobnr_namespaced.find(".");
-        if (dot_position != std::string::npos) {
-            jobnr_namespaced.replace(dot_position, 1, " ");
-        }
-        std::stringstream(jobnr_namespaced) >> jobnr_no_namespace;
-    }
+/**
+   Will return NULL if "something" fails; that again will be
+   translated to JOB_QUEUE_STATUS_FAILURE - which the queue layer will
+   just interpret as "No change in status", e.g. if the correct status
+   string can not be extracted from the qstat output.
 
-    /* Parse the qstat output, looking only for requested job_id */
-    std::string job_id_label("Job Id:");
-    std::string job_state("_void_");
+*/
+static job_status_type
+torque_driver_get_qstat_status(torque_driver_type *driver,
+                               const char *jobnr_char) {
+    /* "qstat -f" means "full"/"long" output
+     * (multiple lines of output pr. job)  */
+    std::vector<const char *> argv{"-f", driver->qstat_opts, jobnr_char};
+    std::string output;
+    torque_driver_run_qstat(driver, argv, output,
+                            fmt::format("job {}", jobnr_char));
+
+    std::istringstream qstatoutput(output);
+    return torque_driver_parse_status(qstatoutput, jobnr_char, "qstat output");
+}
+
+namespace {
+/** The fields we use from the "qstat -f" output of one job. */
+struct torque_qstat_job {
+    std::string job_state = "_void_";
     int exit_status = 0;
-    std::ifstream qstatoutput(qstat_file);
+};
+} // namespace
+
+/**
+   Parses the "qstat -f" output in one pass, and returns the job_state and
+   Exit_status of every job in it, keyed on the job number without the
+   namespace (Torque server name). Returns std::nullopt if the output is
+   unreadable.
+*/
+static std::optional<std::unordered_map<long, torque_qstat_job>>
+torque_driver_parse_qstat(std::istream &qstatoutput) {
+    std::unordered_map<long, torque_qstat_job> jobs;
+    std::string job_id_label("Job Id:");
     qstatoutput.imbue(std::locale::classic());
     try {
         qstatoutput.exceptions(qstatoutput.failbit);
     } catch (const std::ios::failure &) {
-        fprintf(stderr,
-                "** Warning: Failed to parse job state for job %s "
-                "from file '%s', file unreadable.\n",
-                jobnr_char, qstat_file);
-        return JOB_QUEUE_STATUS_FAILURE;
+        return std::nullopt;
     }
 
     std::string line;
-    int job_id_parser_state = -1;
+    torque_qstat_job *job = nullptr;
+    long jobnr = -1;
     try {
         while (std::getline(qstatoutput, line)) {
             auto pos = line.find(job_id_label);
@@ -788,41 +638,52 @@ job_status_type torque_driver_parse_status(const char *qstat_file,
                 if (dot_position != std::string::npos) {
                     line.replace(dot_position, 1, " ");
                 }
-                std::stringstream(line) >> job_id_parser_state;
+                std::stringstream(line) >> jobnr;
+                job = &jobs[jobnr];
             }
 
-            if ((line.find("job_state") != std::string::npos) &&
-                (job_id_parser_state == jobnr_no_namespace)) {
+            if (job == nullptr)
+                continue;
+
+            if (line.find("job_state") != std::string::npos) {
                 std::string key, equalsign;
                 try {
-                    std::stringstream(line) >> key >> equalsign >> job_state;
+                    std::stringstream(line) >> key >> equalsign >>
+                        job->job_state;
 
                 } catch (const std::ios::failure &) {
                     fprintf(stderr,
-                            "** Warning: Failed to parse job state for job %s "
-                            "from string '%s'.\n",
-                            jobnr_char, line.c_str());
+                            "** Warning: Failed to parse job state for job "
+                            "%ld from string '%s'.\n",
+                            jobnr, line.c_str());
                 }
             }
 
-            if ((line.find("Exit_status") != std::string::npos) &&
-                (job_id_parser_state == jobnr_no_namespace)) {
+            if (line.find("Exit_status") != std::string::npos) {
                 std::string key, equalsign;
                 try {
-                    std::stringstream(line) >> key >> equalsign >> exit_status;
+                    std::stringstream(line) >> key >> equalsign >>
+                        job->exit_status;
 
                 } catch (const std::ios::failure &) {
                     fprintf(stderr,
                             "** Warning: Failed to parse exit status for job "
-                            "%s from string '%s'.\n",
-                            jobnr_char, line.c_str());
+                            "%ld from string '%s'.\n",
+                            jobnr, line.c_str());
                 }
             }
         }
     } catch (const std::ios::failure &) {
         // end-of-file
     }
-    switch (job_state[0]) {
+    return jobs;
+}
+
+static job_status_type
+torque_driver_translate_status(const torque_qstat_job &job,
+                               const char *jobnr_char, const char *source) {
+    job_status_type status = JOB_QUEUE_STATUS_FAILURE;
+    switch (job.job_state[0]) {
     case 'R':
         /* Job is running */
         status = JOB_QUEUE_RUNNING;
@@ -853,40 +714,111 @@ job_status_type torque_driver_parse_status(const char *qstat_file,
         break;
     }
 
-    if (exit_status != 0) {
+    if (job.exit_status != 0) {
         fprintf(stderr,
                 "** Warning: Exit code %d from queue system on job: "
                 "%s, job_state: %s\n",
-                exit_status, jobnr_char, job_state.c_str());
+                job.exit_status, jobnr_char, job.job_state.c_str());
         status = JOB_QUEUE_EXIT;
     }
 
     if (status == JOB_QUEUE_STATUS_FAILURE)
         fprintf(
             stderr,
-            "** Warning: failed to get job status for job:%s from file:%s\n",
-            jobnr_char, qstat_file);
+            "** Warning: failed to get job status for job:%s from %s\n",
+            jobnr_char, source);
 
     return status;
 }
 
+/**
+   Gets the status of the job from "qstat -f" output; source is only used in
+   warnings, e.g. "file:qstat.out".
+*/
+static job_status_type torque_driver_parse_status(std::istream &qstatoutput,
+                                                  const char *jobnr_char,
+                                                  const char *source) {
+    long jobnr_no_namespace = -1;
+    if (jobnr_char != nullptr) {
+        /* Remove namespace from incoming job_id */
+        std::string jobnr_namespaced(jobnr_char);
+        int dot_position = jobnr_namespaced.find(".");
+        if (dot_position != std::string::npos) {
+            jobnr_namespaced.replace(dot_position, 1, " ");
+        }
+        std::stringstream(jobnr_namespaced) >> jobnr_no_namespace;
+    }
+
+    auto jobs = torque_driver_parse_qstat(qstatoutput);
+    if (!jobs) {
+        fprintf(stderr,
+                "** Warning: Failed to parse job state for job %s "
+                "from %s, unreadable.\n",
+                jobnr_char, source);
+        return JOB_QUEUE_STATUS_FAILURE;
+    }
+
+    /* Only the requested job_id is of interest */
+    torque_qstat_job job;
+    if (auto found = jobs->find(jobnr_no_namespace); found != jobs->end())
+        job = found->second;
+
+    return torque_driver_translate_status(job, jobnr_char, source);
+}
+
+job_status_type torque_driver_parse_status(const char *qstat_file,
+                                           const char *jobnr_char) {
+    std::ifstream qstatoutput(qstat_file);
+    auto source = fmt::format("file:{}", qstat_file);
+    return torque_driver_parse_status(qstatoutput, jobnr_char, source.c_str());
+}
+
 job_status_type torque_driver_get_job_status(void *_driver, void *_job) {
     auto driver = static_cast<torque_driver_type *>(_driver);
     auto job = static_cast<torque_job_type *>(_job);
     return torque_driver_get_qstat_status(driver, job->torque_jobnr_char);
 }
 
-void torque_driver_kill_job(void *_driver, void *_job) {
-    constexpr int OUTPUT_FILE_SIZE = 32;
-    char tmp_std_file[OUTPUT_FILE_SIZE];
-    strncpy(tmp_std_file, "/tmp/ert-qdel-std-XXXXXX", OUTPUT_FILE_SIZE);
-    int fd = mkstemp(tmp_std_file);
-    close(fd);
-    char tmp_err_file[OUTPUT_FILE_SIZE];
-    strncpy(tmp_err_file, "/tmp/ert-qdel-err-XXXXXX", OUTPUT_FILE_SIZE);
-    fd = mkstemp(tmp_err_file);
-    close(fd);
+/**
+   Gets the status of all the jobs from one "qstat -f" call without any job
+   id, i.e. the status of all jobs known to the Torque server. Jobs which are
+   not found in the output are queried one by one, as in
+   torque_driver_get_job_status().
+*/
+void torque_driver_get_job_status_batch(void *_driver, void *const *jobs,
+                                        size_t num_jobs,
+                                        job_status_type *status) {
+    auto driver = static_cast<torque_driver_type *>(_driver);
+    std::vector<const char *> argv{"-f"};
+    if (driver->qstat_opts != nullptr && strlen(driver->qstat_opts) > 0)
+        argv.push_back(driver->qstat_opts);
+
+    std::optional<std::unordered_map<long, torque_qstat_job>> qstat_jobs;
+    std::string output;
+    if (torque_driver_run_qstat(driver, argv, output,
+                                fmt::format("{} jobs", num_jobs))) {
+        std::istringstream qstatoutput(output);
+        qstat_jobs = torque_driver_parse_qstat(qstatoutput);
+    }
+
+    for (size_t i = 0; i < num_jobs; i++) {
+        auto job = static_cast<torque_job_type *>(jobs[i]);
+        if (!qstat_jobs) {
+            status[i] = JOB_QUEUE_STATUS_FAILURE;
+            continue;
+        }
 
+        if (auto found = qstat_jobs->find(job->torque_jobnr);
+            found != qstat_jobs->end())
+            status[i] = torque_driver_translate_status(
+                found->second, job->torque_jobnr_char, "qstat output");
+        else
+            status[i] =
+                torque_driver_get_qstat_status(driver, job->torque_jobnr_char);
+    }
+}
+
+void torque_driver_kill_job(void *_driver, void *_job) {
     auto driver = static_cast<torque_driver_type *>(_driver);
     auto job = static_cast<torque_job_type *>(_job);
     logger->debug("Killing Torque job: '{} {}'", driver->qdel_cmd,
@@ -899,9 +831,11 @@ void torque_driver_kill_job(void *_driver, void *_job) {
     int retry_interval = 2; /* seconds */
     int slept_time = 0;
     while ((return_value != 0) && (slept_time <= driver->timeout)) {
-        return_value = spawn_blocking(driver->qdel_cmd, 1,
-                                      (const char **)&job->torque_jobnr_char,
-                                      tmp_std_file, tmp_err_file);
+        auto output =
+            spawn_capture(driver->qdel_cmd, 1,
+                          (const char **)&job->torque_jobnr_char,
+                          driver->command_timeout);
+        return_value = output.status;
         if (return_value != 0) {
             if (slept_time + retry_interval <= driver->timeout) {
                 logger->debug("qdel failed for job {} with exit code "
@@ -914,9 +848,7 @@ void torque_driver_kill_job(void *_driver, void *_job) {
             } else {
                 logger->debug("qdel failed for job {}, no (more) retries",
                               job->torque_jobnr_char);
-                std::string stderr_content;
-                std::getline(std::ifstream(tmp_err_file), stderr_content, '\0');
-                logger->debug("qdel stderr: %s\n", stderr_content);
+                logger->debug("qdel stderr: {}", output.err);
                 break;
             }
         } else {
@@ -937,6 +869,7 @@ void torque_driver_free(torque_driver_type *driver) {
     free(driver->qdel_cmd);
     free(driver->num_cpus_per_node_char);
     free(driver->num_nodes_char);
+    free(driver->command_timeout_char);
     if (driver->job_prefix)
         free(driver->job_prefix);
     if (driver->cluster_label)
@@ -1,4 +1,8 @@
 #include "catch2/catch.hpp"
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
 #include <ert/job_queue/job_list.hpp>
 #include <ert/job_queue/job_node.hpp>
 
@@ -16,3 +20,46 @@ TEST_CASE("job_list_add_job", "[job_list]") {
     REQUIRE(job_queue_node_get_queue_index(node) == 0);
     job_list_free(list);
 }
+
+TEST_CASE("job_list_indices_are_stable", "[job_list]") {
+    auto *list = job_list_alloc();
+    std::vector<job_queue_node_type *> nodes;
+    for (int i = 0; i < 5000; i++) {
+        auto *node = job_queue_node_alloc("name", "/tmp", "ls", 1);
+        job_list_add_job(list, node);
+        nodes.push_back(node);
+    }
+
+    REQUIRE(job_list_get_size(list) == nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        REQUIRE(job_queue_node_get_queue_index(nodes[i]) ==
+                static_cast<int>(i));
+        REQUIRE(job_list_iget_job(list, static_cast<int>(i)) == nodes[i]);
+    }
+    REQUIRE_THROWS_AS(job_list_iget_job(list, 5000), std::out_of_range);
+    REQUIRE_THROWS_AS(job_list_iget_job(list, -1), std::out_of_range);
+    job_list_free(list);
+}
+
+TEST_CASE("job_list_read_while_adding", "[job_list]") {
+    auto *list = job_list_alloc();
+    const int num_nodes = 20000;
+
+    std::thread writer{[list] {
+        for (int i = 0; i < num_nodes; i++)
+            job_list_add_job(list,
+                             job_queue_node_alloc("name", "/tmp", "ls", 1));
+    }};
+
+    size_t size = 0;
+    while (size < num_nodes) {
+        size = job_list_get_size(list);
+        for (size_t i = 0; i < size; i += 97) {
+            auto *node = job_list_iget_job(list, static_cast<int>(i));
+            REQUIRE(job_queue_node_get_queue_index(node) ==
+                    static_cast<int>(i));
+        }
+    }
+    writer.join();
+    job_list_free(list);
+}
@@ -0,0 +1,150 @@
+#include "../tmpdir.hpp"
+#include "catch2/catch.hpp"
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+
+#include <ert/job_queue/local_driver.hpp>
+#include <ert/job_queue/queue_driver.hpp>
+
+static std::string make_job_script(const std::string &name,
+                                   const std::string &content) {
+    std::string fname = std::filesystem::current_path().string() + "/" + name;
+    FILE *stream = fopen(fname.c_str(), "w");
+    REQUIRE(stream != nullptr);
+    fprintf(stream, "#!/bin/sh\n%s\n", content.c_str());
+    fclose(stream);
+    chmod(fname.c_str(), S_IRWXU);
+    return fname;
+}
+
+static job_status_type wait_for_completion(queue_driver_type *driver,
+                                           void *job) {
+    for (int i = 0; i < 500; i++) {
+        auto status = queue_driver_get_status(driver, job);
+        if (status != JOB_QUEUE_RUNNING)
+            return status;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    return queue_driver_get_status(driver, job);
+}
+
+TEST_CASE("job_local_driver_exit_status", "[job_local]") {
+    WITH_TMPDIR;
+    auto driver = queue_driver_alloc(LOCAL_DRIVER);
+    auto cwd = std::filesystem::current_path();
+
+    auto ok_job = queue_driver_submit_job(
+        driver, make_job_script("ok.sh", "exit 0"), 1, cwd, "ok");
+    auto fail_job = queue_driver_submit_job(
+        driver, make_job_script("fail.sh", "exit 1"), 1, cwd, "fail");
+
+    REQUIRE(wait_for_completion(driver, ok_job) == JOB_QUEUE_DONE);
+    REQUIRE(wait_for_completion(driver, fail_job) == JOB_QUEUE_EXIT);
+
+    queue_driver_free_job(driver, ok_job);
+    queue_driver_free_job(driver, fail_job);
+    queue_driver_free(driver);
+}
+
+TEST_CASE("job_local_driver_kill_job", "[job_local]") {
+    WITH_TMPDIR;
+    auto driver = queue_driver_alloc(LOCAL_DRIVER);
+    auto cwd = std::filesystem::current_path();
+
+    auto job = queue_driver_submit_job(
+        driver, make_job_script("sleep.sh", "exec sleep 60"), 1, cwd, "sleep");
+    REQUIRE(queue_driver_get_status(driver, job) == JOB_QUEUE_RUNNING);
+
+    queue_driver_kill_job(driver, job);
+    REQUIRE(wait_for_completion(driver, job) == JOB_QUEUE_EXIT);
+
+    queue_driver_free_job(driver, job);
+    queue_driver_free(driver);
+}
+
+TEST_CASE("job_local_driver_many_jobs", "[job_local]") {
+    WITH_TMPDIR;
+    auto driver = queue_driver_alloc(LOCAL_DRIVER);
+    auto cwd = std::filesystem::current_path();
+    auto script = make_job_script("short.sh", "exit 0");
+
+    std::vector<void *> jobs;
+    for (int i = 0; i < 200; i++)
+        jobs.push_back(queue_driver_submit_job(driver, script, 1, cwd,
+                                               std::to_string(i)));
+
+    for (auto job : jobs)
+        REQUIRE(wait_for_completion(driver, job) == JOB_QUEUE_DONE);
+
+    for (auto job : jobs)
+        queue_driver_free_job(driver, job);
+    queue_driver_free(driver);
+}
+
+TEST_CASE("job_local_driver_free_running_job", "[job_local]") {
+    WITH_TMPDIR;
+    auto driver = queue_driver_alloc(LOCAL_DRIVER);
+    auto cwd = std::filesystem::current_path();
+
+    auto job = queue_driver_submit_job(
+        driver, make_job_script("short.sh", "sleep 0.2"), 1, cwd, "short");
+    // The job is owned by the driver until the child process has completed
+    queue_driver_free_job(driver, job);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    queue_driver_free(driver);
+}
+
+TEST_CASE("job_local_driver_free_driver_leaves_running_jobs", "[job_local]") {
+    WITH_TMPDIR;
+    auto driver = local_driver_alloc();
+    auto cwd = std::filesystem::current_path();
+
+    auto job = local_driver_submit_job(
+        driver,
+        make_job_script("sleep.sh", "echo $$ > pid\nsleep 0.5\ntouch done"),
+        1, cwd, "sleep");
+    pid_t pid = 0;
+    for (int i = 0; i < 100 && pid == 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        std::ifstream{"pid"} >> pid;
+    }
+    REQUIRE(pid > 0);
+
+    // The child runs on after the driver is freed, and is still reaped
+    local_driver_free_(driver);
+    REQUIRE(local_driver_get_job_status(nullptr, job) == JOB_QUEUE_RUNNING);
+    for (int i = 0; i < 250; i++) {
+        if (local_driver_get_job_status(nullptr, job) != JOB_QUEUE_RUNNING)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    REQUIRE(local_driver_get_job_status(nullptr, job) == JOB_QUEUE_DONE);
+    REQUIRE(std::filesystem::exists("done"));
+    // Not even a zombie is left
+    REQUIRE(kill(pid, 0) == -1);
+    REQUIRE(errno == ESRCH);
+
+    local_driver_free_job(job);
+}
+
+TEST_CASE("job_local_driver_free_job_after_driver", "[job_local]") {
+    WITH_TMPDIR;
+    auto driver = local_driver_alloc();
+    auto cwd = std::filesystem::current_path();
+
+    auto job = local_driver_submit_job(
+        driver, make_job_script("short.sh", "sleep 0.2"), 1, cwd, "short");
+    // The job is owned by the reaper, which outlives the driver until the
+    // child process has completed
+    local_driver_free_(driver);
+    local_driver_free_job(job);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+}
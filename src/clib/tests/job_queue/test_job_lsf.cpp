@@ -30,6 +30,19 @@ TEST_CASE("job_lsf_test_options", "[job_lsf]") {
     test_option(driver, LSF_BSUB_CMD, "bsub");
     test_option(driver, LSF_PROJECT_CODE, "my-ppu");
     test_option(driver, LSF_BJOBS_TIMEOUT, "1234");
+    test_option(driver, LSF_COMMAND_TIMEOUT, "2.5");
+    test_option(driver, LSF_BJOBS_JSON, "True");
+    REQUIRE_FALSE(lsf_driver_set_option(driver, LSF_BJOBS_JSON, "maybe"));
+    test_option(driver, LSF_ARRAY_SUBMIT, "True");
+    REQUIRE(get_option(driver, LSF_PERSISTENT_SHELL) == "False");
+    test_option(driver, LSF_PERSISTENT_SHELL, "True");
+    REQUIRE_FALSE(lsf_driver_set_option(driver, LSF_COMMAND_TIMEOUT, "0"));
+    test_option(driver, LSF_SUBMIT_WORKERS, "8");
+    test_option(driver, LSF_SUBMIT_RATE, "2.5");
+    test_option(driver, LSF_SUBMIT_BURST, "10");
+    REQUIRE_FALSE(lsf_driver_set_option(driver, LSF_SUBMIT_WORKERS, "0"));
+    REQUIRE_FALSE(lsf_driver_set_option(driver, LSF_SUBMIT_RATE, "-1"));
+    REQUIRE_FALSE(lsf_driver_set_option(driver, LSF_SUBMIT_BURST, "0"));
 
     REQUIRE(lsf_driver_has_project_code(driver));
 
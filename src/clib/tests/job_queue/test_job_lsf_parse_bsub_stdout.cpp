@@ -22,3 +22,11 @@ TEST_CASE("job_lsf_parse_bsub_status_ok", "[job_lsf_parse_bsub_stdout]") {
 TEST_CASE("job_lsf_parse_bsub_no_file", "[job_lsf_parse_bsub_stdout]") {
     REQUIRE(lsf_job_parse_bsub_stdout("bsub", "does/not/exist") == -1);
 }
+
+TEST_CASE("job_lsf_parse_bsub_output", "[job_lsf_parse_bsub_stdout]") {
+    REQUIRE(lsf_job_parse_bsub_output(
+                "bsub", "Job <12345> is submitted to queue <normal>.\n") ==
+            12345);
+    REQUIRE(lsf_job_parse_bsub_output("bsub", "") == -1);
+    REQUIRE(lsf_job_parse_bsub_output("bsub", "Job <abc> failed") == -1);
+}
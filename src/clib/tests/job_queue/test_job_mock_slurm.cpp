@@ -1,9 +1,15 @@
 #include "../tmpdir.hpp"
 #include "catch2/catch.hpp"
+#include <algorithm>
+#include <chrono>
 #include <filesystem>
+#include <fstream>
+#include <string>
 #include <sys/stat.h>
+#include <thread>
 #include <vector>
 
+#include <ert/job_queue/job_queue.hpp>
 #include <ert/job_queue/queue_driver.hpp>
 #include <ert/job_queue/slurm_driver.hpp>
 
@@ -221,3 +227,523 @@ TEST_CASE("job_mock_slurm_run", "[job_slurm]") {
 
     queue_driver_free(driver);
 }
+
+TEST_CASE("job_mock_slurm_get_status_batch", "[job_slurm]") {
+    TmpDir tmpdir; // cwd is now a generated tmpdir
+    queue_driver_type *driver = queue_driver_alloc(SLURM_DRIVER);
+
+    std::string cwd = tmpdir.get_current_tmpdir();
+    std::string cmd_path = cwd + "/cmd.sh";
+    const char *cmd = cmd_path.c_str();
+
+    std::vector<void *> jobs;
+    make_sleep_job(cmd, 10);
+    make_slurm_commands(driver);
+
+    for (const auto *job_name : {"1", "2", "3", "4"}) {
+        auto job = submit_job(driver, cwd, job_name, cmd);
+        REQUIRE_FALSE(job == nullptr);
+        jobs.push_back(job);
+    }
+
+    std::vector<job_status_type> status(jobs.size());
+    queue_driver_get_status_batch(driver, jobs.data(), jobs.size(),
+                                  status.data());
+    REQUIRE(status[0] == JOB_QUEUE_IS_KILLED);
+    REQUIRE(status[1] == JOB_QUEUE_PENDING);
+    REQUIRE(status[2] == JOB_QUEUE_RUNNING);
+    REQUIRE(status[3] == JOB_QUEUE_DONE);
+
+    for (size_t i = 0; i < jobs.size(); i++)
+        REQUIRE(queue_driver_get_status(driver, jobs[i]) == status[i]);
+
+    for (auto job : jobs)
+        queue_driver_free_job(driver, job);
+
+    queue_driver_free(driver);
+}
+
+TEST_CASE("job_mock_slurm_sacct", "[job_slurm]") {
+    TmpDir tmpdir; // cwd is now a generated tmpdir
+    queue_driver_type *driver = queue_driver_alloc(SLURM_DRIVER);
+
+    std::string cwd = tmpdir.get_current_tmpdir();
+    std::string cmd_path = cwd + "/cmd.sh";
+    const char *cmd = cmd_path.c_str();
+
+    make_sleep_job(cmd, 10);
+    make_slurm_commands(driver);
+    // The jobs which have fallen out of squeue are all resolved with one
+    // sacct call, so scontrol is not needed
+    install_script(driver, SLURM_SCONTROL_OPTION, "#!/bin/sh\nexit 1\n");
+    install_script(driver, SLURM_SACCT_OPTION, R"(#!/bin/sh
+echo "$@" >> sacct-calls
+echo "1|CANCELLED by 1000|0:15"
+echo "1.batch|CANCELLED|0:15"
+echo "4|COMPLETED|0:0|4|00:05:00||node7|2023-05-01T10:00:00|2023-05-01T10:00:20"
+echo "4.batch|COMPLETED|0:0|batch|00:05:00|2048K|node7"
+)");
+
+    std::vector<void *> jobs;
+    for (const auto *job_name : {"1", "2", "3", "4"}) {
+        auto job = submit_job(driver, cwd, job_name, cmd);
+        REQUIRE_FALSE(job == nullptr);
+        jobs.push_back(job);
+    }
+
+    std::vector<job_status_type> status(jobs.size());
+    queue_driver_get_status_batch(driver, jobs.data(), jobs.size(),
+                                  status.data());
+    REQUIRE(status[0] == JOB_QUEUE_IS_KILLED);
+    REQUIRE(status[1] == JOB_QUEUE_PENDING);
+    REQUIRE(status[2] == JOB_QUEUE_RUNNING);
+    REQUIRE(status[3] == JOB_QUEUE_DONE);
+
+    std::ifstream calls{"sacct-calls"};
+    std::string call;
+    REQUIRE(std::getline(calls, call));
+    REQUIRE(call.rfind("-j 1,4 ", 0) == 0);
+    REQUIRE_FALSE(std::getline(calls, call));
+
+    // The accounting is recorded for the jobs which sacct has listed
+    queue_driver_job_accounting accounting;
+    REQUIRE(queue_driver_get_accounting(driver, jobs[3], &accounting));
+    REQUIRE(accounting.exit_code == 0);
+    REQUIRE(accounting.elapsed == 300.0);
+    REQUIRE(accounting.max_rss == 2048 * 1024);
+    REQUIRE(accounting.node_list == "node7");
+    REQUIRE(accounting.pending_time == 20.0);
+    REQUIRE_FALSE(queue_driver_get_accounting(driver, jobs[2], &accounting));
+
+    for (auto job : jobs)
+        queue_driver_free_job(driver, job);
+
+    queue_driver_free(driver);
+}
+
+TEST_CASE("job_mock_slurm_submit_batch_one_by_one", "[job_slurm]") {
+    TmpDir tmpdir; // cwd is now a generated tmpdir
+    queue_driver_type *driver = queue_driver_alloc(SLURM_DRIVER);
+
+    std::string cwd = tmpdir.get_current_tmpdir();
+    std::string cmd = cwd + "/cmd.sh";
+    make_sleep_job(cmd.c_str(), 10);
+    make_slurm_commands(driver);
+
+    // Without ARRAY_SUBMIT the jobs are submitted with one sbatch call each
+    std::vector<queue_driver_submit_args> args;
+    for (const auto *job_name : {"0", "1", "2", "3", "4"}) {
+        std::filesystem::create_directory(cwd + "/" + job_name);
+        args.push_back({cmd, 1, cwd + "/" + job_name, job_name});
+    }
+    std::vector<void *> jobs(args.size());
+    queue_driver_submit_job_batch(driver, args.data(), args.size(),
+                                  jobs.data());
+    REQUIRE(jobs[0] == nullptr);
+    for (size_t i = 1; i < jobs.size(); i++)
+        REQUIRE_FALSE(jobs[i] == nullptr);
+
+    REQUIRE(queue_driver_get_status(driver, jobs[2]) == JOB_QUEUE_PENDING);
+    REQUIRE(queue_driver_get_status(driver, jobs[3]) == JOB_QUEUE_RUNNING);
+
+    for (size_t i = 1; i < jobs.size(); i++)
+        queue_driver_free_job(driver, jobs[i]);
+    queue_driver_free(driver);
+}
+
+TEST_CASE("job_mock_slurm_submit_array", "[job_slurm]") {
+    TmpDir tmpdir; // cwd is now a generated tmpdir
+    queue_driver_type *driver = queue_driver_alloc(SLURM_DRIVER);
+    REQUIRE(queue_driver_set_option(driver, SLURM_ARRAY_SUBMIT_OPTION, "True"));
+    REQUIRE(queue_driver_set_option(driver, SLURM_MEMORY_OPTION, "1G"));
+
+    std::string cwd = tmpdir.get_current_tmpdir();
+    std::string cmd = cwd + "/cmd.sh";
+    std::string other_cmd = cwd + "/other_cmd.sh";
+    make_sleep_job(cmd.c_str(), 10);
+    make_sleep_job(other_cmd.c_str(), 10);
+
+    // sbatch answers 7 for the array and 8 for the job on its own, and keeps
+    // the submit scripts, which it reads from stdin
+    install_script(driver, SLURM_SBATCH_OPTION, R"(#!/bin/sh
+echo "$@" >> sbatch-calls
+case "$*" in
+*--array=*) cat > array-script; echo 7 ;;
+*) cat > job-script; echo 8 ;;
+esac
+)");
+    install_script(driver, SLURM_SQUEUE_OPTION, R"(#!/bin/sh
+echo "7_0 RUNNING"
+echo "7_1 PENDING"
+echo "8 RUNNING"
+)");
+    install_script(driver, SLURM_SACCT_OPTION, R"(#!/bin/sh
+echo "7_2|COMPLETED|0:0"
+)");
+    install_script(driver, SLURM_SCANCEL_OPTION, R"(#!/bin/sh
+echo "$@" >> scancel-calls
+)");
+
+    std::vector<queue_driver_submit_args> args;
+    for (const auto *job_name : {"0", "1", "2", "3"}) {
+        std::filesystem::create_directory(cwd + "/" + job_name);
+        args.push_back({job_name == std::string("2") ? other_cmd : cmd, 1,
+                        cwd + "/" + job_name, job_name});
+    }
+    std::vector<void *> jobs(args.size());
+    queue_driver_submit_job_batch(driver, args.data(), args.size(),
+                                  jobs.data());
+    for (auto job : jobs)
+        REQUIRE_FALSE(job == nullptr);
+
+    // The jobs 0, 1 and 3 share the command and are the tasks 0, 1 and 2 of
+    // array job 7, while job 2 is submitted on its own
+    std::ifstream sbatch_calls{"sbatch-calls"};
+    std::vector<std::string> calls;
+    for (std::string call; std::getline(sbatch_calls, call);)
+        calls.push_back(call);
+    REQUIRE(calls.size() == 2);
+    REQUIRE(calls[0].find("--array=0-2") != std::string::npos);
+    REQUIRE(calls[1].find("--array") == std::string::npos);
+
+    std::ifstream array_script{"array-script"};
+    std::string script{std::istreambuf_iterator<char>(array_script),
+                       std::istreambuf_iterator<char>()};
+    REQUIRE(script.find("2) cd '" + cwd + "/3' && exec '" + cmd + "' '" + cwd +
+                        "/3' >'3.stdout' 2>'3.stderr' ;;") !=
+            std::string::npos);
+    REQUIRE(script.find("#SBATCH --mem=1G\n") != std::string::npos);
+
+    std::ifstream job_script{"job-script"};
+    script = {std::istreambuf_iterator<char>(job_script),
+              std::istreambuf_iterator<char>()};
+    REQUIRE(script.find("#SBATCH --output=2.stdout\n") != std::string::npos);
+    REQUIRE(script.find("#SBATCH --mem=1G\n") != std::string::npos);
+    REQUIRE(script.find(other_cmd + " " + cwd + "/2\n") != std::string::npos);
+
+    std::vector<job_status_type> status(jobs.size());
+    queue_driver_get_status_batch(driver, jobs.data(), jobs.size(),
+                                  status.data());
+    REQUIRE(status[0] == JOB_QUEUE_RUNNING);
+    REQUIRE(status[1] == JOB_QUEUE_PENDING);
+    REQUIRE(status[2] == JOB_QUEUE_RUNNING);
+    REQUIRE(status[3] == JOB_QUEUE_DONE);
+
+    queue_driver_kill_job(driver, jobs[1]);
+    std::ifstream scancel_calls{"scancel-calls"};
+    std::string killed;
+    REQUIRE(std::getline(scancel_calls, killed));
+    REQUIRE(killed == "7_1");
+
+    for (auto job : jobs)
+        queue_driver_free_job(driver, job);
+    queue_driver_free(driver);
+}
+
+TEST_CASE("job_mock_slurm_engine_submits_array", "[job_slurm]") {
+    TmpDir tmpdir; // cwd is now a generated tmpdir
+    queue_driver_type *driver = queue_driver_alloc(SLURM_DRIVER);
+    REQUIRE(queue_driver_set_option(driver, SLURM_ARRAY_SUBMIT_OPTION, "True"));
+    auto queue = job_queue_alloc(driver);
+
+    std::string cwd = tmpdir.get_current_tmpdir();
+    std::string cmd = cwd + "/cmd.sh";
+    make_sleep_job(cmd.c_str(), 10);
+    install_script(driver, SLURM_SBATCH_OPTION, R"(#!/bin/sh
+echo "$@" >> sbatch-calls
+cat > /dev/null
+echo 7
+)");
+    install_script(driver, SLURM_SQUEUE_OPTION, R"(#!/bin/sh
+echo "7_0 RUNNING"
+echo "7_1 RUNNING"
+echo "7_2 PENDING"
+)");
+    install_script(driver, SLURM_SCANCEL_OPTION, "#!/bin/sh\n");
+
+    // The nodes which the queue submits together reach the driver as one
+    // batch, and are submitted as one array
+    std::vector<job_queue_node_type *> nodes;
+    for (const auto *job_name : {"0", "1", "2"}) {
+        std::filesystem::create_directory(cwd + "/" + job_name);
+        auto node = job_queue_node_alloc(
+            job_name, (cwd + "/" + job_name).c_str(), cmd.c_str(), 1);
+        job_queue_add_job_node(queue, node);
+        nodes.push_back(node);
+    }
+    job_queue_engine_start(queue, 2);
+    job_queue_engine_submit_many(queue, nodes);
+
+    std::vector<bool> submitted(nodes.size(), false);
+    for (int i = 0; i < 100; i++) {
+        for (auto &transition : job_queue_engine_get_transitions(queue))
+            if (transition.status & (JOB_QUEUE_PENDING + JOB_QUEUE_RUNNING))
+                submitted[transition.queue_index] = true;
+        if (std::all_of(submitted.begin(), submitted.end(),
+                        [](bool s) { return s; }))
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    REQUIRE(job_queue_node_get_status(nodes[0]) == JOB_QUEUE_RUNNING);
+    REQUIRE(job_queue_node_get_status(nodes[2]) == JOB_QUEUE_PENDING);
+
+    std::ifstream sbatch_calls{"sbatch-calls"};
+    std::vector<std::string> calls;
+    for (std::string call; std::getline(sbatch_calls, call);)
+        calls.push_back(call);
+    REQUIRE(calls.size() == 1);
+    REQUIRE(calls[0].find("--array=0-2") != std::string::npos);
+
+    job_queue_engine_stop(queue);
+    job_queue_free(queue);
+    queue_driver_free(driver);
+}
+
+TEST_CASE("job_mock_slurm_submit_pack", "[job_slurm]") {
+    TmpDir tmpdir; // cwd is now a generated tmpdir
+    queue_driver_type *driver = queue_driver_alloc(SLURM_DRIVER);
+    REQUIRE(queue_driver_set_option(driver, SLURM_PACK_SIZE_OPTION, "3"));
+
+    std::string cwd = tmpdir.get_current_tmpdir();
+    std::string cmd = cwd + "/cmd.sh";
+    make_sleep_job(cmd.c_str(), 10);
+
+    // The realizations 0-2 are packed into allocation 7 and 3-4 into
+    // allocation 8, which is still pending. In allocation 7 the step of
+    // realization 1 has not started yet.
+    install_script(driver, SLURM_SBATCH_OPTION, R"(#!/bin/sh
+if [ -e pack-7 ]; then cat > pack-8; echo 8; else cat > pack-7; echo 7; fi
+)");
+    install_script(driver, SLURM_SQUEUE_OPTION, R"(#!/bin/sh
+echo "7 RUNNING"
+echo "8 PENDING"
+)");
+    install_script(driver, SLURM_SACCT_OPTION, R"(#!/bin/sh
+echo "$@" >> sacct-calls
+echo "7|RUNNING|0:0|0"
+echo "7.batch|RUNNING|0:0|batch"
+echo "7.0|RUNNING|0:0|pack2"
+echo "7.1|COMPLETED|0:0|pack0"
+)");
+    install_script(driver, SLURM_SCANCEL_OPTION, R"(#!/bin/sh
+echo "$@" >> scancel-calls
+)");
+
+    std::vector<queue_driver_submit_args> args;
+    for (const auto *job_name : {"0", "1", "2", "3", "4"}) {
+        std::filesystem::create_directory(cwd + "/" + job_name);
+        args.push_back({cmd, 1, cwd + "/" + job_name, job_name});
+    }
+    std::vector<void *> jobs(args.size());
+    queue_driver_submit_job_batch(driver, args.data(), args.size(),
+                                  jobs.data());
+    for (auto job : jobs)
+        REQUIRE_FALSE(job == nullptr);
+
+    std::ifstream pack_script{"pack-7"};
+    std::string script{std::istreambuf_iterator<char>(pack_script),
+                       std::istreambuf_iterator<char>()};
+    REQUIRE(script.find("#SBATCH --ntasks=3\n") != std::string::npos);
+    REQUIRE(script.find("(cd '" + cwd + "/1' && exec srun --exclusive "
+                        "--ntasks=1 --job-name=pack1 '" + cmd + "' '" + cwd +
+                        "/1' >'1.stdout' 2>'1.stderr') &\n") !=
+            std::string::npos);
+    REQUIRE(script.find("wait\n") != std::string::npos);
+
+    std::vector<job_status_type> status(jobs.size());
+    queue_driver_get_status_batch(driver, jobs.data(), jobs.size(),
+                                  status.data());
+    REQUIRE(status[0] == JOB_QUEUE_DONE);
+    REQUIRE(status[1] == JOB_QUEUE_PENDING);
+    REQUIRE(status[2] == JOB_QUEUE_RUNNING);
+    REQUIRE(status[3] == JOB_QUEUE_PENDING);
+    REQUIRE(status[4] == JOB_QUEUE_PENDING);
+
+    // Only the running allocation is given to sacct
+    std::ifstream sacct_calls{"sacct-calls"};
+    std::string call;
+    REQUIRE(std::getline(sacct_calls, call));
+    REQUIRE(call.rfind("-j 7 ", 0) == 0);
+
+    // A started step is cancelled by its step id, and a pack which is killed
+    // before it has started is cancelled as a whole
+    queue_driver_kill_job(driver, jobs[2]);
+    queue_driver_kill_job(driver, jobs[3]);
+    queue_driver_kill_job(driver, jobs[4]);
+    std::ifstream scancel_calls{"scancel-calls"};
+    std::vector<std::string> killed;
+    for (std::string line; std::getline(scancel_calls, line);)
+        killed.push_back(line);
+    REQUIRE(killed == std::vector<std::string>{"7.0", "8"});
+
+    for (auto job : jobs)
+        queue_driver_free_job(driver, job);
+    queue_driver_free(driver);
+}
+
+TEST_CASE("job_mock_slurm_engine_submits_pack", "[job_slurm]") {
+    TmpDir tmpdir; // cwd is now a generated tmpdir
+    queue_driver_type *driver = queue_driver_alloc(SLURM_DRIVER);
+    REQUIRE(queue_driver_set_option(driver, SLURM_PACK_SIZE_OPTION, "3"));
+    auto queue = job_queue_alloc(driver);
+
+    std::string cwd = tmpdir.get_current_tmpdir();
+    std::string cmd = cwd + "/cmd.sh";
+    make_sleep_job(cmd.c_str(), 10);
+    install_script(driver, SLURM_SBATCH_OPTION, R"(#!/bin/sh
+cat >> sbatch-scripts
+echo 7
+)");
+    install_script(driver, SLURM_SQUEUE_OPTION, R"(#!/bin/sh
+echo "7 PENDING"
+)");
+    install_script(driver, SLURM_SCANCEL_OPTION, "#!/bin/sh\n");
+
+    // The nodes which the queue submits together are packed into one
+    // allocation
+    std::vector<job_queue_node_type *> nodes;
+    for (const auto *job_name : {"0", "1", "2"}) {
+        std::filesystem::create_directory(cwd + "/" + job_name);
+        auto node = job_queue_node_alloc(
+            job_name, (cwd + "/" + job_name).c_str(), cmd.c_str(), 1);
+        job_queue_add_job_node(queue, node);
+        nodes.push_back(node);
+    }
+    job_queue_engine_start(queue, 2);
+    job_queue_engine_submit_many(queue, nodes);
+
+    std::vector<bool> pending(nodes.size(), false);
+    for (int i = 0; i < 100; i++) {
+        for (auto &transition : job_queue_engine_get_transitions(queue))
+            if (transition.status == JOB_QUEUE_PENDING)
+                pending[transition.queue_index] = true;
+        if (std::all_of(pending.begin(), pending.end(),
+                        [](bool p) { return p; }))
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    for (auto node : nodes)
+        REQUIRE(job_queue_node_get_status(node) == JOB_QUEUE_PENDING);
+
+    std::ifstream sbatch_scripts{"sbatch-scripts"};
+    std::string scripts{std::istreambuf_iterator<char>(sbatch_scripts),
+                        std::istreambuf_iterator<char>()};
+    REQUIRE(scripts.find("#SBATCH --ntasks=3\n") != std::string::npos);
+    // One sbatch call, i.e. one submit script, for the whole pack
+    REQUIRE(scripts.find("#!", 1) == std::string::npos);
+
+    job_queue_engine_stop(queue);
+    job_queue_free(queue);
+    queue_driver_free(driver);
+}
+
+TEST_CASE("job_mock_slurm_one_squeue_per_interval", "[job_slurm]") {
+    TmpDir tmpdir; // cwd is now a generated tmpdir
+    queue_driver_type *driver = queue_driver_alloc(SLURM_DRIVER);
+
+    std::string cwd = tmpdir.get_current_tmpdir();
+    std::string cmd_path = cwd + "/cmd.sh";
+    const char *cmd = cmd_path.c_str();
+
+    make_sleep_job(cmd, 10);
+    make_slurm_commands(driver);
+    install_script(driver, SLURM_SQUEUE_OPTION, R"(#!/bin/sh
+echo "$@" >> squeue-calls
+echo "2 PENDING"
+echo "3 RUNNING"
+)");
+    REQUIRE(queue_driver_set_option(driver, SLURM_SQUEUE_TIMEOUT_OPTION, "60"));
+
+    std::vector<void *> jobs;
+    for (const auto *job_name : {"2", "3"}) {
+        auto job = submit_job(driver, cwd, job_name, cmd);
+        REQUIRE_FALSE(job == nullptr);
+        jobs.push_back(job);
+    }
+
+    // All the threads read the status from the first snapshot
+    std::vector<std::thread> threads;
+    std::vector<int> failures(8, 0);
+    for (int t = 0; t < 8; t++)
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < 100; i++) {
+                if (queue_driver_get_status(driver, jobs[0]) !=
+                        JOB_QUEUE_PENDING ||
+                    queue_driver_get_status(driver, jobs[1]) !=
+                        JOB_QUEUE_RUNNING)
+                    failures[t]++;
+            }
+        });
+    for (auto &thread : threads)
+        thread.join();
+    for (int failed : failures)
+        REQUIRE(failed == 0);
+
+    // squeue is only asked for the jobs of the driver in the active states
+    std::ifstream calls{"squeue-calls"};
+    std::string call;
+    REQUIRE(std::getline(calls, call));
+    REQUIRE(call.find(" --jobs=2,3") != std::string::npos);
+    REQUIRE(call.find(" --states=PENDING,RUNNING,") != std::string::npos);
+    REQUIRE_FALSE(std::getline(calls, call));
+
+    for (auto job : jobs)
+        queue_driver_free_job(driver, job);
+    queue_driver_free(driver);
+}
+
+TEST_CASE("job_mock_slurm_squeue_iterate", "[job_slurm]") {
+    TmpDir tmpdir; // cwd is now a generated tmpdir
+    queue_driver_type *driver = queue_driver_alloc(SLURM_DRIVER);
+
+    std::string cwd = tmpdir.get_current_tmpdir();
+    std::string cmd_path = cwd + "/cmd.sh";
+    const char *cmd = cmd_path.c_str();
+
+    make_sleep_job(cmd, 10);
+    make_slurm_commands(driver);
+    // The squeue command lists the jobs twice, and then exits to show that
+    // it is restarted
+    install_script(driver, SLURM_SQUEUE_OPTION, R"(#!/bin/sh
+echo "$@" >> squeue-starts
+for i in 1 2; do
+    echo "2 PENDING"
+    echo "3 RUNNING"
+    echo
+    sleep 0.2
+done
+)");
+    install_script(driver, SLURM_SACCT_OPTION, R"(#!/bin/sh
+echo "1|CANCELLED by 1000|0:15"
+)");
+    REQUIRE(queue_driver_set_option(driver, SLURM_SQUEUE_ITERATE_OPTION,
+                                    "True"));
+    REQUIRE(queue_driver_set_option(driver, SLURM_SQUEUE_TIMEOUT_OPTION, "1"));
+
+    std::vector<void *> jobs;
+    for (const auto *job_name : {"1", "2", "3"}) {
+        auto job = submit_job(driver, cwd, job_name, cmd);
+        REQUIRE_FALSE(job == nullptr);
+        jobs.push_back(job);
+    }
+
+    REQUIRE(queue_driver_get_status(driver, jobs[0]) == JOB_QUEUE_IS_KILLED);
+    REQUIRE(queue_driver_get_status(driver, jobs[1]) == JOB_QUEUE_PENDING);
+    REQUIRE(queue_driver_get_status(driver, jobs[2]) == JOB_QUEUE_RUNNING);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(2500));
+    REQUIRE(queue_driver_get_status(driver, jobs[1]) == JOB_QUEUE_PENDING);
+    REQUIRE(queue_driver_get_status(driver, jobs[2]) == JOB_QUEUE_RUNNING);
+
+    std::ifstream starts{"squeue-starts"};
+    std::vector<std::string> calls;
+    for (std::string call; std::getline(starts, call);)
+        calls.push_back(call);
+    REQUIRE(calls.size() >= 2);
+    for (const auto &call : calls)
+        REQUIRE(call.find("--iterate=1") != std::string::npos);
+
+    for (auto job : jobs)
+        queue_driver_free_job(driver, job);
+    queue_driver_free(driver);
+}
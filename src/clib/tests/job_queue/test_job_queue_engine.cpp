@@ -0,0 +1,134 @@
+#include "../tmpdir.hpp"
+#include "catch2/catch.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+
+#include <ert/job_queue/job_queue.hpp>
+
+static std::string make_job_script(const std::string &name,
+                                   const std::string &content) {
+    std::string fname = std::filesystem::current_path().string() + "/" + name;
+    FILE *stream = fopen(fname.c_str(), "w");
+    REQUIRE(stream != nullptr);
+    fprintf(stream, "#!/bin/sh\n%s\n", content.c_str());
+    fclose(stream);
+    chmod(fname.c_str(), S_IRWXU);
+    return fname;
+}
+
+/** Collects transitions until every node has reached one of the statuses. */
+static std::vector<job_queue_transition>
+wait_for_transitions(job_queue_type *queue, size_t num_nodes, int statuses) {
+    std::vector<job_queue_transition> transitions;
+    std::vector<bool> reached(num_nodes, false);
+    for (int i = 0; i < 100; i++) {
+        for (auto &transition : job_queue_engine_get_transitions(queue)) {
+            if (transition.status & statuses)
+                reached[transition.queue_index] = true;
+            transitions.push_back(transition);
+        }
+        if (std::all_of(reached.begin(), reached.end(),
+                        [](bool r) { return r; }))
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    return transitions;
+}
+
+TEST_CASE("job_queue_engine_runs_jobs_to_completion", "[job_queue_engine]") {
+    WITH_TMPDIR;
+    auto driver = queue_driver_alloc(LOCAL_DRIVER);
+    auto queue = job_queue_alloc(driver);
+    auto cwd = std::filesystem::current_path().string();
+    auto ok_script = make_job_script("ok.sh", "exit 0");
+    auto fail_script = make_job_script("fail.sh", "exit 1");
+
+    std::vector<job_queue_node_type *> nodes;
+    for (int i = 0; i < 10; i++) {
+        auto node = job_queue_node_alloc(
+            std::to_string(i).c_str(), cwd.c_str(),
+            (i % 2 == 0 ? ok_script : fail_script).c_str(), 1);
+        job_queue_add_job_node(queue, node);
+        nodes.push_back(node);
+    }
+
+    job_queue_engine_start(queue, 2);
+    for (auto node : nodes)
+        job_queue_engine_submit(queue, node);
+
+    auto transitions = wait_for_transitions(queue, nodes.size(),
+                                             JOB_QUEUE_DONE + JOB_QUEUE_EXIT);
+    for (size_t i = 0; i < nodes.size(); i++) {
+        auto expected = i % 2 == 0 ? JOB_QUEUE_DONE : JOB_QUEUE_EXIT;
+        REQUIRE(job_queue_node_get_status(nodes[i]) == expected);
+    }
+    REQUIRE(std::any_of(transitions.begin(), transitions.end(), [](auto &t) {
+        return t.queue_index == 0 && t.status == JOB_QUEUE_SUBMITTED;
+    }));
+
+    // Once the jobs have completed they are not polled, and there are no more
+    // transitions
+    std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+    REQUIRE(job_queue_engine_get_transitions(queue).empty());
+
+    job_queue_engine_stop(queue);
+    job_queue_free(queue);
+    queue_driver_free(driver);
+}
+
+TEST_CASE("job_queue_engine_kill", "[job_queue_engine]") {
+    WITH_TMPDIR;
+    auto driver = queue_driver_alloc(LOCAL_DRIVER);
+    auto queue = job_queue_alloc(driver);
+    auto cwd = std::filesystem::current_path().string();
+    auto script = make_job_script("sleep.sh", "exec sleep 60");
+
+    auto node = job_queue_node_alloc("sleep", cwd.c_str(), script.c_str(), 1);
+    job_queue_add_job_node(queue, node);
+
+    job_queue_engine_start(queue, 1);
+    job_queue_engine_submit(queue, node);
+    wait_for_transitions(queue, 1, JOB_QUEUE_RUNNING);
+    REQUIRE(job_queue_node_get_status(node) == JOB_QUEUE_RUNNING);
+
+    job_queue_engine_kill(queue, node);
+    auto transitions = wait_for_transitions(queue, 1, JOB_QUEUE_IS_KILLED);
+    REQUIRE(transitions.back().status == JOB_QUEUE_IS_KILLED);
+
+    // The queue stops the engine when it is freed
+    job_queue_free(queue);
+    queue_driver_free(driver);
+}
+
+TEST_CASE("job_queue_engine_submit_many", "[job_queue_engine]") {
+    WITH_TMPDIR;
+    auto driver = queue_driver_alloc(LOCAL_DRIVER);
+    auto queue = job_queue_alloc(driver);
+    auto cwd = std::filesystem::current_path().string();
+    auto script = make_job_script("ok.sh", "exit 0");
+
+    std::vector<job_queue_node_type *> nodes;
+    for (int i = 0; i < 5; i++) {
+        auto node = job_queue_node_alloc(std::to_string(i).c_str(),
+                                         cwd.c_str(), script.c_str(), 1);
+        job_queue_add_job_node(queue, node);
+        nodes.push_back(node);
+    }
+
+    job_queue_engine_start(queue, 2);
+    job_queue_engine_submit_many(queue, nodes);
+    wait_for_transitions(queue, nodes.size(), JOB_QUEUE_DONE);
+    for (auto node : nodes) {
+        REQUIRE(job_queue_node_get_status(node) == JOB_QUEUE_DONE);
+        REQUIRE(node->submit_attempt == 1);
+    }
+
+    job_queue_free(queue);
+    queue_driver_free(driver);
+}
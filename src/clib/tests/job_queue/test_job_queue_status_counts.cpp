@@ -0,0 +1,62 @@
+#include "catch2/catch.hpp"
+#include <thread>
+#include <vector>
+
+#include <ert/job_queue/job_queue.hpp>
+
+TEST_CASE("job_queue_counts_nodes_by_status", "[job_queue]") {
+    auto driver = queue_driver_alloc(LOCAL_DRIVER);
+    auto queue = job_queue_alloc(driver);
+    std::vector<job_queue_node_type *> nodes;
+    for (int i = 0; i < 10; i++) {
+        nodes.push_back(job_queue_node_alloc("name", "/tmp", "ls", 1));
+        job_queue_add_job_node(queue, nodes.back());
+    }
+
+    auto counts = job_queue_get_status_counts(queue);
+    REQUIRE(counts[job_status_index(JOB_QUEUE_WAITING)] == 10);
+    REQUIRE(counts[job_status_index(JOB_QUEUE_NOT_ACTIVE)] == 0);
+
+    for (int i = 0; i < 3; i++)
+        job_queue_node_set_status(nodes[i], JOB_QUEUE_RUNNING);
+    job_queue_node_set_status(nodes[0], JOB_QUEUE_SUCCESS);
+
+    counts = job_queue_get_status_counts(queue);
+    REQUIRE(counts[job_status_index(JOB_QUEUE_WAITING)] == 7);
+    REQUIRE(counts[job_status_index(JOB_QUEUE_RUNNING)] == 2);
+    REQUIRE(counts[job_status_index(JOB_QUEUE_SUCCESS)] == 1);
+    REQUIRE(job_status_index(JOB_QUEUE_UNKNOWN) == JOB_QUEUE_MAX_STATE - 1);
+
+    job_queue_free(queue);
+    queue_driver_free(driver);
+}
+
+TEST_CASE("job_queue_counts_concurrent_status_changes", "[job_queue]") {
+    auto driver = queue_driver_alloc(LOCAL_DRIVER);
+    auto queue = job_queue_alloc(driver);
+    auto node = job_queue_node_alloc("name", "/tmp", "ls", 1);
+    job_queue_add_job_node(queue, node);
+
+    // Both threads move the node away from the same statuses; each change
+    // must be counted once
+    auto set_statuses = [node](job_status_type status) {
+        for (int i = 0; i < 10000; i++) {
+            job_queue_node_lock_and_set_status(node, JOB_QUEUE_RUNNING);
+            job_queue_node_lock_and_set_status(node, status);
+        }
+    };
+    std::thread first{set_statuses, JOB_QUEUE_DONE};
+    std::thread second{set_statuses, JOB_QUEUE_EXIT};
+    first.join();
+    second.join();
+
+    auto counts = job_queue_get_status_counts(queue);
+    int total = 0;
+    for (auto count : counts)
+        total += count;
+    REQUIRE(total == 1);
+    REQUIRE(counts[job_status_index(job_queue_node_get_status(node))] == 1);
+
+    job_queue_free(queue);
+    queue_driver_free(driver);
+}
@@ -30,10 +30,18 @@ TEST_CASE("job_slurm_options", "[job_slurm]") {
     test_option(driver, SLURM_SCANCEL_OPTION, "my_funny_scancel");
     test_option(driver, SLURM_SQUEUE_OPTION, "my_funny_squeue");
     test_option(driver, SLURM_SCONTROL_OPTION, "my_funny_scontrol");
+    test_option(driver, SLURM_SACCT_OPTION, "my_funny_sacct");
     test_option(driver, SLURM_SQUEUE_TIMEOUT_OPTION, "11");
+    test_option(driver, SLURM_COMMAND_TIMEOUT_OPTION, "30");
     test_option(driver, SLURM_MAX_RUNTIME_OPTION, "11");
     test_option(driver, SLURM_MEMORY_OPTION, "100mb");
     test_option(driver, SLURM_MEMORY_PER_CPU_OPTION, "1000gb");
+    test_option(driver, SLURM_ARRAY_SUBMIT_OPTION, "True");
+    test_option(driver, SLURM_ARRAY_SUBMIT_OPTION, "False");
+    REQUIRE_FALSE(
+        slurm_driver_set_option(driver, SLURM_ARRAY_SUBMIT_OPTION, "Maybe"));
+    test_option(driver, SLURM_PACK_SIZE_OPTION, "8");
+    REQUIRE_FALSE(slurm_driver_set_option(driver, SLURM_PACK_SIZE_OPTION, "0"));
     REQUIRE_FALSE(slurm_driver_set_option(driver, "SLURM_SQUEUE_TIMEOUT_OPTION",
                                           "NOT_INTEGER"));
     REQUIRE_FALSE(slurm_driver_set_option(driver, "NO_SUCH_OPTION", "Value"));
@@ -41,3 +49,84 @@ TEST_CASE("job_slurm_options", "[job_slurm]") {
     test_host_options(driver, SLURM_EXCLUDE_HOST_OPTION);
     slurm_driver_free(driver);
 }
+
+TEST_CASE("job_slurm_parse_sacct", "[job_slurm]") {
+    auto jobs = slurm_driver_parse_sacct("JobID|State|ExitCode\n"
+                                         "11|COMPLETED|0:0\n"
+                                         "11.batch|COMPLETED|0:0\n"
+                                         "12|CANCELLED by 1000|0:15\n"
+                                         "12.batch|CANCELLED|0:15\n"
+                                         "13|FAILED|1:0\n"
+                                         "14|TIMEOUT|0:0\n"
+                                         "15|RUNNING|0:0\n"
+                                         "16|COMPLETED|2:0\n"
+                                         "17_0|COMPLETED|0:0\n"
+                                         "17_0.batch|COMPLETED|0:0\n"
+                                         "17_1|FAILED|1:0\n"
+                                         "17_[2-5]|PENDING|0:0");
+    REQUIRE(jobs.size() == 8);
+    REQUIRE(jobs.at("11") == JOB_QUEUE_DONE);
+    REQUIRE(jobs.at("12") == JOB_QUEUE_IS_KILLED);
+    REQUIRE(jobs.at("13") == JOB_QUEUE_EXIT);
+    REQUIRE(jobs.at("14") == JOB_QUEUE_EXIT);
+    REQUIRE(jobs.at("15") == JOB_QUEUE_RUNNING);
+    REQUIRE(jobs.at("16") == JOB_QUEUE_EXIT);
+    REQUIRE(jobs.at("17_0") == JOB_QUEUE_DONE);
+    REQUIRE(jobs.at("17_1") == JOB_QUEUE_EXIT);
+
+    REQUIRE(slurm_driver_parse_sacct("").empty());
+}
+
+TEST_CASE("job_slurm_parse_sacct_accounting", "[job_slurm]") {
+    std::unordered_map<std::string, queue_driver_job_accounting> accounting;
+    auto jobs = slurm_driver_parse_sacct(
+        "11|COMPLETED|0:0|job|1-02:03:04||node[01-02]|2023-05-01T10:00:00|"
+        "2023-05-01T10:01:30\n"
+        "11.batch|COMPLETED|0:0|batch|1-02:03:04|1536K|node01|"
+        "2023-05-01T10:01:30|2023-05-01T10:01:30\n"
+        "11.0|COMPLETED|0:0|step|01:00|2.5G|node02|2023-05-01T10:01:30|"
+        "2023-05-01T10:01:31\n"
+        "12|CANCELLED by 1000|0:15|job|00:10|||2023-05-01T10:00:00|"
+        "Unknown\n"
+        "13|PENDING|0:0|job|00:00:00||None assigned|2023-05-01T10:00:00|"
+        "Unknown\n",
+        nullptr, &accounting);
+    REQUIRE(jobs.size() == 3);
+
+    const auto &done = accounting.at("11");
+    REQUIRE(done.exit_code == 0);
+    REQUIRE(done.exit_signal == 0);
+    REQUIRE(done.elapsed == 93784.0);
+    REQUIRE(done.max_rss == int64_t(2.5 * 1024 * 1024 * 1024));
+    REQUIRE(done.node_list == "node[01-02]");
+    REQUIRE(done.pending_time == 90.0);
+
+    const auto &killed = accounting.at("12");
+    REQUIRE(killed.exit_signal == 15);
+    REQUIRE(killed.elapsed == 10.0);
+    REQUIRE_FALSE(killed.max_rss);
+    REQUIRE_FALSE(killed.pending_time);
+
+    REQUIRE(accounting.at("13").node_list.empty());
+}
+
+TEST_CASE("job_slurm_parse_sacct_steps", "[job_slurm]") {
+    std::unordered_map<std::string, std::string> step_ids;
+    auto jobs =
+        slurm_driver_parse_sacct("20|RUNNING|0:0|ensemble\n"
+                                 "20.batch|RUNNING|0:0|batch\n"
+                                 "20.0|COMPLETED|0:0|pack1\n"
+                                 "20.1|FAILED|1:0|pack0\n"
+                                 "20.2|RUNNING|0:0|pack2\n"
+                                 "20.3|COMPLETED|0:0|other-step\n",
+                                 &step_ids);
+    REQUIRE(jobs.size() == 4);
+    REQUIRE(jobs.at("20") == JOB_QUEUE_RUNNING);
+    REQUIRE(jobs.at("20.pack0") == JOB_QUEUE_EXIT);
+    REQUIRE(jobs.at("20.pack1") == JOB_QUEUE_DONE);
+    REQUIRE(jobs.at("20.pack2") == JOB_QUEUE_RUNNING);
+
+    REQUIRE(step_ids.size() == 3);
+    REQUIRE(step_ids.at("20.pack0") == "20.1");
+    REQUIRE(step_ids.at("20.pack1") == "20.0");
+}
@@ -0,0 +1,129 @@
+#include "../tmpdir.hpp"
+#include "catch2/catch.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ert/job_queue/queue_driver.hpp>
+#include <ert/job_queue/slurm_driver.hpp>
+
+/*
+  These tests run the slurm driver against the Slurm emulator of
+  slurm_emulator.cpp, which keeps its state in the tmpdir of the test. The
+  emulated jobs are pending and running for a fraction of a second each.
+*/
+
+using namespace std::chrono_literals;
+
+static queue_driver_type *alloc_emulated_driver(const std::string &cwd) {
+    setenv("SLURM_EMULATOR_DIR", cwd.c_str(), 1);
+    setenv("SLURM_EMULATOR_QUEUE_DELAY", "0.2", 1);
+    setenv("SLURM_EMULATOR_RUNTIME", "0.4", 1);
+    setenv("SLURM_EMULATOR_FAILURE_RATE", "0", 1);
+    setenv("SLURM_EMULATOR_ACCOUNTING", "1", 1);
+
+    queue_driver_type *driver = queue_driver_alloc(SLURM_DRIVER);
+    for (const auto &[option, command] :
+         {std::pair{SLURM_SBATCH_OPTION, "sbatch"},
+          {SLURM_SQUEUE_OPTION, "squeue"},
+          {SLURM_SCONTROL_OPTION, "scontrol"},
+          {SLURM_SCANCEL_OPTION, "scancel"},
+          {SLURM_SACCT_OPTION, "sacct"}}) {
+        auto link = cwd + "/" + command;
+        std::filesystem::create_symlink(SLURM_EMULATOR, link);
+        REQUIRE(queue_driver_set_option(driver, option, link.c_str()));
+    }
+    REQUIRE(queue_driver_set_option(driver, SLURM_SQUEUE_TIMEOUT_OPTION, "1"));
+    return driver;
+}
+
+static std::vector<void *> submit_jobs(queue_driver_type *driver,
+                                       const std::string &cwd,
+                                       size_t num_jobs) {
+    std::vector<queue_driver_submit_args> args;
+    for (size_t i = 0; i < num_jobs; i++) {
+        auto job_name = std::to_string(i);
+        args.push_back({"/bin/true", 1, cwd + "/" + job_name, job_name});
+    }
+    std::vector<void *> jobs(num_jobs);
+    queue_driver_submit_job_batch(driver, args.data(), args.size(),
+                                  jobs.data());
+    for (auto job : jobs)
+        REQUIRE_FALSE(job == nullptr);
+    return jobs;
+}
+
+/** Polls the status until no job is pending or running. */
+static std::vector<job_status_type>
+wait_for_jobs(queue_driver_type *driver, std::vector<void *> &jobs) {
+    std::vector<job_status_type> status(jobs.size());
+    auto deadline = std::chrono::steady_clock::now() + 60s;
+    while (std::chrono::steady_clock::now() < deadline) {
+        queue_driver_get_status_batch(driver, jobs.data(), jobs.size(),
+                                      status.data());
+        if (std::none_of(status.begin(), status.end(), [](auto job_status) {
+                return job_status == JOB_QUEUE_PENDING ||
+                       job_status == JOB_QUEUE_RUNNING;
+            }))
+            break;
+        std::this_thread::sleep_for(100ms);
+    }
+    return status;
+}
+
+static void free_jobs(queue_driver_type *driver, std::vector<void *> &jobs) {
+    for (auto job : jobs)
+        queue_driver_free_job(driver, job);
+    queue_driver_free(driver);
+}
+
+TEST_CASE("job_slurm_emulator_array", "[job_slurm]") {
+    TmpDir tmpdir; // cwd is now a generated tmpdir
+    std::string cwd = tmpdir.get_current_tmpdir();
+    auto driver = alloc_emulated_driver(cwd);
+    REQUIRE(queue_driver_set_option(driver, SLURM_ARRAY_SUBMIT_OPTION, "1"));
+
+    auto jobs = submit_jobs(driver, cwd, 20);
+    for (auto job_status : wait_for_jobs(driver, jobs))
+        REQUIRE(job_status == JOB_QUEUE_DONE);
+
+    queue_driver_job_accounting accounting;
+    REQUIRE(queue_driver_get_accounting(driver, jobs[7], &accounting));
+    REQUIRE(accounting.exit_code == 0);
+    REQUIRE(accounting.max_rss.value_or(0) >= 1024);
+    REQUIRE(accounting.node_list.rfind("emu", 0) == 0);
+    free_jobs(driver, jobs);
+}
+
+TEST_CASE("job_slurm_emulator_pack_failures", "[job_slurm]") {
+    TmpDir tmpdir; // cwd is now a generated tmpdir
+    std::string cwd = tmpdir.get_current_tmpdir();
+    auto driver = alloc_emulated_driver(cwd);
+    setenv("SLURM_EMULATOR_FAILURE_RATE", "1", 1);
+    REQUIRE(queue_driver_set_option(driver, SLURM_PACK_SIZE_OPTION, "4"));
+
+    auto jobs = submit_jobs(driver, cwd, 6);
+    for (auto job_status : wait_for_jobs(driver, jobs))
+        REQUIRE(job_status == JOB_QUEUE_EXIT);
+    free_jobs(driver, jobs);
+}
+
+TEST_CASE("job_slurm_emulator_kill_without_accounting", "[job_slurm]") {
+    TmpDir tmpdir; // cwd is now a generated tmpdir
+    std::string cwd = tmpdir.get_current_tmpdir();
+    auto driver = alloc_emulated_driver(cwd);
+    // Without sacct the status of the jobs which have ended is from scontrol
+    setenv("SLURM_EMULATOR_ACCOUNTING", "0", 1);
+
+    auto jobs = submit_jobs(driver, cwd, 3);
+    queue_driver_kill_job(driver, jobs[1]);
+    auto status = wait_for_jobs(driver, jobs);
+    REQUIRE(status[0] == JOB_QUEUE_DONE);
+    REQUIRE(status[1] == JOB_QUEUE_IS_KILLED);
+    REQUIRE(status[2] == JOB_QUEUE_DONE);
+    free_jobs(driver, jobs);
+}
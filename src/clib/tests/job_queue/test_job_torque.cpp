@@ -32,6 +32,7 @@ TEST_CASE("job_torque_set_all_options_set", "[job_torque]") {
     test_option(driver, TORQUE_CLUSTER_LABEL, "thecluster");
     test_option(driver, TORQUE_JOB_PREFIX_KEY, "coolJob");
     test_option(driver, TORQUE_QUEUE_QUERY_TIMEOUT, "128");
+    test_option(driver, TORQUE_COMMAND_TIMEOUT, "0.5");
 
     test_option(driver, TORQUE_QSUB_CMD, "");
     test_option(driver, TORQUE_QSTAT_CMD, "");
@@ -74,6 +75,8 @@ TEST_CASE("job_torque_set_typed_options_wrong_format_returns_false",
     REQUIRE_FALSE(torque_driver_set_option(driver, TORQUE_SUBMIT_SLEEP, "X45"));
     REQUIRE_FALSE(
         torque_driver_set_option(driver, TORQUE_QUEUE_QUERY_TIMEOUT, "X45"));
+    REQUIRE_FALSE(
+        torque_driver_set_option(driver, TORQUE_COMMAND_TIMEOUT, "-1"));
     torque_driver_free(driver);
 }
 
@@ -90,5 +93,7 @@ TEST_CASE("job_torque_get_option_no_option_set_default_options_returned",
     REQUIRE(get_option(driver, TORQUE_NUM_NODES) == "1");
     REQUIRE(get_option(driver, TORQUE_CLUSTER_LABEL) == "");
     REQUIRE(get_option(driver, TORQUE_JOB_PREFIX_KEY) == "");
+    REQUIRE(get_option(driver, TORQUE_COMMAND_TIMEOUT) ==
+            TORQUE_DEFAULT_COMMAND_TIMEOUT);
     torque_driver_free(driver);
 }
@@ -14,6 +14,11 @@ void test_submit(torque_driver_type *driver, const char *cmd) {
     REQUIRE(job != nullptr);
     REQUIRE((torque_driver_get_job_status(driver, job) &
              (JOB_QUEUE_RUNNING + JOB_QUEUE_PENDING)) != 0);
+
+    job_status_type batch_status;
+    void *jobs[] = {job};
+    torque_driver_get_job_status_batch(driver, jobs, 1, &batch_status);
+    REQUIRE((batch_status & (JOB_QUEUE_RUNNING + JOB_QUEUE_PENDING)) != 0);
     torque_driver_kill_job(driver, job);
 
     printf("Waiting 3 seconds");
@@ -1,12 +1,20 @@
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
 #include <filesystem>
 #include <fstream>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include "catch2/catch.hpp"
 
 #include "../tmpdir.hpp"
+#include <ert/job_queue/job_queue.hpp>
+#include <ert/job_queue/lsf_driver.hpp>
 
 namespace fs = std::filesystem;
 namespace detail {
@@ -39,3 +47,732 @@ TEST_CASE("parse hostnames lsf", "[lsf]") {
                                          "hname4", "hname5"});
     }
 }
+
+static void write_script(const fs::path &path, const std::string &body) {
+    std::ofstream stream{path};
+    stream << "#!/bin/sh\n" << body;
+    stream.close();
+    fs::permissions(path, fs::perms::owner_all);
+}
+
+/** The body of a bsub which gives the jobs the ids 101, 102, ... in the order
+ * they are submitted, and runs the extra commands before it answers. */
+static std::string counting_bsub(const std::string &extra = "") {
+    return "n=$(cat counter 2>/dev/null || echo 100)\n"
+           "echo $((n+1)) > counter\n" +
+           extra + "echo \"Job <$((n+1))> is submitted\"\n";
+}
+
+/** The lines of the file, e.g. the arguments a script has recorded. */
+static std::vector<std::string> read_lines(const fs::path &path) {
+    std::ifstream stream{path};
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(stream, line);)
+        lines.push_back(line);
+    return lines;
+}
+
+/** The LSF commands which are replaced by scripts in the tests. */
+static const std::pair<const char *, const char *> script_commands[] = {
+    {LSF_BSUB_CMD, "bsub"}, {LSF_BJOBS_CMD, "bjobs"}, {LSF_BHIST_CMD, "bhist"}};
+
+/** A driver which runs the bsub, bjobs and bhist scripts of the directory on
+ * this host. */
+static lsf_driver_type *alloc_script_driver(const fs::path &dir) {
+    auto driver = static_cast<lsf_driver_type *>(lsf_driver_alloc());
+    REQUIRE(lsf_driver_set_option(driver, LSF_SERVER, LOCAL_LSF_SERVER));
+    for (auto [option, command] : script_commands)
+        REQUIRE(lsf_driver_set_option(driver, option, (dir / command).c_str()));
+    return driver;
+}
+
+TEST_CASE("lsf keeps the bjobs status when bjobs hangs", "[lsf]") {
+    WITH_TMPDIR;
+    auto cwd = fs::current_path();
+    // The commands run in the current directory, i.e. the tmpdir
+    write_script(cwd / "bsub", counting_bsub());
+    write_script(cwd / "bjobs", "[ -f hang ] && sleep 30\n"
+                                "echo 'JOBID USER STAT'\n"
+                                "echo '101 user RUN'\n");
+
+    auto driver = alloc_script_driver(cwd);
+    REQUIRE(lsf_driver_set_option(driver, LSF_COMMAND_TIMEOUT, "0.2"));
+
+    auto job1 = lsf_driver_submit_job(driver, "cmd", 1, cwd, "job1");
+    REQUIRE(job1 != nullptr);
+    REQUIRE(lsf_driver_get_job_status(driver, job1) == JOB_QUEUE_RUNNING);
+
+    // The second job is not in the bjobs cache, so bjobs is called again
+    std::ofstream{"hang"}.close();
+    auto job2 = lsf_driver_submit_job(driver, "cmd", 1, cwd, "job2");
+    REQUIRE(job2 != nullptr);
+
+    auto start = std::chrono::steady_clock::now();
+    REQUIRE(lsf_driver_get_job_status(driver, job2) == JOB_QUEUE_UNKNOWN);
+    REQUIRE(lsf_driver_get_job_status(driver, job1) == JOB_QUEUE_RUNNING);
+    REQUIRE(std::chrono::steady_clock::now() - start <
+            std::chrono::seconds(5));
+
+    lsf_driver_free_job(job1);
+    lsf_driver_free_job(job2);
+    lsf_driver_free(driver);
+}
+
+TEST_CASE("lsf does not time out bsub", "[lsf]") {
+    WITH_TMPDIR;
+    auto cwd = fs::current_path();
+    write_script(cwd / "bsub", "sleep 1\n"
+                               "echo 'Job <101> is submitted'\n");
+
+    auto driver = alloc_script_driver(cwd);
+    REQUIRE(lsf_driver_set_option(driver, LSF_COMMAND_TIMEOUT, "0.2"));
+
+    auto job = lsf_driver_submit_job(driver, "cmd", 1, cwd, "job");
+    REQUIRE(job != nullptr);
+
+    lsf_driver_free_job(job);
+    lsf_driver_free(driver);
+}
+
+TEST_CASE("lsf reads the bjobs status from several threads", "[lsf]") {
+    WITH_TMPDIR;
+    auto cwd = fs::current_path();
+    write_script(cwd / "bsub", counting_bsub());
+    write_script(cwd / "bjobs", "echo 'JOBID USER STAT'\n"
+                                "echo '101 user RUN'\n"
+                                "echo '102 user PEND'\n");
+
+    auto driver = alloc_script_driver(cwd);
+    lsf_driver_set_bjobs_refresh_interval(driver, 0);
+    void *jobs[2] = {lsf_driver_submit_job(driver, "cmd", 1, cwd, "job1"),
+                     lsf_driver_submit_job(driver, "cmd", 1, cwd, "job2")};
+
+    // The bjobs cache is replaced once a second, while the other threads read
+    // it
+    std::vector<std::thread> threads;
+    std::atomic<int> wrong_status{0};
+    auto end = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    for (int t = 0; t < 4; t++)
+        threads.emplace_back([&] {
+            while (std::chrono::steady_clock::now() < end) {
+                job_status_type status[2];
+                lsf_driver_get_job_status_batch(driver, jobs, 2, status);
+                if (status[0] != JOB_QUEUE_RUNNING ||
+                    status[1] != JOB_QUEUE_PENDING)
+                    wrong_status++;
+                if (lsf_driver_get_job_status(driver, jobs[0]) !=
+                    JOB_QUEUE_RUNNING)
+                    wrong_status++;
+            }
+        });
+    for (auto &thread : threads)
+        thread.join();
+    REQUIRE(wrong_status == 0);
+
+    for (auto job : jobs)
+        lsf_driver_free_job(job);
+    lsf_driver_free(driver);
+}
+
+TEST_CASE("lsf asks for the status while jobs are submitted", "[lsf]") {
+    WITH_TMPDIR;
+    auto cwd = fs::current_path();
+    write_script(cwd / "bsub", counting_bsub());
+    // Neither bjobs nor bhist know the jobs, so each status call runs them
+    // for all the jobs of the driver
+    write_script(cwd / "bjobs", "echo 'JOBID USER STAT'\n");
+    write_script(cwd / "bhist", "exit 1\n");
+
+    auto driver = alloc_script_driver(cwd);
+    auto first = lsf_driver_submit_job(driver, "cmd", 1, cwd, "job0");
+    REQUIRE(first != nullptr);
+
+    std::atomic<bool> submitting{true};
+    std::thread poller{[&] {
+        while (submitting)
+            lsf_driver_get_job_status(driver, first);
+    }};
+    std::vector<void *> jobs;
+    for (int i = 1; i <= 30; i++)
+        jobs.push_back(lsf_driver_submit_job(driver, "cmd", 1, cwd,
+                                             "job" + std::to_string(i)));
+    submitting = false;
+    poller.join();
+
+    for (auto job : jobs) {
+        REQUIRE(job != nullptr);
+        lsf_driver_free_job(job);
+    }
+    lsf_driver_free_job(first);
+    lsf_driver_free(driver);
+}
+
+TEST_CASE("lsf parses the bjobs json output", "[lsf]") {
+    auto records = lsf_driver_parse_bjobs_json(R"json({
+  "COMMAND":"bjobs",
+  "JOBS":3,
+  "RECORDS":[
+    {
+      "JOBID":"101",
+      "STAT":"RUN",
+      "EXIT_CODE":"",
+      "EXEC_HOST":"4*host-a:host-b",
+      "PEND_TIME":"12",
+      "RUN_TIME":"25 second(s)"
+    },
+    {
+      "JOBID":"102",
+      "STAT":"EXIT",
+      "EXIT_CODE":"3",
+      "EXEC_HOST":"host\"c\u00e6",
+      "PEND_TIME":"1",
+      "RUN_TIME":"2 second(s)",
+      "HOSTS":[{"NAME":"nested"}]
+    },
+    {
+      "JOBID":"103",
+      "ERROR":"Job <103> is not found"
+    }
+  ]
+}
+)json");
+    REQUIRE(records.size() == 3);
+    REQUIRE(records[0].at("STAT") == "RUN");
+    REQUIRE(records[0].at("EXIT_CODE").empty());
+    REQUIRE(records[0].at("EXEC_HOST") == "4*host-a:host-b");
+    REQUIRE(records[0].at("RUN_TIME") == "25 second(s)");
+    REQUIRE(records[1].at("EXEC_HOST") == "host\"c\xc3\xa6");
+    REQUIRE(records[1].count("NAME") == 0);
+    REQUIRE(records[2].at("JOBID") == "103");
+    REQUIRE(records[2].count("STAT") == 0);
+
+    REQUIRE(lsf_driver_parse_bjobs_json("").empty());
+    REQUIRE(lsf_driver_parse_bjobs_json("No unfinished job found\n").empty());
+}
+
+TEST_CASE("lsf asks bjobs -json for the jobs of the driver", "[lsf]") {
+    WITH_TMPDIR;
+    auto cwd = fs::current_path();
+    write_script(cwd / "bsub", counting_bsub());
+    // Job 101 has ended, and 102 is running
+    write_script(cwd / "bjobs",
+                 "echo \"$@\" >> bjobs-calls\n"
+                 "echo '{\"RECORDS\":['\n"
+                 "echo '{\"JOBID\":\"101\",\"STAT\":\"EXIT\",'\n"
+                 "echo '\"EXIT_CODE\":\"3\",\"EXEC_HOST\":\"host-a\",'\n"
+                 "echo '\"PEND_TIME\":\"12\",\"RUN_TIME\":\"25 second(s)\"},'\n"
+                 "echo '{\"JOBID\":\"102\",\"STAT\":\"RUN\",'\n"
+                 "echo '\"EXIT_CODE\":\"\",\"EXEC_HOST\":\"host-b\",'\n"
+                 "echo '\"PEND_TIME\":\"1\",\"RUN_TIME\":\"2 second(s)\"}'\n"
+                 "echo ']}'\n");
+
+    auto driver = alloc_script_driver(cwd);
+    REQUIRE(lsf_driver_set_option(driver, LSF_BJOBS_JSON, "True"));
+    lsf_driver_set_bjobs_refresh_interval(driver, 0);
+
+    void *jobs[2] = {lsf_driver_submit_job(driver, "cmd", 1, cwd, "job1"),
+                     lsf_driver_submit_job(driver, "cmd", 1, cwd, "job2")};
+    job_status_type status[2];
+    lsf_driver_get_job_status_batch(driver, jobs, 2, status);
+    REQUIRE(status[0] == JOB_QUEUE_EXIT);
+    REQUIRE(status[1] == JOB_QUEUE_RUNNING);
+
+    queue_driver_job_accounting accounting;
+    REQUIRE(lsf_driver_get_job_accounting(driver, jobs[0], &accounting));
+    REQUIRE(accounting.exit_code == 3);
+    REQUIRE(accounting.node_list == "host-a");
+    REQUIRE(accounting.pending_time == 12);
+    REQUIRE(accounting.elapsed == 25);
+
+    // The job which has ended is not asked for again
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    lsf_driver_get_job_status_batch(driver, jobs, 2, status);
+    REQUIRE(status[0] == JOB_QUEUE_EXIT);
+    auto lines = read_lines("bjobs-calls");
+    REQUIRE(lines == std::vector<std::string>{
+                         "-o jobid jobindex stat exit_code exec_host "
+                         "pend_time run_time -json 101 102",
+                         "-o jobid jobindex stat exit_code exec_host "
+                         "pend_time run_time -json 102"});
+
+    for (auto job : jobs)
+        lsf_driver_free_job(job);
+    lsf_driver_free(driver);
+}
+
+TEST_CASE("lsf parses the bhist -l output", "[lsf]") {
+    auto history = lsf_driver_parse_bhist(R"bhist(
+Job <101>, Job Name <job1>, User <user>, Project <default>, Command <cmd>
+Mon Oct 16 10:00:00: Submitted from host <host-a>, to Queue <normal>, CWD <$
+                     HOME/run>;
+Mon Oct 16 10:00:05: Dispatched 1 Task(s) on Host(s) <host-b>, Allocated 1 Slo
+                     t(s) on Host(s) <host-b>, Effective RES_REQ <select[type
+                     == local] >;
+Mon Oct 16 10:00:06: Starting (Pid 1234);
+Mon Oct 16 10:00:36: Done successfully. The CPU time used is 1.0 seconds;
+Mon Oct 16 10:00:36: Post job process done successfully;
+
+Summary of time in seconds spent in various states by  Mon Oct 16 10:00:36
+  PEND     PSUSP    RUN      USUSP    SSUSP    UNKWN    TOTAL
+  5        0        31       0        0        0        36
+------------------------------------------------------------------------------
+
+Job <102>, Job Name <job2>, User <user>, Project <default>, Command <cmd>
+Mon Oct 16 10:00:00: Submitted from host <host-a>, to Queue <normal>;
+Mon Oct 16 10:00:10: Dispatched 2 Task(s) on Host(s) <host-c> <host-d>, Alloca
+                     ted 2 Slot(s) on Host(s) <host-c> <host-d>;
+Mon Oct 16 10:00:11: Starting (Pid 4321);
+Mon Oct 16 10:00:20: Exited with exit code 3. The CPU time used is 0.1 seconds;
+Mon Oct 16 10:00:20: Completed <exit>;
+
+Summary of time in seconds spent in various states by  Mon Oct 16 10:00:20
+  PEND     PSUSP    RUN      USUSP    SSUSP    UNKWN    TOTAL
+  10       0        10       0        0        0        20
+------------------------------------------------------------------------------
+
+Job <103>, User <user>, Project <default>, Command <cmd>
+Mon Oct 16 10:00:00: Submitted from host <host-a>, to Queue <normal>;
+Mon Oct 16 10:00:02: Dispatched 1 Task(s) on Host(s) <host-e>;
+Mon Oct 16 10:00:03: Exited by signal 9. The CPU time used is 0.1 seconds;
+)bhist");
+    REQUIRE(history.size() == 3);
+    REQUIRE(history["101"].status == JOB_STAT_DONE);
+    REQUIRE(history["101"].accounting.exit_code == 0);
+    REQUIRE(history["101"].accounting.node_list == "host-b");
+    REQUIRE(history["101"].accounting.pending_time == 5);
+    REQUIRE(history["101"].accounting.elapsed == 31);
+    REQUIRE(history["102"].status == JOB_STAT_EXIT);
+    REQUIRE(history["102"].accounting.exit_code == 3);
+    REQUIRE(history["102"].accounting.node_list == "host-c");
+    REQUIRE(history["102"].accounting.elapsed == 10);
+    REQUIRE(history["103"].status == JOB_STAT_EXIT);
+    REQUIRE(history["103"].accounting.exit_signal == 9);
+    REQUIRE_FALSE(history["103"].accounting.elapsed);
+
+    REQUIRE(lsf_driver_parse_bhist("").empty());
+}
+
+TEST_CASE("lsf asks bhist once for the jobs bjobs does not list", "[lsf]") {
+    WITH_TMPDIR;
+    auto cwd = fs::current_path();
+    write_script(cwd / "bsub", counting_bsub());
+    // Only job 103 is still listed by bjobs
+    write_script(cwd / "bjobs", "echo 'JOBID USER STAT'\n"
+                                "echo '103 user RUN'\n");
+    write_script(cwd / "bhist",
+                 "echo \"$@\" >> bhist-calls\n"
+                 "echo 'Job <101>, User <user>'\n"
+                 "echo 'Mon Oct 16 10:00:20: Exited with exit code 2.'\n"
+                 "echo 'Job <102>, User <user>'\n"
+                 "echo 'Mon Oct 16 10:00:20: Done successfully.'\n");
+
+    auto driver = alloc_script_driver(cwd);
+    lsf_driver_set_bjobs_refresh_interval(driver, 0);
+
+    void *jobs[3] = {lsf_driver_submit_job(driver, "cmd", 1, cwd, "job1"),
+                     lsf_driver_submit_job(driver, "cmd", 1, cwd, "job2"),
+                     lsf_driver_submit_job(driver, "cmd", 1, cwd, "job3")};
+    job_status_type status[3];
+    lsf_driver_get_job_status_batch(driver, jobs, 3, status);
+    REQUIRE(status[0] == JOB_QUEUE_EXIT);
+    REQUIRE(status[1] == JOB_QUEUE_DONE);
+    REQUIRE(status[2] == JOB_QUEUE_RUNNING);
+
+    queue_driver_job_accounting accounting;
+    REQUIRE(lsf_driver_get_job_accounting(driver, jobs[0], &accounting));
+    REQUIRE(accounting.exit_code == 2);
+
+    // The jobs which have ended are not looked up again
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    lsf_driver_get_job_status_batch(driver, jobs, 3, status);
+    REQUIRE(status[0] == JOB_QUEUE_EXIT);
+    REQUIRE(status[1] == JOB_QUEUE_DONE);
+    auto lines = read_lines("bhist-calls");
+    REQUIRE(lines == std::vector<std::string>{"-l 101 102"});
+
+    for (auto job : jobs)
+        lsf_driver_free_job(job);
+    lsf_driver_free(driver);
+}
+
+TEST_CASE("lsf assumes a job bhist has no record of twice is DONE",
+          "[lsf]") {
+    WITH_TMPDIR;
+    auto cwd = fs::current_path();
+    write_script(cwd / "bsub", counting_bsub());
+    write_script(cwd / "bjobs", "echo 'JOBID USER STAT'\n");
+    write_script(cwd / "bhist", "echo \"$@\" >> bhist-calls\n");
+
+    auto driver = alloc_script_driver(cwd);
+    lsf_driver_set_bjobs_refresh_interval(driver, 0);
+
+    void *jobs[1] = {lsf_driver_submit_job(driver, "cmd", 1, cwd, "job1")};
+    job_status_type status[1];
+    lsf_driver_get_job_status_batch(driver, jobs, 1, status);
+    REQUIRE(status[0] == JOB_QUEUE_UNKNOWN);
+    lsf_driver_get_job_status_batch(driver, jobs, 1, status);
+    REQUIRE(status[0] == JOB_QUEUE_DONE);
+
+    // The job is not recorded as ended, so it is looked up again
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    lsf_driver_get_job_status_batch(driver, jobs, 1, status);
+    REQUIRE(status[0] == JOB_QUEUE_DONE);
+    auto lines = read_lines("bhist-calls");
+    REQUIRE(lines == std::vector<std::string>{"-l 101", "-l 101", "-l 101"});
+
+    lsf_driver_free_job(jobs[0]);
+    lsf_driver_free(driver);
+}
+
+TEST_CASE("lsf submits the jobs of a batch as a job array", "[lsf]") {
+    WITH_TMPDIR;
+    auto cwd = fs::current_path();
+    // The job script of a job array is given on stdin
+    write_script(cwd / "bsub", counting_bsub("cat > job-script-$((n+1))\n"
+                                             "echo \"$@\" >> bsub-calls\n"));
+    // Elements of the array are listed with the id of the array; a pending
+    // element has no execution host, and a long job name is cut at the start
+    write_script(
+        cwd / "bjobs",
+        "echo 'JOBID USER STAT QUEUE FROM_HOST EXEC_HOST JOB_NAME "
+        "SUBMIT_TIME'\n"
+        "echo '101 user RUN normal host-a host-b job0[1] Oct 16 10:00'\n"
+        "echo '101 user PEND normal host-a job0[2] Oct 16 10:00'\n"
+        "echo '101 user DONE normal host-a host-b *ob0[3] Oct 16 10:00'\n"
+        "echo '102 user EXIT normal host-a host-b job3 Oct 16 10:00'\n");
+
+    auto driver = alloc_script_driver(cwd);
+    REQUIRE(lsf_driver_set_option(driver, LSF_ARRAY_SUBMIT, "True"));
+    lsf_driver_set_bjobs_refresh_interval(driver, 0);
+
+    std::vector<queue_driver_submit_args> args;
+    for (int i = 0; i < 4; i++) {
+        auto job_name = "job" + std::to_string(i);
+        fs::create_directory(cwd / job_name);
+        // The last job has a command of its own
+        args.push_back({i < 3 ? "echo" : "true", 1, cwd / job_name, job_name});
+    }
+    void *jobs[4];
+    lsf_driver_submit_job_batch(driver, args.data(), args.size(), jobs);
+
+    auto lines = read_lines("bsub-calls");
+    REQUIRE(lines.size() == 2);
+    REQUIRE(lines[0] == "-o /dev/null -J job0[1-3] -n 1");
+    REQUIRE(lines[1].rfind("-o " + (cwd / "job3").string(), 0) == 0);
+
+    // LSB_JOBINDEX selects the realization of an element
+    REQUIRE(std::system("LSB_JOBINDEX=2 sh job-script-101") == 0);
+    std::ifstream stdout_file{cwd / "job1" / "job1.LSF-stdout"};
+    std::string output;
+    std::getline(stdout_file, output);
+    REQUIRE(output == (cwd / "job1").string());
+    std::ifstream info_file{cwd / "job1" / "lsf_info.json"};
+    std::getline(info_file, output);
+    REQUIRE(output == "{\"job_id\" : 101, \"array_index\" : 2 }");
+
+    job_status_type status[4];
+    lsf_driver_get_job_status_batch(driver, jobs, 4, status);
+    REQUIRE(status[0] == JOB_QUEUE_RUNNING);
+    REQUIRE(status[1] == JOB_QUEUE_PENDING);
+    REQUIRE(status[2] == JOB_QUEUE_DONE);
+    REQUIRE(status[3] == JOB_QUEUE_EXIT);
+
+    // With bjobs -json the array is asked for once for its elements which
+    // have not ended
+    write_script(cwd / "bjobs",
+                 "echo \"$@\" > bjobs-args\n"
+                 "echo '{\"RECORDS\":['\n"
+                 "echo '{\"JOBID\":\"101\",\"JOBINDEX\":\"1\",'\n"
+                 "echo '\"STAT\":\"DONE\",\"EXIT_CODE\":\"\"},'\n"
+                 "echo '{\"JOBID\":\"101\",\"JOBINDEX\":\"2\",'\n"
+                 "echo '\"STAT\":\"RUN\",\"EXIT_CODE\":\"\"}'\n"
+                 "echo ']}'\n");
+    REQUIRE(lsf_driver_set_option(driver, LSF_BJOBS_JSON, "True"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    lsf_driver_get_job_status_batch(driver, jobs, 4, status);
+    REQUIRE(status[0] == JOB_QUEUE_DONE);
+    REQUIRE(status[1] == JOB_QUEUE_RUNNING);
+    REQUIRE(status[2] == JOB_QUEUE_DONE);
+    std::ifstream bjobs_args{"bjobs-args"};
+    std::getline(bjobs_args, output);
+    REQUIRE(output.substr(output.rfind(' ')) == " 101");
+
+    for (auto job : jobs)
+        lsf_driver_free_job(job);
+    lsf_driver_free(driver);
+}
+
+TEST_CASE("lsf quotes the run paths and names of a job array", "[lsf]") {
+    WITH_TMPDIR;
+    auto cwd = fs::current_path();
+    write_script(cwd / "bsub", counting_bsub("cat > job-script-$((n+1))\n"));
+
+    auto driver = alloc_script_driver(cwd);
+    REQUIRE(lsf_driver_set_option(driver, LSF_ARRAY_SUBMIT, "True"));
+
+    std::vector<queue_driver_submit_args> args;
+    // A command substitution would create the file hacked if not quoted
+    for (auto job_name : {"it's job0", "job1 $(touch hacked)"}) {
+        fs::create_directory(cwd / job_name);
+        args.push_back({"echo", 1, cwd / job_name, job_name});
+    }
+    void *jobs[2];
+    lsf_driver_submit_job_batch(driver, args.data(), args.size(), jobs);
+
+    for (int index = 1; index <= 2; index++) {
+        auto command =
+            "LSB_JOBINDEX=" + std::to_string(index) + " sh job-script-101";
+        REQUIRE(std::system(command.c_str()) == 0);
+        const auto &run_path = args[index - 1].run_path;
+        std::ifstream stdout_file{run_path /
+                                  (args[index - 1].job_name + ".LSF-stdout")};
+        std::string output;
+        std::getline(stdout_file, output);
+        REQUIRE(output == run_path.string());
+        REQUIRE_FALSE(fs::exists(run_path / "hacked"));
+    }
+    REQUIRE_FALSE(fs::exists("hacked"));
+
+    for (auto job : jobs)
+        lsf_driver_free_job(job);
+    lsf_driver_free(driver);
+}
+
+TEST_CASE("lsf submits the jobs the queue starts together as an array",
+          "[lsf]") {
+    WITH_TMPDIR;
+    auto cwd = fs::current_path();
+    write_script(cwd / "bsub", "cat > /dev/null\n"
+                               "echo \"$@\" >> bsub-calls\n"
+                               "echo 'Job <101> is submitted'\n");
+    write_script(cwd / "bjobs",
+                 "echo 'JOBID USER STAT QUEUE FROM_HOST EXEC_HOST JOB_NAME "
+                 "SUBMIT_TIME'\n"
+                 "for i in 1 2 3; do\n"
+                 "echo \"101 user RUN normal host-a host-b job0[$i] Oct 16\"\n"
+                 "done\n");
+
+    auto driver = queue_driver_alloc(LSF_DRIVER);
+    REQUIRE(queue_driver_set_option(driver, LSF_SERVER, LOCAL_LSF_SERVER));
+    for (auto [option, command] : script_commands)
+        REQUIRE(queue_driver_set_option(driver, option,
+                                        (cwd / command).c_str()));
+    REQUIRE(queue_driver_set_option(driver, LSF_ARRAY_SUBMIT, "True"));
+    auto queue = job_queue_alloc(driver);
+
+    std::vector<job_queue_node_type *> nodes;
+    for (int i = 0; i < 3; i++) {
+        auto job_name = "job" + std::to_string(i);
+        fs::create_directory(cwd / job_name);
+        auto node = job_queue_node_alloc(job_name.c_str(),
+                                         (cwd / job_name).c_str(), "echo", 1);
+        job_queue_add_job_node(queue, node);
+        nodes.push_back(node);
+    }
+    job_queue_engine_start(queue, 2);
+    job_queue_engine_submit_many(queue, nodes);
+
+    std::vector<bool> running(nodes.size(), false);
+    for (int i = 0; i < 100; i++) {
+        for (auto &transition : job_queue_engine_get_transitions(queue))
+            if (transition.status == JOB_QUEUE_RUNNING)
+                running[transition.queue_index] = true;
+        if (std::all_of(running.begin(), running.end(),
+                        [](bool r) { return r; }))
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    for (auto node : nodes)
+        REQUIRE(job_queue_node_get_status(node) == JOB_QUEUE_RUNNING);
+
+    auto lines = read_lines("bsub-calls");
+    REQUIRE(lines.size() == 1);
+    REQUIRE(lines[0] == "-o /dev/null -J job0[1-3] -n 1");
+
+    job_queue_engine_stop(queue);
+    job_queue_free(queue);
+    queue_driver_free(driver);
+}
+
+TEST_CASE("lsf kills a job while its status is asked for", "[lsf]") {
+    WITH_TMPDIR;
+    auto cwd = fs::current_path();
+    write_script(cwd / "bsub", counting_bsub());
+    write_script(cwd / "bjobs", "sleep 1\n"
+                                "echo 'JOBID USER STAT'\n"
+                                "echo '101 user RUN'\n"
+                                "echo '102 user RUN'\n");
+    write_script(cwd / "bkill", "echo \"$@\" >> bkill-calls\n");
+
+    auto driver = queue_driver_alloc(LSF_DRIVER);
+    REQUIRE(queue_driver_set_option(driver, LSF_SERVER, LOCAL_LSF_SERVER));
+    for (auto [option, command] : script_commands)
+        REQUIRE(queue_driver_set_option(driver, option,
+                                        (cwd / command).c_str()));
+    REQUIRE(queue_driver_set_option(driver, LSF_BKILL_CMD,
+                                    (cwd / "bkill").c_str()));
+
+    std::vector<job_queue_node_type *> nodes;
+    for (const auto *job_name : {"job1", "job2"}) {
+        auto node = job_queue_node_alloc(job_name, cwd.c_str(), "cmd", 1);
+        REQUIRE(job_queue_node_submit(node, driver) == SUBMIT_OK);
+        nodes.push_back(node);
+    }
+
+    // The nodes are not locked while bjobs runs
+    std::vector<std::pair<int, std::optional<std::string>>> results;
+    std::thread refresh{[&] {
+        results = job_queue_node_refresh_status_many(nodes, driver);
+    }};
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    auto start = std::chrono::steady_clock::now();
+    REQUIRE(job_queue_node_kill(nodes[0], driver));
+    REQUIRE(std::chrono::steady_clock::now() - start <
+            std::chrono::milliseconds(500));
+    refresh.join();
+
+    // The status of the killed job is not recorded
+    REQUIRE(results[0].first == JOB_QUEUE_IS_KILLED);
+    REQUIRE(job_queue_node_get_status(nodes[0]) == JOB_QUEUE_IS_KILLED);
+    REQUIRE(results[1].first == JOB_QUEUE_RUNNING);
+    REQUIRE(read_lines("bkill-calls") ==
+            std::vector<std::string>{"-s SIGTERM 101"});
+
+    for (auto node : nodes)
+        job_queue_node_free(node);
+    queue_driver_free(driver);
+}
+
+TEST_CASE("lsf runs the remote commands in one shell", "[lsf]") {
+    WITH_TMPDIR;
+    auto cwd = fs::current_path();
+    // A stand-in for ssh, which runs the command on this host
+    write_script(cwd / "rsh", "echo \"$@\" >> rsh-calls\n"
+                              "shift\n"
+                              "exec /bin/sh -c \"$*\"\n");
+    write_script(cwd / "bsub", counting_bsub());
+    write_script(cwd / "bjobs", "echo 'JOBID USER STAT'\n"
+                                "echo '101 user RUN'\n"
+                                "echo '102 user PEND'\n");
+
+    auto persistent = GENERATE(true, false);
+    auto driver = alloc_script_driver(cwd);
+    REQUIRE(lsf_driver_set_option(driver, LSF_SERVER, "lsf-server"));
+    REQUIRE(lsf_driver_set_option(driver, LSF_RSH_CMD, (cwd / "rsh").c_str()));
+    REQUIRE(lsf_driver_set_option(driver, LSF_PERSISTENT_SHELL,
+                                  persistent ? "True" : "False"));
+
+    void *jobs[2] = {lsf_driver_submit_job(driver, "cmd", 1, cwd, "job1"),
+                     lsf_driver_submit_job(driver, "cmd", 1, cwd, "job2")};
+    job_status_type status[2];
+    lsf_driver_get_job_status_batch(driver, jobs, 2, status);
+    REQUIRE(status[0] == JOB_QUEUE_RUNNING);
+    REQUIRE(status[1] == JOB_QUEUE_PENDING);
+
+    auto lines = read_lines("rsh-calls");
+    if (persistent)
+        REQUIRE(lines == std::vector<std::string>{"lsf-server sh"});
+    else
+        REQUIRE(lines.size() == 3);
+
+    for (auto job : jobs)
+        lsf_driver_free_job(job);
+    lsf_driver_free(driver);
+}
+
+TEST_CASE("lsf runs bsub for several jobs at the same time", "[lsf]") {
+    WITH_TMPDIR;
+    auto cwd = fs::current_path();
+    write_script(cwd / "bsub", "sleep 0.5\n"
+                               "echo \"$@\" >> bsub-calls\n"
+                               "echo \"Job <$$> is submitted\"\n");
+
+    auto driver = alloc_script_driver(cwd);
+    REQUIRE(lsf_driver_set_option(driver, LSF_SUBMIT_WORKERS, "4"));
+
+    std::vector<queue_driver_submit_args> args;
+    for (int i = 0; i < 4; i++) {
+        auto job_name = "job" + std::to_string(i);
+        fs::create_directory(cwd / job_name);
+        args.push_back({"true", 1, cwd / job_name, job_name});
+    }
+    void *jobs[4];
+    auto start = std::chrono::steady_clock::now();
+    lsf_driver_submit_job_batch(driver, args.data(), args.size(), jobs);
+    // One at a time the four bsub commands would take two seconds
+    REQUIRE(std::chrono::steady_clock::now() - start <
+            std::chrono::milliseconds(1500));
+
+    auto lines = read_lines("bsub-calls");
+    REQUIRE(lines.size() == 4);
+    for (auto job : jobs) {
+        REQUIRE(job != nullptr);
+        lsf_driver_free_job(job);
+    }
+    lsf_driver_free(driver);
+}
+
+TEST_CASE("lsf stops submitting a batch when a submission throws", "[lsf]") {
+    WITH_TMPDIR;
+    auto cwd = fs::current_path();
+    write_script(cwd / "bsub", "echo \"$@\" >> bsub-calls\n"
+                               "echo \"Job <$$> is submitted\"\n");
+
+    auto driver = alloc_script_driver(cwd);
+    REQUIRE(lsf_driver_set_option(driver, LSF_SUBMIT_WORKERS, "2"));
+    // An unterminated select[] can not be combined with the excluded host
+    REQUIRE(lsf_driver_set_option(driver, LSF_RESOURCE, "select[mem>1"));
+    REQUIRE(lsf_driver_set_option(driver, LSF_EXCLUDE_HOST, "bad"));
+
+    std::vector<queue_driver_submit_args> args;
+    for (int i = 0; i < 8; i++) {
+        auto job_name = "job" + std::to_string(i);
+        fs::create_directory(cwd / job_name);
+        args.push_back({"true", 1, cwd / job_name, job_name});
+    }
+    void *jobs[8];
+    REQUIRE_THROWS_WITH(
+        lsf_driver_submit_job_batch(driver, args.data(), args.size(), jobs),
+        Catch::Contains("select statement"));
+    REQUIRE_FALSE(fs::exists("bsub-calls"));
+
+    // The submit slots of the failed submissions have been given back
+    REQUIRE(lsf_driver_set_option(driver, LSF_RESOURCE, "select[mem>1]"));
+    lsf_driver_submit_job_batch(driver, args.data(), args.size(), jobs);
+    REQUIRE(read_lines("bsub-calls").size() == 8);
+    for (auto job : jobs) {
+        REQUIRE(job != nullptr);
+        lsf_driver_free_job(job);
+    }
+    lsf_driver_free(driver);
+}
+
+TEST_CASE("lsf limits the rate of the bsub commands", "[lsf]") {
+    WITH_TMPDIR;
+    auto cwd = fs::current_path();
+    write_script(cwd / "bsub", "echo \"Job <$$> is submitted\"\n");
+
+    auto driver = alloc_script_driver(cwd);
+    REQUIRE(lsf_driver_set_option(driver, LSF_SUBMIT_WORKERS, "4"));
+    REQUIRE(lsf_driver_set_option(driver, LSF_SUBMIT_RATE, "10"));
+    REQUIRE(lsf_driver_set_option(driver, LSF_SUBMIT_BURST, "2"));
+
+    std::vector<queue_driver_submit_args> args;
+    for (int i = 0; i < 6; i++) {
+        auto job_name = "job" + std::to_string(i);
+        fs::create_directory(cwd / job_name);
+        args.push_back({"true", 1, cwd / job_name, job_name});
+    }
+    void *jobs[6];
+    auto start = std::chrono::steady_clock::now();
+    lsf_driver_submit_job_batch(driver, args.data(), args.size(), jobs);
+    // The burst of two is followed by one bsub every 100 ms
+    REQUIRE(std::chrono::steady_clock::now() - start >=
+            std::chrono::milliseconds(400));
+
+    for (auto job : jobs) {
+        REQUIRE(job != nullptr);
+        lsf_driver_free_job(job);
+    }
+    lsf_driver_free(driver);
+}
@@ -0,0 +1,60 @@
+#include "catch2/catch.hpp"
+#include <chrono>
+#include <string>
+#include <sys/wait.h>
+
+#include <ert/job_queue/remote_shell.hpp>
+
+using namespace std::chrono_literals;
+
+/** A local stand-in for 'ssh <host> sh', which prints a banner as a login
+ * script could. */
+static ert::RemoteShell local_shell() {
+    return ert::RemoteShell(
+        {"/bin/sh", "-c", "echo banner; echo banner >&2; exec /bin/sh"});
+}
+
+TEST_CASE("remote_shell_runs_commands", "[remote_shell]") {
+    auto shell = local_shell();
+    auto output = shell.run("echo out; echo err >&2; false");
+    REQUIRE(WIFEXITED(output.status));
+    REQUIRE(WEXITSTATUS(output.status) == 1);
+    REQUIRE(output.out == "out\n");
+    REQUIRE(output.err == "err\n");
+    REQUIRE_FALSE(output.timed_out);
+
+    // Output without a newline at the end, and input on stdin
+    REQUIRE(shell.run("printf abc").out == "abc");
+    REQUIRE(shell.run("cat", "line1\nline2").out == "line1\nline2\n");
+    REQUIRE(shell.run("cat").out.empty());
+
+    // The commands run in the same shell
+    auto pid = shell.run("echo $$").out;
+    REQUIRE(shell.run("echo $$").out == pid);
+}
+
+TEST_CASE("remote_shell_restarts_after_exit", "[remote_shell]") {
+    auto shell = local_shell();
+    auto pid = shell.run("echo $$").out;
+
+    // The command may have run, so it is not tried again
+    auto output = shell.run("exit 3");
+    REQUIRE(output.status == -1);
+    REQUIRE_FALSE(output.timed_out);
+
+    output = shell.run("echo $$");
+    REQUIRE(output.status == 0);
+    REQUIRE_FALSE(output.out.empty());
+    REQUIRE(output.out != pid);
+}
+
+TEST_CASE("remote_shell_stops_command_after_timeout", "[remote_shell]") {
+    auto shell = local_shell();
+    auto start = std::chrono::steady_clock::now();
+    auto output = shell.run("echo started; sleep 10", std::nullopt, 200ms);
+    REQUIRE(output.timed_out);
+    REQUIRE(output.out == "started\n");
+    REQUIRE(std::chrono::steady_clock::now() - start < 5s);
+
+    REQUIRE(shell.run("echo ok", std::nullopt, 5s).out == "ok\n");
+}
@@ -0,0 +1,67 @@
+#include "catch2/catch.hpp"
+#include <cstdint>
+#include <string>
+
+#include <ert/job_queue/slurm_status_table.hpp>
+
+using ert::slurm_job_key;
+using ert::SlurmStatusTable;
+
+TEST_CASE("slurm_job_key", "[slurm_status_table]") {
+    REQUIRE(slurm_job_key("1234") == uint64_t{1234} << 32);
+    REQUIRE(slurm_job_key("1234_5") ==
+            (uint64_t{1234} << 32 | uint64_t{1} << 30 | 5));
+    REQUIRE(slurm_job_key("1234.pack5") ==
+            (uint64_t{1234} << 32 | uint64_t{2} << 30 | 5));
+
+    // The kinds of id do not collide
+    REQUIRE(slurm_job_key("1234_5") != slurm_job_key("1234.pack5"));
+    REQUIRE(slurm_job_key("1234_0") != slurm_job_key("1234"));
+
+    // The job id must fit in 32 bits, and the index in 30
+    REQUIRE(slurm_job_key(std::to_string(UINT32_MAX)) ==
+            uint64_t{UINT32_MAX} << 32);
+    REQUIRE(slurm_job_key(std::to_string(uint64_t{UINT32_MAX} + 1)) == 0);
+    REQUIRE(slurm_job_key("1234_" + std::to_string((1 << 30) - 1)) != 0);
+    REQUIRE(slurm_job_key("1234_" + std::to_string(1 << 30)) == 0);
+    REQUIRE(slurm_job_key("1234.pack" + std::to_string(1 << 30)) == 0);
+
+    for (const auto *id : {"", "_5", "1234_", "1234.5", "1234.batch",
+                           "1234_5x", "-1", "12a4"})
+        REQUIRE(slurm_job_key(id) == 0);
+}
+
+TEST_CASE("slurm_status_table_find", "[slurm_status_table]") {
+    SlurmStatusTable table(3);
+    table.insert(slurm_job_key("1234"), JOB_QUEUE_RUNNING);
+    table.insert(slurm_job_key("1234_5"), JOB_QUEUE_PENDING);
+    table.insert(slurm_job_key("1234.pack5"), JOB_QUEUE_DONE);
+
+    REQUIRE(table.find(slurm_job_key("1234")) == JOB_QUEUE_RUNNING);
+    REQUIRE(table.find(slurm_job_key("1234_5")) == JOB_QUEUE_PENDING);
+    REQUIRE(table.find(slurm_job_key("1234.pack5")) == JOB_QUEUE_DONE);
+    REQUIRE_FALSE(table.find(slurm_job_key("1234_6")).has_value());
+    REQUIRE_FALSE(table.find(slurm_job_key("1235")).has_value());
+
+    // An id which has no key is never found
+    auto no_key = slurm_job_key("1234_" + std::to_string(1 << 30));
+    REQUIRE(no_key == 0);
+    REQUIRE_FALSE(table.find(no_key).has_value());
+}
+
+TEST_CASE("slurm_status_table_grows_past_16_slots", "[slurm_status_table]") {
+    // A table of more than 8 jobs has more than the 16 slots of the smallest
+    // table, as it is kept at most half full; 100 jobs get 256 slots
+    constexpr int num_jobs = 100;
+    SlurmStatusTable table(num_jobs);
+    for (int i = 0; i < num_jobs; i++)
+        table.insert(slurm_job_key("1234_" + std::to_string(i)),
+                     i % 2 ? JOB_QUEUE_RUNNING : JOB_QUEUE_PENDING);
+
+    for (int i = 0; i < num_jobs; i++)
+        REQUIRE(table.find(slurm_job_key("1234_" + std::to_string(i))) ==
+                (i % 2 ? JOB_QUEUE_RUNNING : JOB_QUEUE_PENDING));
+    REQUIRE_FALSE(
+        table.find(slurm_job_key("1234_" + std::to_string(num_jobs)))
+            .has_value());
+}
@@ -0,0 +1,145 @@
+#include "catch2/catch.hpp"
+#include <chrono>
+#include <csignal>
+#include <string>
+#include <unistd.h>
+
+#include <ert/job_queue/spawn.hpp>
+
+using namespace std::chrono_literals;
+
+static spawn_output capture_shell(
+    const char *script,
+    std::optional<std::chrono::milliseconds> timeout = std::nullopt) {
+    const char *argv[] = {"-c", script};
+    return spawn_capture("/bin/sh", 2, argv, timeout);
+}
+
+TEST_CASE("spawn_capture_returns_output", "[spawn]") {
+    spawn_server_stop();
+    auto output = capture_shell("echo out; echo err >&2; exit 2");
+    REQUIRE(WIFEXITED(output.status));
+    REQUIRE(WEXITSTATUS(output.status) == 2);
+    REQUIRE(output.out == "out\n");
+    REQUIRE(output.err == "err\n");
+    REQUIRE_FALSE(output.timed_out);
+}
+
+TEST_CASE("spawn_capture_large_output", "[spawn]") {
+    // More than a pipe buffer on both streams, so they must be read together
+    auto output = capture_shell("i=0; while [ $i -lt 20000 ]; do "
+                                "echo 0123456789; echo 0123456789 >&2; "
+                                "i=$((i+1)); done");
+    REQUIRE(output.status == 0);
+    REQUIRE(output.out.size() == 20000 * 11);
+    REQUIRE(output.err.size() == 20000 * 11);
+}
+
+TEST_CASE("spawn_capture_timeout_kills_process_group", "[spawn]") {
+    auto start = std::chrono::steady_clock::now();
+    auto output = capture_shell("echo started; sleep 30 & sleep 30", 200ms);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    REQUIRE(output.timed_out);
+    REQUIRE(output.out == "started\n");
+    REQUIRE(WIFSIGNALED(output.status));
+    REQUIRE(WTERMSIG(output.status) == SIGKILL);
+    REQUIRE(elapsed < 10s);
+}
+
+TEST_CASE("spawn_capture_through_spawn_server", "[spawn]") {
+    REQUIRE(spawn_server_start());
+    auto output = capture_shell("echo out; echo err >&2; exit 4");
+    REQUIRE(WEXITSTATUS(output.status) == 4);
+    REQUIRE(output.out == "out\n");
+    REQUIRE(output.err == "err\n");
+
+    output = capture_shell("sleep 30", 200ms);
+    REQUIRE(output.timed_out);
+    REQUIRE(WIFSIGNALED(output.status));
+    spawn_server_stop();
+}
+
+TEST_CASE("spawn_capture_writes_input", "[spawn]") {
+    char sh[] = "/bin/sh";
+    char flag[] = "-c";
+    char cat[] = "cat; echo done >&2";
+    char exit_early[] = "exit 3";
+    char *cat_argv[] = {sh, flag, cat, nullptr};
+    char *exit_argv[] = {sh, flag, exit_early, nullptr};
+    // More than a socket buffer, so it is written while the output is read
+    std::string input(1 << 20, 'x');
+
+    for (bool server : {false, true}) {
+        if (server)
+            REQUIRE(spawn_server_start());
+        else
+            spawn_server_stop();
+
+        auto output = spawn_capture(cat_argv, 10s, input);
+        REQUIRE(output.status == 0);
+        REQUIRE(output.out == input);
+        REQUIRE(output.err == "done\n");
+
+        // A command which does not read its input does not block the caller
+        output = spawn_capture(exit_argv, 10s, input);
+        REQUIRE_FALSE(output.timed_out);
+        REQUIRE(WEXITSTATUS(output.status) == 3);
+
+        // Without input stdin is closed
+        output = spawn_capture(cat_argv, 10s);
+        REQUIRE(output.out.empty());
+    }
+    spawn_server_stop();
+}
+
+TEST_CASE("spawn_blocking_timeout", "[spawn]") {
+    const char *argv[] = {"-c", "sleep 30"};
+    auto start = std::chrono::steady_clock::now();
+    int status = spawn_blocking("/bin/sh", 2, argv, nullptr, nullptr, 200ms);
+    REQUIRE(WIFSIGNALED(status));
+    REQUIRE(WTERMSIG(status) == SIGKILL);
+    REQUIRE(std::chrono::steady_clock::now() - start < 10s);
+
+    // A command which completes in time is not affected
+    const char *exit_argv[] = {"-c", "exit 3"};
+    status = spawn_blocking("/bin/sh", 2, exit_argv, nullptr, nullptr, 10s);
+    REQUIRE(WEXITSTATUS(status) == 3);
+
+    REQUIRE(spawn_server_start());
+    status = spawn_blocking("/bin/sh", 2, argv, nullptr, nullptr, 200ms);
+    REQUIRE(WIFSIGNALED(status));
+    spawn_server_stop();
+}
+
+TEST_CASE("spawn_capture_timeout_after_output_is_closed", "[spawn]") {
+    // The command closes its output before it completes, so the deadline
+    // must also apply to the wait
+    auto output = capture_shell("exec >&- 2>&-; sleep 30", 200ms);
+    REQUIRE(output.timed_out);
+    REQUIRE(WIFSIGNALED(output.status));
+}
+
+TEST_CASE("spawn_stream_reads_output_while_running", "[spawn]") {
+    const char *argv[] = {"/bin/sh", "-c", "echo first; echo err >&2; sleep 30",
+                          nullptr};
+    auto start = std::chrono::steady_clock::now();
+    auto stream = spawn_stream(const_cast<char *const *>(argv));
+    REQUIRE(stream.pid > 0);
+
+    char buffer[16];
+    std::string output;
+    while (output.find('\n') == std::string::npos) {
+        auto count = read(stream.out_fd, buffer, sizeof buffer);
+        REQUIRE(count > 0);
+        output.append(buffer, count);
+    }
+    REQUIRE(output == "first\n");
+
+    int status = spawn_stream_stop(stream);
+    REQUIRE(WIFSIGNALED(status));
+    REQUIRE(WTERMSIG(status) == SIGKILL);
+    REQUIRE(stream.pid == -1);
+    REQUIRE(stream.out_fd == -1);
+    REQUIRE(std::chrono::steady_clock::now() - start < 10s);
+}
@@ -0,0 +1,85 @@
+#include "../tmpdir.hpp"
+#include "catch2/catch.hpp"
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ert/job_queue/spawn.hpp>
+
+static std::string read_file(const std::string &path) {
+    std::ifstream stream{path};
+    return {std::istreambuf_iterator<char>(stream),
+            std::istreambuf_iterator<char>()};
+}
+
+static int run_shell(const char *script, const char *stdout_file = nullptr,
+                     const char *stderr_file = nullptr) {
+    const char *argv[] = {"-c", script};
+    return spawn_blocking("/bin/sh", 2, argv, stdout_file, stderr_file);
+}
+
+TEST_CASE("spawn_server_runs_commands", "[spawn_server]") {
+    WITH_TMPDIR;
+    REQUIRE(spawn_server_start());
+    REQUIRE(spawn_server_is_running());
+
+    int status = run_shell("exit 3");
+    REQUIRE(WIFEXITED(status));
+    REQUIRE(WEXITSTATUS(status) == 3);
+
+    // Relative redirections and the current directory are those of the caller
+    REQUIRE(run_shell("pwd; echo error >&2", "out.txt", "err.txt") == 0);
+    auto pwd = read_file("out.txt");
+    pwd.pop_back();
+    REQUIRE(std::filesystem::equivalent(pwd, std::filesystem::current_path()));
+    REQUIRE(read_file("err.txt") == "error\n");
+
+    // The environment of the caller is passed on
+    setenv("ERT_SPAWN_SERVER_TEST", "value", 1);
+    REQUIRE(run_shell("test \"$ERT_SPAWN_SERVER_TEST\" = value") == 0);
+
+    spawn_server_stop();
+    REQUIRE_FALSE(spawn_server_is_running());
+}
+
+TEST_CASE("spawn_server_command_not_found", "[spawn_server]") {
+    REQUIRE(spawn_server_start());
+    const char *argv[] = {"does-not-exist"};
+    REQUIRE_THROWS_AS(
+        spawn_blocking("ert-no-such-command", 1, argv, nullptr, nullptr),
+        std::runtime_error);
+    spawn_server_stop();
+}
+
+TEST_CASE("spawn_server_concurrent_commands", "[spawn_server]") {
+    REQUIRE(spawn_server_start());
+
+    std::vector<std::thread> threads;
+    std::vector<int> failures(8, 0);
+    for (int t = 0; t < 8; t++)
+        threads.emplace_back([t, &failures] {
+            for (int i = 0; i < 20; i++) {
+                auto script = "sleep 0.01; exit " + std::to_string(i % 4);
+                int status = run_shell(script.c_str());
+                if (!WIFEXITED(status) || WEXITSTATUS(status) != i % 4)
+                    failures[t]++;
+            }
+        });
+    for (auto &thread : threads)
+        thread.join();
+
+    for (int failed : failures)
+        REQUIRE(failed == 0);
+    spawn_server_stop();
+}
+
+TEST_CASE("spawn_blocking_without_spawn_server", "[spawn_server]") {
+    spawn_server_stop();
+    REQUIRE_FALSE(spawn_server_is_running());
+    int status = run_shell("exit 5");
+    REQUIRE(WEXITSTATUS(status) == 5);
+}
@@ -0,0 +1,113 @@
+#include "catch2/catch.hpp"
+#include <poll.h>
+#include <thread>
+#include <vector>
+
+#include <ert/job_queue/job_queue.hpp>
+#include <ert/job_queue/status_notifier.hpp>
+
+using status_change = ert::StatusNotifier::status_change;
+
+static bool is_readable(int fd) {
+    struct pollfd pfd = {fd, POLLIN, 0};
+    return poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLIN) != 0;
+}
+
+TEST_CASE("status_notifier_push_and_drain", "[status_notifier]") {
+    ert::StatusNotifier notifier;
+    std::vector<status_change> changes;
+
+    REQUIRE_FALSE(is_readable(notifier.fd()));
+    notifier.push(3, JOB_QUEUE_RUNNING);
+    notifier.push(4, JOB_QUEUE_DONE);
+    REQUIRE(is_readable(notifier.fd()));
+
+    REQUIRE(notifier.drain(changes));
+    REQUIRE_FALSE(is_readable(notifier.fd()));
+    REQUIRE(changes.size() == 2);
+    REQUIRE(changes[0].queue_index == 3);
+    REQUIRE(changes[0].status == JOB_QUEUE_RUNNING);
+    REQUIRE(changes[1].queue_index == 4);
+    REQUIRE(changes[1].status == JOB_QUEUE_DONE);
+
+    changes.clear();
+    REQUIRE(notifier.drain(changes));
+    REQUIRE(changes.empty());
+}
+
+TEST_CASE("status_notifier_many_producers", "[status_notifier]") {
+    const int num_producers = 4;
+    const int num_changes = 20000;
+    ert::StatusNotifier notifier;
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < num_producers; p++)
+        producers.emplace_back([&notifier, p] {
+            for (int i = 0; i < num_changes; i++) {
+                notifier.push(p * num_changes + i, JOB_QUEUE_RUNNING);
+                // Let the consumer keep up with the bounded ring
+                if (i % 1000 == 0)
+                    std::this_thread::yield();
+            }
+        });
+
+    std::vector<status_change> changes;
+    bool complete = true;
+    while (complete && changes.size() < num_producers * num_changes) {
+        struct pollfd pfd = {notifier.fd(), POLLIN, 0};
+        poll(&pfd, 1, 1000);
+        complete = notifier.drain(changes);
+    }
+    for (auto &producer : producers)
+        producer.join();
+    complete = notifier.drain(changes) && complete;
+
+    if (!complete)
+        WARN("The consumer could not keep up and changes were dropped");
+    else
+        REQUIRE(changes.size() == num_producers * num_changes);
+
+    // The changes from each producer arrive in the order they were pushed
+    std::vector<int> last(num_producers, -1);
+    for (const auto &change : changes) {
+        int producer = change.queue_index / num_changes;
+        REQUIRE(change.queue_index > last[producer]);
+        last[producer] = change.queue_index;
+    }
+}
+
+TEST_CASE("status_notifier_overflow", "[status_notifier]") {
+    ert::StatusNotifier notifier;
+    for (size_t i = 0; i <= ert::StatusNotifier::CAPACITY; i++)
+        notifier.push(static_cast<int>(i), JOB_QUEUE_PENDING);
+
+    std::vector<status_change> changes;
+    REQUIRE_FALSE(notifier.drain(changes));
+    REQUIRE(changes.size() == ert::StatusNotifier::CAPACITY);
+
+    changes.clear();
+    notifier.push(0, JOB_QUEUE_DONE);
+    REQUIRE(notifier.drain(changes));
+    REQUIRE(changes.size() == 1);
+}
+
+TEST_CASE("job_queue_reports_status_changes", "[status_notifier]") {
+    auto driver = queue_driver_alloc(LOCAL_DRIVER);
+    auto queue = job_queue_alloc(driver);
+    auto node = job_queue_node_alloc("name", "/tmp", "ls", 1);
+
+    int queue_index = job_queue_add_job_node(queue, node);
+    job_queue_node_set_status(node, JOB_QUEUE_RUNNING);
+    job_queue_node_set_status(node, JOB_QUEUE_RUNNING);
+    REQUIRE(is_readable(job_queue_get_status_notifier_fd(queue)));
+
+    std::vector<status_change> changes;
+    REQUIRE(job_queue_drain_status_changes(queue, changes));
+    REQUIRE(changes.size() == 2);
+    REQUIRE(changes[0].queue_index == queue_index);
+    REQUIRE(changes[0].status == JOB_QUEUE_WAITING);
+    REQUIRE(changes[1].status == JOB_QUEUE_RUNNING);
+
+    job_queue_free(queue);
+    queue_driver_free(driver);
+}
@@ -0,0 +1,66 @@
+#include "catch2/catch.hpp"
+#include <vector>
+
+#include <ert/job_queue/timing_wheel.hpp>
+
+using ert::TimingWheel;
+
+TEST_CASE("timing_wheel_expires_in_deadline_order", "[timing_wheel]") {
+    TimingWheel wheel;
+    wheel.schedule(1, 30);
+    wheel.schedule(2, 10);
+    wheel.schedule(3, 20);
+    REQUIRE(wheel.size() == 3);
+
+    std::vector<int> expired;
+    wheel.advance(15, expired);
+    REQUIRE(expired == std::vector<int>{2});
+
+    wheel.advance(30, expired);
+    REQUIRE(expired == std::vector<int>{2, 3, 1});
+    REQUIRE(wheel.size() == 0);
+}
+
+TEST_CASE("timing_wheel_deadline_in_the_past_expires_at_next_tick",
+          "[timing_wheel]") {
+    TimingWheel wheel(100);
+    wheel.schedule(1, 50);
+
+    std::vector<int> expired;
+    wheel.advance(100, expired);
+    REQUIRE(expired.empty());
+    wheel.advance(101, expired);
+    REQUIRE(expired == std::vector<int>{1});
+}
+
+TEST_CASE("timing_wheel_reschedule_and_cancel", "[timing_wheel]") {
+    TimingWheel wheel;
+    wheel.schedule(1, 10);
+    wheel.schedule(1, 5000);
+    wheel.schedule(2, 10);
+    wheel.cancel(2);
+    REQUIRE(wheel.is_scheduled(1));
+    REQUIRE_FALSE(wheel.is_scheduled(2));
+
+    std::vector<int> expired;
+    wheel.advance(4999, expired);
+    REQUIRE(expired.empty());
+    wheel.advance(5000, expired);
+    REQUIRE(expired == std::vector<int>{1});
+}
+
+TEST_CASE("timing_wheel_cascades_through_all_levels", "[timing_wheel]") {
+    // One deadline on each level, and one beyond the top level
+    std::vector<uint64_t> deadlines{9, 100, 10000, 1000000, 20000000};
+    TimingWheel wheel(7);
+    for (size_t id = 0; id < deadlines.size(); id++)
+        wheel.schedule(id, deadlines[id]);
+
+    for (size_t id = 0; id < deadlines.size(); id++) {
+        std::vector<int> expired;
+        wheel.advance(deadlines[id] - 1, expired);
+        REQUIRE(expired.empty());
+        wheel.advance(deadlines[id], expired);
+        REQUIRE(expired == std::vector<int>{static_cast<int>(id)});
+    }
+}
@@ -0,0 +1,39 @@
+#include "catch2/catch.hpp"
+#include <chrono>
+
+#include <ert/job_queue/token_bucket.hpp>
+
+using ert::TokenBucket;
+using namespace std::chrono_literals;
+
+TEST_CASE("token_bucket_allows_a_burst_and_then_the_rate",
+          "[token_bucket]") {
+    TokenBucket bucket(10.0, 3.0);
+    auto now = TokenBucket::clock::now() + 1s;
+    // The bucket starts full
+    for (int i = 0; i < 3; i++)
+        REQUIRE(bucket.reserve(now) == now);
+
+    // The callers are given the next tokens, 100 ms apart
+    REQUIRE(bucket.reserve(now) == now + 100ms);
+    REQUIRE(bucket.reserve(now) == now + 200ms);
+
+    // The owed tokens have been added after 200 ms, and one more after 300 ms
+    REQUIRE(bucket.reserve(now + 300ms) == now + 300ms);
+    REQUIRE(bucket.reserve(now + 300ms) == now + 400ms);
+}
+
+TEST_CASE("token_bucket_saves_up_at_most_burst_tokens", "[token_bucket]") {
+    TokenBucket bucket(10.0, 2.0);
+    auto now = TokenBucket::clock::now() + 10s;
+    REQUIRE(bucket.reserve(now) == now);
+    REQUIRE(bucket.reserve(now) == now);
+    REQUIRE(bucket.reserve(now) == now + 100ms);
+}
+
+TEST_CASE("token_bucket_without_a_rate_does_not_wait", "[token_bucket]") {
+    TokenBucket bucket;
+    auto now = TokenBucket::clock::now();
+    for (int i = 0; i < 100; i++)
+        REQUIRE(bucket.reserve(now) == now);
+}
@@ -0,0 +1,155 @@
+/*
+  Drives the slurm driver with many jobs against the Slurm emulator, and
+  reports the submission throughput and the cost of polling the status:
+
+    slurm_driver_benchmark [NUM_JOBS] [OPTION=VALUE]...
+
+  NUM_JOBS defaults to 10000. The options are given to the driver, e.g.
+  ARRAY_SUBMIT=TRUE, PACK_SIZE=10 or SQUEUE_TIMEOUT=1. The emulator is
+  configured with its SLURM_EMULATOR_* environment variables, see
+  slurm_emulator.cpp; its state is kept in a temporary directory which is
+  removed afterwards.
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <ert/job_queue/queue_driver.hpp>
+#include <ert/job_queue/slurm_driver.hpp>
+
+namespace fs = std::filesystem;
+using namespace std::chrono_literals;
+using clock_type = std::chrono::steady_clock;
+
+static double seconds_since(clock_type::time_point start) {
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+static bool is_active(job_status_type status) {
+    return status == JOB_QUEUE_PENDING || status == JOB_QUEUE_RUNNING ||
+           status == JOB_QUEUE_SUBMITTED || status == JOB_QUEUE_UNKNOWN;
+}
+
+/** The number of emulated commands of each kind and their total duration. */
+static void report_emulator_calls(const fs::path &calls_file) {
+    std::map<std::string, std::pair<int, double>> calls;
+    std::ifstream stream{calls_file};
+    std::string command;
+    double duration;
+    while (stream >> command >> duration) {
+        calls[command].first++;
+        calls[command].second += duration;
+    }
+    for (const auto &[name, count_duration] : calls)
+        fmt::print("  {:<8} {:>6} calls {:>10.3f} s\n", name,
+                   count_duration.first, count_duration.second);
+}
+
+int main(int argc, char **argv) {
+    size_t num_jobs = 10000;
+    std::vector<std::pair<std::string, std::string>> options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto sep = arg.find('=');
+        if (sep == std::string::npos)
+            num_jobs = std::stoul(arg);
+        else
+            options.emplace_back(arg.substr(0, sep), arg.substr(sep + 1));
+    }
+
+    char dir_template[] = "/tmp/slurm-driver-benchmark-XXXXXX";
+    if (mkdtemp(dir_template) == nullptr) {
+        fmt::print(stderr, "Unable to create a temporary directory\n");
+        return 1;
+    }
+    fs::path work_dir{dir_template};
+    setenv("SLURM_EMULATOR_DIR", work_dir.c_str(), 1);
+
+    auto *driver = queue_driver_alloc(SLURM_DRIVER);
+    for (const auto &[option, command] :
+         {std::pair{SLURM_SBATCH_OPTION, "sbatch"},
+          {SLURM_SQUEUE_OPTION, "squeue"},
+          {SLURM_SCONTROL_OPTION, "scontrol"},
+          {SLURM_SCANCEL_OPTION, "scancel"},
+          {SLURM_SACCT_OPTION, "sacct"}}) {
+        auto link = work_dir / command;
+        fs::create_symlink(SLURM_EMULATOR, link);
+        queue_driver_set_option(driver, option, link.c_str());
+    }
+    for (const auto &[key, value] : options)
+        if (!queue_driver_set_option(driver, key.c_str(), value.c_str())) {
+            fmt::print(stderr, "Invalid driver option {}={}\n", key, value);
+            return 1;
+        }
+
+    std::vector<queue_driver_submit_args> args;
+    for (size_t i = 0; i < num_jobs; i++) {
+        auto name = fmt::format("realization-{}", i);
+        args.push_back({"/bin/true", 1, work_dir / name, name});
+    }
+    std::vector<void *> jobs(num_jobs);
+
+    auto start = clock_type::now();
+    queue_driver_submit_job_batch(driver, args.data(), num_jobs, jobs.data());
+    double submit_time = seconds_since(start);
+    auto num_submitted =
+        num_jobs - std::count(jobs.begin(), jobs.end(), nullptr);
+    jobs.erase(std::remove(jobs.begin(), jobs.end(), nullptr), jobs.end());
+    fmt::print("Submitted {} of {} jobs in {:.3f} s, {:.1f} jobs/s\n",
+               num_submitted, num_jobs, submit_time,
+               num_submitted / submit_time);
+
+    // Poll the status as the job queue does, until all jobs have ended
+    std::vector<job_status_type> status(jobs.size());
+    std::vector<double> poll_times;
+    auto poll_start = clock_type::now();
+    while (true) {
+        auto call_start = clock_type::now();
+        queue_driver_get_status_batch(driver, jobs.data(), jobs.size(),
+                                      status.data());
+        poll_times.push_back(seconds_since(call_start));
+        if (std::none_of(status.begin(), status.end(), is_active))
+            break;
+        std::this_thread::sleep_for(100ms);
+    }
+    double poll_time = seconds_since(poll_start);
+
+    std::map<job_status_type, int> final_status;
+    for (auto job_status : status)
+        final_status[job_status]++;
+    // The first call waits for the first snapshot of the poller
+    auto steady_polls = std::vector<double>(
+        poll_times.begin() + std::min<size_t>(1, poll_times.size()),
+        poll_times.end());
+    double total = 0.0;
+    for (auto time : steady_polls)
+        total += time;
+    fmt::print("All jobs ended after {:.3f} s\n", poll_time);
+    fmt::print("First status call {:.6f} s, {} more calls: "
+               "mean {:.6f} s, max {:.6f} s\n",
+               poll_times.front(), steady_polls.size(),
+               steady_polls.empty() ? 0.0 : total / steady_polls.size(),
+               steady_polls.empty() ? 0.0
+                                    : *std::max_element(steady_polls.begin(),
+                                                        steady_polls.end()));
+    for (const auto &[job_status, count] : final_status)
+        fmt::print("  status {:>5}: {} jobs\n", static_cast<int>(job_status),
+                   count);
+
+    for (auto job : jobs)
+        queue_driver_free_job(driver, job);
+    queue_driver_free(driver);
+
+    fmt::print("Emulated Slurm commands:\n");
+    report_emulator_calls(work_dir / "slurm-emulator.calls");
+    fs::remove_all(work_dir);
+    return 0;
+}
@@ -0,0 +1,714 @@
+/*
+  An emulator of the Slurm commands used by the slurm driver: sbatch, squeue,
+  scontrol, scancel and sacct. It lets the driver be load tested with many
+  thousands of jobs without a cluster, see slurm_driver_benchmark.cpp.
+
+  The emulator is invoked through a symlink with the name of the command, or
+  as 'slurm_emulator <command> <args>'. It runs nothing: sbatch records the
+  job in a state file, and the state of a job is worked out from its submit
+  time whenever it is asked for. The state files are kept in the directory
+  $SLURM_EMULATOR_DIR, or in the current directory:
+
+    slurm-emulator.jobs     One line per sbatch call: id, submit time, array
+                            range, job name and the names of the srun steps.
+    slurm-emulator.cancels  One line per scancel argument: id and time.
+    slurm-emulator.next_id  The id of the next job.
+    slurm-emulator.calls    One line per command: name and duration.
+
+  The behaviour is configured with environment variables, the times are in
+  seconds:
+
+    SLURM_EMULATOR_LATENCY              Delay of each command, default 0.
+    SLURM_EMULATOR_QUEUE_DELAY          Mean time pending, default 1.
+    SLURM_EMULATOR_RUNTIME              Mean time running, default 5.
+    SLURM_EMULATOR_FAILURE_RATE         Fraction of jobs which fail,
+                                        default 0.
+    SLURM_EMULATOR_SUBMIT_FAILURE_RATE  Fraction of sbatch calls which fail,
+                                        default 0.
+    SLURM_EMULATOR_FALLOUT              Time after the end of a job when
+                                        squeue and scontrol no longer know
+                                        it, default 300.
+    SLURM_EMULATOR_ACCOUNTING           Whether sacct is available, default 1.
+
+  The time pending and running of each job is drawn between half and one and
+  a half times the mean, from a hash of the job id, so that every command
+  sees the same history.
+*/
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/file.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <fmt/format.h>
+
+namespace {
+
+struct Config {
+    std::string dir;
+    double latency = 0.0;
+    double queue_delay = 1.0;
+    double runtime = 5.0;
+    double failure_rate = 0.0;
+    double submit_failure_rate = 0.0;
+    double fallout = 300.0;
+    bool accounting = true;
+};
+
+double env_number(const char *name, double default_value) {
+    const char *value = getenv(name);
+    if (value == nullptr || *value == '\0')
+        return default_value;
+    return std::strtod(value, nullptr);
+}
+
+Config load_config() {
+    Config config;
+    const char *dir = getenv("SLURM_EMULATOR_DIR");
+    config.dir = dir != nullptr && *dir != '\0' ? dir : ".";
+    config.latency = env_number("SLURM_EMULATOR_LATENCY", config.latency);
+    config.queue_delay =
+        env_number("SLURM_EMULATOR_QUEUE_DELAY", config.queue_delay);
+    config.runtime = env_number("SLURM_EMULATOR_RUNTIME", config.runtime);
+    config.failure_rate =
+        env_number("SLURM_EMULATOR_FAILURE_RATE", config.failure_rate);
+    config.submit_failure_rate = env_number(
+        "SLURM_EMULATOR_SUBMIT_FAILURE_RATE", config.submit_failure_rate);
+    config.fallout = env_number("SLURM_EMULATOR_FALLOUT", config.fallout);
+    config.accounting = env_number("SLURM_EMULATOR_ACCOUNTING", 1) != 0;
+    return config;
+}
+
+std::string state_file(const Config &config, const char *name) {
+    return config.dir + "/slurm-emulator." + name;
+}
+
+double now() {
+    return std::chrono::duration<double>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+/** A number in [0, 1) which is fixed for the job, task and purpose. */
+double job_random(long job_id, int task, int purpose) {
+    uint64_t x = (static_cast<uint64_t>(job_id) << 24) ^
+                 (static_cast<uint64_t>(task) << 4) ^ purpose;
+    // The splitmix64 finalizer
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return static_cast<double>(x >> 11) / static_cast<double>(1ULL << 53);
+}
+
+enum purpose { QUEUE_DELAY, RUNTIME, FAILURE, MAX_RSS, NODE };
+
+/** What sbatch recorded about a job. */
+struct Submission {
+    long id = 0;
+    double submit = 0.0;
+    /** The first and last task of a job array, or -1. */
+    int first_task = -1;
+    int last_task = -1;
+    std::string name;
+    /** The names of the srun steps in the submit script. */
+    std::vector<std::string> steps;
+};
+
+std::vector<Submission> load_submissions(const Config &config) {
+    std::vector<Submission> submissions;
+    std::ifstream stream{state_file(config, "jobs")};
+    for (std::string line; std::getline(stream, line);) {
+        std::istringstream fields{line};
+        Submission submission;
+        std::string tasks;
+        std::string steps;
+        if (!(fields >> submission.id >> submission.submit >> tasks >>
+              submission.name >> steps))
+            continue; // A line which is still being written
+        if (tasks != "-")
+            sscanf(tasks.c_str(), "%d-%d", &submission.first_task,
+                   &submission.last_task);
+        if (steps != "-") {
+            std::istringstream step_names{steps};
+            for (std::string step; std::getline(step_names, step, ',');)
+                submission.steps.push_back(step);
+        }
+        submissions.push_back(std::move(submission));
+    }
+    return submissions;
+}
+
+/** The earliest time each id was given to scancel. */
+std::map<std::string, double> load_cancels(const Config &config) {
+    std::map<std::string, double> cancels;
+    std::ifstream stream{state_file(config, "cancels")};
+    std::string id;
+    double time;
+    while (stream >> id >> time) {
+        auto [iter, inserted] = cancels.emplace(id, time);
+        if (!inserted)
+            iter->second = std::min(iter->second, time);
+    }
+    return cancels;
+}
+
+void append_line(const std::string &path, const std::string &line) {
+    // One write to a file opened for appending, so that the lines of
+    // concurrent commands do not interleave
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0)
+        throw std::runtime_error("Unable to open " + path);
+    auto written = write(fd, line.data(), line.size());
+    close(fd);
+    if (written != static_cast<ssize_t>(line.size()))
+        throw std::runtime_error("Unable to write to " + path);
+}
+
+/** The history of a job, an array task, a pack step or the batch step. */
+struct Timeline {
+    double submit = 0.0;
+    double start = 0.0;
+    double end = 0.0;
+    bool failed = false;
+    std::optional<double> cancelled;
+    double max_rss = 0.0;
+    int node = 0;
+};
+
+std::optional<double>
+first_cancel(const std::map<std::string, double> &cancels,
+             std::initializer_list<std::string> ids) {
+    std::optional<double> first;
+    for (const auto &id : ids)
+        if (auto iter = cancels.find(id); iter != cancels.end())
+            first = std::min(first.value_or(iter->second), iter->second);
+    return first;
+}
+
+struct Step {
+    std::string id;
+    std::string name;
+    Timeline timeline;
+};
+
+struct Unit {
+    std::string id;
+    std::string name;
+    Timeline timeline;
+    /** The srun steps of a pack, which start with the unit. */
+    std::vector<Step> steps;
+};
+
+/**
+  The units which are scheduled on their own: jobs, array tasks, and the
+  allocations of packs, with their steps.
+*/
+std::vector<Unit> load_units(const Config &config) {
+    auto cancels = load_cancels(config);
+    std::vector<Unit> units;
+    for (const auto &submission : load_submissions(config)) {
+        auto job_id = std::to_string(submission.id);
+        bool array = submission.first_task >= 0;
+        int last_task = array ? submission.last_task : 0;
+        for (int task = array ? submission.first_task : 0; task <= last_task;
+             task++) {
+            Unit unit;
+            unit.id = array ? fmt::format("{}_{}", job_id, task) : job_id;
+            unit.name = submission.name;
+            auto &timeline = unit.timeline;
+            timeline.submit = submission.submit;
+            timeline.start =
+                submission.submit +
+                config.queue_delay *
+                    (0.5 + job_random(submission.id, task, QUEUE_DELAY));
+            timeline.end =
+                timeline.start +
+                config.runtime *
+                    (0.5 + job_random(submission.id, task, RUNTIME));
+            timeline.failed = job_random(submission.id, task, FAILURE) <
+                              config.failure_rate;
+            timeline.cancelled = first_cancel(cancels, {job_id, unit.id});
+            timeline.max_rss =
+                1024 * (1 + job_random(submission.id, task, MAX_RSS));
+            timeline.node =
+                static_cast<int>(100 * job_random(submission.id, task, NODE));
+
+            if (!submission.steps.empty()) {
+                // The allocation lasts until its last step has ended
+                timeline.end = timeline.start;
+                timeline.failed = false;
+                for (size_t index = 0; index < submission.steps.size();
+                     index++) {
+                    auto step_id = fmt::format("{}.{}", unit.id, index);
+                    int step_task = static_cast<int>(index) + 1;
+                    auto step = timeline;
+                    step.end = timeline.start +
+                               config.runtime *
+                                   (0.5 + job_random(submission.id, step_task,
+                                                     RUNTIME));
+                    step.failed =
+                        job_random(submission.id, step_task, FAILURE) <
+                        config.failure_rate;
+                    step.cancelled =
+                        first_cancel(cancels, {job_id, unit.id, step_id});
+                    step.max_rss =
+                        1024 * (1 + job_random(submission.id, step_task,
+                                               MAX_RSS));
+                    auto step_end = std::min(
+                        step.end, step.cancelled.value_or(step.end));
+                    timeline.end =
+                        std::max(timeline.end, std::max(step_end, step.start));
+                    unit.steps.push_back(
+                        {step_id, submission.steps[index], step});
+                }
+            }
+            units.push_back(std::move(unit));
+        }
+    }
+    return units;
+}
+
+struct State {
+    std::string name;
+    std::string exit_code = "0:0";
+    bool started = false;
+    /** The end of the job, if it has ended. */
+    std::optional<double> end;
+};
+
+State job_state(const Timeline &timeline, double time) {
+    State state;
+    if (timeline.cancelled && *timeline.cancelled < timeline.end) {
+        if (*timeline.cancelled <= time) {
+            state.name = "CANCELLED";
+            state.exit_code = "0:15";
+            state.started = timeline.start < *timeline.cancelled;
+            state.end = *timeline.cancelled;
+            return state;
+        }
+    }
+    if (time < timeline.start) {
+        state.name = "PENDING";
+        return state;
+    }
+    state.started = true;
+    if (time < timeline.end) {
+        state.name = "RUNNING";
+        return state;
+    }
+    state.end = timeline.end;
+    state.name = timeline.failed ? "FAILED" : "COMPLETED";
+    state.exit_code = timeline.failed ? "1:0" : "0:0";
+    return state;
+}
+
+bool fallen_out(const Config &config, const State &state, double time) {
+    return state.end && *state.end + config.fallout < time;
+}
+
+std::string format_time(double time) {
+    auto seconds = static_cast<time_t>(time);
+    struct tm parts;
+    gmtime_r(&seconds, &parts);
+    char buffer[32];
+    strftime(buffer, sizeof buffer, "%Y-%m-%dT%H:%M:%S", &parts);
+    return buffer;
+}
+
+std::string format_duration(double duration) {
+    auto seconds = static_cast<long>(std::max(duration, 0.0));
+    auto days = seconds / 86400;
+    auto clock = fmt::format("{:02}:{:02}:{:02}", seconds % 86400 / 3600,
+                             seconds % 3600 / 60, seconds % 60);
+    return days > 0 ? fmt::format("{}-{}", days, clock) : clock;
+}
+
+std::string format_node(int node) { return fmt::format("emu{:03}", node); }
+
+/** The value of an option given as --name=value or as --name value. */
+std::optional<std::string> option_value(const std::vector<std::string> &args,
+                                        size_t &index,
+                                        std::initializer_list<const char *>
+                                            names) {
+    const auto &arg = args[index];
+    for (const char *name : names) {
+        std::string prefix = std::string(name) + "=";
+        if (arg.rfind(prefix, 0) == 0)
+            return arg.substr(prefix.size());
+        if (arg == name && index + 1 < args.size())
+            return args[++index];
+    }
+    return std::nullopt;
+}
+
+std::set<std::string> split_list(const std::string &list) {
+    std::set<std::string> items;
+    std::istringstream stream{list};
+    for (std::string item; std::getline(stream, item, ',');)
+        if (!item.empty())
+            items.insert(item);
+    return items;
+}
+
+/** Whether the listed ids select the unit, by its own id or its job id. */
+bool selected(const std::set<std::string> &ids, const std::string &unit_id) {
+    return ids.empty() || ids.count(unit_id) > 0 ||
+           ids.count(unit_id.substr(0, unit_id.find('_'))) > 0;
+}
+
+int sbatch(const Config &config, const std::vector<std::string> &args) {
+    Submission submission;
+    submission.name = "sbatch";
+    bool parsable = false;
+    std::string script_file;
+    std::vector<std::string> options;
+    for (size_t index = 0; index < args.size(); index++) {
+        if (args[index] == "--parsable")
+            parsable = true;
+        else if (args[index][0] != '-' && script_file.empty())
+            script_file = args[index];
+        else
+            options.push_back(args[index]);
+    }
+
+    std::string script;
+    if (script_file.empty())
+        script.assign(std::istreambuf_iterator<char>(std::cin),
+                      std::istreambuf_iterator<char>());
+    else {
+        std::ifstream stream{script_file};
+        script.assign(std::istreambuf_iterator<char>(stream),
+                      std::istreambuf_iterator<char>());
+    }
+
+    // The #SBATCH options of the script come before those of the command
+    std::vector<std::string> all_options;
+    std::istringstream lines{script};
+    for (std::string line; std::getline(lines, line);) {
+        std::istringstream words{line};
+        std::string word;
+        words >> word;
+        if (word == "#SBATCH") {
+            while (words >> word)
+                all_options.push_back(word);
+        } else if (line.find("srun ") != std::string::npos) {
+            std::string step_name = "srun";
+            while (words >> word)
+                if (word.rfind("--job-name=", 0) == 0)
+                    step_name = word.substr(11);
+            submission.steps.push_back(step_name);
+        }
+    }
+    all_options.insert(all_options.end(), options.begin(), options.end());
+    for (size_t index = 0; index < all_options.size(); index++) {
+        if (auto name = option_value(all_options, index, {"--job-name", "-J"}))
+            submission.name = *name;
+        else if (auto array =
+                     option_value(all_options, index, {"--array", "-a"})) {
+            if (sscanf(array->c_str(), "%d-%d", &submission.first_task,
+                       &submission.last_task) == 1)
+                submission.last_task = submission.first_task;
+        }
+    }
+    std::replace_if(
+        submission.name.begin(), submission.name.end(),
+        [](char c) { return isspace(static_cast<unsigned char>(c)); }, '_');
+
+    std::random_device random;
+    if (std::uniform_real_distribution<double>(0, 1)(random) <
+        config.submit_failure_rate) {
+        std::cerr << "sbatch: error: Batch job submission failed: Resource "
+                     "temporarily unavailable\n";
+        return 1;
+    }
+
+    auto lock_path = state_file(config, "lock");
+    int lock_fd = open(lock_path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (lock_fd < 0 || flock(lock_fd, LOCK_EX) != 0) {
+        std::cerr << "sbatch: error: Unable to lock " << lock_path << "\n";
+        return 1;
+    }
+    auto id_path = state_file(config, "next_id");
+    std::ifstream{id_path} >> submission.id;
+    submission.id = std::max(submission.id, 1L);
+    std::ofstream{id_path} << submission.id + 1 << "\n";
+
+    std::string steps;
+    for (const auto &step : submission.steps)
+        steps += (steps.empty() ? "" : ",") + step;
+    append_line(state_file(config, "jobs"),
+                fmt::format("{} {:.3f} {} {} {}\n", submission.id, now(),
+                            submission.first_task < 0
+                                ? std::string("-")
+                                : fmt::format("{}-{}", submission.first_task,
+                                              submission.last_task),
+                            submission.name, steps.empty() ? "-" : steps));
+    close(lock_fd);
+
+    if (parsable)
+        fmt::print("{}\n", submission.id);
+    else
+        fmt::print("Submitted batch job {}\n", submission.id);
+    return 0;
+}
+
+/** Formats a squeue line, with the %i, %j and %T fields of the format. */
+std::string squeue_line(const std::string &format, const Unit &unit,
+                        const State &state) {
+    std::string line;
+    for (size_t index = 0; index < format.size(); index++) {
+        if (format[index] != '%' || index + 1 == format.size()) {
+            line += format[index];
+            continue;
+        }
+        switch (format[++index]) {
+        case 'i':
+            line += unit.id;
+            break;
+        case 'j':
+            line += unit.name;
+            break;
+        case 'T':
+            line += state.name;
+            break;
+        default:
+            line += format.substr(index - 1, 2);
+        }
+    }
+    return line;
+}
+
+int squeue(const Config &config, const std::vector<std::string> &args) {
+    bool header = true;
+    std::string format = "%i %j %T";
+    std::set<std::string> ids;
+    std::set<std::string> states = {"PENDING", "RUNNING", "COMPLETING"};
+    int iterate = 0;
+    for (size_t index = 0; index < args.size(); index++) {
+        if (args[index] == "-h" || args[index] == "--noheader")
+            header = false;
+        else if (auto value = option_value(args, index, {"--format", "-o"}))
+            format = *value;
+        else if (auto value = option_value(args, index, {"--jobs", "-j"}))
+            ids = split_list(*value);
+        else if (auto value = option_value(args, index, {"--states", "-t"}))
+            states = split_list(*value);
+        else if (auto value = option_value(args, index, {"--iterate", "-i"}))
+            iterate = std::max(atoi(value->c_str()), 1);
+    }
+
+    while (true) {
+        auto time = now();
+        std::string listing;
+        if (header)
+            listing += "JOBID NAME STATE\n";
+        for (const auto &unit : load_units(config)) {
+            if (!selected(ids, unit.id))
+                continue;
+            auto state = job_state(unit.timeline, time);
+            if (states.count(state.name) > 0 &&
+                !fallen_out(config, state, time))
+                listing += squeue_line(format, unit, state) + "\n";
+        }
+        fmt::print("{}", listing);
+        if (iterate == 0)
+            return 0;
+
+        fmt::print("\n");
+        fflush(stdout);
+        std::this_thread::sleep_for(std::chrono::seconds(iterate));
+    }
+}
+
+int scontrol(const Config &config, const std::vector<std::string> &args) {
+    if (args.size() < 3 || args[0] != "show" || args[1] != "jobid") {
+        std::cerr << "scontrol: only 'scontrol show jobid <id>' is emulated\n";
+        return 1;
+    }
+
+    auto time = now();
+    std::set<std::string> ids{args[2]};
+    std::string output;
+    for (const auto &unit : load_units(config)) {
+        if (!selected(ids, unit.id))
+            continue;
+        const auto &timeline = unit.timeline;
+        auto state = job_state(timeline, time);
+        if (fallen_out(config, state, time))
+            continue;
+        auto end = state.end.value_or(time);
+        output += fmt::format(
+            "JobId={} JobName={}\n"
+            "   UserId=emulator(1000) GroupId=emulator(1000)\n"
+            "   JobState={} Reason=None Dependency=(null)\n"
+            "   Requeue=1 Restarts=0 BatchFlag=1 Reboot=0 ExitCode={}\n"
+            "   RunTime={} TimeLimit=UNLIMITED TimeMin=N/A\n"
+            "   SubmitTime={} EligibleTime={}\n"
+            "   StartTime={} EndTime={}\n"
+            "   NodeList={}\n\n",
+            unit.id, unit.name, state.name, state.exit_code,
+            format_duration(state.started ? end - timeline.start : 0),
+            format_time(timeline.submit), format_time(timeline.submit),
+            state.started ? format_time(timeline.start) : "Unknown",
+            state.end ? format_time(*state.end) : "Unknown",
+            state.started ? format_node(timeline.node) : "(null)");
+    }
+    if (output.empty()) {
+        std::cerr << "slurm_load_jobs error: Invalid job id specified\n";
+        return 1;
+    }
+    fmt::print("{}", output);
+    return 0;
+}
+
+int scancel(const Config &config, const std::vector<std::string> &args) {
+    std::string lines;
+    for (const auto &arg : args)
+        if (arg[0] != '-')
+            lines += fmt::format("{} {:.3f}\n", arg, now());
+    append_line(state_file(config, "cancels"), lines);
+    return 0;
+}
+
+/** A sacct line with the fields of the format, separated by '|'. */
+std::string sacct_line(const std::vector<std::string> &fields,
+                       const std::string &id, const std::string &name,
+                       const Timeline &timeline, bool step, double time) {
+    auto state = job_state(timeline, time);
+    auto end = state.end.value_or(time);
+    std::string line;
+    for (const auto &field : fields) {
+        if (&field != &fields.front())
+            line += "|";
+        if (field == "JobID")
+            line += id;
+        else if (field == "JobName")
+            line += name;
+        else if (field == "State")
+            line += state.name == "CANCELLED" ? "CANCELLED by 1000"
+                                              : state.name;
+        else if (field == "ExitCode")
+            line += state.exit_code;
+        else if (field == "Elapsed")
+            line += format_duration(state.started ? end - timeline.start : 0);
+        else if (field == "MaxRSS" && step && state.started)
+            line += fmt::format("{}K", std::lround(timeline.max_rss));
+        else if (field == "NodeList")
+            line += state.started ? format_node(timeline.node)
+                                  : "None assigned";
+        else if (field == "Submit")
+            line += format_time(timeline.submit);
+        else if (field == "Start")
+            line += state.started ? format_time(timeline.start) : "Unknown";
+        else if (field == "End")
+            line += state.end ? format_time(*state.end) : "Unknown";
+    }
+    return line + "\n";
+}
+
+int sacct(const Config &config, const std::vector<std::string> &args) {
+    if (!config.accounting) {
+        std::cerr << "sacct: error: Slurm accounting storage is disabled\n";
+        return 1;
+    }
+
+    bool header = true;
+    std::vector<std::string> fields = {"JobID", "JobName", "State",
+                                       "ExitCode"};
+    std::set<std::string> ids;
+    for (size_t index = 0; index < args.size(); index++) {
+        if (args[index] == "-n" || args[index] == "--noheader")
+            header = false;
+        else if (auto value = option_value(args, index, {"--format", "-o"})) {
+            fields.clear();
+            std::istringstream stream{*value};
+            for (std::string field; std::getline(stream, field, ',');)
+                fields.push_back(field);
+        } else if (auto value = option_value(args, index, {"--jobs", "-j"}))
+            ids = split_list(*value);
+    }
+
+    auto time = now();
+    std::string output;
+    if (header) {
+        for (const auto &field : fields)
+            output += (&field == &fields.front() ? "" : "|") + field;
+        output += "\n";
+    }
+    for (const auto &unit : load_units(config)) {
+        if (!selected(ids, unit.id))
+            continue;
+        output += sacct_line(fields, unit.id, unit.name, unit.timeline, false,
+                             time);
+        if (!job_state(unit.timeline, time).started)
+            continue;
+        output += sacct_line(fields, unit.id + ".batch", "batch",
+                             unit.timeline, true, time);
+        for (const auto &step : unit.steps)
+            output += sacct_line(fields, step.id, step.name, step.timeline,
+                                 true, time);
+    }
+    fmt::print("{}", output);
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string command = argv[0];
+    command = command.substr(command.rfind('/') + 1);
+    std::vector<std::string> args(argv + 1, argv + argc);
+    if (command == "slurm_emulator" && !args.empty()) {
+        command = args.front();
+        args.erase(args.begin());
+    }
+
+    auto config = load_config();
+    auto start = now();
+    if (config.latency > 0)
+        std::this_thread::sleep_for(
+            std::chrono::duration<double>(config.latency));
+
+    int status;
+    try {
+        if (command == "sbatch")
+            status = sbatch(config, args);
+        else if (command == "squeue")
+            status = squeue(config, args);
+        else if (command == "scontrol")
+            status = scontrol(config, args);
+        else if (command == "scancel")
+            status = scancel(config, args);
+        else if (command == "sacct")
+            status = sacct(config, args);
+        else {
+            std::cerr << "Usage: slurm_emulator "
+                         "sbatch|squeue|scontrol|scancel|sacct [args]\n";
+            return 2;
+        }
+        append_line(state_file(config, "calls"),
+                    fmt::format("{} {:.6f}\n", command, now() - start));
+    } catch (std::exception &exc) {
+        std::cerr << command << ": error: " << exc.what() << "\n";
+        return 1;
+    }
+    return status;
+}
@@ -17,6 +17,7 @@
 
 import ert.shared
 from _ert.threading import set_signal_handler
+from ert._clib.queue import _start_spawn_server
 from ert.cli import (
     ENSEMBLE_EXPERIMENT_MODE,
     ENSEMBLE_SMOOTHER_MODE,
@@ -638,6 +639,11 @@ def main() -> None:
     # Have ErtThread re-raise uncaught exceptions on main thread
     set_signal_handler()
 
+    # The spawn server is forked while the process is still small, so that
+    # queue system commands do not have to fork the full ert process
+    if os.environ.get("ERT_SPAWN_SERVER", "").lower() in ("1", "true"):
+        _start_spawn_server()
+
     args = ert_parser(None, sys.argv[1:])
 
     log_dir = os.path.abspath(args.logdir)
@@ -214,6 +214,7 @@ def parse_torque_memopt(s: str) -> str:
         "SBATCH",
         "SCANCEL",
         "SCONTROL",
+        "SACCT",
         "SQUEUE",
         "PARTITION",
         "INCLUDE_HOST",
@@ -236,9 +237,12 @@ def parse_torque_memopt(s: str) -> str:
     "LSF": [
         "BJOBS_TIMEOUT",
         "MAX_RUNNING",
+        "SUBMIT_WORKERS",
+        "SUBMIT_BURST",
     ],
     "SLURM": [
         "MAX_RUNNING",
+        "PACK_SIZE",
     ],
     "TORQUE": [
         "NUM_NODES",
@@ -251,18 +255,21 @@ def parse_torque_memopt(s: str) -> str:
 queue_positive_number_options: Mapping[str, List[str]] = {
     "LSF": [
         "SUBMIT_SLEEP",
+        "COMMAND_TIMEOUT",
+        "SUBMIT_RATE",
     ],
     "SLURM": [
         "SQUEUE_TIMEOUT",
         "MAX_RUNTIME",
+        "COMMAND_TIMEOUT",
     ],
-    "TORQUE": ["SUBMIT_SLEEP", "QUEUE_QUERY_TIMEOUT"],
+    "TORQUE": ["SUBMIT_SLEEP", "QUEUE_QUERY_TIMEOUT", "COMMAND_TIMEOUT"],
     "LOCAL": [],
 }
 
 queue_bool_options: Mapping[str, List[str]] = {
-    "LSF": ["DEBUG_OUTPUT"],
-    "SLURM": [],
+    "LSF": ["DEBUG_OUTPUT", "BJOBS_JSON", "ARRAY_SUBMIT", "PERSISTENT_SHELL"],
+    "SLURM": ["ARRAY_SUBMIT", "SQUEUE_ITERATE"],
     "TORQUE": ["KEEP_QSUB_OUTPUT"],
     "LOCAL": [],
 }
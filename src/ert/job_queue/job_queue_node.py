@@ -1,17 +1,19 @@
 from __future__ import annotations
 
 import logging
-import random
 import time
-from threading import Lock, Semaphore, Thread
-from typing import TYPE_CHECKING, Callable, Optional
+from threading import Lock, Semaphore
+from typing import TYPE_CHECKING, Any, Callable, Dict, Optional
 
 from cwrap import BaseCClass
 
-from _ert.threading import ErtThread
-
 # pylint: disable=import-error
-from ert._clib.queue import _get_submit_attempt, _kill, _refresh_status, _submit
+from ert._clib.queue import (
+    _get_accounting,
+    _get_submit_attempt,
+    _refresh_status,
+    _submit,
+)
 from ert.callbacks import forward_model_ok
 from ert.load_status import LoadStatus
 from ert.storage.realization_storage_state import RealizationStorageState
@@ -28,33 +30,9 @@
 
 logger = logging.getLogger(__name__)
 
-
-class _BackoffFunction:
-    def __init__(
-        self,
-        time_sleep_seconds: int = 1,
-        max_sleep_seconds: int = 30,
-        time_until_longer_sleep_seconds: int = 30,
-        use_random_sleep_offset: bool = False,
-    ) -> None:
-        self.max_sleep_seconds = max_sleep_seconds
-        self.time_until_longer_sleep_seconds = time_until_longer_sleep_seconds
-        self.use_random_sleep_offset = use_random_sleep_offset
-        self.time_sleep_seconds = time_sleep_seconds
-
-    def __call__(
-        self,
-        elapsed_time: float,
-    ) -> int:
-        if (
-            self.time_sleep_seconds != self.max_sleep_seconds
-            and elapsed_time > self.time_until_longer_sleep_seconds
-        ):
-            self.time_sleep_seconds = self.max_sleep_seconds
-            self.use_random_sleep_offset = True
-        return self.time_sleep_seconds + self.use_random_sleep_offset * random.randint(
-            -5, 5
-        )
+KILL_RETRY_INTERVAL = 1
+"""Seconds between the requests to kill a job run by the polling engine, while
+it keeps running."""
 
 
 class JobQueueNode(BaseCClass):  # type: ignore
@@ -69,7 +47,8 @@ class JobQueueNode(BaseCClass):  # type: ignore
         "job_status_type_enum job_queue_node_get_status(job_queue_node)"
     )
     _set_queue_status = ResPrototype(
-        "void job_queue_node_set_status(job_queue_node, job_status_type_enum)"
+        "void job_queue_node_lock_and_set_status(job_queue_node, "
+        "job_status_type_enum)"
     )
 
     def __init__(
@@ -84,9 +63,9 @@ def __init__(
         self.run_arg = run_arg
 
         self.thread_status: ThreadStatus = ThreadStatus.READY
-        self._thread: Optional[Thread] = None
         self._mutex = Lock()
         self._tried_killing = 0
+        self._next_kill_time = 0.0
 
         self._max_runtime = max_runtime
         self._start_time: Optional[float] = None
@@ -143,6 +122,14 @@ def queue_status(self) -> JobStatus:
     def queue_status(self, value: JobStatus) -> None:
         return self._set_queue_status(value)
 
+    def accounting(self, driver: "Driver") -> Optional[Dict[str, Any]]:
+        """What the queue system has recorded about the resources used by the
+        job: exit_code, exit_signal, elapsed and pending_time in seconds,
+        max_rss in bytes and node_list, each None when not reported. None if
+        the driver records no accounting, currently all but Slurm, and LSF
+        with BJOBS_JSON."""
+        return _get_accounting(self, driver)
+
     def submit(self, driver: "Driver") -> SubmitStatus:
         return SubmitStatus(_submit(self, driver))
 
@@ -186,44 +173,6 @@ def runtime(self) -> float:
 
         return self._end_time - self._start_time
 
-    def _job_monitor(
-        self, driver: "Driver", pool_sema: Semaphore, max_submit: int
-    ) -> None:
-        submit_status = self.submit(driver)
-        if submit_status is not SubmitStatus.OK:
-            self.queue_status = JobStatus.DONE  #  type: ignore
-
-        end_status = self._poll_until_done(driver)
-        self._handle_end_status(driver, pool_sema, end_status, max_submit)
-
-    def _poll_until_done(self, driver: Driver) -> JobStatus:
-        current_status = self._poll_queue_status(driver)
-        backoff = _BackoffFunction()
-        # in the following loop, we increase the sleep time between loop iterations as
-        # long running realizations do not change state often, and too frequent querying
-        # with many realizations starves other threads for resources.
-        while self.is_running(current_status):
-            if self._start_time is None and current_status == JobStatus.RUNNING:
-                self._start_time = time.time()
-            if self._start_time is not None:
-                elapsed_time = time.time() - self._start_time
-            else:
-                elapsed_time = 0.0
-            time.sleep(backoff(elapsed_time))
-            if self._exceeded_allowed_runtime():
-                self._kill(driver)
-                self._log_kill_timeout_status()
-                self.run_timeout_callback()
-                with self._mutex:
-                    self._timed_out = True
-            elif self.thread_status == ThreadStatus.STOPPING:
-                self._kill(driver)
-                self._log_kill_thread_stopping_status()
-
-            current_status = self._poll_queue_status(driver)
-        self._end_time = time.time()
-        return current_status
-
     def _exceeded_allowed_runtime(self) -> bool:
         return self._max_runtime is not None and self.runtime >= self._max_runtime
 
@@ -325,24 +274,66 @@ def _transition_status(
 
         self.thread_status = thread_status
 
-    def _kill(self, driver: "Driver") -> None:
-        _kill(self, driver)
-        self._tried_killing += 1
-
-    def run(self, driver: "Driver", pool_sema: Semaphore, max_submit: int = 2) -> None:
-        # Prevent multiple threads working on the same object
-        self.wait_for()
-        # Do not start if already kill signal is sent
-        if self.thread_status == ThreadStatus.STOPPING:
-            self.thread_status = ThreadStatus.DONE
-            return
-
+    def launch(self) -> None:
+        """Prepares the job to be submitted by the polling engine of the
+        queue, which submits, polls and kills it; see on_engine_transition()
+        and engine_kill_due()."""
         self.thread_status = ThreadStatus.RUNNING
         self._start_time = None
-        self._thread = ErtThread(
-            target=self._job_monitor, args=(driver, pool_sema, max_submit)
-        )
-        self._thread.start()
+        self._end_time = None
+
+    def on_engine_transition(
+        self, status: JobStatus, message: Optional[str]
+    ) -> Optional[JobStatus]:
+        """Records a change of status observed by the polling engine. Returns
+        the end status when the job has stopped running, which must then be
+        handled with handle_engine_end_status(), and None otherwise."""
+        if message is not None:
+            self._status_msg = message
+        if status == JobStatus.WAITING:
+            # The engine has failed to submit the job
+            self.queue_status = JobStatus.DONE  # type: ignore
+            status = JobStatus.DONE  # type: ignore
+        if self._start_time is None and status == JobStatus.RUNNING:
+            self._start_time = time.time()
+        if self.is_running(status) or self._end_time is not None:
+            return None
+        self._end_time = time.time()
+        return status
+
+    def handle_engine_end_status(
+        self,
+        driver: "Driver",
+        pool_sema: Semaphore,
+        end_status: JobStatus,
+        max_submit: int,
+    ) -> None:
+        self._handle_end_status(driver, pool_sema, end_status, max_submit)
+
+    def engine_kill_due(self) -> bool:
+        """Whether the polling engine should be asked to kill the job, because
+        it has exceeded its MAX_RUNTIME or it is stopping. The request is
+        repeated every KILL_RETRY_INTERVAL seconds while the job is running."""
+        if (
+            self.thread_status not in (ThreadStatus.RUNNING, ThreadStatus.STOPPING)
+            or self._end_time is not None
+            or time.time() < self._next_kill_time
+        ):
+            return False
+
+        if self._exceeded_allowed_runtime():
+            self._tried_killing += 1
+            self._log_kill_timeout_status()
+            self.run_timeout_callback()
+            with self._mutex:
+                self._timed_out = True
+        elif self.thread_status == ThreadStatus.STOPPING:
+            self._tried_killing += 1
+            self._log_kill_thread_stopping_status()
+        else:
+            return False
+        self._next_kill_time = time.time() + KILL_RETRY_INTERVAL
+        return True
 
     def stop(self) -> None:
         with self._mutex:
@@ -359,6 +350,3 @@ def stop(self) -> None:
                 ThreadStatus.FAILED,
             ]
 
-    def wait_for(self) -> None:
-        if self._thread is not None and self._thread.is_alive():
-            self._thread.join()
@@ -10,7 +10,8 @@
 import logging
 import ssl
 from collections import deque
-from threading import BoundedSemaphore, Semaphore
+from concurrent.futures import Future, ThreadPoolExecutor
+from threading import BoundedSemaphore
 from typing import TYPE_CHECKING, Callable, Dict, List, Optional, Sequence, Tuple, Union
 
 from cloudevents.conversion import to_json
@@ -20,6 +21,16 @@
 from websockets.datastructures import Headers
 from websockets.exceptions import ConnectionClosed
 
+from ert._clib.queue import (
+    _drain_status_changes,
+    _engine_kill,
+    _engine_start,
+    _engine_stop,
+    _engine_submit_many,
+    _engine_transitions,
+    _status_counts,
+    _status_notifier_fd,
+)
 from ert.config import QueueConfig
 from ert.constant_filenames import CERT_FILE, JOBS_FILE
 from ert.event_type_constants import (
@@ -55,6 +66,12 @@
 CONCURRENT_INTERNALIZATION = 1
 """How many realizations allowed to be concurrently internalized using
 threads."""
+MAX_STATUS_WAIT = 1
+"""Longest time in seconds execute() waits for a status change before it
+checks the queue anyway, e.g. to launch jobs or stop long running ones."""
+ENGINE_WORKERS = 4
+"""How many threads the native polling engine uses to submit, poll and kill
+the jobs, and how many threads handle the jobs which have stopped running."""
 
 
 _queue_state_to_event_type_map = {
@@ -130,6 +147,8 @@ def __init__(
         self._changes_to_publish: Optional[
             asyncio.Queue[Union[Dict[int, str], object]]
         ] = None
+        self._end_status_executor: Optional[ThreadPoolExecutor] = None
+        self._end_status_futures: List[Future[None]] = []
 
         for real in realizations or []:
             self.add_realization(real)
@@ -161,7 +180,12 @@ def fetch_next_waiting(self) -> Optional[JobQueueNode]:
         return None
 
     def count_status(self, status: JobStatus) -> int:
-        return len([job for job in self.job_list if job.queue_status == status])
+        return self.status_counts()[status.value]
+
+    def status_counts(self) -> Dict[int, int]:
+        """The number of jobs in each queue status, keyed by the status value."""
+        counts: Dict[int, int] = _status_counts(self)
+        return counts
 
     @property
     def stopped(self) -> bool:
@@ -197,6 +221,8 @@ async def stop_jobs(self) -> None:
         for job in self.job_list:
             job.stop()
         while self.is_active():
+            if self._end_status_executor is not None:
+                self._drive_engine()
             await asyncio.sleep(1)
 
     def assert_complete(self) -> None:
@@ -208,17 +234,56 @@ def assert_complete(self) -> None:
                 )
                 raise AssertionError(msg.format(job.queue_status, job.thread_status))
 
-    def launch_jobs(self, pool_sema: Semaphore) -> None:
-        # Start waiting jobs
-        while self.available_capacity():
-            job = self.fetch_next_waiting()
-            if job is None:
+    def launch_jobs(self) -> None:
+        """Submits as many waiting jobs as there is capacity for through the
+        polling engine, all in one call, so that the driver can submit them
+        together, e.g. as one job array."""
+        if not self.available_capacity():
+            return
+        capacity = self.max_running() - self.count_running()
+        jobs: List[JobQueueNode] = []
+        for job in self.job_list:
+            if len(jobs) >= capacity:
                 break
-            job.run(
-                driver=self.driver,
-                pool_sema=pool_sema,
-                max_submit=self.max_submit,
-            )
+            if job.thread_status == ThreadStatus.READY:
+                jobs.append(job)
+        for job in jobs:
+            job.launch()
+        if jobs:
+            _engine_submit_many(self, jobs)
+
+    def _drive_engine(self) -> None:
+        """Passes the status changes observed by the polling engine on to the
+        jobs, hands the jobs which have stopped running to the end status
+        threads, and asks the engine to kill the jobs which have exceeded
+        their MAX_RUNTIME or are stopping."""
+        assert self._end_status_executor is not None
+        for queue_index, status, message in _engine_transitions(self):
+            job = self.job_list[queue_index]
+            end_status = job.on_engine_transition(JobStatus(status), message)
+            if end_status is not None:
+                self._end_status_futures.append(
+                    self._end_status_executor.submit(
+                        job.handle_engine_end_status,
+                        self.driver,
+                        self._pool_sema,
+                        end_status,
+                        self.max_submit,
+                    )
+                )
+
+        for job in self.job_list:
+            if job.engine_kill_due():
+                _engine_kill(self, job)
+
+    def _raise_end_status_errors(self) -> None:
+        pending = []
+        for future in self._end_status_futures:
+            if future.done():
+                future.result()
+            else:
+                pending.append(future)
+        self._end_status_futures = pending
 
     @staticmethod
     def _translate_change_to_cloudevent(
@@ -293,12 +358,39 @@ async def execute(
         self._changes_to_publish = asyncio.Queue()
         asyncio.create_task(self._jobqueue_publisher())
 
+        # The C++ side signals the notifier fd whenever a node changes status,
+        # so the loop wakes up as soon as there is something to publish.
+        loop = asyncio.get_running_loop()
+        status_changed = asyncio.Event()
+
+        def _on_status_change() -> None:
+            _drain_status_changes(self)
+            status_changed.set()
+
+        notifier_fd = _status_notifier_fd(self)
+        loop.add_reader(notifier_fd, _on_status_change)
+
+        # The jobs are submitted, polled and killed by the native polling
+        # engine; a job only needs a thread of its own once it has stopped
+        # running, e.g. to load its results.
+        _engine_start(self, ENGINE_WORKERS)
+        self._end_status_executor = ThreadPoolExecutor(max_workers=ENGINE_WORKERS)
+
         try:
             await self._changes_to_publish.put(self._differ.snapshot())
             while True:
-                self.launch_jobs(self._pool_sema)
+                self.launch_jobs()
+
+                try:
+                    await asyncio.wait_for(
+                        status_changed.wait(), timeout=MAX_STATUS_WAIT
+                    )
+                except asyncio.TimeoutError:
+                    pass
+                status_changed.clear()
 
-                await asyncio.sleep(1)
+                self._drive_engine()
+                self._raise_end_status_errors()
 
                 if min_required_realizations > 0:
                     self.stop_long_running_jobs(min_required_realizations)
@@ -325,6 +417,12 @@ async def execute(
             await self.stop_jobs()
             logger.debug("jobs stopped, re-raising exception")
             return EVTYPE_ENSEMBLE_FAILED
+        finally:
+            loop.remove_reader(notifier_fd)
+            _engine_stop(self)
+            self._end_status_executor.shutdown(wait=False)
+            self._end_status_executor = None
+            self._end_status_futures = []
 
         if not self.stopped:
             self.assert_complete()
@@ -2,35 +2,19 @@
 import json
 import os
 import stat
-import time
 from pathlib import Path
-from threading import BoundedSemaphore
 from typing import Any, Callable, Dict, List, Optional
 from unittest.mock import MagicMock, patch
 
 import pytest
 
+from ert._clib.queue import _engine_submit_many
 from ert.config import QueueConfig, QueueSystem
-from ert.job_queue import Driver, JobQueue, JobQueueNode, JobStatus
+from ert.job_queue import JobQueue, JobQueueNode, JobStatus, ThreadStatus
 from ert.run_arg import RunArg
 from ert.storage import Ensemble
 
 
-def wait_for(
-    func: Callable, target: Any = True, interval: float = 0.1, timeout: float = 30
-):
-    """Sleeps (with timeout) until the provided function returns the provided target"""
-    t = 0.0
-    while func() != target:
-        time.sleep(interval)
-        t += interval
-        if t >= timeout:
-            raise AssertionError(
-                "Timeout reached in wait_for "
-                f"(function {func.__name__}, timeout {timeout}) "
-            )
-
-
 DUMMY_CONFIG: Dict[str, Any] = {
     "job_script": "job_script.py",
     "num_cpu": 1,
@@ -112,32 +96,69 @@ def test_execute(tmpdir, monkeypatch, mock_fm_ok, simple_script):
     assert len(mock_fm_ok.mock_calls) == len(job_queue.job_list)
 
 
-def start_all(job_queue, sema_pool):
-    job = job_queue.fetch_next_waiting()
-    while job is not None:
-        job.run(job_queue.driver, sema_pool, job_queue.max_submit)
-        job = job_queue.fetch_next_waiting()
+def test_execute_submits_the_waiting_jobs_together(
+    tmpdir, monkeypatch, mock_fm_ok, simple_script
+):
+    monkeypatch.chdir(tmpdir)
+    job_queue = create_local_queue(simple_script)
+    with patch(
+        "ert.job_queue.queue._engine_submit_many", wraps=_engine_submit_many
+    ) as submit_many:
+        asyncio.run(job_queue.execute())
+
+    # The engine hands all the jobs to the driver in one batch
+    assert submit_many.call_count == 1
+    assert len(submit_many.call_args.args[1]) == len(job_queue.job_list)
+    assert len(mock_fm_ok.mock_calls) == len(job_queue.job_list)
 
 
-def test_kill_jobs(tmpdir, monkeypatch, never_ending_script):
+def test_execute_kills_jobs_after_max_runtime(
+    tmpdir, monkeypatch, never_ending_script
+):
     monkeypatch.chdir(tmpdir)
-    job_queue = create_local_queue(never_ending_script)
-
-    assert job_queue.queue_size == 10
-    assert job_queue.is_active()
+    mock_callback = MagicMock()
+    job_queue = create_local_queue(
+        never_ending_script,
+        num_realizations=2,
+        max_runtime=2,
+        callback_timeout=mock_callback,
+    )
+    asyncio.run(job_queue.execute())
 
-    pool_sema = BoundedSemaphore(value=10)
-    start_all(job_queue, pool_sema)
+    for job in job_queue.job_list:
+        assert job.timed_out
+        assert job.queue_status == JobStatus.IS_KILLED
+    assert mock_callback.call_count >= 2
 
-    # Make sure NEVER_ENDING_SCRIPT has started:
-    wait_for(job_queue.is_active)
 
-    # Ask the job to stop:
+async def stop_jobs_when(job_queue, predicate):
+    """Stops all the jobs of the queue once the predicate holds for each"""
+    while not all(predicate(job) for job in job_queue.job_list):
+        await asyncio.sleep(0.1)
     for job in job_queue.job_list:
         job.stop()
 
-    wait_for(job_queue.is_active, target=False)
 
+def execute_and_stop_jobs_when(job_queue, predicate, timeout: float = 30):
+    async def _run():
+        await asyncio.gather(job_queue.execute(), stop_jobs_when(job_queue, predicate))
+
+    asyncio.run(asyncio.wait_for(_run(), timeout))
+
+
+def test_kill_jobs(tmpdir, monkeypatch, never_ending_script):
+    monkeypatch.chdir(tmpdir)
+    job_queue = create_local_queue(never_ending_script)
+
+    assert job_queue.queue_size == 10
+    assert job_queue.is_active()
+
+    # Ask the jobs to stop once NEVER_ENDING_SCRIPT has started:
+    execute_and_stop_jobs_when(
+        job_queue, lambda job: job.queue_status == JobStatus.RUNNING
+    )
+
+    assert not job_queue.is_active()
     job_queue._differ.transition(job_queue.job_list)
 
     for q_index, job in enumerate(job_queue.job_list):
@@ -145,9 +166,6 @@ def test_kill_jobs(tmpdir, monkeypatch, never_ending_script):
         iens = job_queue._differ.qindex_to_iens(q_index)
         assert job_queue.snapshot()[iens] == str(JobStatus.IS_KILLED)
 
-    for job in job_queue.job_list:
-        job.wait_for()
-
 
 def test_add_jobs(tmpdir, monkeypatch, simple_script):
     monkeypatch.chdir(tmpdir)
@@ -157,16 +175,12 @@ def test_add_jobs(tmpdir, monkeypatch, simple_script):
     assert job_queue.is_active()
     assert job_queue.fetch_next_waiting() is not None
 
-    pool_sema = BoundedSemaphore(value=10)
-    start_all(job_queue, pool_sema)
-
-    for job in job_queue.job_list:
-        job.stop()
-
-    wait_for(job_queue.is_active, target=False)
+    execute_and_stop_jobs_when(
+        job_queue, lambda job: job.thread_status != ThreadStatus.READY
+    )
 
-    for job in job_queue.job_list:
-        job.wait_for()
+    assert not job_queue.is_active()
+    assert job_queue.fetch_next_waiting() is None
 
 
 def test_failing_jobs(tmpdir, monkeypatch, failing_script):
@@ -176,14 +190,9 @@ def test_failing_jobs(tmpdir, monkeypatch, failing_script):
     assert job_queue.queue_size == 10
     assert job_queue.is_active()
 
-    pool_sema = BoundedSemaphore(value=10)
-    start_all(job_queue, pool_sema)
-
-    wait_for(job_queue.is_active, target=False)
-
-    for job in job_queue.job_list:
-        job.wait_for()
+    asyncio.run(job_queue.execute())
 
+    assert not job_queue.is_active()
     job_queue._differ.transition(job_queue.job_list)
 
     assert job_queue.fetch_next_waiting() is None
@@ -209,26 +218,19 @@ def test_timeout_jobs(tmpdir, monkeypatch, never_ending_script):
     assert job_queue.queue_size == 10
     assert job_queue.is_active()
 
-    pool_sema = BoundedSemaphore(value=10)
-    start_all(job_queue, pool_sema)
-
-    # Make sure NEVER_ENDING_SCRIPT jobs have started:
-    wait_for(job_queue.is_active)
-
-    # Wait for the timeout to kill them:
-    wait_for(job_queue.is_active, target=False)
+    # The engine kills the jobs once they have timed out
+    asyncio.run(asyncio.wait_for(job_queue.execute(), 30))
 
     job_queue._differ.transition(job_queue.job_list)
 
     for q_index, job in enumerate(job_queue.job_list):
+        assert job.timed_out
         assert job.queue_status == JobStatus.IS_KILLED
         iens = job_queue._differ.qindex_to_iens(q_index)
         assert job_queue.snapshot()[iens] == str(JobStatus.IS_KILLED)
 
-    assert len(mock_callback.mock_calls) == 20
-
-    for job in job_queue.job_list:
-        job.wait_for()
+    # The timeout callback is called at least once for each job
+    assert mock_callback.call_count >= len(job_queue.job_list)
 
 
 def test_add_dispatch_info(tmpdir, monkeypatch, simple_script):
@@ -397,7 +399,6 @@ def test_num_cpu_submitted_correctly_lsf(tmpdir, simple_script):
     """Assert that num_cpu from the ERT configuration is passed on to the bsub
     command used to submit jobs to LSF"""
     os.putenv("PATH", os.getcwd() + ":" + os.getenv("PATH"))
-    driver = Driver(driver_type=QueueSystem.LSF)
 
     bsub = Path("bsub")
     bsub.write_text(MOCK_BSUB, encoding="utf-8")
@@ -420,10 +421,9 @@ def test_num_cpu_submitted_correctly_lsf(tmpdir, simple_script):
         ),
     )
 
-    pool_sema = BoundedSemaphore(value=2)
-    job.run(driver, pool_sema)
-    job.stop()
-    job.wait_for()
+    job_queue = JobQueue(QueueConfig(queue_system=QueueSystem.LSF))
+    job_queue.add_job(job, job_id)
+    asyncio.run(job_queue.execute())
 
     bsub_argv: List[str] = Path("test.out").read_text(encoding="utf-8").split()
 
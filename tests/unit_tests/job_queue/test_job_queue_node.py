@@ -12,6 +12,7 @@
 import pytest
 from hypothesis import HealthCheck, given, settings
 
+from ert._clib.queue import _refresh_status, _refresh_status_many
 from ert.config import QueueConfig, QueueSystem
 from ert.job_queue.driver import Driver
 from ert.job_queue.job_queue_node import JobQueueNode
@@ -118,6 +119,13 @@ def test_submit_attempt_is_initially_zero(job_queue_node):
     assert job_queue_node.submit_attempt == 0
 
 
+@given(st.lists(job_queue_nodes, max_size=5), drivers)
+def test_refresh_status_many_gives_same_result_as_refresh_status(nodes, driver):
+    assert _refresh_status_many(nodes, driver) == [
+        _refresh_status(node, driver) for node in nodes
+    ]
+
+
 @pytest.mark.usefixtures("use_tmpdir")
 @settings(max_examples=10, suppress_health_check=[HealthCheck.function_scoped_fixture])
 @given(job_queue_nodes, drivers.filter(lambda d: d.name != "LOCAL"))
@@ -202,7 +210,7 @@ def test_submitting_updates_status(tmp_path, job_queue_node, driver, jobid, data
     )
     assert job_queue_node.submit(driver) == SubmitStatus.OK
     assert job_queue_node.submit_attempt == 1
-    job_queue_node._poll_until_done(driver)
+    job_queue_node._poll_queue_status(driver)
     assert job_queue_node.queue_status == JobStatus.DONE
 
 
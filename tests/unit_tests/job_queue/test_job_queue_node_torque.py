@@ -1,14 +1,14 @@
+import asyncio
 import os
 import stat
 from pathlib import Path
-from threading import BoundedSemaphore
-from typing import TypedDict
+from typing import List, Tuple, TypedDict
 from unittest.mock import MagicMock
 
 import pytest
 
-from ert.config import QueueSystem
-from ert.job_queue import Driver, JobQueueNode, JobStatus
+from ert.config import QueueConfig, QueueSystem
+from ert.job_queue import JobQueue, JobQueueNode, JobStatus
 from ert.run_arg import RunArg
 from ert.storage import Ensemble
 
@@ -131,6 +131,21 @@ def _build_jobqueuenode(job_script, dummy_config: JobConfig, job_id=0):
     return job, runpath
 
 
+def _run_job(
+    job: JobQueueNode, queue_options: List[Tuple[str, str]], max_submit: int = 2
+):
+    """Runs the job to its end in a Torque queue of its own"""
+    job_queue = JobQueue(
+        QueueConfig(
+            queue_system=QueueSystem.TORQUE,
+            max_submit=max_submit,
+            queue_options={QueueSystem.TORQUE: queue_options},
+        )
+    )
+    job_queue.add_job(job, 0)
+    asyncio.run(job_queue.execute())
+
+
 @pytest.mark.usefixtures("use_tmpdir")
 @pytest.mark.parametrize(
     "qsub_script, qstat_script",
@@ -165,14 +180,8 @@ def test_run_torque_job(
     _deploy_script("qsub", qsub_script)
     _deploy_script("qstat", qstat_script)
 
-    driver = Driver(
-        driver_type=QueueSystem.TORQUE,
-        options=[("QSTAT_CMD", temp_working_directory / "qstat")],
-    )
-
     job, runpath = _build_jobqueuenode(simple_script, dummy_config)
-    job.run(driver, BoundedSemaphore())
-    job.wait_for()
+    _run_job(job, [("QSTAT_CMD", str(temp_working_directory / "qstat"))])
 
     # This file is supposed created by the job that the qsub script points to,
     # but here it is created by the mocked qsub.
@@ -206,18 +215,15 @@ def test_that_torque_driver_passes_options_to_qstat(
         + "echo $@ > qstat_options",
     )
 
-    driver = Driver(
-        driver_type=QueueSystem.TORQUE,
-        options=[
-            ("QSTAT_CMD", temp_working_directory / "qstat"),
+    job, _runpath = _build_jobqueuenode(simple_script, dummy_config)
+    _run_job(
+        job,
+        [
+            ("QSTAT_CMD", str(temp_working_directory / "qstat")),
             ("QSTAT_OPTIONS", user_qstat_option),
         ],
     )
 
-    job, _runpath = _build_jobqueuenode(simple_script, dummy_config)
-    job.run(driver, BoundedSemaphore())
-    job.wait_for()
-
     assert Path("qstat_options").read_text(encoding="utf-8").strip() == expected_options
 
 
@@ -226,11 +232,11 @@ def test_that_torque_driver_passes_options_to_qstat(
     "job_state, exit_status, expected_status",
     [
         ("E", 0, JobStatus.SUCCESS),
-        ("E", 1, JobStatus.EXIT),
+        ("E", 1, JobStatus.FAILED),
         ("F", 0, JobStatus.SUCCESS),
-        ("F", 1, JobStatus.EXIT),
+        ("F", 1, JobStatus.FAILED),
         ("C", 0, JobStatus.SUCCESS),
-        ("C", 1, JobStatus.EXIT),
+        ("C", 1, JobStatus.FAILED),
     ],
 )
 def test_torque_job_status_from_qstat_output(
@@ -248,14 +254,10 @@ def test_torque_job_status_from_qstat_output(
         + create_qstat_f_output(state=job_state, exit_status=exit_status, bash=True),
     )
 
-    driver = Driver(
-        driver_type=QueueSystem.TORQUE,
-        options=[("QSTAT_CMD", temp_working_directory / "qstat")],
-    )
-
     job, _runpath = _build_jobqueuenode(simple_script, dummy_config)
 
-    pool_sema = BoundedSemaphore(value=2)
-    job.run(driver, pool_sema)
-    job.wait_for()
+    # A job which exits at its last submission is FAILED
+    _run_job(
+        job, [("QSTAT_CMD", str(temp_working_directory / "qstat"))], max_submit=1
+    )
     assert job.queue_status == expected_status